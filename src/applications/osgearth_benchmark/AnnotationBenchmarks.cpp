@@ -0,0 +1,340 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Annotation benchmarks: place culling and decluttering, and track
+ * updates.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Random>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ScreenSpaceLayout>
+#include <osgEarth/URI>
+#include <osgEarth/Notify>
+#include <osgEarthSymbology/Style>
+#include <osgEarthAnnotation/PlaceNode>
+#include <osgEarthAnnotation/PlaceBatchNode>
+#include <osgEarthAnnotation/TrackNode>
+#include <osgEarthAnnotation/TrackBatchNode>
+#include <osg/Timer>
+#include <osgUtil/CullVisitor>
+#include <osgUtil/UpdateVisitor>
+#include <osgUtil/RenderStage>
+#include <osgUtil/StateGraph>
+#include <iostream>
+#include <iomanip>
+
+#define LC "[benchmark] "
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Annotation;
+
+// Counts the render leaves (draw calls) in a render bin and its children.
+unsigned
+countRenderLeaves(osgUtil::RenderBin* bin)
+{
+    unsigned count = bin->getRenderLeafList().size();
+
+    for(osgUtil::RenderBin::StateGraphList::const_iterator i = bin->getStateGraphList().begin(); i != bin->getStateGraphList().end(); ++i)
+        count += (*i)->_leaves.size();
+
+    for(osgUtil::RenderBin::RenderBinList::iterator i = bin->getRenderBinList().begin(); i != bin->getRenderBinList().end(); ++i)
+        count += countRenderLeaves( i->second.get() );
+
+    return count;
+}
+
+// Runs cull traversals of a graph through a camera, the way SceneView
+// does, and returns the average time of a cull and sort in seconds.
+double
+cullAndSort(osg::Node* root, osg::Camera* camera, unsigned iterations, unsigned& leaves)
+{
+    osg::ref_ptr<osgUtil::CullVisitor> cv = new osgUtil::CullVisitor();
+    osg::ref_ptr<osgUtil::StateGraph> stateGraph = new osgUtil::StateGraph();
+    osg::ref_ptr<osgUtil::RenderStage> renderStage = new osgUtil::RenderStage();
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp();
+
+    cv->setStateGraph( stateGraph.get() );
+    cv->setRenderStage( renderStage.get() );
+    cv->setFrameStamp( frameStamp.get() );
+    cv->setComputeNearFarMode( osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR );
+
+    double total = 0.0;
+
+    for(unsigned i = 0; i <= iterations; ++i)
+    {
+        frameStamp->setFrameNumber( i );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        cv->reset();
+        stateGraph->clean();
+        renderStage->reset();
+        renderStage->setCamera( camera );
+        renderStage->setViewport( camera->getViewport() );
+        cv->setTraversalNumber( i );
+
+        cv->pushViewport( camera->getViewport() );
+        cv->pushProjectionMatrix( new osg::RefMatrix(camera->getProjectionMatrix()) );
+        cv->pushModelViewMatrix( new osg::RefMatrix(camera->getViewMatrix()), osg::Transform::ABSOLUTE_RF );
+
+        root->accept( *cv );
+
+        cv->popModelViewMatrix();
+        cv->popProjectionMatrix();
+        cv->popViewport();
+
+        // the declutter bin does its work when sorted.
+        renderStage->sort();
+        stateGraph->prune();
+
+        // the first traversal builds per-camera data.
+        if ( i > 0 )
+            total += osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+    }
+
+    leaves = countRenderLeaves( renderStage.get() );
+    return total / (double)iterations;
+}
+
+int
+benchmarkPlaces(osg::ArgumentParser& arguments)
+{
+    unsigned count = 20000;
+    arguments.read("--count", count);
+
+    unsigned iterations = 20;
+    arguments.read("--iterations", iterations);
+
+    std::string iconFile;
+    arguments.read("--icon", iconFile);
+
+    unsigned numIcons = 0;
+    arguments.read("--icons", numIcons);
+
+    std::vector< osg::ref_ptr<osg::Image> > icons;
+    if ( !iconFile.empty() )
+    {
+        osg::ref_ptr<osg::Image> icon = URI(iconFile).getImage();
+        if ( !icon.valid() )
+        {
+            OE_WARN << LC << "Failed to load " << iconFile << std::endl;
+            return 1;
+        }
+        icons.push_back( icon.get() );
+    }
+    else
+    {
+        // distinct images, so each one would need a texture of its own.
+        for(unsigned i = 0; i < numIcons; ++i)
+        {
+            int size = 16 + (i % 5) * 8;
+            osg::Image* icon = new osg::Image();
+            icon->allocateImage( size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+            icon->setInternalTextureFormat( GL_RGBA8 );
+            for(int t = 0; t < size; ++t)
+            {
+                for(int s = 0; s < size; ++s)
+                {
+                    unsigned char* p = icon->data(s, t);
+                    p[0] = (unsigned char)(i * 37);
+                    p[1] = (unsigned char)(i * 91);
+                    p[2] = (unsigned char)(s * 255 / size);
+                    p[3] = 255;
+                }
+            }
+            icons.push_back( icon );
+        }
+    }
+
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+
+    Style style;
+    TextSymbol* text = style.getOrCreate<TextSymbol>();
+    text->size() = 14.0f;
+    text->halo()->color() = Color::Black;
+
+    // places scattered over a 20 degree square, seen from above its center.
+    Random prng(1234);
+    std::vector<GeoPoint> points;
+    std::vector<std::string> labels;
+    for(unsigned i = 0; i < count; ++i)
+    {
+        points.push_back( GeoPoint(wgs84, -100.0 + prng.next()*20.0, 30.0 + prng.next()*20.0, 0.0, ALTMODE_ABSOLUTE) );
+        labels.push_back( Stringify() << "Place " << i );
+    }
+
+    osg::Vec3d center, eye;
+    GeoPoint(wgs84, -90.0, 40.0, 0.0, ALTMODE_ABSOLUTE).toWorld( center );
+    GeoPoint(wgs84, -90.0, 40.0, 3000000.0, ALTMODE_ABSOLUTE).toWorld( eye );
+
+    osg::ref_ptr<osg::Camera> camera = new osg::Camera();
+    camera->setViewport( 0, 0, 1920, 1080 );
+    camera->setProjectionMatrixAsPerspective( 45.0, 1920.0/1080.0, 1000.0, 1e7 );
+    camera->setViewMatrixAsLookAt( eye, center, osg::Vec3d(0,0,1) );
+
+    osg::ref_ptr<osgUtil::UpdateVisitor> update = new osgUtil::UpdateVisitor();
+
+    // one node per place.
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::Group> nodes = new osg::Group();
+    for(unsigned i = 0; i < count; ++i)
+    {
+        if ( !icons.empty() )
+            nodes->addChild( new PlaceNode(0L, points[i], icons[i % icons.size()].get(), labels[i], style) );
+        else
+            nodes->addChild( new PlaceNode(0L, points[i], labels[i], style) );
+    }
+    nodes->accept( *update );
+    double nodesBuild = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+    // one batch for all of them.
+    start = osg::Timer::instance()->tick();
+    osg::ref_ptr<PlaceBatchNode> batch = new PlaceBatchNode( 0L );
+    for(unsigned i = 0; i < count; ++i)
+    {
+        batch->addPlace( points[i], labels[i], style, icons.empty() ? 0L : icons[i % icons.size()].get() );
+    }
+    batch->accept( *update );
+    double batchBuild = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+    unsigned nodesLeaves, batchLeaves;
+    double nodesCull = cullAndSort( nodes.get(), camera.get(), iterations, nodesLeaves );
+    double batchCull = cullAndSort( batch.get(), camera.get(), iterations, batchLeaves );
+
+    std::cout << std::fixed << std::setprecision(2)
+        << count << " places with " << icons.size() << " icons (" << batch->getIconAtlas()->getNumPages() << " atlas pages), 1920x1080 view, "
+        << "decluttering " << (ScreenSpaceLayout::isDeclutteringEnabled() ? "on" : "off") << "\n\n"
+        << "                      build ms   cull+sort ms   draw calls\n"
+        << "  PlaceNodes:      " << std::setw(11) << nodesBuild*1000.0 << std::setw(15) << nodesCull*1000.0 << std::setw(13) << nodesLeaves << "\n"
+        << "  PlaceBatchNode:  " << std::setw(11) << batchBuild*1000.0 << std::setw(15) << batchCull*1000.0 << std::setw(13) << batchLeaves << "\n"
+        << std::endl;
+
+    return 0;
+}
+
+int
+benchmarkTracks(osg::ArgumentParser& arguments)
+{
+    unsigned count = 10000;
+    arguments.read("--count", count);
+
+    unsigned iterations = 100;
+    arguments.read("--iterations", iterations);
+
+    double fraction = 1.0;
+    arguments.read("--fraction", fraction);
+
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+
+    osg::ref_ptr<osg::Image> icon = new osg::Image();
+    icon->allocateImage( 32, 32, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    memset( icon->data(), 0xff, icon->getTotalSizeInBytes() );
+
+    // tracks scattered over a 20 degree square, at cruising altitudes.
+    Random prng(1234);
+    std::vector<double> x(count), y(count), z(count);
+    std::vector<float> headings(count);
+    for(unsigned i = 0; i < count; ++i)
+    {
+        x[i] = -100.0 + prng.next()*20.0;
+        y[i] = 30.0 + prng.next()*20.0;
+        z[i] = 5000.0 + prng.next()*7000.0;
+        headings[i] = prng.next()*360.0;
+    }
+
+    // the tracks that move each frame.
+    unsigned numMoving = osg::clampBetween( (unsigned)(fraction * (double)count), 1u, count );
+    std::vector<unsigned> ids(numMoving);
+    std::vector<double> mx(numMoving), my(numMoving), mz(numMoving);
+    std::vector<float> mh(numMoving);
+    for(unsigned i = 0; i < numMoving; ++i)
+        ids[i] = (unsigned)(((unsigned long long)i * count) / numMoving);
+
+    osg::ref_ptr<osgUtil::UpdateVisitor> update = new osgUtil::UpdateVisitor();
+
+    // one node per track.
+    osg::ref_ptr<osg::Group> nodes = new osg::Group();
+    std::vector<TrackNode*> trackNodes;
+    for(unsigned i = 0; i < count; ++i)
+    {
+        TrackNode* node = new TrackNode( 0L, GeoPoint(wgs84, x[i], y[i], z[i], ALTMODE_ABSOLUTE), icon.get(), TrackNodeFieldSchema() );
+        nodes->addChild( node );
+        trackNodes.push_back( node );
+    }
+
+    // one batch for all of them.
+    osg::ref_ptr<TrackBatchNode> batch = new TrackBatchNode( 0L );
+    for(unsigned i = 0; i < count; ++i)
+    {
+        batch->addTrack( GeoPoint(wgs84, x[i], y[i], z[i], ALTMODE_ABSOLUTE), icon.get(), headings[i] );
+    }
+
+    double seconds[2];
+    for(unsigned pass = 0; pass < 2; ++pass)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned frame = 0; frame < iterations; ++frame)
+        {
+            // move each track a little to the east.
+            double step = 0.0001 * (double)(frame + 1);
+            for(unsigned i = 0; i < numMoving; ++i)
+            {
+                mx[i] = x[ids[i]] + step;
+                my[i] = y[ids[i]];
+                mz[i] = z[ids[i]];
+                mh[i] = headings[ids[i]];
+            }
+
+            if ( pass == 0 )
+            {
+                for(unsigned i = 0; i < numMoving; ++i)
+                {
+                    // TrackNode headings are fixed by the icon symbol, so only positions move.
+                    trackNodes[ids[i]]->setPosition( GeoPoint(wgs84, mx[i], my[i], mz[i], ALTMODE_ABSOLUTE) );
+                }
+                nodes->accept( *update );
+            }
+            else
+            {
+                batch->updateTracks( &ids[0], &mx[0], &my[0], &mz[0], &mh[0], numMoving, wgs84 );
+                batch->accept( *update );
+            }
+        }
+        seconds[pass] = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+    }
+
+    double updates = (double)numMoving * (double)iterations;
+
+    std::cout << std::fixed << std::setprecision(0)
+        << count << " tracks, " << numMoving << " moving per frame, " << iterations << " frames\n\n"
+        << "  TrackNodes:     " << std::setw(12) << updates/seconds[0] << " updates/s\n"
+        << "  TrackBatchNode: " << std::setw(12) << updates/seconds[1] << " updates/s ("
+        << std::setprecision(1) << seconds[0]/seconds[1] << "x), " << batch->getNumDrawables() << " draw call(s)\n"
+        << std::endl;
+
+    return 0;
+}
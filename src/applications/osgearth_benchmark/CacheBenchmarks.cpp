@@ -0,0 +1,263 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Cache benchmarks: image codecs in a filesystem cache bin.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/TileKey>
+#include <osgEarth/Random>
+#include <osgEarth/Registry>
+#include <osgEarth/TileSource>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/Cache>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarthDrivers/gdal/GDALOptions>
+#include <osgEarthDrivers/cache_filesystem/FileSystemCache>
+#include <osg/Timer>
+#include <osgDB/Registry>
+#include <osgDB/FileNameUtils>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <float.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+// Synthetic opaque imagery: smooth shaded relief with some pixel noise.
+osg::Image*
+makeImagery(unsigned seed)
+{
+    Random prng(seed);
+    double phase = prng.next();
+    osg::Image* image = new osg::Image();
+    image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    image->setInternalTextureFormat(GL_RGBA8);
+    for(int t = 0; t < 256; ++t)
+    {
+        unsigned char* p = image->data(0, t);
+        for(int s = 0; s < 256; ++s, p += 4)
+        {
+            double v = 0.5 + 0.25*sin((double)s*0.04 + phase*6.0) + 0.2*cos((double)t*0.03 + phase*4.0);
+            int noise = (int)prng.next(16u) - 8;
+            p[0] = (unsigned char)osg::clampBetween( (int)(v*140.0) + noise, 0, 255 );
+            p[1] = (unsigned char)osg::clampBetween( (int)(v*170.0) + noise, 0, 255 );
+            p[2] = (unsigned char)osg::clampBetween( (int)(v*110.0) + noise, 0, 255 );
+            p[3] = 255;
+        }
+    }
+    return image;
+}
+
+// Size of a file in bytes, or 0 if it doesn't exist.
+unsigned
+getFileSize(const std::string& path)
+{
+    std::ifstream in( path.c_str(), std::ios_base::in | std::ios_base::binary | std::ios_base::ate );
+    return in.is_open() ? (unsigned)in.tellg() : 0u;
+}
+
+int
+benchmarkCache(osg::ArgumentParser& arguments)
+{
+    unsigned numTiles = 256;
+    arguments.read("--tiles", numTiles);
+
+    std::string source;
+    arguments.read("--source", source);
+
+    std::string path = "osgearth_benchmark_cache";
+    arguments.read("--path", path);
+
+    // collect the rasters to cache.
+    std::vector< osg::ref_ptr<osg::Object> > images, heightFields;
+
+    if ( !source.empty() )
+    {
+        GDALOptions options;
+        options.url() = source;
+        osg::ref_ptr<TileSource> ts = TileSourceFactory::create( options );
+        if ( !ts.valid() || !ts->open().isOK() )
+        {
+            std::cout << "Cannot open " << source << std::endl;
+            return -1;
+        }
+
+        unsigned level = 0;
+        const DataExtentList& extents = ts->getDataExtents();
+        for(DataExtentList::const_iterator e = extents.begin(); e != extents.end(); ++e)
+        {
+            if ( e->maxLevel().isSet() )
+                level = osg::maximum( level, e->maxLevel().get() );
+        }
+
+        std::vector<TileKey> keys;
+        ts->getProfile()->getIntersectingTiles( ts->getDataExtentsUnion(), level, keys );
+        for(unsigned i = 0; i < keys.size() && images.size() < numTiles; ++i)
+        {
+            osg::ref_ptr<osg::Image> image = ts->createImage( keys[i] );
+            if ( image.valid() )
+                images.push_back( image.get() );
+        }
+    }
+    else
+    {
+        for(unsigned i = 0; i < numTiles; ++i)
+            images.push_back( makeImagery(i) );
+    }
+
+    GeoHeightField hills = makeHills( SpatialReference::get("wgs84") );
+    for(unsigned i = 0; i < numTiles; ++i)
+    {
+        osg::HeightField* hf = new osg::HeightField( *hills.getHeightField(), osg::CopyOp::DEEP_COPY_ALL );
+        for(unsigned h = 0; h < hf->getFloatArray()->size(); ++h)
+            hf->getFloatArray()->at(h) += (float)i;
+        heightFields.push_back( hf );
+    }
+
+    if ( images.empty() )
+    {
+        std::cout << "No imagery to cache" << std::endl;
+        return -1;
+    }
+
+    FileSystemCacheOptions cacheOptions;
+    cacheOptions.rootPath() = path;
+    osg::ref_ptr<Cache> cache = CacheFactory::create( cacheOptions );
+    if ( !cache.valid() || !cache->isOK() )
+    {
+        std::cout << "Cannot open a filesystem cache at " << path << std::endl;
+        return -1;
+    }
+
+    struct Codec
+    {
+        const char* label;
+        const char* imageCodec;
+        const char* compressor;
+        bool        heightFields;
+    };
+
+    const Codec codecs[] = {
+        { "osgb+zlib",   "",     "zlib", false },
+        { "osgb",        "",     "none", false },
+        { "png",         "png",  "zlib", false },
+        { "jpg",         "jpg",  "zlib", false },
+        { "webp",        "webp", "zlib", false },
+        { "osgb+zlib",   "",     "zlib", true  },
+        { "osgb",        "",     "none", true  }
+    };
+
+    std::cout
+        << "Caching " << images.size() << " " << static_cast<const osg::Image*>(images[0].get())->s() << "x" << static_cast<const osg::Image*>(images[0].get())->t()
+        << " images and " << heightFields.size() << " 257x257 heightfields in " << path << "\n"
+        << "  data          codec        KB/tile   write ms/tile   read ms/tile   max error"
+        << std::endl;
+
+    for(unsigned c = 0; c < sizeof(codecs)/sizeof(Codec); ++c)
+    {
+        const Codec& codec = codecs[c];
+        const std::vector< osg::ref_ptr<osg::Object> >& tiles = codec.heightFields ? heightFields : images;
+
+        std::cout << "  " << std::left << std::setw(14) << (codec.heightFields ? "heightfield" : "image")
+            << std::setw(10) << codec.label << std::right;
+
+        if ( *codec.imageCodec && !osgDB::Registry::instance()->getReaderWriterForExtension(codec.imageCodec) )
+        {
+            std::cout << "   (no plugin)" << std::endl;
+            continue;
+        }
+
+        std::string binID = Stringify() << "benchmark_" << c;
+        CacheBin* bin = cache->addBin( binID );
+        bin->clear();
+        bin->setHashKeys( false );
+        bin->setImageCodec( codec.imageCodec );
+        bin->setCompressor( codec.compressor );
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < tiles.size(); ++i)
+            bin->write( Stringify() << i, tiles[i].get(), 0L );
+        double writeSeconds = osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+
+        unsigned long long bytes = 0u;
+        for(unsigned i = 0; i < tiles.size(); ++i)
+            bytes += getFileSize( osgDB::concatPaths(osgDB::concatPaths(path, binID), Stringify() << i << ".osgb") );
+
+        // read everything back and compare it to the original.
+        double maxError = 0.0;
+        t0 = osg::Timer::instance()->tick();
+        std::vector< osg::ref_ptr<osg::Object> > results( tiles.size() );
+        for(unsigned i = 0; i < tiles.size(); ++i)
+        {
+            ReadResult r = codec.heightFields ? bin->readObject( Stringify() << i, 0L ) : bin->readImage( Stringify() << i, 0L );
+            results[i] = r.getObject();
+        }
+        double readSeconds = osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+
+        for(unsigned i = 0; i < tiles.size(); ++i)
+        {
+            if ( codec.heightFields )
+            {
+                const osg::HeightField* a = static_cast<const osg::HeightField*>( tiles[i].get() );
+                const osg::HeightField* b = dynamic_cast<const osg::HeightField*>( results[i].get() );
+                if ( !b || b->getFloatArray()->size() != a->getFloatArray()->size() )
+                {
+                    maxError = DBL_MAX;
+                    break;
+                }
+                for(unsigned h = 0; h < a->getFloatArray()->size(); ++h)
+                    maxError = osg::maximum( maxError, (double)fabs(a->getFloatArray()->at(h) - b->getFloatArray()->at(h)) );
+            }
+            else
+            {
+                const osg::Image* a = static_cast<const osg::Image*>( tiles[i].get() );
+                const osg::Image* b = dynamic_cast<const osg::Image*>( results[i].get() );
+                if ( !b || !ImageUtils::sameFormat(a, b) || a->s() != b->s() || a->t() != b->t() )
+                {
+                    maxError = DBL_MAX;
+                    break;
+                }
+                for(unsigned k = 0; k < a->getTotalSizeInBytes(); ++k)
+                    maxError = osg::maximum( maxError, fabs((double)a->data()[k] - (double)b->data()[k]) );
+            }
+        }
+
+        std::cout << std::fixed
+            << std::setprecision(1) << std::setw(11) << (double)bytes/1024.0/(double)tiles.size()
+            << std::setprecision(3) << std::setw(16) << writeSeconds*1000.0/(double)tiles.size()
+            << std::setw(15) << readSeconds*1000.0/(double)tiles.size();
+        if ( maxError == DBL_MAX )
+            std::cout << std::setw(12) << "failed";
+        else
+            std::cout << std::setprecision(1) << std::setw(12) << maxError;
+        std::cout << std::endl;
+
+        bin->clear();
+    }
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Container benchmarks: PerThread access and LRU cache throughput.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Random>
+#include <osgEarth/Containers>
+#include <osgEarth/ThreadingUtils>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Atomic>
+#include <iostream>
+#include <iomanip>
+#include <map>
+
+using namespace osgEarth;
+
+// The map+mutex PerThread that Containers used before thread-local slots.
+template<typename T>
+struct LockedPerThread
+{
+    T& get() {
+        Threading::ScopedMutexLock lock(_mutex);
+        return _data[Threading::getCurrentThreadId()];
+    }
+private:
+    std::map<unsigned,T> _data;
+    Threading::Mutex     _mutex;
+};
+
+// Per-thread value that counts live instances, to check that each
+// thread's value is destroyed when the thread exits.
+struct PerThreadCounter
+{
+    PerThreadCounter() : _value(0u) { ++s_live; }
+    ~PerThreadCounter() { --s_live; }
+    unsigned _value;
+    static OpenThreads::Atomic s_live;
+};
+OpenThreads::Atomic PerThreadCounter::s_live;
+
+template<typename PT>
+struct PerThreadAccessor : public OpenThreads::Thread
+{
+    PT*                   _data;
+    OpenThreads::Barrier* _start;
+    unsigned              _iterations;
+    double                _seconds;
+
+    void run()
+    {
+        _start->block();
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < _iterations; ++i)
+            _data->get()._value++;
+        _seconds = osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+    }
+};
+
+// Average cost of one get() in nanoseconds, with all the threads
+// hammering the same object at once.
+template<typename PT>
+double
+timePerThread(PT& data, unsigned numThreads, unsigned iterations)
+{
+    OpenThreads::Barrier start( numThreads );
+
+    std::vector< PerThreadAccessor<PT>* > threads( numThreads );
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        threads[t] = new PerThreadAccessor<PT>();
+        threads[t]->_data       = &data;
+        threads[t]->_start      = &start;
+        threads[t]->_iterations = iterations;
+        threads[t]->_seconds    = 0.0;
+        threads[t]->startThread();
+    }
+
+    double seconds = 0.0;
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        threads[t]->join();
+        seconds += threads[t]->_seconds;
+        delete threads[t];
+    }
+
+    return seconds*1.0e9/((double)numThreads*(double)iterations);
+}
+
+int
+benchmarkPerThread(osg::ArgumentParser& arguments)
+{
+    unsigned maxThreads = 32;
+    arguments.read("--max-threads", maxThreads);
+
+    unsigned iterations = 1000000;
+    arguments.read("--iterations", iterations);
+
+    std::cout
+        << "PerThread<T>::get(), " << iterations << " accesses per thread\n\n"
+        << "  threads    map+mutex (ns)    thread-local (ns)    speedup"
+        << std::endl;
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        double locked, local;
+        {
+            LockedPerThread<PerThreadCounter> data;
+            locked = timePerThread( data, numThreads, iterations );
+        }
+
+        unsigned outlived;
+        {
+            PerThread<PerThreadCounter> data;
+            local = timePerThread( data, numThreads, iterations );
+            // the threads have exited, so they should have destroyed their values.
+            outlived = PerThreadCounter::s_live;
+        }
+
+        std::cout << std::fixed
+            << "  " << std::setw(7) << numThreads
+            << std::setprecision(1) << std::setw(18) << locked
+            << std::setw(21) << local
+            << std::setw(10) << locked/local << "x";
+        if ( outlived > 0u )
+            std::cout << "  (" << outlived << " values outlived their threads)";
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
+
+//........................................................................
+
+// Looks up keys in a cache, inserting the misses. Keys are skewed so
+// that a small set is hot, the way tile requests cluster around the view.
+template<typename CACHE>
+struct LRUAccessor : public OpenThreads::Thread
+{
+    CACHE*                _cache;
+    OpenThreads::Barrier* _start;
+    unsigned              _iterations;
+    unsigned              _keyRange;
+    unsigned              _seed;
+    double                _seconds;
+
+    void run()
+    {
+        Random prng( _seed );
+        std::vector<unsigned> keys( _iterations );
+        for(unsigned i = 0; i < _iterations; ++i)
+        {
+            double r = prng.next();
+            keys[i] = (unsigned)(r*r*r*(double)_keyRange);
+        }
+
+        _start->block();
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < _iterations; ++i)
+        {
+            typename CACHE::Record rec;
+            if ( !_cache->get(keys[i], rec) )
+                _cache->insert( keys[i], keys[i] );
+        }
+        _seconds = osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+    }
+};
+
+// Lookups per second over all threads.
+template<typename CACHE>
+double
+timeLRU(CACHE& cache, unsigned numThreads, unsigned iterations, unsigned keyRange)
+{
+    OpenThreads::Barrier start( numThreads );
+
+    std::vector< LRUAccessor<CACHE>* > threads( numThreads );
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        threads[t] = new LRUAccessor<CACHE>();
+        threads[t]->_cache      = &cache;
+        threads[t]->_start      = &start;
+        threads[t]->_iterations = iterations;
+        threads[t]->_keyRange   = keyRange;
+        threads[t]->_seed       = 1234 + t;
+        threads[t]->_seconds    = 0.0;
+        threads[t]->startThread();
+    }
+
+    double seconds = 0.0;
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        threads[t]->join();
+        seconds = osg::maximum( seconds, threads[t]->_seconds );
+        delete threads[t];
+    }
+
+    return (double)numThreads*(double)iterations/seconds;
+}
+
+int
+benchmarkLRU(osg::ArgumentParser& arguments)
+{
+    unsigned maxThreads = 32;
+    arguments.read("--max-threads", maxThreads);
+
+    unsigned iterations = 1000000;
+    arguments.read("--iterations", iterations);
+
+    unsigned size = 4096;
+    arguments.read("--size", size);
+
+    // four times as many keys as entries, so there is steady eviction.
+    unsigned keyRange = size*4;
+
+    std::cout
+        << "LRU cache, " << size << " entries, " << iterations << " lookups per thread\n\n"
+        << "  threads    LRUCache (Mops/s)  hits    Sharded (Mops/s)  hits    speedup"
+        << std::endl;
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        LRUCache<unsigned, unsigned> single( true, size );
+        double singleRate = timeLRU( single, numThreads, iterations, keyRange );
+
+        ShardedLRUCache<unsigned, unsigned> sharded( true, size );
+        double shardedRate = timeLRU( sharded, numThreads, iterations, keyRange );
+
+        std::cout << std::fixed << std::setprecision(2)
+            << "  " << std::setw(7) << numThreads
+            << std::setw(19) << singleRate/1.0e6
+            << std::setw(7) << single.getStats()._hitRatio
+            << std::setw(19) << shardedRate/1.0e6
+            << std::setw(7) << sharded.getStats()._hitRatio
+            << std::setprecision(1) << std::setw(10) << shardedRate/singleRate << "x"
+            << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Earth file benchmarks: XML parsing.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Random>
+#include <osgEarth/Config>
+#include <osgEarth/ConfigReader>
+#include <osgEarth/XmlUtils>
+#include <osgEarth/URI>
+#include <osgEarth/Notify>
+#include <osg/Timer>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+
+#define LC "[benchmark] "
+
+using namespace osgEarth;
+
+// Whether two Config trees are identical, including referrers.
+bool
+sameConfig(const Config& a, const Config& b)
+{
+    if ( a.key() != b.key() ||
+         a.value() != b.value() ||
+         a.referrer() != b.referrer() ||
+         a.externalRef() != b.externalRef() ||
+         a.children().size() != b.children().size() )
+    {
+        return false;
+    }
+
+    ConfigSet::const_iterator i = a.children().begin();
+    ConfigSet::const_iterator j = b.children().begin();
+    for( ; i != a.children().end(); ++i, ++j )
+    {
+        if ( !sameConfig(*i, *j) )
+            return false;
+    }
+    return true;
+}
+
+unsigned
+countConfigs(const Config& conf)
+{
+    unsigned count = 1;
+    for(ConfigSet::const_iterator i = conf.children().begin(); i != conf.children().end(); ++i)
+        count += countConfigs(*i);
+    return count;
+}
+
+// An earth file with many inline feature layers and styles.
+std::string
+makeEarthFile(unsigned count)
+{
+    Random prng(1234);
+    std::stringstream buf;
+    buf << std::fixed << std::setprecision(6)
+        << "<?xml version=\"1.0\"?>\n"
+        << "<map name=\"benchmark\" type=\"geocentric\" version=\"2\">\n"
+        << "  <options>\n"
+        << "    <terrain driver=\"rex\" tile_size=\"17\" min_lod=\"0\"/>\n"
+        << "  </options>\n"
+        << "  <image name=\"base\" driver=\"gdal\">\n"
+        << "    <url>../data/world.tif</url>\n"
+        << "  </image>\n";
+
+    for(unsigned i = 0; i < count; ++i)
+    {
+        buf << "  <model name=\"roads_" << i << "\" driver=\"feature_geom\">\n"
+            << "    <features name=\"roads\" driver=\"ogr\">\n"
+            << "      <geometry>LINESTRING(";
+        double x = -180.0 + 360.0*prng.next(), y = -80.0 + 160.0*prng.next();
+        for(unsigned v = 0; v < 16; ++v)
+        {
+            buf << (v > 0 ? ", " : "") << x << " " << y;
+            x += 0.01*(prng.next()-0.5);
+            y += 0.01*(prng.next()-0.5);
+        }
+        buf << ")</geometry>\n"
+            << "    </features>\n"
+            << "    <styles>\n"
+            << "      <style type=\"text/css\">\n"
+            << "        default { stroke: #ffff00; stroke-width: 2px; altitude-clamping: terrain; render-depth-offset: true; }\n"
+            << "      </style>\n"
+            << "    </styles>\n"
+            << "    <lighting>false</lighting>\n"
+            << "  </model>\n";
+    }
+
+    buf << "</map>\n";
+    return buf.str();
+}
+
+int
+benchmarkEarthFile(osg::ArgumentParser& arguments)
+{
+    std::string file;
+    arguments.read("--file", file);
+
+    unsigned count = 5000;
+    arguments.read("--count", count);
+
+    unsigned iterations = 10;
+    arguments.read("--iterations", iterations);
+
+    std::string xml;
+    URIContext context;
+    if ( !file.empty() )
+    {
+        std::ifstream in( file.c_str() );
+        if ( !in.is_open() )
+        {
+            OE_WARN << LC << "Failed to open " << file << std::endl;
+            return 1;
+        }
+        xml.assign( (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>() );
+        context = URIContext( file );
+    }
+    else
+    {
+        xml = makeEarthFile( count );
+    }
+
+    Config results[2];
+    double seconds[2];
+    for(unsigned pass = 0; pass < 2; ++pass)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < iterations; ++i)
+        {
+            std::stringstream in( xml );
+            if ( pass == 0 )
+            {
+                osg::ref_ptr<XmlDocument> doc = XmlDocument::load( in, context );
+                if ( doc.valid() )
+                    results[pass] = doc->getConfig();
+            }
+            else
+            {
+                ConfigReader::readXML( in, results[pass], context );
+            }
+        }
+        seconds[pass] = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) / (double)iterations;
+    }
+
+    // round trip through JSON.
+    std::string json = results[1].toJSON();
+    Config fromJSON;
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned i = 0; i < iterations; ++i)
+    {
+        fromJSON = Config();
+        fromJSON.fromJSON( json );
+    }
+    double jsonSeconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) / (double)iterations;
+
+    std::cout << std::fixed << std::setprecision(2)
+        << "Parsed " << (file.empty() ? std::string("synthetic earth file") : file)
+        << ", " << (double)xml.size()/1048576.0 << " MB, " << countConfigs(results[1]) << " Config nodes\n"
+        << "  XmlDocument:  " << seconds[0]*1000.0 << " ms\n"
+        << "  ConfigReader: " << seconds[1]*1000.0 << " ms (" << std::setprecision(1) << seconds[0]/seconds[1] << "x)\n"
+        << "  trees identical: " << (sameConfig(results[0], results[1]) ? "yes" : "NO") << "\n"
+        << std::setprecision(2)
+        << "  JSON read:    " << jsonSeconds*1000.0 << " ms, " << (double)json.size()/1048576.0 << " MB\n"
+        << "  JSON round trip identical: " << (fromJSON.toJSON() == json ? "yes" : "NO") << "\n"
+        << std::endl;
+
+    return 0;
+}
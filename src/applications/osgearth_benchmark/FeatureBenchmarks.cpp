@@ -0,0 +1,364 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Feature pipeline benchmarks: extrusion, vector tile decoding and
+ * geometry consolidation.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Map>
+#include <osgEarth/Profile>
+#include <osgEarth/TileKey>
+#include <osgEarth/Random>
+#include <osgEarth/Registry>
+#include <osgEarth/ObjectIndex>
+#include <osgEarthFeatures/Session>
+#include <osgEarthFeatures/FilterContext>
+#include <osgEarthFeatures/ExtrudeGeometryFilter>
+#include <osgEarthFeatures/BuildGeometryFilter>
+#include <osgEarthFeatures/GeometryConsolidator>
+#include <osgEarthFeatures/MVT>
+#include <osgEarthSymbology/Style>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <set>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+// Collects drawable, vertex, and triangle counts for a graph.
+struct GeometryStats : public osg::NodeVisitor
+{
+    unsigned drawables, vertices, triangles;
+
+    GeometryStats() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), drawables(0), vertices(0), triangles(0) { }
+
+    void apply(osg::Geode& geode)
+    {
+        for(unsigned i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+            if ( !geom )
+                continue;
+
+            ++drawables;
+            if ( geom->getVertexArray() )
+                vertices += geom->getVertexArray()->getNumElements();
+
+            for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+            {
+                const osg::PrimitiveSet* ps = geom->getPrimitiveSet(p);
+                if ( ps->getMode() == GL_TRIANGLES )
+                    triangles += ps->getNumIndices() / 3;
+                else if ( ps->getMode() == GL_TRIANGLE_STRIP || ps->getMode() == GL_TRIANGLE_FAN )
+                    triangles += ps->getNumIndices() > 2 ? ps->getNumIndices() - 2 : 0;
+            }
+        }
+        traverse(geode);
+    }
+};
+
+//........................................................................
+
+// Generates a reproducible set of building footprints around a point.
+// Every tenth building is L-shaped and every twentieth has a courtyard.
+void
+makeBuildings(unsigned count, const SpatialReference* srs, FeatureList& out)
+{
+    Random prng(1234);
+
+    const double lon0 = -77.05, lat0 = 38.88, span = 0.1;
+
+    for(unsigned i=0; i<count; ++i)
+    {
+        double x = lon0 + prng.next()*span;
+        double y = lat0 + prng.next()*span;
+        double w = 0.0001 + prng.next()*0.0003;
+        double h = 0.0001 + prng.next()*0.0003;
+
+        Polygon* poly = new Polygon();
+
+        if ( i % 10 == 0 )
+        {
+            poly->push_back( osg::Vec3d(x,       y,       0) );
+            poly->push_back( osg::Vec3d(x+w,     y,       0) );
+            poly->push_back( osg::Vec3d(x+w,     y+h*0.5, 0) );
+            poly->push_back( osg::Vec3d(x+w*0.5, y+h*0.5, 0) );
+            poly->push_back( osg::Vec3d(x+w*0.5, y+h,     0) );
+            poly->push_back( osg::Vec3d(x,       y+h,     0) );
+        }
+        else
+        {
+            poly->push_back( osg::Vec3d(x,   y,   0) );
+            poly->push_back( osg::Vec3d(x+w, y,   0) );
+            poly->push_back( osg::Vec3d(x+w, y+h, 0) );
+            poly->push_back( osg::Vec3d(x,   y+h, 0) );
+
+            if ( i % 20 == 1 )
+            {
+                Ring* hole = new Ring();
+                hole->push_back( osg::Vec3d(x+w*0.25, y+h*0.25, 0) );
+                hole->push_back( osg::Vec3d(x+w*0.25, y+h*0.75, 0) );
+                hole->push_back( osg::Vec3d(x+w*0.75, y+h*0.75, 0) );
+                hole->push_back( osg::Vec3d(x+w*0.75, y+h*0.25, 0) );
+                poly->getHoles().push_back( hole );
+            }
+        }
+
+        Feature* feature = new Feature(poly, srs);
+        feature->set( "height", 5.0 + prng.next()*60.0 );
+        out.push_back( feature );
+    }
+}
+
+int
+benchmarkExtrude(osg::ArgumentParser& arguments)
+{
+    unsigned count = 20000;
+    arguments.read("--count", count);
+
+    unsigned iterations = 3;
+    arguments.read("--iterations", iterations);
+
+    osg::ref_ptr<Map> map = new Map();
+    osg::ref_ptr<Session> session = new Session(map.get());
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+    GeoExtent extent(srs, -180.0, -90.0, 180.0, 90.0);
+    osg::ref_ptr<FeatureProfile> profile = new FeatureProfile(extent);
+
+    Style style;
+    style.getOrCreate<ExtrusionSymbol>()->heightExpression() = NumericExpression("[height]");
+    style.getOrCreate<ExtrusionSymbol>()->wallGradientPercentage() = 0.25f;
+    style.getOrCreate<PolygonSymbol>()->fill()->color() = Color::White;
+
+    std::cout << "Extruding " << count << " buildings, " << iterations << " iteration(s)" << std::endl;
+
+    for(int fast=0; fast<2; ++fast)
+    {
+        double total = 0.0;
+        GeometryStats stats;
+
+        for(unsigned i=0; i<iterations; ++i)
+        {
+            FeatureList features;
+            makeBuildings(count, srs, features);
+
+            FilterContext cx(session.get(), profile.get(), extent);
+
+            ExtrudeGeometryFilter filter;
+            filter.setStyle( style );
+            filter.setUseFastPath( fast == 1 );
+
+            osg::Timer_t t0 = osg::Timer::instance()->tick();
+            osg::ref_ptr<osg::Node> node = filter.push(features, cx);
+            osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+            total += osg::Timer::instance()->delta_s(t0, t1);
+
+            if ( i == 0 && node.valid() )
+                node->accept( stats );
+        }
+
+        double avg = total / (double)iterations;
+
+        std::cout << std::fixed << std::setprecision(3)
+            << (fast ? "  fast:   " : "  legacy: ")
+            << avg*1000.0 << " ms, "
+            << std::setprecision(0) << (double)count/avg << " buildings/s, "
+            << stats.drawables << " drawables, "
+            << stats.vertices << " verts, "
+            << stats.triangles << " tris"
+            << std::endl;
+    }
+
+    return 0;
+}
+
+//........................................................................
+
+int
+benchmarkMVT(osg::ArgumentParser& arguments)
+{
+    std::string filename;
+    if ( !arguments.read("--mvt", filename) )
+        return usage(arguments[0]);
+
+    unsigned z = 0, x = 0, y = 0;
+    arguments.read("--tile", z, x, y);
+
+    unsigned iterations = 100;
+    arguments.read("--iterations", iterations);
+
+    MVT::ReadOptions options;
+    std::string layer;
+    while( arguments.read("--layer", layer) )
+        options.layers.insert( layer );
+
+    if ( arguments.read("--no-attributes") )
+        options.readAttributes = false;
+
+    std::ifstream in( filename.c_str(), std::ios::binary );
+    if ( !in.is_open() )
+    {
+        std::cout << "Cannot open " << filename << std::endl;
+        return -1;
+    }
+    std::string buffer;
+    buffer.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+
+    osg::ref_ptr<const Profile> profile = Profile::create("spherical-mercator");
+    TileKey key(z, x, y, profile.get());
+
+    unsigned numFeatures = 0, numPoints = 0;
+    double total = 0.0;
+
+    for(unsigned i=0; i<iterations; ++i)
+    {
+        FeatureList features;
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        if ( !MVT::read(buffer.data(), buffer.size(), key, options, features) )
+        {
+            std::cout << "Failed to decode " << filename << std::endl;
+            return -1;
+        }
+        osg::Timer_t t1 = osg::Timer::instance()->tick();
+        total += osg::Timer::instance()->delta_s(t0, t1);
+
+        if ( i == 0 )
+        {
+            numFeatures = features.size();
+            for(FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
+            {
+                ConstGeometryIterator parts( f->get()->getGeometry(), true );
+                while( parts.hasMore() )
+                    numPoints += parts.next()->size();
+            }
+        }
+    }
+
+    double avg = total / (double)iterations;
+
+    std::cout << std::fixed << std::setprecision(3)
+        << filename << " (" << buffer.size() << " bytes): "
+        << numFeatures << " features, " << numPoints << " points\n"
+        << "  " << avg*1000.0 << " ms/tile, "
+        << std::setprecision(0) << (double)numFeatures/avg << " features/s, "
+        << std::setprecision(2) << ((double)buffer.size()/avg)/1048576.0 << " MB/s"
+        << std::endl;
+
+    return 0;
+}
+
+//........................................................................
+
+// Tags each drawable with its own ObjectID, like a feature index would,
+// and collects the distinct IDs found in a graph.
+struct ObjectIDVisitor : public osg::NodeVisitor
+{
+    bool                tag;
+    ObjectID            next;
+    std::set<ObjectID>  ids;
+
+    ObjectIDVisitor(bool tagDrawables) : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), tag(tagDrawables), next(1000) { }
+
+    void apply(osg::Geode& geode)
+    {
+        ObjectIndex* index = Registry::objectIndex();
+        for(unsigned i=0; i<geode.getNumDrawables(); ++i)
+        {
+            if ( tag )
+                index->tagDrawable( geode.getDrawable(i), next++ );
+            index->getObjectIDs( geode.getDrawable(i), ids );
+        }
+        traverse(geode);
+    }
+};
+
+int
+benchmarkConsolidate(osg::ArgumentParser& arguments)
+{
+    unsigned count = 20000;
+    arguments.read("--count", count);
+
+    GeometryConsolidator consolidator;
+    unsigned maxVerts;
+    if ( arguments.read("--max-verts", maxVerts) )
+        consolidator.setMaxVertices( maxVerts );
+
+    osg::ref_ptr<Map> map = new Map();
+    osg::ref_ptr<Session> session = new Session(map.get());
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+    GeoExtent extent(srs, -180.0, -90.0, 180.0, 90.0);
+    osg::ref_ptr<FeatureProfile> profile = new FeatureProfile(extent);
+
+    Style style;
+    style.getOrCreate<PolygonSymbol>()->fill()->color() = Color::White;
+
+    FeatureList features;
+    makeBuildings(count, srs, features);
+
+    FilterContext cx(session.get(), profile.get(), extent);
+    BuildGeometryFilter filter( style );
+    osg::ref_ptr<osg::Node> node = filter.push(features, cx);
+    if ( !node.valid() )
+    {
+        std::cout << "Failed to build geometry" << std::endl;
+        return -1;
+    }
+
+    ObjectIDVisitor tagger(true);
+    node->accept( tagger );
+
+    GeometryStats before;
+    node->accept( before );
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    GeometryConsolidator::Stats stats = consolidator.run( node.get() );
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+    GeometryStats after;
+    node->accept( after );
+
+    ObjectIDVisitor check(false);
+    node->accept( check );
+
+    std::cout << std::fixed << std::setprecision(3)
+        << "Consolidated " << count << " polygons in " << osg::Timer::instance()->delta_m(t0, t1) << " ms\n"
+        << "  drawables: " << stats.drawablesIn << " -> " << stats.drawablesOut << "\n"
+        << "  vertices:  " << before.vertices << " -> " << after.vertices << "\n"
+        << "  triangles: " << before.triangles << " -> " << after.triangles << "\n"
+        << "  object IDs preserved: " << check.ids.size() << " of " << tagger.ids.size()
+        << std::endl;
+
+    return 0;
+}
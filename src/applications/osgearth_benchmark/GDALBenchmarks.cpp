@@ -0,0 +1,233 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * GDAL driver benchmarks: tile read throughput and pixel sampling.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Profile>
+#include <osgEarth/TileKey>
+#include <osgEarth/TileSource>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarthDrivers/gdal/GDALOptions>
+#include <osg/Timer>
+#include <iostream>
+#include <iomanip>
+#include <set>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+// Reads a slice of the tile keys from a tile source.
+struct ReadTiles
+{
+    TileSource*                  _source;
+    const std::vector<TileKey>*  _keys;
+    unsigned                     _first, _last;
+    bool                         _elevation;
+
+    void execute()
+    {
+        for(unsigned i = _first; i < _last; ++i)
+        {
+            if ( _elevation )
+            {
+                osg::ref_ptr<osg::HeightField> hf = _source->createHeightField( (*_keys)[i] );
+            }
+            else
+            {
+                osg::ref_ptr<osg::Image> image = _source->createImage( (*_keys)[i] );
+            }
+        }
+    }
+};
+
+// Times reading all the keys with a given number of threads, in seconds.
+double
+readTiles(TileSource* source, const std::vector<TileKey>& keys, unsigned numThreads, bool elevation)
+{
+    osg::ref_ptr<TaskService> service = new TaskService("benchmark", numThreads);
+
+    unsigned perTask = (keys.size() + numThreads - 1) / numThreads;
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+
+    Threading::MultiEvent semaphore( numThreads );
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        ParallelTask<ReadTiles>* task = new ParallelTask<ReadTiles>( &semaphore );
+        task->_source    = source;
+        task->_keys      = &keys;
+        task->_first     = osg::minimum( (unsigned)keys.size(), t * perTask );
+        task->_last      = osg::minimum( (unsigned)keys.size(), (t + 1) * perTask );
+        task->_elevation = elevation;
+        service->add( task );
+    }
+    semaphore.wait();
+
+    return osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+}
+
+int
+benchmarkGDAL(osg::ArgumentParser& arguments)
+{
+    std::string filename;
+    if ( !arguments.read("--gdal", filename) )
+        return usage(arguments[0]);
+
+    unsigned numTiles = 512;
+    arguments.read("--tiles", numTiles);
+
+    unsigned maxThreads = 16;
+    arguments.read("--max-threads", maxThreads);
+
+    bool elevation = arguments.read("--elevation");
+
+    int level = -1;
+    arguments.read("--level", level);
+
+    bool sampling = arguments.read("--sampling");
+
+    unsigned blockCacheMB = 0;
+    arguments.read("--block-cache", blockCacheMB);
+
+    // sampling: [0] = per-pixel reads, [1] = windowed reads.
+    // otherwise: [0] = shared dataset, [1] = per-thread datasets.
+    osg::ref_ptr<TileSource> sources[2];
+    for(unsigned i = 0; i < 2; ++i)
+    {
+        GDALOptions options;
+        options.url() = filename;
+        options.blockCacheSizeMB() = blockCacheMB;
+        if ( sampling )
+        {
+            options.interpolation() = INTERP_BILINEAR;
+            options.interpolateImagery() = true;
+            options.windowedSampling() = (i == 1);
+        }
+        else
+        {
+            options.datasetPerThread() = (i == 1);
+        }
+
+        sources[i] = TileSourceFactory::create( options );
+        if ( !sources[i].valid() || !sources[i]->open().isOK() )
+        {
+            std::cout << "Cannot open " << filename << std::endl;
+            return -1;
+        }
+    }
+
+    const Profile* profile = sources[0]->getProfile();
+    const DataExtentList& extents = sources[0]->getDataExtents();
+    if ( level < 0 )
+    {
+        level = 0;
+        for(DataExtentList::const_iterator e = extents.begin(); e != extents.end(); ++e)
+        {
+            if ( e->maxLevel().isSet() )
+                level = osg::maximum( level, (int)e->maxLevel().get() );
+        }
+    }
+
+    // read the same keys over and over if the data doesn't cover enough tiles.
+    std::vector<TileKey> dataKeys;
+    profile->getIntersectingTiles( sources[0]->getDataExtentsUnion(), level, dataKeys );
+    if ( dataKeys.empty() )
+    {
+        std::cout << "No tiles intersect the data at level " << level << std::endl;
+        return -1;
+    }
+
+    std::vector<TileKey> keys;
+    keys.reserve( numTiles );
+    for(unsigned i = 0; i < numTiles; ++i)
+        keys.push_back( dataKeys[i % dataKeys.size()] );
+
+    std::cout
+        << filename << ": " << keys.size() << (elevation ? " heightfields" : " images")
+        << " at level " << level << " (" << dataKeys.size() << " distinct)" << std::endl;
+
+    if ( sampling )
+    {
+        // warm up the OS file cache so the first run isn't penalized.
+        readTiles( sources[0].get(), dataKeys, 1, elevation );
+
+        double perPixel = readTiles( sources[0].get(), keys, 1, elevation );
+        double windowed = readTiles( sources[1].get(), keys, 1, elevation );
+
+        // make sure both modes produce the same output.
+        unsigned mismatches = 0;
+        for(unsigned i = 0; i < dataKeys.size() && i < numTiles; ++i)
+        {
+            if ( elevation )
+            {
+                osg::ref_ptr<osg::HeightField> a = sources[0]->createHeightField( dataKeys[i] );
+                osg::ref_ptr<osg::HeightField> b = sources[1]->createHeightField( dataKeys[i] );
+                if ( a.valid() != b.valid() || (a.valid() && a->getHeightList() != b->getHeightList()) )
+                    ++mismatches;
+            }
+            else
+            {
+                osg::ref_ptr<osg::Image> a = sources[0]->createImage( dataKeys[i] );
+                osg::ref_ptr<osg::Image> b = sources[1]->createImage( dataKeys[i] );
+                if ( a.valid() != b.valid() ||
+                    (a.valid() && (a->getTotalSizeInBytes() != b->getTotalSizeInBytes() ||
+                                   ::memcmp(a->data(), b->data(), a->getTotalSizeInBytes()) != 0)) )
+                    ++mismatches;
+            }
+        }
+
+        std::cout << std::fixed << std::setprecision(3)
+            << "  per-pixel: " << perPixel*1000.0/(double)keys.size() << " ms/tile\n"
+            << "  windowed:  " << windowed*1000.0/(double)keys.size() << " ms/tile ("
+            << std::setprecision(1) << perPixel/windowed << "x)\n"
+            << "  tiles with different output: " << mismatches
+            << std::endl;
+
+        return 0;
+    }
+
+    std::cout
+        << "  threads    shared (tiles/s)    per-thread (tiles/s)"
+        << std::endl;
+
+    // warm up the OS file cache so the first run isn't penalized.
+    readTiles( sources[0].get(), dataKeys, 1, elevation );
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        double shared    = readTiles( sources[0].get(), keys, numThreads, elevation );
+        double perThread = readTiles( sources[1].get(), keys, numThreads, elevation );
+
+        std::cout << std::fixed << std::setprecision(1)
+            << "  " << std::setw(7) << numThreads
+            << std::setw(20) << (double)keys.size()/shared
+            << std::setw(24) << (double)keys.size()/perThread
+            << std::endl;
+    }
+
+    return 0;
+}
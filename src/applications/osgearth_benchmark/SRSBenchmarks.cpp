@@ -0,0 +1,303 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Coordinate system benchmarks: bulk SRS transforms, ECEF conversion
+ * and vertical datums.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Profile>
+#include <osgEarth/TileKey>
+#include <osgEarth/Random>
+#include <osgEarth/Registry>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/ECEF>
+#include <osgEarth/VerticalDatum>
+#include <osg/Timer>
+#include <iostream>
+#include <iomanip>
+
+#define LC "[benchmark] "
+
+using namespace osgEarth;
+
+// Transforms a slice of coordinate arrays.
+struct TransformArrays
+{
+    const SpatialReference* _from;
+    const SpatialReference* _to;
+    double *_x, *_y, *_z;
+    unsigned _count;
+
+    void execute()
+    {
+        _from->transform( _x, _y, _z, _count, _to );
+    }
+};
+
+int
+benchmarkSRS(osg::ArgumentParser& arguments)
+{
+    unsigned count = 1000000;
+    arguments.read("--count", count);
+
+    unsigned maxThreads = 8;
+    arguments.read("--max-threads", maxThreads);
+
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+    const SpatialReference* merc  = SpatialReference::get("spherical-mercator");
+    const SpatialReference* ecef  = wgs84->getECEF();
+    const SpatialReference* utm   = SpatialReference::get("+proj=utm +zone=32 +datum=WGS84");
+
+    // random points over the UTM zone.
+    Random prng(1234);
+    std::vector<osg::Vec3d> source( count );
+    for(unsigned i = 0; i < count; ++i)
+        source[i].set( 6.0 + 6.0*prng.next(), -60.0 + 120.0*prng.next(), 1000.0*prng.next() );
+
+    const SpatialReference* targets[3] = { merc, ecef, utm };
+    const char* names[3] = { "geodetic -> mercator: ", "geodetic -> ECEF:     ", "geodetic -> UTM:      " };
+
+    std::cout << std::fixed << "Transformed " << count << " points (points/s)\n";
+
+    for(unsigned t = 0; t < 3; ++t)
+    {
+        std::vector<osg::Vec3d> points( source );
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        wgs84->transform( points, targets[t] );
+        double vecTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        std::vector<double> x(count), y(count), z(count);
+        for(unsigned i = 0; i < count; ++i)
+        {
+            x[i] = source[i].x();
+            y[i] = source[i].y();
+            z[i] = source[i].z();
+        }
+
+        start = osg::Timer::instance()->tick();
+        wgs84->transform( &x[0], &y[0], &z[0], count, targets[t] );
+        double arrayTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        double maxError = 0.0;
+        for(unsigned i = 0; i < count; ++i)
+            maxError = osg::maximum( maxError, (points[i] - osg::Vec3d(x[i], y[i], z[i])).length() );
+
+        std::cout << std::setprecision(0)
+            << "  " << names[t] << "vector " << (double)count/vecTime
+            << ", arrays " << (double)count/arrayTime
+            << std::setprecision(6) << " (max difference " << maxError << ")\n";
+    }
+
+    // OGR transforms on several threads, each with its own handle.
+    for(unsigned threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        std::vector<double> x(count), y(count), z(count);
+        for(unsigned i = 0; i < count; ++i)
+        {
+            x[i] = source[i].x();
+            y[i] = source[i].y();
+            z[i] = source[i].z();
+        }
+
+        osg::ref_ptr<TaskService> service = new TaskService("benchmark", threads);
+        unsigned perTask = (count + threads - 1) / threads;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        Threading::MultiEvent semaphore( threads );
+        for(unsigned t = 0; t < threads; ++t)
+        {
+            unsigned first = osg::minimum( count, t * perTask );
+            ParallelTask<TransformArrays>* task = new ParallelTask<TransformArrays>( &semaphore );
+            task->_from  = wgs84;
+            task->_to    = utm;
+            task->_x     = &x[0] + first;
+            task->_y     = &y[0] + first;
+            task->_z     = &z[0] + first;
+            task->_count = osg::minimum( count, (t + 1) * perTask ) - first;
+            service->add( task );
+        }
+        semaphore.wait();
+        double time = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        std::cout << std::setprecision(0)
+            << "  geodetic -> UTM, " << std::setw(2) << threads << " thr.: arrays " << (double)count/time << "\n";
+    }
+
+    std::cout << std::endl;
+    return 0;
+}
+
+//........................................................................
+
+int
+benchmarkECEF(osg::ArgumentParser& arguments)
+{
+    unsigned count = 1000000;
+    arguments.read("--count", count);
+
+    const osg::EllipsoidModel* em = SpatialReference::get("wgs84")->getEllipsoid();
+
+    // points all over the globe, from below sea level to orbit.
+    Random prng(1234);
+    std::vector<double> lon(count), lat(count), alt(count);
+    for(unsigned i = 0; i < count; ++i)
+    {
+        lon[i] = -180.0 + 360.0*prng.next();
+        lat[i] = -90.0 + 180.0*prng.next();
+        alt[i] = -500.0 + 1000000.0*prng.next()*prng.next();
+    }
+
+    // reference: one point at a time through the ellipsoid model.
+    std::vector<osg::Vec3d> refECEF(count), refLLA(count);
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned i = 0; i < count; ++i)
+        em->convertLatLongHeightToXYZ( osg::DegreesToRadians(lat[i]), osg::DegreesToRadians(lon[i]), alt[i], refECEF[i].x(), refECEF[i].y(), refECEF[i].z() );
+    double refToECEF = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned i = 0; i < count; ++i)
+        em->convertXYZToLatLongHeight( refECEF[i].x(), refECEF[i].y(), refECEF[i].z(), refLLA[i].y(), refLLA[i].x(), refLLA[i].z() );
+    double refToLLA = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    // batch kernels, in place.
+    std::vector<double> x(lon), y(lat), z(alt);
+    start = osg::Timer::instance()->tick();
+    ECEF::geodeticToECEF( &x[0], &y[0], &z[0], count, em );
+    double batchToECEF = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    double maxECEFError = 0.0;
+    for(unsigned i = 0; i < count; ++i)
+        maxECEFError = osg::maximum( maxECEFError, (refECEF[i] - osg::Vec3d(x[i], y[i], z[i])).length() );
+
+    start = osg::Timer::instance()->tick();
+    ECEF::ECEFToGeodetic( &x[0], &y[0], &z[0], count, em );
+    double batchToLLA = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    // compare against the reference conversion, and against the original input.
+    double maxAngleError = 0.0, maxHeightError = 0.0, maxRoundTrip = 0.0;
+    for(unsigned i = 0; i < count; ++i)
+    {
+        double dLon = fabs(osg::RadiansToDegrees(refLLA[i].x()) - x[i]);
+        if ( dLon > 180.0 ) dLon = 360.0 - dLon;
+        maxAngleError  = osg::maximum( maxAngleError, osg::maximum(dLon, fabs(osg::RadiansToDegrees(refLLA[i].y()) - y[i])) );
+        maxHeightError = osg::maximum( maxHeightError, fabs(refLLA[i].z() - z[i]) );
+        maxRoundTrip   = osg::maximum( maxRoundTrip, fabs(alt[i] - z[i]) );
+    }
+
+    std::cout << std::fixed << std::setprecision(0)
+        << "Converted " << count << " points (points/s)\n"
+        << "  geodetic -> ECEF: ellipsoid model " << (double)count/refToECEF << ", batch " << (double)count/batchToECEF << "\n"
+        << "  ECEF -> geodetic: ellipsoid model " << (double)count/refToLLA << ", batch " << (double)count/batchToLLA << "\n"
+        << std::setprecision(9)
+        << "  max ECEF difference:      " << maxECEFError << " m\n"
+        << "  max lat/long difference:  " << maxAngleError << " deg\n"
+        << "  max height difference:    " << maxHeightError << " m\n"
+        << "  max round trip height:    " << maxRoundTrip << " m\n"
+        << std::endl;
+
+    return 0;
+}
+
+//........................................................................
+
+int
+benchmarkVDatum(osg::ArgumentParser& arguments)
+{
+    std::string name;
+    if ( !arguments.read("--vdatum", name) )
+        return usage(arguments[0]);
+
+    unsigned numTiles = 256;
+    arguments.read("--tiles", numTiles);
+
+    const VerticalDatum* vdatum = VerticalDatum::get( name );
+    if ( !vdatum )
+    {
+        OE_WARN << LC << "Unknown vertical datum " << name << std::endl;
+        return 1;
+    }
+
+    // random level-8 tiles of the global geodetic profile.
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    Random prng(1234);
+    std::vector<GeoExtent> extents;
+    for(unsigned i = 0; i < numTiles; ++i)
+    {
+        unsigned tx, ty;
+        profile->getNumTiles( 8, tx, ty );
+        extents.push_back( TileKey(8, prng.next(tx), prng.next(ty), profile).getExtent() );
+    }
+
+    double seconds[2];
+    std::vector< osg::ref_ptr<osg::HeightField> > results[2];
+    for(unsigned pass = 0; pass < 2; ++pass)
+    {
+        for(unsigned i = 0; i < numTiles; ++i)
+        {
+            osg::HeightField* hf = new osg::HeightField();
+            hf->allocate( 257, 257 );
+            for(unsigned h = 0; h < 257*257; ++h)
+                hf->getFloatArray()->at(h) = (float)(h % 1000);
+            results[pass].push_back( hf );
+        }
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < numTiles; ++i)
+        {
+            const GeoExtent& ex = extents[i];
+            osg::HeightField* hf = results[pass][i].get();
+            if ( pass == 0 )
+            {
+                // one point at a time, as before.
+                double dx = ex.width()/256.0, dy = ex.height()/256.0;
+                for(unsigned c = 0; c < 257; ++c)
+                    for(unsigned r = 0; r < 257; ++r)
+                        VerticalDatum::transform( vdatum, 0L, ex.south() + dy*(double)r, ex.west() + dx*(double)c, hf->getHeight(c, r) );
+            }
+            else
+            {
+                VerticalDatum::transform( vdatum, 0L, ex, hf );
+            }
+        }
+        seconds[pass] = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    }
+
+    float maxError = 0.0f;
+    for(unsigned i = 0; i < numTiles; ++i)
+        for(unsigned h = 0; h < 257*257; ++h)
+            maxError = osg::maximum( maxError, fabs(results[0][i]->getFloatArray()->at(h) - results[1][i]->getFloatArray()->at(h)) );
+
+    std::cout << std::fixed << std::setprecision(0)
+        << "Converted " << numTiles << " 257x257 tiles from " << vdatum->getName() << " to HAE (tiles/s)\n"
+        << "  per point: " << (double)numTiles/seconds[0] << "\n"
+        << "  grid:      " << (double)numTiles/seconds[1] << "\n"
+        << std::setprecision(6)
+        << "  max difference: " << maxError << " m\n"
+        << std::endl;
+
+    return 0;
+}
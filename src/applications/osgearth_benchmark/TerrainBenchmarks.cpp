@@ -0,0 +1,333 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Terrain analysis benchmarks: geometry clamping, line of sight and
+ * viewshed.
+ */
+
+#include "Benchmarks"
+
+#include <osgEarth/Random>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/GeometryClamper>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/DPLineSegmentIntersector>
+#include <osgEarthUtil/HeightFieldLineOfSight>
+#include <osgEarthUtil/Viewshed>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <osgUtil/IntersectionVisitor>
+#include <OpenThreads/Thread>
+#include <iostream>
+#include <iomanip>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+// Synthetic terrain: a 257x257 grid of rolling hills over one degree.
+GeoHeightField
+makeHills(const SpatialReference* srs)
+{
+    GeoExtent extent(srs, 10.0, 45.0, 11.0, 46.0);
+    osg::HeightField* hf = new osg::HeightField();
+    hf->allocate(257, 257);
+    for(unsigned r = 0; r < 257; ++r)
+        for(unsigned c = 0; c < 257; ++c)
+            hf->setHeight(c, r, (float)(500.0 + 300.0*sin((double)c*0.05)*cos((double)r*0.07)));
+    return GeoHeightField( hf, extent );
+}
+
+// Builds terrain patch geometry for a heightfield, split into triangles
+// along the same diagonal as INTERP_TRIANGULATE.
+osg::Node*
+makeTerrainPatch(const GeoHeightField& geoHF)
+{
+    const osg::HeightField* hf = geoHF.getHeightField();
+    const GeoExtent& extent = geoHF.getExtent();
+    unsigned cols = hf->getNumColumns(), rows = hf->getNumRows();
+    double dx = extent.width() / (double)(cols-1);
+    double dy = extent.height() / (double)(rows-1);
+
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->reserve( cols*rows );
+    for(unsigned r = 0; r < rows; ++r)
+    {
+        for(unsigned c = 0; c < cols; ++c)
+        {
+            GeoPoint p(extent.getSRS(), extent.xMin() + dx*(double)c, extent.yMin() + dy*(double)r, hf->getHeight(c, r), ALTMODE_ABSOLUTE);
+            osg::Vec3d world;
+            p.toWorld( world );
+            verts->push_back( world );
+        }
+    }
+
+    osg::DrawElementsUInt* tris = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for(unsigned r = 0; r < rows-1; ++r)
+    {
+        for(unsigned c = 0; c < cols-1; ++c)
+        {
+            unsigned ll = r*cols + c, lr = ll + 1, ul = ll + cols, ur = ul + 1;
+            tris->push_back(ll); tris->push_back(lr); tris->push_back(ur);
+            tris->push_back(ll); tris->push_back(ur); tris->push_back(ul);
+        }
+    }
+
+    osg::Geometry* geom = new osg::Geometry();
+    geom->setUseVertexBufferObjects( true );
+    geom->setVertexArray( verts );
+    geom->addPrimitiveSet( tris );
+
+    osg::Geode* geode = new osg::Geode();
+    geode->addDrawable( geom );
+    return geode;
+}
+
+// Makes a long polyline that jumps randomly around the extent, in world coordinates.
+osg::Node*
+makePolyline(const GeoExtent& extent, unsigned count)
+{
+    Random prng(1234);
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->reserve( count );
+    for(unsigned i = 0; i < count; ++i)
+    {
+        GeoPoint p(extent.getSRS(),
+            extent.xMin() + extent.width() * prng.next(),
+            extent.yMin() + extent.height() * prng.next(),
+            0.0, ALTMODE_ABSOLUTE);
+        osg::Vec3d world;
+        p.toWorld( world );
+        verts->push_back( world );
+    }
+
+    osg::Geometry* geom = new osg::Geometry();
+    geom->setUseVertexBufferObjects( true );
+    geom->setVertexArray( verts );
+    geom->addPrimitiveSet( new osg::DrawArrays(GL_LINE_STRIP, 0, verts->size()) );
+
+    osg::Geode* geode = new osg::Geode();
+    geode->addDrawable( geom );
+    return geode;
+}
+
+int
+benchmarkClamp(osg::ArgumentParser& arguments)
+{
+    unsigned count = 20000;
+    arguments.read("--count", count);
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+    GeoHeightField geoHF = makeHills( srs );
+    const GeoExtent& extent = geoHF.getExtent();
+
+    osg::ref_ptr<osg::Node> patch = makeTerrainPatch( geoHF );
+
+    osg::ref_ptr<osg::Node> lines[2];
+    double seconds[2];
+    for(unsigned i = 0; i < 2; ++i)
+    {
+        lines[i] = makePolyline( extent, count );
+
+        GeometryClamper clamper;
+        clamper.setTerrainSRS( srs );
+        clamper.setTerrainPatch( patch.get() );
+        if ( i == 1 )
+            clamper.setTerrainHeightField( geoHF );
+
+        lines[i]->accept( clamper );
+        seconds[i] = clamper.getClampingTime();
+    }
+
+    // compare the two results.
+    osg::Vec3Array* a = static_cast<osg::Vec3Array*>(lines[0]->asGeode()->getDrawable(0)->asGeometry()->getVertexArray());
+    osg::Vec3Array* b = static_cast<osg::Vec3Array*>(lines[1]->asGeode()->getDrawable(0)->asGeometry()->getVertexArray());
+    double maxError = 0.0;
+    for(unsigned i = 0; i < a->size(); ++i)
+        maxError = osg::maximum( maxError, (double)((*a)[i] - (*b)[i]).length() );
+
+    std::cout << std::fixed << std::setprecision(0)
+        << "Clamped " << count << " vertices to a 257x257 patch\n"
+        << "  intersection: " << (double)count/seconds[0] << " verts/s\n"
+        << "  heightfield:  " << (double)count/seconds[1] << " verts/s\n"
+        << std::setprecision(3)
+        << "  max difference: " << maxError << " m"
+        << std::endl;
+
+    return 0;
+}
+
+//........................................................................
+
+int
+benchmarkLOS(osg::ArgumentParser& arguments)
+{
+    unsigned count = 1000;
+    arguments.read("--count", count);
+
+    unsigned numSpokes = 36;
+    arguments.read("--spokes", numSpokes);
+
+    double radius = 5000.0;
+    arguments.read("--radius", radius);
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+    GeoHeightField geoHF = makeHills( srs );
+    const GeoExtent& extent = geoHF.getExtent();
+
+    osg::ref_ptr<osg::Node> patch = makeTerrainPatch( geoHF );
+
+    // observers 2m above the terrain, kept a radius away from the edges.
+    Random prng(1234);
+    double margin = radius / 70000.0;
+    std::vector<GeoPoint> observers;
+    for(unsigned i = 0; i < count; ++i)
+    {
+        double x = extent.xMin() + margin + (extent.width() - 2.0*margin) * prng.next();
+        double y = extent.yMin() + margin + (extent.height() - 2.0*margin) * prng.next();
+        double z = HeightFieldUtils::getHeightAtNormalizedLocation(
+            geoHF.getHeightField(), (x-extent.xMin())/extent.width(), (y-extent.yMin())/extent.height(), INTERP_TRIANGULATE );
+        observers.push_back( GeoPoint(srs, x, y, z + 2.0, ALTMODE_ABSOLUTE) );
+    }
+
+    // the scene graph way, as in RadialLineOfSightNode: one intersector per radial.
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    std::vector<bool> clear( count * numSpokes );
+    double delta = osg::PI * 2.0 / (double)numSpokes;
+    for(unsigned i = 0; i < count; ++i)
+    {
+        osg::Vec3d center;
+        observers[i].toWorld( center );
+        osg::Vec3d up = center;
+        up.normalize();
+        osg::Vec3d side = up ^ osg::Vec3d(0,0,1);
+
+        osg::ref_ptr<osgUtil::IntersectorGroup> group = new osgUtil::IntersectorGroup();
+        for(unsigned s = 0; s < numSpokes; ++s)
+        {
+            osg::Vec3d end = center + osg::Quat(delta*(double)s, up) * (side * radius);
+            group->addIntersector( new DPLineSegmentIntersector(center, end) );
+        }
+
+        osgUtil::IntersectionVisitor iv( group.get() );
+        patch->accept( iv );
+
+        for(unsigned s = 0; s < numSpokes; ++s)
+        {
+            DPLineSegmentIntersector* lsi = static_cast<DPLineSegmentIntersector*>(group->getIntersectors()[s].get());
+            clear[i*numSpokes + s] = lsi->getIntersections().empty();
+        }
+    }
+    double intersectTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    std::cout << std::fixed << std::setprecision(0)
+        << "Radial LOS for " << count << " observers, " << numSpokes << " radials of " << radius << " m\n"
+        << "  intersection:          " << (double)count/intersectTime << " observers/s\n";
+
+    unsigned maxThreads = (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+    for(unsigned threads = 1; ; threads = osg::minimum( threads*2u, maxThreads ))
+    {
+        HeightFieldLineOfSight los;
+        los.setElevationGrid( geoHF );
+        los.setRadius( radius );
+        los.setNumSpokes( numSpokes );
+        los.setNumThreads( threads );
+
+        std::vector<HeightFieldLineOfSight::Result> results;
+        start = osg::Timer::instance()->tick();
+        los.compute( observers, results );
+        double t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        unsigned agree = 0;
+        for(unsigned i = 0; i < count; ++i)
+            for(unsigned s = 0; s < numSpokes; ++s)
+                if ( clear[i*numSpokes + s] == (results[i].hits[s] < 0.0f) )
+                    ++agree;
+
+        std::cout << std::setprecision(0)
+            << "  heightfield, " << std::setw(2) << threads << " thr.:  " << (double)count/t << " observers/s"
+            << std::setprecision(2)
+            << " (" << 100.0*(double)agree/(double)(count*numSpokes) << "% radials agree)\n";
+
+        if ( threads == maxThreads )
+            break;
+    }
+
+    std::cout << std::endl;
+    return 0;
+}
+
+//........................................................................
+
+int
+benchmarkViewshed(osg::ArgumentParser& arguments)
+{
+    unsigned resolution = 512;
+    arguments.read("--resolution", resolution);
+
+    double radius = 10000.0;
+    arguments.read("--radius", radius);
+
+    const SpatialReference* srs = SpatialReference::get("wgs84");
+    GeoHeightField geoHF = makeHills( srs );
+    const GeoExtent& extent = geoHF.getExtent();
+
+    GeoPoint observer(srs, 0.5*(extent.xMin()+extent.xMax()), 0.5*(extent.yMin()+extent.yMax()), 2.0, ALTMODE_RELATIVE);
+
+    std::cout << std::fixed
+        << "Viewshed of " << (2*resolution+1) << "x" << (2*resolution+1) << " cells, radius " << std::setprecision(0) << radius << " m\n";
+
+    GeoImage first;
+    unsigned maxThreads = (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+    for(unsigned threads = 1; ; threads = osg::minimum( threads*2u, maxThreads ))
+    {
+        Viewshed viewshed;
+        viewshed.setRadius( radius );
+        viewshed.setResolution( resolution );
+        viewshed.setNumThreads( threads );
+
+        GeoImage mask;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        viewshed.compute( geoHF, observer, mask );
+        double t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        const osg::Image* image = mask.getImage();
+        unsigned visible = 0;
+        for(unsigned i = 0; i < image->getTotalSizeInBytes(); ++i)
+            if ( image->data()[i] ) ++visible;
+
+        bool same = !first.valid() || memcmp(first.getImage()->data(), image->data(), image->getTotalSizeInBytes()) == 0;
+        if ( !first.valid() )
+            first = mask;
+
+        std::cout << std::setprecision(1)
+            << "  " << std::setw(2) << threads << " thr.: " << 1000.0*t << " ms, "
+            << visible << " cells visible" << (same ? "" : " (MISMATCH)") << "\n";
+
+        if ( threads == maxThreads )
+            break;
+    }
+
+    std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,172 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Headless micro-benchmarks for osgEarth processing pipelines.
+ * Each benchmark is selected with a command line switch and prints
+ * its timings to stdout.
+ */
+
+#include "Benchmarks"
+
+#include <osg/ArgumentParser>
+#include <iostream>
+
+int
+usage(const char* name)
+{
+    std::cout
+        << "Usage: " << name << " <benchmark> [options]\n"
+        << "\n"
+        << "  --extrude                 : building extrusion (ExtrudeGeometryFilter)\n"
+        << "      [--count n]           : number of building footprints (default 20000)\n"
+        << "      [--iterations n]      : number of timed runs per mode (default 3)\n"
+        << "\n"
+        << "  --mvt file.pbf            : vector tile decoding throughput (MVT)\n"
+        << "      [--tile z x y]        : spherical-mercator key of the tile (default 0 0 0)\n"
+        << "      [--layer name]        : only decode this layer (repeatable)\n"
+        << "      [--no-attributes]     : skip attribute decoding\n"
+        << "      [--iterations n]      : number of decodes (default 100)\n"
+        << "\n"
+        << "  --consolidate             : geometry consolidation (GeometryConsolidator)\n"
+        << "      [--count n]           : number of polygon features (default 20000)\n"
+        << "      [--max-verts n]       : vertex limit per merged geometry\n"
+        << "\n"
+        << "  --clamp                   : geometry clamping, patch intersection vs. heightfield\n"
+        << "      [--count n]           : number of line vertices to clamp (default 20000)\n"
+        << "\n"
+        << "  --gdal file.tif           : GDAL tile read throughput, shared vs. per-thread datasets\n"
+        << "      [--tiles n]           : number of tiles to read per run (default 512)\n"
+        << "      [--level n]           : level of the tiles (default: deepest level with data)\n"
+        << "      [--max-threads n]     : read with 1, 2, 4... up to n threads (default 16)\n"
+        << "      [--elevation]         : read heightfields instead of images\n"
+        << "      [--block-cache mb]    : read through an overview-aware block cache of this size\n"
+        << "      [--sampling]          : instead, time bilinear sampling with windowed vs.\n"
+        << "                              per-pixel reads on one thread and compare the output\n"
+        << "\n"
+        << "  --los                     : radial line of sight, patch intersection vs. heightfield\n"
+        << "      [--count n]           : number of observers (default 1000)\n"
+        << "      [--spokes n]          : radials per observer (default 36)\n"
+        << "      [--radius m]          : radial length in meters (default 5000)\n"
+        << "\n"
+        << "  --viewshed                : viewshed raster generation (Viewshed)\n"
+        << "      [--resolution n]      : cells from the observer to the edge (default 512)\n"
+        << "      [--radius m]          : viewshed radius in meters (default 10000)\n"
+        << "\n"
+        << "  --srs                     : bulk SRS transforms, Vec3d vectors vs. coordinate arrays\n"
+        << "      [--count n]           : number of points (default 1000000)\n"
+        << "      [--max-threads n]     : also transform to UTM with 1, 2, 4... up to n threads (default 8)\n"
+        << "\n"
+        << "  --ecef                    : batch geodetic <=> ECEF kernels vs. osg::EllipsoidModel\n"
+        << "      [--count n]           : number of points (default 1000000)\n"
+        << "\n"
+        << "  --vdatum name             : heightfield vertical datum conversion, per point vs. grid\n"
+        << "      [--tiles n]           : number of 257x257 tiles to convert (default 256)\n"
+        << "\n"
+        << "  --cache                   : cache bin codecs; bytes on disk and read time per tile\n"
+        << "      [--tiles n]           : number of tiles to write (default 256)\n"
+        << "      [--source file.tif]   : imagery to cache (default: synthetic 256x256 RGBA)\n"
+        << "      [--path dir]          : filesystem cache location (default ./osgearth_benchmark_cache)\n"
+        << "\n"
+        << "  --perthread               : PerThread<T> access cost, map+mutex vs. thread-local slots\n"
+        << "      [--max-threads n]     : run with 1, 2, 4... up to n threads (default 32)\n"
+        << "      [--iterations n]      : accesses per thread (default 1000000)\n"
+        << "\n"
+        << "  --lru                     : LRU cache throughput, LRUCache vs. ShardedLRUCache\n"
+        << "      [--max-threads n]     : run with 1, 2, 4... up to n threads (default 32)\n"
+        << "      [--iterations n]      : lookups per thread (default 1000000)\n"
+        << "      [--size n]            : cache capacity in entries (default 4096)\n"
+        << "\n"
+        << "  --earthfile               : earth file parsing, XmlDocument vs. ConfigReader\n"
+        << "      [--file file.earth]   : earth file to parse (default: synthetic, with inline features)\n"
+        << "      [--count n]           : number of inline feature layers to synthesize (default 5000)\n"
+        << "      [--iterations n]      : number of timed parses (default 10)\n"
+        << "\n"
+        << "  --places                  : place culling and decluttering, PlaceNodes vs. PlaceBatchNode\n"
+        << "      [--count n]           : number of places (default 20000)\n"
+        << "      [--iterations n]      : number of timed cull traversals (default 20)\n"
+        << "      [--icon file]         : icon image for the places (default: labels only)\n"
+        << "      [--icons n]           : or n generated icons of different sizes, used in turn\n"
+        << "\n"
+        << "  --tracks                  : track position updates per second, TrackNodes vs. TrackBatchNode\n"
+        << "      [--count n]           : number of tracks (default 10000)\n"
+        << "      [--iterations n]      : number of update frames (default 100)\n"
+        << "      [--fraction f]        : fraction of the tracks that move each frame (default 1.0)\n"
+        << std::endl;
+    return 0;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--extrude") )
+        return benchmarkExtrude(arguments);
+
+    if ( arguments.find("--mvt") > 0 )
+        return benchmarkMVT(arguments);
+
+    if ( arguments.read("--consolidate") )
+        return benchmarkConsolidate(arguments);
+
+    if ( arguments.read("--clamp") )
+        return benchmarkClamp(arguments);
+
+    if ( arguments.find("--gdal") > 0 )
+        return benchmarkGDAL(arguments);
+
+    if ( arguments.read("--los") )
+        return benchmarkLOS(arguments);
+
+    if ( arguments.read("--viewshed") )
+        return benchmarkViewshed(arguments);
+
+    if ( arguments.read("--srs") )
+        return benchmarkSRS(arguments);
+
+    if ( arguments.read("--ecef") )
+        return benchmarkECEF(arguments);
+
+    if ( arguments.find("--vdatum") > 0 )
+        return benchmarkVDatum(arguments);
+
+    if ( arguments.read("--cache") )
+        return benchmarkCache(arguments);
+
+    if ( arguments.read("--perthread") )
+        return benchmarkPerThread(arguments);
+
+    if ( arguments.read("--lru") )
+        return benchmarkLRU(arguments);
+
+    if ( arguments.read("--earthfile") )
+        return benchmarkEarthFile(arguments);
+
+    if ( arguments.read("--places") )
+        return benchmarkPlaces(arguments);
+
+    if ( arguments.read("--tracks") )
+        return benchmarkTracks(arguments);
+
+    return usage(argv[0]);
+}
@@ -31,6 +31,9 @@
 #include <osgEarthUtil/AutoClipPlaneHandler>
 #include <osgEarthUtil/LinearLineOfSight>
 #include <osgEarthUtil/RadialLineOfSight>
+#include <osgEarthUtil/Viewshed>
+#include <osgDB/WriteFile>
+#include <osg/Timer>
 #include <osg/io_utils>
 #include <osg/MatrixTransform>
 #include <osg/Depth>
@@ -103,10 +106,64 @@ osg::Node* createPlane(osg::Node* node, const GeoPoint& pos, const SpatialRefere
     return positioner;
 }
 
+struct ViewshedJob
+{
+    double      lon, lat, height;
+    std::string filename;
+};
+
+// Headless mode: writes one viewshed mask per job and exits.
+int
+runViewsheds(MapNode* mapNode, const std::vector<ViewshedJob>& jobs, double radius, unsigned resolution)
+{
+    const SpatialReference* geoSRS = mapNode->getMapSRS()->getGeographicSRS();
+
+    Viewshed viewshed;
+    viewshed.setRadius( radius );
+    viewshed.setResolution( resolution );
+
+    for (std::vector<ViewshedJob>::const_iterator job = jobs.begin(); job != jobs.end(); ++job)
+    {
+        GeoPoint observer(geoSRS, job->lon, job->lat, job->height, ALTMODE_RELATIVE);
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        GeoImage mask;
+        if ( !viewshed.compute(mapNode->getMap(), observer, mask) )
+        {
+            OE_WARN << "Viewshed failed at " << job->lon << ", " << job->lat << std::endl;
+            return 1;
+        }
+        double t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        if ( !osgDB::writeImageFile(*mask.getImage(), job->filename) )
+        {
+            OE_WARN << "Unable to write " << job->filename << std::endl;
+            return 1;
+        }
+
+        OE_NOTICE << "Wrote " << job->filename << " (" << mask.getExtent().toString() << ") in " << t << "s" << std::endl;
+    }
+
+    return 0;
+}
+
 int
 main(int argc, char** argv)
 {
     osg::ArgumentParser arguments(&argc,argv);
+
+    // --viewshed lon lat height out.png : compute a viewshed headless (repeatable)
+    std::vector<ViewshedJob> viewsheds;
+    ViewshedJob job;
+    while ( arguments.read("--viewshed", job.lon, job.lat, job.height, job.filename) )
+        viewsheds.push_back( job );
+
+    double radius = 5000.0;
+    arguments.read("--radius", radius);
+
+    unsigned resolution = 256;
+    arguments.read("--resolution", resolution);
+
     osgViewer::Viewer viewer(arguments);
 
     // load the .earth file from the command line.
@@ -126,6 +183,9 @@ main(int argc, char** argv)
         return 1;
     }
 
+    if ( !viewsheds.empty() )
+        return runViewsheds( mapNode, viewsheds, radius, resolution );
+
     osgEarth::Util::EarthManipulator* manip = new EarthManipulator();
     viewer.setCameraManipulator( manip );
     
@@ -49,12 +49,14 @@ usage( const std::string& msg )
         << "    --max-level        ; The maximum level of the feature quadtree" << std::endl
         << "    --max-features     ; The maximum number of features per tile" << std::endl
         << "    --grid             ; Generate a single level grid with the specified resolution.  Default units are meters. (ex. 50, 100km, 200mi)" << std::endl
-        << "    --out              ; The destination directory" << std::endl
+        << "    --out              ; The destination directory, or the .mbtiles file for --format mvt" << std::endl
+        << "    --format           ; The output format: json (default) or mvt (vector tiles in an MBTiles file)" << std::endl
+        << "    --threads          ; The number of threads to use when encoding vector tiles.  Defaults to one per core" << std::endl
         << "    --layer            ; The name of the layer to be written to the metadata document" << std::endl
         << "    --description      ; The abstract/description of the layer to be written to the metadata document" << std::endl
         << "    --expression       ; The expression to run on the feature source, specific to the feature source" << std::endl
         << "    --order-by         ; Sort the features, if not already included in the expression. Append DESC for descending order!" << std::endl
-        << "    --crop             ; Crops features instead of doing a centroid check.  Features can be added to multiple tiles when cropping is enabled" << std::endl
+        << "    --crop             ; Crops features instead of doing a centroid check.  Features can be added to multiple tiles when cropping is enabled. Always on for --format mvt" << std::endl
         << "    --dest-srs         ; The destination SRS string in any format osgEarth can understand (wkt, proj4, epsg).  If none is specified the source data SRS will be used" << std::endl
         << "    --bounds minx miny maxx maxy ; The bounding box to use as Level 0.  Feature extent will be used by default" << std::endl
         << std::endl;
@@ -88,6 +90,13 @@ int main(int argc, char** argv)
     std::string destination = "out";
     while (arguments.read("--out", destination));
 
+    //The output format
+    std::string format = "json";
+    while (arguments.read("--format", format));
+
+    unsigned int numThreads = 0;
+    while (arguments.read("--threads", numThreads));
+
     //The name of the layer
     std::string layer = "layer";
     while (arguments.read("--layer", layer));
@@ -103,8 +112,9 @@ int main(int argc, char** argv)
     while (arguments.read("--order-by", queryOrderBy));
 
     CropFilter::Method cropMethod = CropFilter::METHOD_CENTROID;
-    if (arguments.read("--crop"))
+    if (arguments.read("--crop") || format == "mvt")
     {
+        // vector tiles are clipped to their extents, so they always crop.
         cropMethod = CropFilter::METHOD_CROPPING;
     }
 
@@ -236,6 +246,8 @@ int main(int argc, char** argv)
     packager.setMethod( cropMethod );    
     packager.setDestSRS( destSRS );
     packager.setLod0Extent(ext);
+    packager.setFormat( format == "mvt" ? TFSPackager::FORMAT_MVT : TFSPackager::FORMAT_JSON );
+    packager.setNumThreads( numThreads );
 
     packager.package( features, destination, layer, description );
     osg::Timer_t endTime = osg::Timer::instance()->tick();
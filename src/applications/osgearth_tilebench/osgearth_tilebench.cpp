@@ -0,0 +1,423 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Headless tile pipeline benchmark. Loads an earth file, builds a
+ * reproducible list of tile keys, and creates the tiles on several threads
+ * without a viewer or graphics context, timing each layer on its own and
+ * then the complete terrain tile models.
+ */
+#include <osgEarth/MapNode>
+#include <osgEarth/Map>
+#include <osgEarth/MapFrame>
+#include <osgEarth/TerrainEngineNode>
+#include <osgEarth/TerrainTileModelFactory>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/Registry>
+#include <osgEarth/Random>
+#include <osgEarth/Cache>
+#include <osgEarth/CachePolicy>
+#include <osgEarth/Metrics>
+#include <osgEarthDrivers/cache_filesystem/FileSystemCache>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+int
+usage(const char* name)
+{
+    std::cout
+        << "Usage: " << name << " file.earth [options]\n"
+        << "\n"
+        << "  Creates tiles from the map without a viewer and reports latency\n"
+        << "  and throughput for each layer and for complete terrain tile models.\n"
+        << "\n"
+        << "  --workload name           : pyramid, random, or flythrough (default pyramid)\n"
+        << "  --tiles n                 : maximum number of tiles (default 1000)\n"
+        << "  --min-level n             : shallowest level (default 0)\n"
+        << "  --max-level n             : deepest level (default 8)\n"
+        << "  --bounds xmin ymin xmax ymax : area to cover, in the map's SRS (default: whole map)\n"
+        << "  --seed n                  : seed for the random workload (default 0)\n"
+        << "  --threads n               : number of worker threads (default: one per core)\n"
+        << "  --cache path              : use a filesystem cache at this location\n"
+        << "  --cache-policy name       : no_cache, read_only, read_write, or cache_only\n"
+        << "  --warmup                  : create the tile models once before timing\n"
+        << "  --no-layers               : skip the per-layer passes\n"
+        << "  --no-model                : skip the tile model pass\n"
+        << "  --metrics file            : write pipeline metrics (.json or .csv) after the run\n"
+        << "  --trace file              : write a Chrome trace of the run\n"
+        << std::endl;
+    return -1;
+}
+
+//........................................................................
+
+// Every tile covering the bounds, level by level from the top.
+void
+makePyramid(const Profile* profile, const GeoExtent& bounds, unsigned minLevel, unsigned maxLevel,
+            unsigned maxTiles, std::vector<TileKey>& out)
+{
+    for(unsigned lod = minLevel; lod <= maxLevel && out.size() < maxTiles; ++lod)
+    {
+        std::vector<TileKey> keys;
+        profile->getIntersectingTiles( bounds, lod, keys );
+        for(std::vector<TileKey>::const_iterator k = keys.begin(); k != keys.end() && out.size() < maxTiles; ++k)
+            out.push_back( *k );
+    }
+}
+
+// Tiles at random locations and levels within the bounds.
+void
+makeRandom(const Profile* profile, const GeoExtent& bounds, unsigned minLevel, unsigned maxLevel,
+           unsigned maxTiles, unsigned seed, std::vector<TileKey>& out)
+{
+    Random prng( seed );
+    for(unsigned i = 0; i < maxTiles; ++i)
+    {
+        unsigned lod = minLevel + prng.next( maxLevel - minLevel + 1 );
+        double x = bounds.xMin() + prng.next()*bounds.width();
+        double y = bounds.yMin() + prng.next()*bounds.height();
+        TileKey key = profile->createTileKey( x, y, lod );
+        if ( key.valid() )
+            out.push_back( key );
+    }
+}
+
+// A camera flying diagonally across the bounds. At each step it requests
+// the tile under it and its eight neighbors at every level, coarse to
+// fine, the way the pager would; each tile is requested once.
+void
+makeFlythrough(const Profile* profile, const GeoExtent& bounds, unsigned minLevel, unsigned maxLevel,
+               unsigned maxTiles, std::vector<TileKey>& out)
+{
+    const unsigned steps = 1024;
+    std::set<TileKey> seen;
+
+    for(unsigned s = 0; s <= steps && out.size() < maxTiles; ++s)
+    {
+        double t = (double)s/(double)steps;
+        double x = bounds.xMin() + t*bounds.width();
+        double y = bounds.yMin() + t*bounds.height();
+
+        for(unsigned lod = minLevel; lod <= maxLevel && out.size() < maxTiles; ++lod)
+        {
+            TileKey center = profile->createTileKey( x, y, lod );
+            if ( !center.valid() )
+                continue;
+
+            for(int dy = -1; dy <= 1; ++dy)
+            {
+                for(int dx = -1; dx <= 1 && out.size() < maxTiles; ++dx)
+                {
+                    TileKey key = (dx == 0 && dy == 0) ? center : center.createNeighborKey( dx, dy );
+                    if ( key.valid() && seen.insert(key).second )
+                        out.push_back( key );
+                }
+            }
+        }
+    }
+}
+
+//........................................................................
+
+// One timed pass over the workload: a single layer, or whole tile models.
+struct Pass
+{
+    Pass() : _imageLayer(0L), _elevationLayer(0L), _factory(0L), _requirements(0L) { }
+
+    std::string                      _name;
+    ImageLayer*                      _imageLayer;
+    ElevationLayer*                  _elevationLayer;
+    TerrainTileModelFactory*         _factory;
+    const TerrainEngineRequirements* _requirements;
+
+    // Creates the tile; returns false if there was no data for it.
+    bool run(const MapFrame& frame, const TileKey& key) const
+    {
+        if ( _imageLayer )
+            return _imageLayer->createImage( key ).valid();
+
+        if ( _elevationLayer )
+            return _elevationLayer->createHeightField( key ).valid();
+
+        osg::ref_ptr<TerrainTileModel> model = _factory->createTileModel( frame, key, _requirements, 0L );
+        return model.valid() && (!model->colorLayers().empty() || model->elevationModel().valid());
+    }
+};
+
+// Pulls keys off the shared workload until it is empty.
+struct PassThread : public OpenThreads::Thread
+{
+    const Pass*                 _pass;
+    const Map*                  _map;
+    const std::vector<TileKey>* _keys;
+    OpenThreads::Atomic*        _next;
+    std::vector<double>         _latencies; // ms
+    unsigned                    _empty;
+
+    void run()
+    {
+        MapFrame frame( _map );
+        _empty = 0u;
+
+        for(;;)
+        {
+            unsigned i = ++(*_next) - 1u;
+            if ( i >= _keys->size() )
+                break;
+
+            osg::Timer_t t0 = osg::Timer::instance()->tick();
+            bool ok = _pass->run( frame, (*_keys)[i] );
+            _latencies.push_back( osg::Timer::instance()->delta_m(t0, osg::Timer::instance()->tick()) );
+            if ( !ok )
+                ++_empty;
+        }
+    }
+};
+
+double
+percentile(const std::vector<double>& sorted, double p)
+{
+    if ( sorted.empty() )
+        return 0.0;
+    unsigned i = (unsigned)(p*(double)(sorted.size()-1) + 0.5);
+    return sorted[osg::minimum(i, (unsigned)sorted.size()-1u)];
+}
+
+// Runs a pass on all the keys and prints one line of results.
+void
+runPass(const Pass& pass, const Map* map, const std::vector<TileKey>& keys, unsigned numThreads, bool print)
+{
+    OpenThreads::Atomic next( 0u );
+
+    std::vector<PassThread*> threads( numThreads );
+
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        threads[t] = new PassThread();
+        threads[t]->_pass = &pass;
+        threads[t]->_map  = map;
+        threads[t]->_keys = &keys;
+        threads[t]->_next = &next;
+        threads[t]->startThread();
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve( keys.size() );
+    unsigned empty = 0u;
+
+    for(unsigned t = 0; t < numThreads; ++t)
+    {
+        threads[t]->join();
+        latencies.insert( latencies.end(), threads[t]->_latencies.begin(), threads[t]->_latencies.end() );
+        empty += threads[t]->_empty;
+        delete threads[t];
+    }
+
+    double seconds = osg::Timer::instance()->delta_s( t0, osg::Timer::instance()->tick() );
+
+    if ( !print )
+        return;
+
+    std::sort( latencies.begin(), latencies.end() );
+
+    std::cout << std::fixed
+        << "  " << std::left << std::setw(28) << pass._name.substr(0, 27) << std::right
+        << std::setw(7) << latencies.size()
+        << std::setw(8) << empty
+        << std::setprecision(1) << std::setw(11) << (seconds > 0.0 ? (double)latencies.size()/seconds : 0.0)
+        << std::setprecision(3)
+        << std::setw(10) << percentile(latencies, 0.50)
+        << std::setw(10) << percentile(latencies, 0.99)
+        << std::setw(10) << (latencies.empty() ? 0.0 : latencies.back())
+        << std::endl;
+}
+
+//........................................................................
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( argc < 2 || arguments.read("--help") )
+        return usage(argv[0]);
+
+    std::string workload = "pyramid";
+    arguments.read("--workload", workload);
+
+    unsigned maxTiles = 1000;
+    arguments.read("--tiles", maxTiles);
+
+    unsigned minLevel = 0, maxLevel = 8;
+    arguments.read("--min-level", minLevel);
+    arguments.read("--max-level", maxLevel);
+    if ( maxLevel < minLevel )
+        maxLevel = minLevel;
+
+    double xmin, ymin, xmax, ymax;
+    bool hasBounds = arguments.read("--bounds", xmin, ymin, xmax, ymax);
+
+    unsigned seed = 0;
+    arguments.read("--seed", seed);
+
+    unsigned numThreads = (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+    arguments.read("--threads", numThreads);
+    numThreads = osg::maximum( numThreads, 1u );
+
+    bool warmup   = arguments.read("--warmup");
+    bool doLayers = !arguments.read("--no-layers");
+    bool doModel  = !arguments.read("--no-model");
+
+    std::string metricsFile, traceFile;
+    arguments.read("--metrics", metricsFile);
+    arguments.read("--trace", traceFile);
+
+    // caches must be configured before the map opens its layers.
+    std::string cachePath;
+    if ( arguments.read("--cache", cachePath) )
+    {
+        FileSystemCacheOptions cacheOptions;
+        cacheOptions.rootPath() = cachePath;
+        osg::ref_ptr<Cache> cache = CacheFactory::create( cacheOptions );
+        if ( !cache.valid() )
+        {
+            std::cerr << "Failed to create a cache at " << cachePath << std::endl;
+            return -1;
+        }
+        Registry::instance()->setDefaultCache( cache.get() );
+    }
+
+    std::string policy;
+    if ( arguments.read("--cache-policy", policy) )
+    {
+        if      ( policy == "no_cache" )   Registry::instance()->setOverrideCachePolicy( CachePolicy::USAGE_NO_CACHE );
+        else if ( policy == "read_only" )  Registry::instance()->setOverrideCachePolicy( CachePolicy::USAGE_READ_ONLY );
+        else if ( policy == "read_write" ) Registry::instance()->setOverrideCachePolicy( CachePolicy::USAGE_READ_WRITE );
+        else if ( policy == "cache_only" ) Registry::instance()->setOverrideCachePolicy( CachePolicy::USAGE_CACHE_ONLY );
+        else
+            return usage(argv[0]);
+    }
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles( arguments );
+    MapNode* mapNode = MapNode::get( node.get() );
+    if ( !mapNode )
+    {
+        std::cerr << "Failed to load an earth file" << std::endl;
+        return -1;
+    }
+
+    const Map* map = mapNode->getMap();
+    const Profile* profile = map->getProfile();
+
+    GeoExtent bounds = hasBounds ?
+        GeoExtent( profile->getSRS(), xmin, ymin, xmax, ymax ) :
+        profile->getExtent();
+
+    std::vector<TileKey> keys;
+    if ( workload == "pyramid" )
+        makePyramid( profile, bounds, minLevel, maxLevel, maxTiles, keys );
+    else if ( workload == "random" )
+        makeRandom( profile, bounds, minLevel, maxLevel, maxTiles, seed, keys );
+    else if ( workload == "flythrough" )
+        makeFlythrough( profile, bounds, minLevel, maxLevel, maxTiles, keys );
+    else
+        return usage(argv[0]);
+
+    if ( keys.empty() )
+    {
+        std::cerr << "The workload is empty; check the bounds and levels" << std::endl;
+        return -1;
+    }
+
+    if ( !metricsFile.empty() )
+        Metrics::setEnabled( true );
+    if ( !traceFile.empty() )
+        Metrics::setTracing( true );
+
+    MapFrame frame( map );
+
+    osg::ref_ptr<TerrainTileModelFactory> factory =
+        new TerrainTileModelFactory( mapNode->getMapNodeOptions().getTerrainOptions() );
+
+    Pass modelPass;
+    modelPass._name         = "tile model";
+    modelPass._factory      = factory.get();
+    modelPass._requirements = mapNode->getTerrainEngine();
+
+    std::cout
+        << "Workload: " << workload << ", " << keys.size() << " tiles, levels "
+        << minLevel << "-" << maxLevel << ", " << numThreads << " threads\n"
+        << "Latencies in ms; \"empty\" counts tiles with no data.\n\n"
+        << "  pass                          tiles   empty    tiles/s       p50       p99       max"
+        << std::endl;
+
+    if ( warmup )
+    {
+        runPass( modelPass, map, keys, numThreads, false );
+        Metrics::reset();
+    }
+
+    if ( doLayers )
+    {
+        for(ImageLayerVector::const_iterator i = frame.imageLayers().begin(); i != frame.imageLayers().end(); ++i)
+        {
+            Pass pass;
+            pass._name = "image: " + i->get()->getName();
+            pass._imageLayer = i->get();
+            runPass( pass, map, keys, numThreads, true );
+        }
+
+        for(ElevationLayerVector::const_iterator i = frame.elevationLayers().begin(); i != frame.elevationLayers().end(); ++i)
+        {
+            Pass pass;
+            pass._name = "elevation: " + i->get()->getName();
+            pass._elevationLayer = i->get();
+            runPass( pass, map, keys, numThreads, true );
+        }
+    }
+
+    if ( doModel )
+    {
+        runPass( modelPass, map, keys, numThreads, true );
+    }
+
+    if ( !metricsFile.empty() )
+        Metrics::write( metricsFile );
+    if ( !traceFile.empty() )
+        Metrics::writeChromeTrace( traceFile );
+
+    return 0;
+}
@@ -21,6 +21,7 @@
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Registry>
 #include <osgEarth/Cache>
+#include <osgEarth/StringUtils>
 
 #include <osgDB/ReaderWriter>
 #include <osgDB/FileNameUtils>
@@ -29,6 +30,8 @@
 #include <osg/Texture>
 #include <osg/Image>
 #include <osg/TextureBuffer>
+#include <sstream>
+#include <string.h>
 
 using namespace osgEarth;
 
@@ -283,11 +286,9 @@ namespace
 }
 
 
-bool
-CacheBin::writeNode(const std::string&    key,
-                    osg::Node*            node,
-                    const Config&         metadata,
-                    const osgDB::Options* writeOptions)
+void
+CacheBin::prepareNode(osg::Node*            node,
+                      const osgDB::Options* writeOptions)
 {
     // Preparation step - removes things like UserDataContainers
     PrepareForCaching prep;
@@ -296,6 +297,15 @@ CacheBin::writeNode(const std::string&    key,
     // Write external refs (like texture images) to the cache bin
     WriteExternalReferencesToCache writeRefs(this, writeOptions);
     node->accept( writeRefs );
+}
+
+bool
+CacheBin::writeNode(const std::string&    key,
+                    osg::Node*            node,
+                    const Config&         metadata,
+                    const osgDB::Options* writeOptions)
+{
+    prepareNode( node, writeOptions );
 
     // finally, write the graph to the bin:
     write(key, node, metadata, writeOptions);
@@ -304,6 +314,215 @@ CacheBin::writeNode(const std::string&    key,
 }
 
 
+#undef  LC
+#define LC "[CacheBin] "
+
+namespace
+{
+    // Records written with an image codec start with this header:
+    //   "OEIC", version, flags, codec extension length, codec extension,
+    //   internal texture format (4 bytes, little-endian)
+    // followed by the encoded image.
+    const char          CODEC_MAGIC[4] = { 'O', 'E', 'I', 'C' };
+    const unsigned char CODEC_VERSION  = 1;
+    const unsigned char CODEC_FLAG_RESTORE_ALPHA = 1 << 0;
+
+    bool isOpaque(const osg::Image* image)
+    {
+        if ( image->getPixelFormat() != GL_RGBA )
+            return false;
+
+        for(int t = 0; t < image->t(); ++t)
+        {
+            const unsigned char* p = image->data(0, t);
+            for(int s = 0; s < image->s(); ++s, p += 4)
+            {
+                if ( p[3] != 255 )
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+void
+CacheBin::setImageCodec(const std::string& codec, const std::string& options)
+{
+    _imageCodec = osgEarth::toLower(codec);
+    _imageCodecRW = 0L;
+    _imageCodecOptions = 0L;
+
+    if ( !_imageCodec.empty() && _imageCodec != "osgb" )
+    {
+        _imageCodecRW = osgDB::Registry::instance()->getReaderWriterForExtension( _imageCodec );
+        if ( _imageCodecRW.valid() )
+        {
+            _pngRW = osgDB::Registry::instance()->getReaderWriterForExtension( "png" );
+            _imageCodecOptions = Registry::instance()->cloneOrCreateOptions();
+            _imageCodecOptions->setOptionString( options );
+        }
+        else
+        {
+            OE_WARN << LC << "No plugin for image codec \"" << _imageCodec << "\"; bin "
+                << getID() << " will store images as osgb" << std::endl;
+        }
+    }
+}
+
+void
+CacheBin::setCompressor(const std::string& value)
+{
+    _compressor = value;
+    _compressorOptions = 0L;
+
+    if ( !_compressor.empty() && _compressor != "none" )
+    {
+        _compressorOptions = Registry::instance()->cloneOrCreateOptions();
+        _compressorOptions->setPluginStringData( "Compressor", _compressor );
+    }
+}
+
+osg::ref_ptr<const osgDB::Options>
+CacheBin::getSerializerOptions(const osgDB::Options* dbo) const
+{
+    if ( !_compressorOptions.valid() )
+    {
+        return dbo;
+    }
+    else if ( !dbo )
+    {
+        return _compressorOptions.get();
+    }
+    else
+    {
+        osgDB::Options* merged = Registry::cloneOrCreateOptions(dbo);
+        merged->setPluginStringData( "Compressor", _compressor );
+        return merged;
+    }
+}
+
+bool
+CacheBin::writeImageWithCodec(const osg::Image* image, std::ostream& out) const
+{
+    if ( !_imageCodecRW.valid() || !image || !image->data() )
+        return false;
+
+    // Image formats only hold plain 8-bit 2D rasters, and know nothing of
+    // mipmaps, row padding, origins, or osgEarth's user values:
+    if ( image->r() != 1 ||
+         image->isMipmap() ||
+         ImageUtils::isCompressed(image) ||
+         image->getDataType() != GL_UNSIGNED_BYTE ||
+         image->getOrigin() != osg::Image::BOTTOM_LEFT ||
+         image->getRowSizeInBytes() != image->s() * image->getPixelSizeInBits() / 8 ||
+         image->getUserDataContainer() != 0L )
+    {
+        return false;
+    }
+
+    GLenum pf = image->getPixelFormat();
+    if ( pf != GL_RGB && pf != GL_RGBA && pf != GL_LUMINANCE && pf != GL_LUMINANCE_ALPHA )
+        return false;
+
+    osg::ref_ptr<const osg::Image> encoded = image;
+    osgDB::ReaderWriter*           rw      = _imageCodecRW.get();
+    std::string                    codec   = _imageCodec;
+    unsigned char                  flags   = 0;
+
+    bool isJPEG = (codec == "jpg" || codec == "jpeg");
+
+    if ( isJPEG && pf == GL_RGBA && isOpaque(image) )
+    {
+        // JPEG has no alpha; drop it and restore it when reading.
+        encoded = ImageUtils::convertToRGB8(image);
+        if ( !encoded.valid() )
+            return false;
+        flags |= CODEC_FLAG_RESTORE_ALPHA;
+    }
+    else if ( (isJPEG && (pf == GL_RGBA || pf == GL_LUMINANCE_ALPHA)) ||
+              (codec != "png" && (pf == GL_LUMINANCE || pf == GL_LUMINANCE_ALPHA)) )
+    {
+        // Keep translucent pixels, and luminance images the codec may not take,
+        // lossless:
+        if ( !_pngRW.valid() )
+            return false;
+        rw = _pngRW.get();
+        codec = "png";
+    }
+
+    std::stringstream buf;
+    osgDB::ReaderWriter::WriteResult r = rw->writeImage( *encoded.get(), buf, _imageCodecOptions.get() );
+    if ( !r.success() )
+    {
+        OE_DEBUG << LC << "Image codec \"" << codec << "\" failed (" << r.message() << "); using osgb" << std::endl;
+        return false;
+    }
+
+    GLint internalFormat = image->getInternalTextureFormat();
+    unsigned char header[4+3];
+    ::memcpy( header, CODEC_MAGIC, 4 );
+    header[4] = CODEC_VERSION;
+    header[5] = flags;
+    header[6] = (unsigned char)codec.size();
+    out.write( (const char*)header, sizeof(header) );
+    out.write( codec.c_str(), codec.size() );
+    for(unsigned i = 0; i < 4; ++i)
+        out.put( (char)((internalFormat >> (8*i)) & 0xff) );
+    out << buf.rdbuf();
+
+    return out.good();
+}
+
+osgDB::ReaderWriter::ReadResult
+CacheBin::readImageWithCodec(std::istream& in, const osgDB::Options* dbo) const
+{
+    std::istream::pos_type start = in.tellg();
+
+    unsigned char header[4+3];
+    if ( !in.read((char*)header, sizeof(header)) || ::memcmp(header, CODEC_MAGIC, 4) != 0 )
+    {
+        in.clear();
+        in.seekg( start );
+        return osgDB::ReaderWriter::ReadResult::FILE_NOT_HANDLED;
+    }
+
+    if ( header[4] != CODEC_VERSION || header[6] == 0 )
+        return osgDB::ReaderWriter::ReadResult( "Unsupported image codec record" );
+
+    unsigned char flags = header[5];
+    std::string codec( (size_t)header[6], ' ' );
+    in.read( &codec[0], codec.size() );
+
+    unsigned char fmt[4];
+    if ( !in.read((char*)fmt, 4) )
+        return osgDB::ReaderWriter::ReadResult( "Truncated image codec record" );
+    GLint internalFormat = fmt[0] | (fmt[1] << 8) | (fmt[2] << 16) | (fmt[3] << 24);
+
+    osgDB::ReaderWriter* rw =
+        codec == _imageCodec ? _imageCodecRW.get() :
+        codec == "png" && _pngRW.valid() ? _pngRW.get() :
+        osgDB::Registry::instance()->getReaderWriterForExtension( codec );
+
+    if ( !rw )
+        return osgDB::ReaderWriter::ReadResult( "No plugin for image codec \"" + codec + "\"" );
+
+    osgDB::ReaderWriter::ReadResult r = rw->readImage( in, dbo );
+    if ( !r.success() || !r.getImage() )
+        return r;
+
+    osg::ref_ptr<osg::Image> image = r.getImage();
+    if ( flags & CODEC_FLAG_RESTORE_ALPHA )
+    {
+        image = ImageUtils::convertToRGBA8( image.get() );
+        if ( !image.valid() )
+            return osgDB::ReaderWriter::ReadResult( "Failed to restore alpha channel" );
+    }
+    image->setInternalTextureFormat( internalFormat );
+
+    return image.release();
+}
+
+
 #undef  LC
 #define LC "[ReadImageFromCachePseudoLoader] "
 
@@ -20,6 +20,7 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include <osgEarth/Config>
+#include <osgEarth/ConfigReader>
 #include <osgEarth/XmlUtils>
 #include <osgEarth/JsonUtils>
 #include <osgEarth/FileUtils>
@@ -74,10 +75,7 @@ Config::setReferrer( const std::string& referrer )
 bool
 Config::fromXML( std::istream& in )
 {
-    osg::ref_ptr<XmlDocument> xml = XmlDocument::load( in );
-    if ( xml.valid() )
-        *this = xml->getConfig();
-    return xml.valid();
+    return ConfigReader::readXML( in, *this );
 }
 
 Config
@@ -276,93 +274,6 @@ namespace
 
         return value;
     }
-
-    void json2conf(const Json::Value& json, Config& conf, int depth)
-    {
-        if ( json.type() == Json::objectValue )
-        {
-            Json::Value::Members members = json.getMemberNames();
-
-            for( Json::Value::Members::const_iterator i = members.begin(); i != members.end(); ++i )
-            {
-                const Json::Value& value = json[*i];
-
-                if ( value.isObject() )
-                {
-                    if (depth == 0 && members.size() == 1)
-                    {
-                        conf.key() = *i;
-                        json2conf(value, conf, depth+1);
-                    }
-                    else
-                    {
-                        Config element( *i );
-                        json2conf( value, element, depth+1 );
-                        conf.add( element );
-                    }
-                }
-                else if ( value.isArray() )
-                {
-                    if ( endsWith(*i, "__array__") )
-                    {
-                        std::string key = i->substr(0, i->length()-9);
-                        for( Json::Value::const_iterator j = value.begin(); j != value.end(); ++j )
-                        {
-                            Config child;
-                            json2conf( *j, child, depth+1 );
-                            conf.add( key, child );
-                        }
-                    }
-                    else if ( endsWith(*i, "_$set") ) // backwards compatibility
-                    {
-                        std::string key = i->substr(0, i->length()-5);
-                        for( Json::Value::const_iterator j = value.begin(); j != value.end(); ++j )
-                        {
-                            Config child;
-                            json2conf( *j, child, depth+1 );
-                            conf.add( key, child );
-                        }
-                    }
-                    else
-                    {
-                        Config element( *i );
-                        json2conf( value, element, depth+1 );
-                        conf.add( element );
-                    }
-                }
-                else if ( (*i) == "$key" )
-                {
-                    conf.key() = value.asString();
-                }
-                else if ( (*i) == "$value" )
-                {
-                    conf.value() = value.asString();
-                }
-                else if ( (*i) == "$children" && value.isArray() )
-                {
-                    json2conf( value, conf, depth+1 );
-                }
-                else
-                {
-                    conf.add( *i, value.asString() );
-                }
-            }
-        }
-        else if ( json.type() == Json::arrayValue )
-        {          
-            for( Json::Value::const_iterator j = json.begin(); j != json.end(); ++j )
-            {
-                Config child;
-                json2conf( *j, child, depth+1 );
-                if ( !child.empty() )
-                    conf.add( child );
-            }
-        }
-        else if ( json.type() != Json::nullValue )
-        {
-            conf.value() = json.asString();
-        }
-    }
 }
 
 std::string
@@ -378,21 +289,7 @@ Config::toJSON( bool pretty ) const
 bool
 Config::fromJSON( const std::string& input )
 {
-    Json::Reader reader;
-    Json::Value root( Json::objectValue );
-    if ( reader.parse( input, root ) )
-    {
-        json2conf( root, *this, 0 );
-        return true;
-    }
-    else
-    {
-        OE_WARN 
-            << "JSON decoding error: "
-            << reader.getFormatedErrorMessages() 
-            << std::endl;
-    }
-    return false;
+    return ConfigReader::readJSON( input, *this );
 }
 
 Config
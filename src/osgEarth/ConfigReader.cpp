@@ -0,0 +1,1406 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/ConfigReader>
+#include <osgEarth/XmlUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <iterator>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace osgEarth;
+
+namespace
+{
+    // FNV-1a
+    inline unsigned hashChars(const char* str, unsigned len)
+    {
+        unsigned h = 2166136261u;
+        for(unsigned i = 0; i < len; ++i)
+        {
+            h ^= (unsigned char)str[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    void appendUTF8(unsigned long ucs, std::string& out)
+    {
+        if ( ucs < 0x80 )
+        {
+            out += (char)ucs;
+        }
+        else if ( ucs < 0x800 )
+        {
+            out += (char)(0xC0 | (ucs >> 6));
+            out += (char)(0x80 | (ucs & 0x3F));
+        }
+        else if ( ucs < 0x10000 )
+        {
+            out += (char)(0xE0 | (ucs >> 12));
+            out += (char)(0x80 | ((ucs >> 6) & 0x3F));
+            out += (char)(0x80 | (ucs & 0x3F));
+        }
+        else if ( ucs < 0x200000 )
+        {
+            out += (char)(0xF0 | (ucs >> 18));
+            out += (char)(0x80 | ((ucs >> 12) & 0x3F));
+            out += (char)(0x80 | ((ucs >> 6) & 0x3F));
+            out += (char)(0x80 | (ucs & 0x3F));
+        }
+    }
+}
+
+//........................................................................
+
+ConfigBuilder::ConfigBuilder()
+{
+    clear();
+}
+
+void
+ConfigBuilder::clear()
+{
+    _nodes.clear();
+    _arena.clear();
+    _configs.clear();
+    _strings.clear();
+    _strings.push_back( std::string() );
+    _hashTable.assign( 256, 0u );
+}
+
+void
+ConfigBuilder::rehash(unsigned size)
+{
+    _hashTable.assign( size, 0u );
+    unsigned mask = size - 1;
+    for(unsigned id = 1; id < _strings.size(); ++id)
+    {
+        const std::string& s = _strings[id];
+        unsigned i = hashChars(s.data(), (unsigned)s.length()) & mask;
+        while( _hashTable[i] != 0u )
+            i = (i+1) & mask;
+        _hashTable[i] = id;
+    }
+}
+
+unsigned
+ConfigBuilder::intern(const char* str, unsigned len)
+{
+    if ( len == 0 )
+        return 0;
+
+    unsigned mask = (unsigned)_hashTable.size() - 1;
+    for(unsigned i = hashChars(str, len) & mask; ; i = (i+1) & mask)
+    {
+        unsigned id = _hashTable[i];
+        if ( id == 0u )
+        {
+            id = (unsigned)_strings.size();
+            _strings.push_back( std::string(str, len) );
+            _hashTable[i] = id;
+
+            // keep the table at most half full
+            if ( _strings.size()*2 > _hashTable.size() )
+                rehash( (unsigned)_hashTable.size()*2 );
+            return id;
+        }
+
+        const std::string& s = _strings[id];
+        if ( s.length() == len && memcmp(s.data(), str, len) == 0 )
+            return id;
+    }
+}
+
+unsigned
+ConfigBuilder::addNode(unsigned parent, unsigned key)
+{
+    Node node;
+    node._key         = key;
+    node._valueOffset = 0;
+    node._valueLength = 0;
+    node._firstChild  = NONE;
+    node._lastChild   = NONE;
+    node._prevSibling = NONE;
+    node._nextSibling = NONE;
+    node._config      = NONE;
+
+    unsigned index = (unsigned)_nodes.size();
+
+    if ( parent != NONE )
+    {
+        Node& p = _nodes[parent];
+        if ( p._lastChild == NONE )
+        {
+            p._firstChild = index;
+        }
+        else
+        {
+            _nodes[p._lastChild]._nextSibling = index;
+            node._prevSibling = p._lastChild;
+        }
+        p._lastChild = index;
+    }
+
+    _nodes.push_back( node );
+    return index;
+}
+
+void
+ConfigBuilder::addConfig(unsigned parent, const Config& conf)
+{
+    unsigned node = addNode( parent, 0 );
+    _nodes[node]._config = (unsigned)_configs.size();
+    _configs.push_back( conf );
+}
+
+void
+ConfigBuilder::removeLastChild(unsigned parent)
+{
+    Node& p = _nodes[parent];
+    if ( p._lastChild == NONE )
+        return;
+
+    // the node's storage stays in the arena until the next clear().
+    unsigned prev = _nodes[p._lastChild]._prevSibling;
+    if ( prev == NONE )
+        p._firstChild = NONE;
+    else
+        _nodes[prev]._nextSibling = NONE;
+    p._lastChild = prev;
+}
+
+void
+ConfigBuilder::setValue(unsigned node, const char* data, unsigned len)
+{
+    Node& n = _nodes[node];
+    n._valueOffset = (unsigned)_arena.size();
+    n._valueLength = len;
+    _arena.insert( _arena.end(), data, data+len );
+}
+
+void
+ConfigBuilder::appendValue(unsigned node, const char* data, unsigned len)
+{
+    if ( len == 0 )
+        return;
+
+    Node& n = _nodes[node];
+    if ( n._valueLength == 0 )
+    {
+        setValue( node, data, len );
+    }
+    else if ( n._valueOffset + n._valueLength == _arena.size() )
+    {
+        // the value is at the end of the arena; extend it in place.
+        _arena.insert( _arena.end(), data, data+len );
+        n._valueLength += len;
+    }
+    else
+    {
+        // another value was written since; move this one to the end.
+        unsigned offset = (unsigned)_arena.size();
+        _arena.resize( offset + n._valueLength + len );
+        memmove( &_arena[offset], &_arena[n._valueOffset], n._valueLength );
+        memcpy( &_arena[offset + n._valueLength], data, len );
+        n._valueOffset = offset;
+        n._valueLength += len;
+    }
+}
+
+void
+ConfigBuilder::trimValue(unsigned node)
+{
+    Node& n = _nodes[node];
+    while( n._valueLength > 0 && isSpace(_arena[n._valueOffset + n._valueLength - 1]) )
+        --n._valueLength;
+    while( n._valueLength > 0 && isSpace(_arena[n._valueOffset]) )
+    {
+        ++n._valueOffset;
+        --n._valueLength;
+    }
+}
+
+bool
+ConfigBuilder::isEmpty(unsigned node) const
+{
+    const Node& n = _nodes[node];
+    return n._key == 0 && n._valueLength == 0 && n._firstChild == NONE && n._config == NONE;
+}
+
+void
+ConfigBuilder::build(unsigned node, Config& out) const
+{
+    const Node& n = _nodes[node];
+
+    out._key = _strings[n._key];
+    if ( n._valueLength > 0 )
+        out._defaultValue.assign( &_arena[n._valueOffset], n._valueLength );
+    else
+        out._defaultValue.clear();
+
+    for(unsigned c = n._firstChild; c != NONE; c = _nodes[c]._nextSibling)
+    {
+        const Node& child = _nodes[c];
+        if ( child._config != NONE )
+        {
+            out.add( _configs[child._config] );
+        }
+        else
+        {
+            // construct the child in place; Config::add would copy the
+            // whole subtree and re-resolve the referrer on every node.
+            out._children.push_back( Config() );
+            Config& conf = out._children.back();
+            conf._referrer = out._referrer;
+            build( c, conf );
+        }
+    }
+}
+
+//........................................................................
+
+namespace
+{
+    /**
+     * Single pass XML reader that emits the same tree XmlDocument::getConfig
+     * does for a document parsed by TinyXML: element and attribute names are
+     * lower-cased, attributes precede child elements in name order, text is
+     * white-space condensed and the concatenated text of an element trimmed.
+     */
+    class XmlReader
+    {
+    public:
+        XmlReader(ConfigBuilder& builder, const std::string& xml, const std::string& referrer) :
+            _b        ( builder ),
+            _begin    ( xml.data() ),
+            _p        ( xml.data() ),
+            _end      ( xml.data() + xml.length() ),
+            _referrer ( referrer )
+        {
+            //nop
+        }
+
+        /** Parses the document and returns the "Document" node, or NONE */
+        unsigned parse()
+        {
+            // UTF-8 byte order mark
+            if ( _end - _p >= 3 && (unsigned char)_p[0] == 0xEF && (unsigned char)_p[1] == 0xBB && (unsigned char)_p[2] == 0xBF )
+                _p += 3;
+
+            // prolog: skip everything up to the root element.
+            while( true )
+            {
+                while( _p < _end && isSpace(*_p) )
+                    ++_p;
+
+                if ( _p >= _end )
+                {
+                    fail( "No root element" );
+                    return ConfigBuilder::NONE;
+                }
+
+                if ( *_p != '<' )
+                {
+                    while( _p < _end && *_p != '<' )
+                        ++_p;
+                }
+                else if ( startsWith("<?") )
+                {
+                    if ( !skipPast("?>") )
+                    {
+                        fail( "Unterminated declaration" );
+                        return ConfigBuilder::NONE;
+                    }
+                }
+                else if ( startsWith("<!--") )
+                {
+                    if ( !skipPast("-->") )
+                    {
+                        fail( "Unterminated comment" );
+                        return ConfigBuilder::NONE;
+                    }
+                }
+                else if ( startsWith("<!DOCTYPE") )
+                {
+                    if ( !skipDocType() )
+                    {
+                        fail( "Unterminated DOCTYPE" );
+                        return ConfigBuilder::NONE;
+                    }
+                }
+                else if ( startsWith("<!") )
+                {
+                    if ( !skipPast(">") )
+                    {
+                        fail( "Unterminated markup" );
+                        return ConfigBuilder::NONE;
+                    }
+                }
+                else break;
+            }
+
+            unsigned doc = _b.addNode( ConfigBuilder::NONE, _b.intern("Document") );
+
+            if ( !readStartTag(doc) )
+                return ConfigBuilder::NONE;
+
+            while( !_open.empty() )
+            {
+                if ( _p >= _end )
+                {
+                    fail( "Unexpected end of document" );
+                    return ConfigBuilder::NONE;
+                }
+
+                if ( *_p != '<' )
+                {
+                    readText();
+                }
+                else if ( startsWith("</") )
+                {
+                    if ( !readEndTag() )
+                        return ConfigBuilder::NONE;
+                }
+                else if ( startsWith("<!--") )
+                {
+                    if ( !skipPast("-->") )
+                    {
+                        fail( "Unterminated comment" );
+                        return ConfigBuilder::NONE;
+                    }
+                }
+                else if ( startsWith("<![CDATA[") )
+                {
+                    const char* start = _p + 9;
+                    _p = start;
+                    if ( !skipPast("]]>") )
+                    {
+                        fail( "Unterminated CDATA section" );
+                        return ConfigBuilder::NONE;
+                    }
+                    if ( _open.back()._node != ConfigBuilder::NONE )
+                        _b.appendValue( _open.back()._node, start, (unsigned)(_p - 3 - start) );
+                }
+                else if ( startsWith("<?") || startsWith("<!") )
+                {
+                    if ( !skipPast(">") )
+                    {
+                        fail( "Unterminated markup" );
+                        return ConfigBuilder::NONE;
+                    }
+                }
+                else
+                {
+                    if ( !readStartTag(_open.back()._node) )
+                        return ConfigBuilder::NONE;
+                }
+            }
+
+            // anything after the root element is ignored, as before.
+            return doc;
+        }
+
+        const std::string& getError() const { return _error; }
+
+    private:
+        struct Open
+        {
+            unsigned    _node;      // NONE when inside an xi:include
+            unsigned    _parent;
+            const char* _name;
+            unsigned    _nameLength;
+            int         _include;   // index into _includes, or -1
+        };
+
+        struct Attr
+        {
+            unsigned    _name;
+            const char* _rawName;
+            unsigned    _rawNameLength;
+            unsigned    _offset;
+            unsigned    _length;
+            unsigned    _order;
+        };
+
+        struct AttrLess
+        {
+            const ConfigBuilder& _b;
+            AttrLess(const ConfigBuilder& b) : _b(b) { }
+            bool operator()(const Attr& lhs, const Attr& rhs) const
+            {
+                if ( lhs._name == rhs._name )
+                    return lhs._order < rhs._order;
+                return _b.getString(lhs._name) < _b.getString(rhs._name);
+            }
+        };
+
+        ConfigBuilder&            _b;
+        const char*               _begin;
+        const char*               _p;
+        const char*               _end;
+        std::string               _referrer;
+        std::string               _error;
+        std::vector<Open>         _open;
+        std::vector<Attr>         _attrs;
+        std::string               _attrText;
+        std::string               _text;
+        std::string               _lower;
+        std::vector<XmlAttributes> _includes;
+
+        bool fail(const std::string& message)
+        {
+            unsigned row = 1, col = 1;
+            for(const char* c = _begin; c < _p && c < _end; ++c)
+            {
+                if ( *c == '\n' ) { ++row; col = 1; }
+                else ++col;
+            }
+            _error = Stringify() << message << " (row " << row << ", col " << col << ")";
+            return false;
+        }
+
+        bool startsWith(const char* token) const
+        {
+            size_t len = strlen(token);
+            return (size_t)(_end - _p) >= len && strncmp(_p, token, len) == 0;
+        }
+
+        bool skipPast(const char* token)
+        {
+            size_t len = strlen(token);
+            for( ; _p + len <= _end; ++_p )
+            {
+                if ( strncmp(_p, token, len) == 0 )
+                {
+                    _p += len;
+                    return true;
+                }
+            }
+            _p = _end;
+            return false;
+        }
+
+        bool skipDocType()
+        {
+            // DOCTYPE blocks can contain nested markup declarations.
+            int depth = 0;
+            for( ++_p; _p < _end; ++_p )
+            {
+                if ( *_p == '<' )
+                    ++depth;
+                else if ( *_p == '>' && depth-- == 0 )
+                {
+                    ++_p;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Decodes the entity at _p into out.
+        void readEntity(std::string& out)
+        {
+            static const struct { const char* str; unsigned len; char chr; } entities[] = {
+                { "&amp;", 5, '&' }, { "&lt;", 4, '<' }, { "&gt;", 4, '>' },
+                { "&quot;", 6, '\"' }, { "&apos;", 6, '\'' } };
+
+            if ( _p + 2 < _end && _p[1] == '#' )
+            {
+                bool hex = _p[2] == 'x';
+                const char* q = _p + (hex ? 3 : 2);
+                unsigned long ucs = 0;
+                bool valid = q < _end && *q != ';';
+                for( ; q < _end && *q != ';' && valid; ++q )
+                {
+                    char c = *q;
+                    if ( c >= '0' && c <= '9' )
+                        ucs = ucs*(hex ? 16 : 10) + (c - '0');
+                    else if ( hex && c >= 'a' && c <= 'f' )
+                        ucs = ucs*16 + (c - 'a' + 10);
+                    else if ( hex && c >= 'A' && c <= 'F' )
+                        ucs = ucs*16 + (c - 'A' + 10);
+                    else
+                        valid = false;
+                }
+                if ( valid && q < _end )
+                {
+                    appendUTF8( ucs, out );
+                    _p = q + 1;
+                    return;
+                }
+            }
+            else
+            {
+                for(unsigned i = 0; i < 5; ++i)
+                {
+                    if ( (unsigned)(_end - _p) >= entities[i].len && strncmp(_p, entities[i].str, entities[i].len) == 0 )
+                    {
+                        out += entities[i].chr;
+                        _p += entities[i].len;
+                        return;
+                    }
+                }
+            }
+
+            // not an entity; keep the ampersand (TinyXML dropped it).
+            out += '&';
+            ++_p;
+        }
+
+        const char* readName()
+        {
+            const char* start = _p;
+            while( _p < _end && !isSpace(*_p) && *_p != '/' && *_p != '>' && *_p != '=' )
+                ++_p;
+            return start;
+        }
+
+        unsigned internLower(const char* str, unsigned len)
+        {
+            _lower.assign( str, len );
+            for(std::string::iterator i = _lower.begin(); i != _lower.end(); ++i)
+                *i = ::tolower(*i);
+            return _b.intern( _lower );
+        }
+
+        void skipSpace()
+        {
+            while( _p < _end && isSpace(*_p) )
+                ++_p;
+        }
+
+        bool readStartTag(unsigned parent)
+        {
+            ++_p; // '<'
+            const char* name = readName();
+            unsigned nameLength = (unsigned)(_p - name);
+            if ( nameLength == 0 )
+                return fail( "Missing element name" );
+
+            unsigned key = internLower( name, nameLength );
+
+            // attributes
+            _attrs.clear();
+            _attrText.clear();
+            bool empty = false;
+            while( true )
+            {
+                skipSpace();
+                if ( _p >= _end )
+                    return fail( "Unterminated start tag" );
+
+                if ( *_p == '>' )
+                {
+                    ++_p;
+                    break;
+                }
+                if ( *_p == '/' )
+                {
+                    if ( _p + 1 >= _end || _p[1] != '>' )
+                        return fail( "Malformed empty element tag" );
+                    _p += 2;
+                    empty = true;
+                    break;
+                }
+
+                const char* attrName = readName();
+                unsigned attrNameLength = (unsigned)(_p - attrName);
+                skipSpace();
+                if ( attrNameLength == 0 || _p >= _end || *_p != '=' )
+                    return fail( "Malformed attribute" );
+                ++_p;
+                skipSpace();
+                if ( _p >= _end )
+                    return fail( "Malformed attribute" );
+
+                for(std::vector<Attr>::const_iterator a = _attrs.begin(); a != _attrs.end(); ++a)
+                {
+                    if ( a->_rawNameLength == attrNameLength && strncmp(a->_rawName, attrName, attrNameLength) == 0 )
+                        return fail( "Duplicate attribute" );
+                }
+
+                Attr attr;
+                attr._name          = internLower( attrName, attrNameLength );
+                attr._rawName       = attrName;
+                attr._rawNameLength = attrNameLength;
+                attr._offset        = (unsigned)_attrText.length();
+                attr._order         = (unsigned)_attrs.size();
+
+                if ( *_p == '\"' || *_p == '\'' )
+                {
+                    char quote = *_p++;
+                    while( _p < _end && *_p != quote )
+                    {
+                        if ( *_p == '&' )
+                            readEntity( _attrText );
+                        else
+                            _attrText += *_p++;
+                    }
+                    if ( _p >= _end )
+                        return fail( "Unterminated attribute value" );
+                    ++_p;
+                }
+                else
+                {
+                    while( _p < _end && !isSpace(*_p) && *_p != '/' && *_p != '>' )
+                    {
+                        if ( *_p == '&' )
+                            readEntity( _attrText );
+                        else
+                            _attrText += *_p++;
+                    }
+                }
+
+                attr._length = (unsigned)_attrText.length() - attr._offset;
+                _attrs.push_back( attr );
+            }
+
+            // attributes were kept in a map: sorted by lower-case name, last one wins.
+            std::sort( _attrs.begin(), _attrs.end(), AttrLess(_b) );
+            unsigned numAttrs = 0;
+            for(unsigned i = 0; i < _attrs.size(); ++i)
+            {
+                if ( i+1 == _attrs.size() || _attrs[i+1]._name != _attrs[i]._name )
+                    _attrs[numAttrs++] = _attrs[i];
+            }
+            _attrs.resize( numAttrs );
+
+            Open open;
+            open._node       = ConfigBuilder::NONE;
+            open._parent     = parent;
+            open._name       = name;
+            open._nameLength = nameLength;
+            open._include    = -1;
+
+            if ( parent != ConfigBuilder::NONE )
+            {
+                if ( _b.getString(key) == "xi:include" )
+                {
+                    XmlAttributes attrs;
+                    for(std::vector<Attr>::const_iterator a = _attrs.begin(); a != _attrs.end(); ++a)
+                        attrs[_b.getString(a->_name)] = _attrText.substr(a->_offset, a->_length);
+
+                    if ( empty )
+                    {
+                        resolveInclude( parent, attrs );
+                    }
+                    else
+                    {
+                        open._include = (int)_includes.size();
+                        _includes.push_back( attrs );
+                    }
+                }
+                else
+                {
+                    open._node = _b.addNode( parent, key );
+                    for(std::vector<Attr>::const_iterator a = _attrs.begin(); a != _attrs.end(); ++a)
+                    {
+                        unsigned attrNode = _b.addNode( open._node, a->_name );
+                        if ( a->_length > 0 )
+                            _b.setValue( attrNode, &_attrText[a->_offset], a->_length );
+                    }
+                }
+            }
+
+            if ( !empty )
+                _open.push_back( open );
+
+            return true;
+        }
+
+        bool readEndTag()
+        {
+            _p += 2; // "</"
+            const char* name = readName();
+            unsigned nameLength = (unsigned)(_p - name);
+            skipSpace();
+            if ( _p >= _end || *_p != '>' )
+                return fail( "Malformed end tag" );
+            ++_p;
+
+            const Open& open = _open.back();
+            if ( nameLength != open._nameLength || strncmp(name, open._name, nameLength) != 0 )
+                return fail( "Mismatched end tag" );
+
+            if ( open._include >= 0 )
+            {
+                resolveInclude( open._parent, _includes[open._include] );
+            }
+            else if ( open._node != ConfigBuilder::NONE )
+            {
+                _b.trimValue( open._node );
+            }
+
+            _open.pop_back();
+            return true;
+        }
+
+        void readText()
+        {
+            // white space runs condense to a single space, and leading
+            // and trailing white space is dropped.
+            _text.clear();
+            bool space = false;
+            while( _p < _end && isSpace(*_p) )
+                ++_p;
+            while( _p < _end && *_p != '<' )
+            {
+                if ( isSpace(*_p) )
+                {
+                    space = true;
+                    ++_p;
+                }
+                else
+                {
+                    if ( space )
+                    {
+                        _text += ' ';
+                        space = false;
+                    }
+                    if ( *_p == '&' )
+                        readEntity( _text );
+                    else
+                        _text += *_p++;
+                }
+            }
+
+            // a run that is only white space, even by way of entities, is dropped.
+            bool blank = true;
+            for(std::string::const_iterator c = _text.begin(); c != _text.end() && blank; ++c)
+                blank = isSpace(*c);
+
+            unsigned node = _open.back()._node;
+            if ( node != ConfigBuilder::NONE && !blank )
+                _b.appendValue( node, _text.data(), (unsigned)_text.length() );
+        }
+
+        void resolveInclude(unsigned parent, const XmlAttributes& attrs)
+        {
+            XmlElement include( "xi:include", attrs );
+            _b.addConfig( parent, include.getConfig(_referrer) );
+        }
+    };
+}
+
+//........................................................................
+
+namespace
+{
+    /**
+     * JSON reader that emits the same tree as parsing with the bundled
+     * jsoncpp and converting the Json::Value: object members are visited
+     * in name order with the last duplicate winning, and scalars are
+     * converted to strings the way Json::Value::asString does.
+     */
+    class JsonReader
+    {
+    public:
+        JsonReader(ConfigBuilder& builder, const std::string& json) :
+            _b     ( builder ),
+            _begin ( json.data() ),
+            _p     ( json.data() ),
+            _end   ( json.data() + json.length() )
+        {
+            _arrayKey = _b.intern("__array__");
+            _setKey   = _b.intern("_$set");
+            _keyKey   = _b.intern("$key");
+            _valueKey = _b.intern("$value");
+        }
+
+        /** Parses the document; returns false on a syntax error */
+        bool parse()
+        {
+            _root = readValue();
+            return _root != ConfigBuilder::NONE;
+        }
+
+        /** Converts the parsed document into a builder node */
+        void build(unsigned conf)
+        {
+            toConfig( _root, conf, 0 );
+        }
+
+        const std::string& getError() const { return _error; }
+
+    private:
+        enum Type { TYPE_NULL, TYPE_SCALAR, TYPE_ARRAY, TYPE_OBJECT };
+
+        struct Value
+        {
+            Type     _type;
+            unsigned _key;          // member name, for object members
+            unsigned _offset;       // scalar text in _text
+            unsigned _length;
+            unsigned _firstChild;
+            unsigned _nextSibling;
+            unsigned _numChildren;
+        };
+
+        struct MemberLess
+        {
+            const ConfigBuilder&      _b;
+            const std::vector<Value>& _values;
+            MemberLess(const ConfigBuilder& b, const std::vector<Value>& values) : _b(b), _values(values) { }
+            bool operator()(unsigned lhs, unsigned rhs) const
+            {
+                // jsoncpp orders members with strcmp.
+                return strcmp(
+                    _b.getString(_values[lhs]._key).c_str(),
+                    _b.getString(_values[rhs]._key).c_str()) < 0;
+            }
+        };
+
+        ConfigBuilder&     _b;
+        const char*        _begin;
+        const char*        _p;
+        const char*        _end;
+        std::string        _error;
+        std::vector<Value> _values;
+        std::string        _text;
+        std::string        _scratch;
+        unsigned           _root;
+        unsigned           _arrayKey, _setKey, _keyKey, _valueKey;
+
+        unsigned error(const std::string& message)
+        {
+            if ( _error.empty() )
+            {
+                unsigned line = 1, column = 1;
+                for(const char* c = _begin; c < _p && c < _end; ++c)
+                {
+                    if ( *c == '\n' ) { ++line; column = 1; }
+                    else ++column;
+                }
+                _error = Stringify() << message << " (line " << line << ", column " << column << ")";
+            }
+            return ConfigBuilder::NONE;
+        }
+
+        unsigned newValue(Type type)
+        {
+            Value v;
+            v._type        = type;
+            v._key         = 0;
+            v._offset      = 0;
+            v._length      = 0;
+            v._firstChild  = ConfigBuilder::NONE;
+            v._nextSibling = ConfigBuilder::NONE;
+            v._numChildren = 0;
+            _values.push_back( v );
+            return (unsigned)_values.size() - 1;
+        }
+
+        unsigned newScalar(const char* data, unsigned len)
+        {
+            unsigned index = newValue( TYPE_SCALAR );
+            _values[index]._offset = (unsigned)_text.length();
+            _values[index]._length = len;
+            _text.append( data, len );
+            return index;
+        }
+
+        // Skips white space and comments.
+        bool skipSpace()
+        {
+            while( _p < _end )
+            {
+                char c = *_p;
+                if ( c == ' ' || c == '\t' || c == '\r' || c == '\n' )
+                {
+                    ++_p;
+                }
+                else if ( c == '/' && _p + 1 < _end && _p[1] == '/' )
+                {
+                    while( _p < _end && *_p != '\r' && *_p != '\n' )
+                        ++_p;
+                }
+                else if ( c == '/' && _p + 1 < _end && _p[1] == '*' )
+                {
+                    _p += 2;
+                    while( _p + 1 < _end && !(_p[0] == '*' && _p[1] == '/') )
+                        ++_p;
+                    if ( _p + 1 >= _end )
+                    {
+                        error( "Unterminated comment" );
+                        return false;
+                    }
+                    _p += 2;
+                }
+                else break;
+            }
+            return true;
+        }
+
+        bool match(const char* literal)
+        {
+            size_t len = strlen(literal);
+            if ( (size_t)(_end - _p) < len || strncmp(_p, literal, len) != 0 )
+                return false;
+            _p += len;
+            return true;
+        }
+
+        unsigned readValue()
+        {
+            if ( !skipSpace() )
+                return ConfigBuilder::NONE;
+            if ( _p >= _end )
+                return error( "Syntax error: value, object or array expected." );
+
+            char c = *_p;
+            if ( c == '{' )
+                return readObject();
+            if ( c == '[' )
+                return readArray();
+            if ( c == '\"' )
+            {
+                _scratch.clear();
+                if ( !readString(_scratch) )
+                    return ConfigBuilder::NONE;
+                return newScalar( _scratch.data(), (unsigned)_scratch.length() );
+            }
+            if ( c == '-' || (c >= '0' && c <= '9') )
+                return readNumber();
+            if ( match("true") )
+                return newScalar( "true", 4 );
+            if ( match("false") )
+                return newScalar( "false", 5 );
+            if ( match("null") )
+                return newValue( TYPE_NULL );
+
+            return error( "Syntax error: value, object or array expected." );
+        }
+
+        unsigned readObject()
+        {
+            ++_p; // '{'
+            std::vector<unsigned> members;
+
+            if ( !skipSpace() )
+                return ConfigBuilder::NONE;
+            if ( _p < _end && *_p == '}' )
+            {
+                ++_p;
+            }
+            else while( true )
+            {
+                if ( !skipSpace() )
+                    return ConfigBuilder::NONE;
+                if ( _p >= _end || *_p != '\"' )
+                    return error( "Missing '}' or object member name" );
+
+                _scratch.clear();
+                if ( !readString(_scratch) )
+                    return ConfigBuilder::NONE;
+                unsigned key = _b.intern( _scratch );
+
+                if ( !skipSpace() )
+                    return ConfigBuilder::NONE;
+                if ( _p >= _end || *_p != ':' )
+                    return error( "Missing ':' after object member name" );
+                ++_p;
+
+                unsigned member = readValue();
+                if ( member == ConfigBuilder::NONE )
+                    return ConfigBuilder::NONE;
+                _values[member]._key = key;
+                members.push_back( member );
+
+                if ( !skipSpace() )
+                    return ConfigBuilder::NONE;
+                if ( _p < _end && *_p == ',' )
+                {
+                    ++_p;
+                }
+                else if ( _p < _end && *_p == '}' )
+                {
+                    ++_p;
+                    break;
+                }
+                else
+                {
+                    return error( "Missing ',' or '}' in object declaration" );
+                }
+            }
+
+            // name order; of duplicate names the last one wins.
+            MemberLess less( _b, _values );
+            std::stable_sort( members.begin(), members.end(), less );
+
+            unsigned object = newValue( TYPE_OBJECT );
+            unsigned last = ConfigBuilder::NONE;
+            for(unsigned i = 0; i < members.size(); ++i)
+            {
+                if ( i+1 < members.size() && !less(members[i], members[i+1]) )
+                    continue;
+
+                if ( last == ConfigBuilder::NONE )
+                    _values[object]._firstChild = members[i];
+                else
+                    _values[last]._nextSibling = members[i];
+                last = members[i];
+                _values[object]._numChildren++;
+            }
+            return object;
+        }
+
+        unsigned readArray()
+        {
+            ++_p; // '['
+            std::vector<unsigned> elements;
+
+            if ( !skipSpace() )
+                return ConfigBuilder::NONE;
+            if ( _p < _end && *_p == ']' )
+            {
+                ++_p;
+            }
+            else while( true )
+            {
+                unsigned element = readValue();
+                if ( element == ConfigBuilder::NONE )
+                    return ConfigBuilder::NONE;
+                elements.push_back( element );
+
+                if ( !skipSpace() )
+                    return ConfigBuilder::NONE;
+                if ( _p < _end && *_p == ',' )
+                {
+                    ++_p;
+                }
+                else if ( _p < _end && *_p == ']' )
+                {
+                    ++_p;
+                    break;
+                }
+                else
+                {
+                    return error( "Missing ',' or ']' in array declaration" );
+                }
+            }
+
+            unsigned array = newValue( TYPE_ARRAY );
+            for(unsigned i = 0; i < elements.size(); ++i)
+            {
+                if ( i == 0 )
+                    _values[array]._firstChild = elements[i];
+                else
+                    _values[elements[i-1]]._nextSibling = elements[i];
+            }
+            _values[array]._numChildren = (unsigned)elements.size();
+            return array;
+        }
+
+        bool readString(std::string& out)
+        {
+            ++_p; // '"'
+            while( _p < _end && *_p != '\"' )
+            {
+                char c = *_p++;
+                if ( c != '\\' )
+                {
+                    out += c;
+                    continue;
+                }
+
+                if ( _p >= _end )
+                {
+                    error( "Empty escape sequence in string" );
+                    return false;
+                }
+
+                char escape = *_p++;
+                switch( escape )
+                {
+                case '\"': out += '\"'; break;
+                case '/':  out += '/';  break;
+                case '\\': out += '\\'; break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u':
+                    {
+                        unsigned long unicode;
+                        if ( !readUnicode(unicode) )
+                            return false;
+
+                        // combine a surrogate pair
+                        if ( unicode >= 0xD800 && unicode <= 0xDBFF && _end - _p >= 6 && _p[0] == '\\' && _p[1] == 'u' )
+                        {
+                            const char* save = _p;
+                            _p += 2;
+                            unsigned long low;
+                            if ( readUnicode(low) && low >= 0xDC00 && low <= 0xDFFF )
+                                unicode = 0x10000 + ((unicode - 0xD800) << 10) + (low - 0xDC00);
+                            else
+                                _p = save;
+                        }
+                        appendUTF8( unicode, out );
+                    }
+                    break;
+                default:
+                    error( "Bad escape sequence in string" );
+                    return false;
+                }
+            }
+
+            if ( _p >= _end )
+            {
+                error( "Unterminated string" );
+                return false;
+            }
+
+            ++_p; // '"'
+            return true;
+        }
+
+        bool readUnicode(unsigned long& unicode)
+        {
+            if ( _end - _p < 4 )
+            {
+                error( "Bad unicode escape sequence in string: four digits expected." );
+                return false;
+            }
+
+            unicode = 0;
+            for(int i = 0; i < 4; ++i)
+            {
+                char c = *_p++;
+                unicode *= 16;
+                if ( c >= '0' && c <= '9' )
+                    unicode += c - '0';
+                else if ( c >= 'a' && c <= 'f' )
+                    unicode += c - 'a' + 10;
+                else if ( c >= 'A' && c <= 'F' )
+                    unicode += c - 'A' + 10;
+                else
+                {
+                    error( "Bad unicode escape sequence in string: hexadecimal digit expected." );
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        unsigned readNumber()
+        {
+            const char* start = _p;
+            while( _p < _end && ((*_p >= '0' && *_p <= '9') || *_p == '.' || *_p == 'e' || *_p == 'E' || *_p == '+' || *_p == '-') )
+                ++_p;
+
+            bool isDouble = false;
+            for(const char* c = start; c != _p; ++c)
+                isDouble = isDouble || *c == '.' || *c == 'e' || *c == 'E' || *c == '+' || (*c == '-' && c != start);
+
+            if ( !isDouble )
+            {
+                // integers; fall back on double if one overflows.
+                const char* c = start;
+                bool isNegative = *c == '-';
+                if ( isNegative )
+                    ++c;
+                unsigned threshold = (isNegative ? 2147483648u : 4294967295u) / 10u;
+                unsigned value = 0;
+                for( ; c < _p; ++c )
+                {
+                    if ( *c < '0' || *c > '9' )
+                        return error( "'" + std::string(start, _p) + "' is not a number." );
+                    if ( value >= threshold )
+                    {
+                        isDouble = true;
+                        break;
+                    }
+                    value = value*10u + (unsigned)(*c - '0');
+                }
+
+                if ( !isDouble )
+                {
+                    std::string str = isNegative ?
+                        (std::string)(Stringify() << -(int)value) :
+                        (std::string)(Stringify() << value);
+                    return newScalar( str.data(), (unsigned)str.length() );
+                }
+            }
+
+            std::string buffer( start, _p );
+            double value = 0.0;
+            if ( sscanf(buffer.c_str(), "%lf", &value) != 1 )
+                return error( "'" + buffer + "' is not a number." );
+
+            std::string str = Stringify() << value;
+            return newScalar( str.data(), (unsigned)str.length() );
+        }
+
+        bool endsWith(unsigned key, unsigned suffix, unsigned& prefix)
+        {
+            const std::string& s = _b.getString(key);
+            const std::string& x = _b.getString(suffix);
+            if ( s.length() < x.length() || s.compare(s.length()-x.length(), x.length(), x) != 0 )
+                return false;
+            prefix = _b.intern( s.data(), (unsigned)(s.length()-x.length()) );
+            return true;
+        }
+
+        void setValue(unsigned conf, const Value& v)
+        {
+            if ( v._type == TYPE_SCALAR && v._length > 0 )
+                _b.setValue( conf, &_text[v._offset], v._length );
+            else
+                _b.setValue( conf, 0L, 0 );
+        }
+
+        // Same conversion as json2conf in Config.cpp did.
+        void toConfig(unsigned index, unsigned conf, int depth)
+        {
+            const Value& json = _values[index];
+
+            if ( json._type == TYPE_OBJECT )
+            {
+                for(unsigned m = json._firstChild; m != ConfigBuilder::NONE; m = _values[m]._nextSibling)
+                {
+                    const Value& value = _values[m];
+                    unsigned key = value._key;
+
+                    // Json::Value::isObject() is also true for null.
+                    if ( value._type == TYPE_OBJECT || value._type == TYPE_NULL )
+                    {
+                        if ( depth == 0 && json._numChildren == 1 )
+                        {
+                            _b.setKey( conf, key );
+                            toConfig( m, conf, depth+1 );
+                        }
+                        else
+                        {
+                            toConfig( m, _b.addNode(conf, key), depth+1 );
+                        }
+                    }
+                    else if ( value._type == TYPE_ARRAY )
+                    {
+                        unsigned prefix;
+                        if ( endsWith(key, _arrayKey, prefix) || endsWith(key, _setKey, prefix) )
+                        {
+                            for(unsigned e = value._firstChild; e != ConfigBuilder::NONE; e = _values[e]._nextSibling)
+                            {
+                                unsigned child = _b.addNode( conf, 0 );
+                                toConfig( e, child, depth+1 );
+                                _b.setKey( child, prefix );
+                            }
+                        }
+                        else
+                        {
+                            toConfig( m, _b.addNode(conf, key), depth+1 );
+                        }
+                    }
+                    else if ( key == _keyKey )
+                    {
+                        _b.setKey( conf, value._type == TYPE_SCALAR ? _b.intern(&_text[value._offset], value._length) : 0 );
+                    }
+                    else if ( key == _valueKey )
+                    {
+                        setValue( conf, value );
+                    }
+                    else
+                    {
+                        setValue( _b.addNode(conf, key), value );
+                    }
+                }
+            }
+            else if ( json._type == TYPE_ARRAY )
+            {
+                for(unsigned e = json._firstChild; e != ConfigBuilder::NONE; e = _values[e]._nextSibling)
+                {
+                    unsigned child = _b.addNode( conf, 0 );
+                    toConfig( e, child, depth+1 );
+                    if ( _b.isEmpty(child) )
+                        _b.removeLastChild( conf );
+                }
+            }
+            else if ( json._type != TYPE_NULL )
+            {
+                setValue( conf, json );
+            }
+        }
+    };
+}
+
+//........................................................................
+
+bool
+ConfigReader::readXML(std::istream& in, Config& out, const URIContext& context)
+{
+    std::string xml(
+        (std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>() );
+
+    return readXML( xml, out, context );
+}
+
+bool
+ConfigReader::readXML(const std::string& xml, Config& out, const URIContext& context)
+{
+    std::string referrer = URI("", context).full();
+
+    ConfigBuilder builder;
+    XmlReader reader( builder, xml, referrer );
+    unsigned doc = reader.parse();
+    if ( doc == ConfigBuilder::NONE )
+    {
+        OE_WARN << "Error in XML document: " << reader.getError() << std::endl;
+        if ( !context.referrer().empty() )
+            OE_WARN << context.referrer() << std::endl;
+        return false;
+    }
+
+    out = Config();
+    out.setReferrer( referrer );
+    builder.build( doc, out );
+    return true;
+}
+
+bool
+ConfigReader::readJSON(const std::string& json, Config& out)
+{
+    ConfigBuilder builder;
+    JsonReader reader( builder, json );
+    if ( !reader.parse() )
+    {
+        OE_WARN << "JSON decoding error: " << reader.getError() << std::endl;
+        return false;
+    }
+
+    // start from the output's key and value, which the document may replace.
+    unsigned root = builder.addNode( ConfigBuilder::NONE, builder.intern(out.key()) );
+    builder.setValue( root, out.value().data(), (unsigned)out.value().length() );
+    reader.build( root );
+    builder.build( root, out );
+    return true;
+}
@@ -24,6 +24,37 @@ using namespace osgEarth;
 
 #define LC "[ECEF] "
 
+namespace
+{
+    // Transforms all the points to ECEF in one bulk call (which takes the
+    // direct geodetic path when it can) and appends the localized results.
+    void transformAndLocalizeArrays(const std::vector<osg::Vec3d>& input,
+                                    const SpatialReference*        inputSRS,
+                                    osg::Vec3Array*                output,
+                                    const SpatialReference*        outputSRS,
+                                    const osg::Matrixd&            world2local)
+    {
+        unsigned count = input.size();
+        if ( count == 0 )
+            return;
+
+        std::vector<double> x(count), y(count), z(count);
+        for( unsigned i=0; i<count; ++i )
+        {
+            x[i] = input[i].x();
+            y[i] = input[i].y();
+            z[i] = input[i].z();
+        }
+
+        inputSRS->transform( &x[0], &y[0], &z[0], count, outputSRS->getECEF() );
+
+        for( unsigned i=0; i<count; ++i )
+        {
+            output->push_back( osg::Vec3d(x[i], y[i], z[i]) * world2local );
+        }
+    }
+}
+
 // --------------------------------------------------------------------------
 
 osg::Matrixd
@@ -87,16 +118,8 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
                            const SpatialReference*        outputSRS,
                            const osg::Matrixd&            world2local )
 {
-    const SpatialReference* ecefSRS = outputSRS->getECEF();
     output->reserve( output->size() + input.size() );
-
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
-    {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        //inputSRS->transformToECEF( *i, ecef );
-        output->push_back( ecef * world2local );
-    }
+    transformAndLocalizeArrays( input, inputSRS, output, outputSRS, world2local );
 }
 
 
@@ -108,15 +131,8 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
                            const SpatialReference*        outputSRS,
                            const osg::Matrixd&            world2local )
 {
-    const SpatialReference* ecefSRS = outputSRS->getECEF();
     out_verts->reserve( out_verts->size() + input.size() );
-    
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
-    {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        out_verts->push_back( ecef * world2local );
-    }
+    transformAndLocalizeArrays( input, inputSRS, out_verts, outputSRS, world2local );
 
     if ( out_normals )
     {
@@ -178,3 +194,70 @@ ECEF::transformAndGetRotationMatrix(const osg::Vec3d&       input,
     // then convert that to ECEF.
     geoSRS->transform(geoPoint, ecefSRS, out_point);
 }
+
+void
+ECEF::geodeticToECEF(double*                    x,
+                     double*                    y,
+                     double*                    z,
+                     unsigned                   count,
+                     const osg::EllipsoidModel* em)
+{
+    const double a  = em->getRadiusEquator();
+    const double b  = em->getRadiusPolar();
+    const double e2 = 1.0 - (b*b)/(a*a);
+    const double d2r = osg::PI / 180.0;
+
+    // Straight-line loop over independent arrays, so the compiler is free to
+    // vectorize it (given a vector math library for sin/cos).
+    for( unsigned i=0; i<count; ++i )
+    {
+        double lon = x[i] * d2r;
+        double lat = y[i] * d2r;
+        double h   = z[i];
+
+        double sinLat = sin(lat), cosLat = cos(lat);
+        double N = a / sqrt(1.0 - e2*sinLat*sinLat);
+
+        x[i] = (N + h) * cosLat * cos(lon);
+        y[i] = (N + h) * cosLat * sin(lon);
+        z[i] = (N*(1.0 - e2) + h) * sinLat;
+    }
+}
+
+void
+ECEF::ECEFToGeodetic(double*                    x,
+                     double*                    y,
+                     double*                    z,
+                     unsigned                   count,
+                     const osg::EllipsoidModel* em)
+{
+    const double a  = em->getRadiusEquator();
+    const double b  = em->getRadiusPolar();
+    const double e2 = 1.0 - (b*b)/(a*a);
+    const double ep2b = ((a*a - b*b)/(b*b)) * b;
+    const double e2a  = e2 * a;
+    const double r2d  = 180.0 / osg::PI;
+
+    for( unsigned i=0; i<count; ++i )
+    {
+        double X = x[i], Y = y[i], Z = z[i];
+        double p = sqrt(X*X + Y*Y);
+
+        // Bowring's approximation, as in osg::EllipsoidModel. The sines and
+        // cosines of the auxiliary and geodetic latitudes come from their
+        // tangents instead of from the angles.
+        double za = Z*a, pb = p*b;
+        double r  = sqrt(za*za + pb*pb);
+        double sinTheta = r > 0.0 ? za/r : 1.0;
+        double cosTheta = r > 0.0 ? pb/r : 0.0;
+
+        double num = Z + ep2b*sinTheta*sinTheta*sinTheta;
+        double den = p - e2a*cosTheta*cosTheta*cosTheta;
+        double q   = sqrt(num*num + den*den);
+        double sinLat = num/q, cosLat = den/q;
+
+        x[i] = atan2(Y, X) * r2d;
+        y[i] = atan2(num, den) * r2d;
+        z[i] = p*cosLat + Z*sinLat - a*sqrt(1.0 - e2*sinLat*sinLat);
+    }
+}
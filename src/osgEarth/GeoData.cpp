@@ -25,6 +25,7 @@
 #include <osgEarth/Cube>
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Terrain>
+#include <osgEarth/Metrics>
 
 #include <osg/Notify>
 #include <osg/Timer>
@@ -1902,6 +1903,8 @@ namespace
 GeoImage
 GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent, unsigned int width, unsigned int height, bool useBilinearInterpolation) const
 {  
+    ScopedMetric metric( Metrics::TIMER_REPROJECT );
+
     GeoExtent destExtent;
     if (to_extent)
     {
@@ -26,8 +26,13 @@ using namespace osgEarth;
 
 
 Geoid::Geoid() :
-_units( Units::METERS ),
-_valid( false )
+_units     ( Units::METERS ),
+_valid     ( false ),
+_data      ( 0L ),
+_cols      ( 0 ),
+_rows      ( 0 ),
+_colsPerDeg( 0.0 ),
+_rowsPerDeg( 0.0 )
 {
     //nop
 }
@@ -48,6 +53,13 @@ Geoid::setHeightField( osg::HeightField* hf )
         _hf->getOrigin().y(),
         _hf->getOrigin().x() + _hf->getXInterval() * double(_hf->getNumColumns()-1),
         _hf->getOrigin().y() + _hf->getYInterval() * double(_hf->getNumRows()-1) );
+
+    _data = &_hf->getFloatArray()->front();
+    _cols = _hf->getNumColumns();
+    _rows = _hf->getNumRows();
+    _colsPerDeg = double(_cols-1) / _bounds.width();
+    _rowsPerDeg = double(_rows-1) / _bounds.height();
+
     validate();
 }
 
@@ -76,6 +88,18 @@ Geoid::validate()
     }
 }
 
+namespace
+{
+    // Grid index and weight of a coordinate along one axis.
+    inline void getCell(double v, double cellsPerDeg, double origin, unsigned size, unsigned& i, float& t)
+    {
+        double f = (v - origin) * cellsPerDeg;
+        f = osg::clampBetween( f, 0.0, double(size-1) );
+        i = osg::minimum( unsigned(f), size-2 );
+        t = float(f - double(i));
+    }
+}
+
 float 
 Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& interp ) const
 {
@@ -83,14 +107,82 @@ Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& i
 
     if ( _valid && _bounds.contains(lon_deg, lat_deg) )
     {
-        double nlon = (lon_deg-_bounds.xMin())/_bounds.width();
-        double nlat = (lat_deg-_bounds.yMin())/_bounds.height();
-        result = HeightFieldUtils::getHeightAtNormalizedLocation( _hf.get(), nlon, nlat, interp );
+        if ( interp == INTERP_BILINEAR && _cols > 1 && _rows > 1 )
+        {
+            // geoid grids have no NO_DATA cells, so skip the general interpolator.
+            unsigned c, r;
+            float tx, ty;
+            getCell( lon_deg, _colsPerDeg, _bounds.xMin(), _cols, c, tx );
+            getCell( lat_deg, _rowsPerDeg, _bounds.yMin(), _rows, r, ty );
+            const float* p = _data + r*_cols + c;
+            float bottom = p[0] + (p[1] - p[0]) * tx;
+            float top    = p[_cols] + (p[_cols+1] - p[_cols]) * tx;
+            result = bottom + (top - bottom) * ty;
+        }
+        else
+        {
+            double nlon = (lon_deg-_bounds.xMin())/_bounds.width();
+            double nlat = (lat_deg-_bounds.yMin())/_bounds.height();
+            result = HeightFieldUtils::getHeightAtNormalizedLocation( _hf.get(), nlon, nlat, interp );
+        }
     }
 
     return result;
 }
 
+void
+Geoid::getHeights(double              lat0_deg,
+                  double              lon0_deg,
+                  double              latStep_deg,
+                  double              lonStep_deg,
+                  unsigned            cols,
+                  unsigned            rows,
+                  std::vector<float>& out_heights) const
+{
+    out_heights.assign( cols*rows, 0.0f );
+
+    if ( !_valid || _cols < 2 || _rows < 2 )
+        return;
+
+    // Per-column lookups, shared by all the rows. Points off the geoid get 0,
+    // as in getHeight.
+    std::vector<unsigned> colIndex( cols );
+    std::vector<float>    colWeight( cols );
+    std::vector<bool>     colValid( cols );
+    for( unsigned c=0; c<cols; ++c )
+    {
+        double lon = lon0_deg + lonStep_deg*double(c);
+        colValid[c] = lon >= _bounds.xMin() && lon <= _bounds.xMax();
+        getCell( lon, _colsPerDeg, _bounds.xMin(), _cols, colIndex[c], colWeight[c] );
+    }
+
+    for( unsigned r=0; r<rows; ++r )
+    {
+        double lat = lat0_deg + latStep_deg*double(r);
+        if ( lat < _bounds.yMin() || lat > _bounds.yMax() )
+            continue;
+
+        unsigned gr;
+        float ty;
+        getCell( lat, _rowsPerDeg, _bounds.yMin(), _rows, gr, ty );
+        const float* bottom = _data + gr*_cols;
+        const float* top    = bottom + _cols;
+        float* out = &out_heights[r*cols];
+
+        for( unsigned c=0; c<cols; ++c )
+        {
+            if ( colValid[c] )
+            {
+                unsigned gc = colIndex[c];
+                float tx = colWeight[c];
+                float b = bottom[gc] + (bottom[gc+1] - bottom[gc]) * tx;
+                float t = top[gc]    + (top[gc+1]    - top[gc])    * tx;
+                out[c] = b + (t - b) * ty;
+            }
+        }
+    }
+}
+
 bool
 Geoid::isEquivalentTo( const Geoid& rhs ) const
 {
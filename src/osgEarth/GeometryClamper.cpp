@@ -17,12 +17,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/GeometryClamper>
+#include <osgEarth/HeightFieldUtils>
 
 #include <osgUtil/IntersectionVisitor>
 
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/UserDataContainer>
+#include <osg/Timer>
 
 #define LC "[GeometryClamper] "
 
@@ -36,7 +38,9 @@ GeometryClamper::GeometryClamper() :
 osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ),
 _preserveZ      ( false ),
 _scale          ( 1.0f ),
-_offset         ( 0.0f )
+_offset         ( 0.0f ),
+_numClamped     ( 0 ),
+_clampTime      ( 0.0 )
 {
     this->setNodeMaskOverride( ~0 );
     _lsi = new osgEarth::DPLineSegmentIntersector(osg::Vec3d(0,0,0), osg::Vec3d(0,0,0));
@@ -63,6 +67,8 @@ GeometryClamper::apply(osg::Geode& geode)
     osg::Matrix world2local;
     world2local.invert( local2world );
 
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
     const osg::EllipsoidModel* em = _terrainSRS->getEllipsoid();
     osg::Vec3d n_vector(0,0,1), start, end, msl;
 
@@ -105,7 +111,14 @@ GeometryClamper::apply(osg::Geode& geode)
                 }
             }
 
-            for( unsigned k=0; k<verts->size(); ++k )
+            if ( _terrainHF.valid() )
+            {
+                unsigned clamped = clampToHeightField( verts, zOffsets, buildZOffsets, local2world, world2local );
+                geomDirty = clamped > 0;
+                count += clamped;
+            }
+
+            else for( unsigned k=0; k<verts->size(); ++k )
             {
                 osg::Vec3d vw = (*verts)[k];
                 vw = vw * local2world;
@@ -183,16 +196,162 @@ GeometryClamper::apply(osg::Geode& geode)
             }
         }
 
-        OE_DEBUG << LC << "clamped " << count << " verts." << std::endl;
     }
+
+    double seconds = osg::Timer::instance()->delta_s( startTime, osg::Timer::instance()->tick() );
+    _numClamped += count;
+    _clampTime  += seconds;
+
+    OE_DEBUG << LC << "clamped " << count << " verts in " << seconds*1000.0 << " ms ("
+        << (seconds > 0.0 ? (double)count/seconds : 0.0) << " verts/s)" << std::endl;
+}
+
+unsigned
+GeometryClamper::clampToHeightField(osg::Vec3Array*     verts,
+                                    osg::FloatArray*    zOffsets,
+                                    bool                buildZOffsets,
+                                    const osg::Matrixd& local2world,
+                                    const osg::Matrixd& world2local)
+{
+    const osg::EllipsoidModel* em = _terrainSRS->getEllipsoid();
+    const GeoExtent&           extent = _terrainHF.getExtent();
+    const osg::HeightField*    hf = _terrainHF.getHeightField();
+    bool                       isGeocentric = _terrainSRS->isGeographic();
+
+    unsigned size = verts->size();
+    _world.resize( size );
+    _coords.resize( size );
+
+    // Pass 1: local to world, and world to the terrain SRS.
+    for( unsigned k=0; k<size; ++k )
+    {
+        _world[k] = osg::Vec3d((*verts)[k]) * local2world;
+
+        if ( isGeocentric )
+        {
+            double lat, lon, hae;
+            em->convertXYZToLatLongHeight( _world[k].x(), _world[k].y(), _world[k].z(), lat, lon, hae );
+            _coords[k].set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), 0.0 );
+
+            if ( buildZOffsets )
+                zOffsets->push_back( (*verts)[k].z() );
+        }
+        else
+        {
+            _coords[k].set( _world[k].x(), _world[k].y(), 0.0 );
+
+            if ( buildZOffsets )
+                zOffsets->push_back( float(_world[k].z()) );
+        }
+    }
+
+    // Pass 2: into the heightfield's SRS, all at once.
+    const SpatialReference* coordSRS = isGeocentric ? _terrainSRS->getGeographicSRS() : _terrainSRS.get();
+    std::vector<osg::Vec3d> hfCoords;
+    const std::vector<osg::Vec3d>* sampleCoords = &_coords;
+    if ( !coordSRS->isHorizEquivalentTo(extent.getSRS()) )
+    {
+        hfCoords = _coords;
+        if ( !coordSRS->transform(hfCoords, extent.getSRS()) )
+            return 0u;
+        sampleCoords = &hfCoords;
+    }
+
+    // Pass 3: sample the grid and move each vertex onto the surface.
+    double xmin = extent.xMin(), ymin = extent.yMin();
+    double width = extent.width(), height = extent.height();
+    unsigned count = 0;
+
+    for( unsigned k=0; k<size; ++k )
+    {
+        double nx = ((*sampleCoords)[k].x() - xmin) / width;
+        double ny = ((*sampleCoords)[k].y() - ymin) / height;
+        if ( nx < 0.0 || nx > 1.0 || ny < 0.0 || ny > 1.0 )
+            continue;
+
+        float h = HeightFieldUtils::getHeightAtNormalizedLocation( hf, nx, ny, INTERP_TRIANGULATE );
+        if ( h == NO_DATA_VALUE )
+            continue;
+
+        double z = h;
+        if ( _scale != 1.0 )
+            z += h*_scale;
+        z += _offset;
+        if ( _preserveZ && (zOffsets != 0L) )
+            z += (*zOffsets)[k];
+
+        osg::Vec3d fw;
+        if ( isGeocentric )
+        {
+            em->convertLatLongHeightToXYZ(
+                osg::DegreesToRadians(_coords[k].y()), osg::DegreesToRadians(_coords[k].x()), z,
+                fw.x(), fw.y(), fw.z() );
+        }
+        else
+        {
+            fw.set( _coords[k].x(), _coords[k].y(), z );
+        }
+
+        (*verts)[k] = (fw * world2local);
+        ++count;
+    }
+
+    return count;
 }
 
 
 
+GeometryClamperCallback::~GeometryClamperCallback()
+{
+    setTerrainEngine( 0L );
+}
+
+void
+GeometryClamperCallback::setTerrainEngine(TerrainEngineNode* engine)
+{
+    osg::ref_ptr<TerrainEngineNode> oldEngine;
+    if ( _engine.lock(oldEngine) && _collector.valid() )
+    {
+        oldEngine->removeCreateTileModelCallback( _collector.get() );
+    }
+    _collector = 0L;
+    _engine = engine;
+
+    if ( engine )
+    {
+        _collector = new CollectHeightFields();
+        engine->addCreateTileModelCallback( _collector.get() );
+    }
+}
+
 void
 GeometryClamperCallback::onTileAdded(const TileKey&          key, 
                                      osg::Node*              tile, 
                                      TerrainCallbackContext& context)
 {
+    CollectHeightFields::HeightFieldCache::Record record;
+    if ( _collector.valid() && _collector->_heightFields.get(key, record) )
+    {
+        _clamper.setTerrainHeightField( GeoHeightField(
+            const_cast<osg::HeightField*>(record.value().get()),
+            key.getExtent()) );
+    }
+    else
+    {
+        _clamper.setTerrainHeightField( GeoHeightField::INVALID );
+    }
+
     tile->accept( _clamper );
 }
+
+void
+GeometryClamperCallback::CollectHeightFields::onCreateTileModel(TerrainEngineNode* engine,
+                                                                TerrainTileModel*  model)
+{
+    if ( model && model->elevationModel().valid() && model->elevationModel()->getHeightField() )
+    {
+        _heightFields.insert(
+            model->getKey(),
+            model->elevationModel()->getHeightField() );
+    }
+}
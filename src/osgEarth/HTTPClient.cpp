@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Version>
 #include <osgEarth/Progress>
+#include <osgEarth/Metrics>
 #include <osgEarth/StringUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/Registry>
@@ -749,6 +750,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
                   const osgDB::Options* options, 
                   ProgressCallback*     progress) const
 {
+    ScopedMetric metric( Metrics::TIMER_HTTP_GET );
     OE_START_TIMER(http_get);
 
     std::string url = request.getURL();
@@ -944,6 +946,9 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
     response._duration_s = OE_STOP_TIMER(http_get);
 
+    if ( response._cancelled )
+        Metrics::count( Metrics::COUNTER_HTTP_CANCEL );
+
     if ( progress )
     {
         progress->stats("http_get_time") += OE_GET_TIMER(http_get);
@@ -964,6 +969,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
 {    
     initialize();
 
+    ScopedMetric metric( Metrics::TIMER_HTTP_GET );
     OE_START_TIMER(http_get);
     
     std::string url = request.getURL();
@@ -1234,6 +1240,9 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
     response._duration_s = OE_STOP_TIMER(get_duration);
 
+    if ( response._cancelled )
+        Metrics::count( Metrics::COUNTER_HTTP_CANCEL );
+
     if ( progress )
     {
         progress->stats()["http_get_time"] += OE_STOP_TIMER(http_get);
@@ -1399,6 +1408,7 @@ HTTPClient::doReadImage(const HTTPRequest&    request,
 
         else 
         {
+            ScopedMetric metric( Metrics::TIMER_DECODE );
             osgDB::ReaderWriter::ReadResult rr = reader->readImage(response.getPartStream(0), options);
             if ( rr.validImage() )
             {
@@ -1478,6 +1488,7 @@ HTTPClient::doReadNode(const HTTPRequest&    request,
 
         else 
         {
+            ScopedMetric metric( Metrics::TIMER_DECODE );
             osgDB::ReaderWriter::ReadResult rr = reader->readNode(response.getPartStream(0), options);
             if ( rr.validNode() )
             {
@@ -1550,6 +1561,7 @@ HTTPClient::doReadObject(const HTTPRequest&    request,
 
         else 
         {
+            ScopedMetric metric( Metrics::TIMER_DECODE );
             osgDB::ReaderWriter::ReadResult rr = reader->readObject(response.getPartStream(0), options);
             if ( rr.validObject() )
             {
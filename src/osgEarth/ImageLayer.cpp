@@ -24,6 +24,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Progress>
+#include <osgEarth/Metrics>
 #include <osgEarth/URI>
 #include <osgEarth/MemCache>
 #include <osgEarth/Registry>
@@ -501,6 +502,7 @@ ImageLayer::createImageInNativeProfile(const TileKey&    key,
         if ( mosaic.getImages().size() > 0 )
         {
             // assemble new GeoImage from the mosaic.
+            ScopedMetric metric( Metrics::TIMER_MERGE );
             double rxmin, rymin, rxmax, rymax;
             mosaic.getExtents( rxmin, rymin, rxmax, rymax );
 
@@ -849,6 +851,7 @@ ImageLayer::assembleImageFromTileSource(const TileKey&    key,
         }
 
         // all set. Mosaic all the images together.
+        ScopedMetric metric( Metrics::TIMER_MERGE );
         double rxmin, rymin, rxmax, rymax;
         mosaic.getExtents( rxmin, rymin, rxmax, rymax );
 
@@ -0,0 +1,514 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/Metrics>
+#include <osgEarth/Containers>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/Notify>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+#define LC "[Metrics] "
+
+using namespace osgEarth;
+using namespace osgEarth::Threading;
+
+namespace
+{
+    enum Type
+    {
+        TYPE_COUNTER,
+        TYPE_TIMER
+    };
+
+    struct Value
+    {
+        unsigned long long _count; // number of calls
+        long long          _sum;   // counters: total amount; timers: total nanoseconds
+        long long          _max;   // timers: longest interval in nanoseconds
+    };
+
+    struct TraceEvent
+    {
+        unsigned     _handle;
+        unsigned     _thread;
+        osg::Timer_t _start;
+        osg::Timer_t _end;
+    };
+
+    // Trace events kept per thread before new ones are dropped.
+    const unsigned MAX_EVENTS_PER_THREAD = 1u << 20;
+
+    // Recording switches; plain flags so the disabled path is a single test.
+    bool s_enabled = false;
+    bool s_tracing = false;
+
+    // Values recorded by one thread. Only the owning thread records, but
+    // other threads read the block when writing the metrics, so all access
+    // goes through the block's lock. Lock order: registry, then block.
+    struct ThreadBlock
+    {
+        ThreadBlock();
+        ~ThreadBlock();
+
+        // discards what was recorded before the last reset. Call with _mutex held.
+        void sync(unsigned generation);
+
+        Value                   _values[Metrics::MAX_METRICS];
+        unsigned                _thread;
+        unsigned                _generation;    // of the registry when last recorded
+        Mutex                   _mutex;
+        std::vector<TraceEvent> _events;
+    };
+
+    struct MetricsRegistry
+    {
+        MetricsRegistry();
+
+        unsigned add(const std::string& name, Type type);
+
+        // sums the retired values and those of every live thread.
+        void collect(std::vector<Value>& out);
+
+        Mutex                           _mutex;
+        unsigned                        _numMetrics;
+        std::string                     _names[Metrics::MAX_METRICS];
+        Type                            _types[Metrics::MAX_METRICS];
+        std::map<std::string, unsigned> _handles;
+        std::set<ThreadBlock*>          _blocks;
+        Value                           _retired[Metrics::MAX_METRICS];
+        std::vector<TraceEvent>         _retiredEvents;
+        PerThread<ThreadBlock>*         _perThread;
+        OpenThreads::Atomic             _generation;    // incremented by reset()
+        osg::Timer_t                    _epoch;
+        std::string                     _outputFile;
+        std::string                     _traceFile;
+    };
+
+    // Allocated once and never freed, since threads may still be recording
+    // while the process shuts down.
+    MetricsRegistry& getRegistry()
+    {
+        static MetricsRegistry* s_registry = new MetricsRegistry();
+        return *s_registry;
+    }
+
+    MetricsRegistry::MetricsRegistry() :
+        _numMetrics ( 0u ),
+        _perThread  ( new PerThread<ThreadBlock>() ),
+        _epoch      ( osg::Timer::instance()->tick() )
+    {
+        ::memset( _retired, 0, sizeof(_retired) );
+
+        // must match the order of Metrics::BuiltIn.
+        add( "fetch_imagery",   TYPE_TIMER );
+        add( "fetch_elevation", TYPE_TIMER );
+        add( "fetch_normalmap", TYPE_TIMER );
+        add( "http_get",        TYPE_TIMER );
+        add( "decode",          TYPE_TIMER );
+        add( "reproject",       TYPE_TIMER );
+        add( "merge",           TYPE_TIMER );
+        add( "cache_read",      TYPE_TIMER );
+        add( "cache_write",     TYPE_TIMER );
+        add( "http_cancel",     TYPE_COUNTER );
+        add( "cache_hit",       TYPE_COUNTER );
+        add( "cache_miss",      TYPE_COUNTER );
+        add( "hfcache_hit",     TYPE_COUNTER );
+        add( "hfcache_miss",    TYPE_COUNTER );
+
+        const char* output = ::getenv("OSGEARTH_METRICS");
+        if ( output )
+        {
+            _outputFile = output;
+            s_enabled = true;
+        }
+
+        const char* trace = ::getenv("OSGEARTH_METRICS_TRACE");
+        if ( trace )
+        {
+            _traceFile = trace;
+            s_enabled = true;
+            s_tracing = true;
+        }
+    }
+
+    unsigned MetricsRegistry::add(const std::string& name, Type type)
+    {
+        ScopedMutexLock lock( _mutex );
+
+        std::map<std::string, unsigned>::const_iterator i = _handles.find( name );
+        if ( i != _handles.end() )
+        {
+            if ( _types[i->second] != type )
+            {
+                OE_WARN << LC << "\"" << name << "\" is already registered as a different type" << std::endl;
+                return Metrics::INVALID;
+            }
+            return i->second;
+        }
+
+        if ( _numMetrics >= Metrics::MAX_METRICS )
+        {
+            OE_WARN << LC << "Too many metrics; \"" << name << "\" ignored" << std::endl;
+            return Metrics::INVALID;
+        }
+
+        unsigned handle = _numMetrics++;
+        _names[handle] = name;
+        _types[handle] = type;
+        _handles[name] = handle;
+        return handle;
+    }
+
+    void MetricsRegistry::collect(std::vector<Value>& out)
+    {
+        ScopedMutexLock lock( _mutex );
+
+        out.assign( _retired, _retired + _numMetrics );
+        for(std::set<ThreadBlock*>::const_iterator b = _blocks.begin(); b != _blocks.end(); ++b)
+        {
+            ScopedMutexLock blockLock( (*b)->_mutex );
+            if ( (*b)->_generation != (unsigned)_generation )
+                continue;
+
+            for(unsigned i = 0; i < _numMetrics; ++i)
+            {
+                const Value& v = (*b)->_values[i];
+                out[i]._count += v._count;
+                out[i]._sum   += v._sum;
+                out[i]._max    = osg::maximum( out[i]._max, v._max );
+            }
+        }
+    }
+
+    ThreadBlock::ThreadBlock() :
+        _thread( getCurrentThreadId() )
+    {
+        ::memset( _values, 0, sizeof(_values) );
+
+        MetricsRegistry& reg = getRegistry();
+        ScopedMutexLock lock( reg._mutex );
+        _generation = reg._generation;
+        reg._blocks.insert( this );
+    }
+
+    // The thread is exiting; keep what it recorded.
+    ThreadBlock::~ThreadBlock()
+    {
+        MetricsRegistry& reg = getRegistry();
+        ScopedMutexLock lock( reg._mutex );
+        reg._blocks.erase( this );
+
+        ScopedMutexLock blockLock( _mutex );
+        if ( _generation != (unsigned)reg._generation )
+            return;
+
+        for(unsigned i = 0; i < reg._numMetrics; ++i)
+        {
+            reg._retired[i]._count += _values[i]._count;
+            reg._retired[i]._sum   += _values[i]._sum;
+            reg._retired[i]._max    = osg::maximum( reg._retired[i]._max, _values[i]._max );
+        }
+        reg._retiredEvents.insert( reg._retiredEvents.end(), _events.begin(), _events.end() );
+    }
+
+    void ThreadBlock::sync(unsigned generation)
+    {
+        if ( _generation != generation )
+        {
+            ::memset( _values, 0, sizeof(_values) );
+            _events.clear();
+            _generation = generation;
+        }
+    }
+
+    // Escapes a metric name for a JSON string.
+    std::string escape(const std::string& in)
+    {
+        std::string out;
+        for(std::string::const_iterator c = in.begin(); c != in.end(); ++c)
+        {
+            if ( *c == '"' || *c == '\\' )
+                out.push_back( '\\' );
+            if ( (unsigned char)(*c) >= 0x20 )
+                out.push_back( *c );
+        }
+        return out;
+    }
+
+    // Makes sure the registry reads the environment at startup, and writes
+    // the requested files when the process exits.
+    struct WriteAtExit
+    {
+        WriteAtExit()
+        {
+            getRegistry();
+        }
+
+        ~WriteAtExit()
+        {
+            MetricsRegistry& reg = getRegistry();
+            if ( !reg._outputFile.empty() )
+                Metrics::write( reg._outputFile );
+            if ( !reg._traceFile.empty() )
+                Metrics::writeChromeTrace( reg._traceFile );
+        }
+    };
+    WriteAtExit s_writeAtExit;
+}
+
+//------------------------------------------------------------------------
+
+unsigned
+Metrics::registerCounter(const std::string& name)
+{
+    return getRegistry().add( name, TYPE_COUNTER );
+}
+
+unsigned
+Metrics::registerTimer(const std::string& name)
+{
+    return getRegistry().add( name, TYPE_TIMER );
+}
+
+bool
+Metrics::enabled()
+{
+    return s_enabled;
+}
+
+void
+Metrics::setEnabled(bool value)
+{
+    s_enabled = value;
+    if ( !value )
+        s_tracing = false;
+}
+
+bool
+Metrics::tracing()
+{
+    return s_tracing;
+}
+
+void
+Metrics::setTracing(bool value)
+{
+    s_tracing = value;
+    if ( value )
+        s_enabled = true;
+}
+
+void
+Metrics::count(unsigned handle, long long amount)
+{
+    if ( !s_enabled || handle >= MAX_METRICS )
+        return;
+
+    MetricsRegistry& reg = getRegistry();
+    ThreadBlock& block = reg._perThread->get();
+    ScopedMutexLock lock( block._mutex );
+    block.sync( reg._generation );
+
+    Value& v = block._values[handle];
+    v._count++;
+    v._sum += amount;
+}
+
+void
+Metrics::time(unsigned handle, osg::Timer_t start, osg::Timer_t end)
+{
+    if ( !s_enabled || handle >= MAX_METRICS )
+        return;
+
+    MetricsRegistry& reg = getRegistry();
+    ThreadBlock& block = reg._perThread->get();
+    long long ns = (long long)osg::Timer::instance()->delta_n( start, end );
+
+    ScopedMutexLock lock( block._mutex );
+    block.sync( reg._generation );
+
+    Value& v = block._values[handle];
+    v._count++;
+    v._sum += ns;
+    if ( ns > v._max )
+        v._max = ns;
+
+    if ( s_tracing )
+    {
+        if ( block._events.size() < MAX_EVENTS_PER_THREAD )
+        {
+            TraceEvent e;
+            e._handle = handle;
+            e._thread = block._thread;
+            e._start  = start;
+            e._end    = end;
+            block._events.push_back( e );
+        }
+    }
+}
+
+void
+Metrics::reset()
+{
+    MetricsRegistry& reg = getRegistry();
+    ScopedMutexLock lock( reg._mutex );
+
+    // start a new generation; each thread discards its old values the next
+    // time it records, and until then they are left out of the totals.
+    ++reg._generation;
+
+    ::memset( reg._retired, 0, sizeof(reg._retired) );
+    reg._retiredEvents.clear();
+}
+
+void
+Metrics::writeJSON(std::ostream& out)
+{
+    MetricsRegistry& reg = getRegistry();
+    std::vector<Value> values;
+    reg.collect( values );
+
+    out << "{\n" << std::fixed << std::setprecision(3);
+    for(unsigned i = 0; i < values.size(); ++i)
+    {
+        const Value& v = values[i];
+        out << "  \"" << escape(reg._names[i]) << "\": { ";
+        if ( reg._types[i] == TYPE_TIMER )
+        {
+            out << "\"type\": \"timer\", \"count\": " << v._count
+                << ", \"total_ms\": " << (double)v._sum*1.0e-6
+                << ", \"mean_ms\": " << (v._count > 0 ? (double)v._sum*1.0e-6/(double)v._count : 0.0)
+                << ", \"max_ms\": " << (double)v._max*1.0e-6;
+        }
+        else
+        {
+            out << "\"type\": \"counter\", \"count\": " << v._count
+                << ", \"total\": " << v._sum;
+        }
+        out << " }" << (i+1 < values.size() ? "," : "") << "\n";
+    }
+    out << "}" << std::endl;
+}
+
+void
+Metrics::writeCSV(std::ostream& out)
+{
+    MetricsRegistry& reg = getRegistry();
+    std::vector<Value> values;
+    reg.collect( values );
+
+    out << "name,type,count,total,mean,max\n" << std::fixed << std::setprecision(3);
+    for(unsigned i = 0; i < values.size(); ++i)
+    {
+        const Value& v = values[i];
+        out << reg._names[i] << ",";
+        if ( reg._types[i] == TYPE_TIMER )
+        {
+            // times in milliseconds
+            out << "timer," << v._count
+                << "," << (double)v._sum*1.0e-6
+                << "," << (v._count > 0 ? (double)v._sum*1.0e-6/(double)v._count : 0.0)
+                << "," << (double)v._max*1.0e-6;
+        }
+        else
+        {
+            out << "counter," << v._count << "," << v._sum
+                << "," << (v._count > 0 ? (double)v._sum/(double)v._count : 0.0)
+                << ",";
+        }
+        out << "\n";
+    }
+    out << std::flush;
+}
+
+void
+Metrics::writeChromeTrace(std::ostream& out)
+{
+    MetricsRegistry& reg = getRegistry();
+
+    std::vector<TraceEvent> events;
+    std::vector<std::string> names;
+    {
+        ScopedMutexLock lock( reg._mutex );
+        events = reg._retiredEvents;
+        for(std::set<ThreadBlock*>::iterator b = reg._blocks.begin(); b != reg._blocks.end(); ++b)
+        {
+            ScopedMutexLock blockLock( (*b)->_mutex );
+            if ( (*b)->_generation == (unsigned)reg._generation )
+                events.insert( events.end(), (*b)->_events.begin(), (*b)->_events.end() );
+        }
+        names.assign( reg._names, reg._names + reg._numMetrics );
+    }
+
+    // timestamps and durations are in microseconds.
+    const osg::Timer* timer = osg::Timer::instance();
+    out << "{\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+    for(unsigned i = 0; i < events.size(); ++i)
+    {
+        const TraceEvent& e = events[i];
+        out << "{\"name\":\"" << escape(names[e._handle]) << "\",\"cat\":\"osgEarth\",\"ph\":\"X\",\"pid\":0"
+            << ",\"tid\":" << e._thread
+            << ",\"ts\":" << timer->delta_u( reg._epoch, e._start )
+            << ",\"dur\":" << timer->delta_u( e._start, e._end )
+            << "}" << (i+1 < events.size() ? "," : "") << "\n";
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+bool
+Metrics::write(const std::string& filename)
+{
+    std::ofstream out( filename.c_str() );
+    if ( !out.is_open() )
+    {
+        OE_WARN << LC << "Failed to open \"" << filename << "\" for writing" << std::endl;
+        return false;
+    }
+
+    if ( osgDB::getLowerCaseFileExtension(filename) == "csv" )
+        writeCSV( out );
+    else
+        writeJSON( out );
+
+    return !out.fail();
+}
+
+bool
+Metrics::writeChromeTrace(const std::string& filename)
+{
+    std::ofstream out( filename.c_str() );
+    if ( !out.is_open() )
+    {
+        OE_WARN << LC << "Failed to open \"" << filename << "\" for writing" << std::endl;
+        return false;
+    }
+
+    writeChromeTrace( out );
+    return !out.fail();
+}
@@ -833,6 +833,12 @@ ScreenSpaceLayout::setDeclutteringEnabled(bool enabled)
     s_declutteringEnabledGlobally = enabled;
 }
 
+bool
+ScreenSpaceLayout::isDeclutteringEnabled()
+{
+    return s_declutteringEnabledGlobally;
+}
+
 void
 ScreenSpaceLayout::setSortFunctor( DeclutterSortFunctor* functor )
 {
@@ -101,6 +101,35 @@ namespace
         }
     }
 
+    // Structure-of-arrays versions of the above, for the bulk transform API.
+
+    void sphericalMercatorToGeographic(double* x, double* y, unsigned count)
+    {
+        for( unsigned i=0; i<count; ++i )
+        {
+            double xr = -osg::PI + ((osg::clampBetween(x[i], MERC_MINX, MERC_MAXX)-MERC_MINX)/MERC_WIDTH)*2.0*osg::PI;
+            double yr = -osg::PI + ((osg::clampBetween(y[i], MERC_MINY, MERC_MAXY)-MERC_MINY)/MERC_HEIGHT)*2.0*osg::PI;
+            x[i] = osg::RadiansToDegrees( xr );
+            y[i] = osg::RadiansToDegrees( 2.0 * atan( exp(yr) ) - osg::PI_2 );
+        }
+    }
+
+    void geographicToSphericalMercator(double* x, double* y, unsigned count)
+    {
+        for( unsigned i=0; i<count; ++i )
+        {
+            double xr = (osg::DegreesToRadians(osg::clampBetween(x[i], -180.0, 180.0)) - (-osg::PI)) / (2.0*osg::PI);
+            double sinLat = sin(osg::DegreesToRadians(osg::clampBetween(y[i], -90.0, 90.0)));
+            double oneMinusSinLat = 1-sinLat;
+            if ( oneMinusSinLat != 0.0 )
+            {
+                double yr = ((0.5 * log( (1+sinLat)/oneMinusSinLat )) - (-osg::PI)) / (2.0*osg::PI);
+                x[i] = osg::clampBetween(MERC_MINX + (xr * MERC_WIDTH), MERC_MINX, MERC_MAXX);
+                y[i] = osg::clampBetween(MERC_MINY + (yr * MERC_HEIGHT), MERC_MINY, MERC_MAXY);
+            }
+        }
+    }
+
     void ECEFtoGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
         for( unsigned i=0; i<points.size(); ++i )
@@ -455,11 +484,6 @@ SpatialReference::~SpatialReference()
     {
         GDAL_SCOPED_LOCK;
 
-        for (TransformHandleCache::iterator itr = _transformHandleCache.begin(); itr != _transformHandleCache.end(); ++itr)
-        {
-            OCTDestroyCoordinateTransformation(itr->second);
-        }
-
         if ( _owns_handle )
         {
             OSRDestroySpatialReference( _handle );
@@ -1135,6 +1159,91 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
 }
 
 
+bool
+SpatialReference::transform(double*                 x,
+                            double*                 y,
+                            double*                 z,
+                            unsigned                count,
+                            const SpatialReference* outputSRS) const
+{
+    if ( !outputSRS || !x || !y )
+        return false;
+
+    if ( !_initialized )
+        const_cast<SpatialReference*>(this)->init();
+
+    if ( count == 0 || isEquivalentTo(outputSRS) )
+        return true;
+
+    // Direct paths only apply to plain SRS's; cubes and tangent planes
+    // have their own pre/post-transform steps.
+    bool plain = !isCube() && !isLTP() && !outputSRS->isCube() && !outputSRS->isLTP();
+    bool sameVDatum = getVerticalDatum() == outputSRS->getVerticalDatum();
+
+    if ( plain )
+    {
+        // same shortcuts as the vector version, minus the vertical datum conversion.
+        if ( sameVDatum && isGeographic() && outputSRS->isSphericalMercator() )
+        {
+            geographicToSphericalMercator( x, y, count );
+            return true;
+        }
+
+        if ( sameVDatum && isSphericalMercator() && outputSRS->isGeographic() )
+        {
+            sphericalMercatorToGeographic( x, y, count );
+            return true;
+        }
+
+        if ( z && isECEF() && outputSRS->isGeographic() && !outputSRS->getVerticalDatum() )
+        {
+            ECEF::ECEFToGeodetic( x, y, z, count, outputSRS->getEllipsoid() );
+            return true;
+        }
+
+        if ( z && isGeographic() && outputSRS->isECEF() && isEquivalentTo(outputSRS->getGeodeticSRS()) )
+        {
+            ECEF::geodeticToECEF( x, y, z, count, outputSRS->getEllipsoid() );
+            return true;
+        }
+
+        // OGR handles X and Y; Z only changes with the vertical datum.
+        if ( sameVDatum && !isECEF() && !outputSRS->isECEF() )
+        {
+            if ( !transformXYPointArrays(x, y, count, outputSRS) )
+                return false;
+
+            if ( isProjected() && outputSRS->isGeographic() )
+            {
+                // see the vector version.
+                for( unsigned i=0; i<count; ++i )
+                {
+                    x[i] = osg::clampBetween( x[i], -180.0, 180.0 );
+                    y[i] = osg::clampBetween( y[i],  -90.0,  90.0 );
+                }
+            }
+            return true;
+        }
+    }
+
+    // Everything else goes through the general version.
+    std::vector<osg::Vec3d> points( count );
+    for( unsigned i=0; i<count; ++i )
+        points[i].set( x[i], y[i], z ? z[i] : 0.0 );
+
+    bool success = transform( points, outputSRS );
+
+    for( unsigned i=0; i<count; ++i )
+    {
+        x[i] = points[i].x();
+        y[i] = points[i].y();
+        if ( z ) z[i] = points[i].z();
+    }
+
+    return success;
+}
+
+
 bool 
 SpatialReference::transform2D(double x, double y,
                               const SpatialReference* outputSRS,
@@ -1150,29 +1259,46 @@ SpatialReference::transform2D(double x, double y,
 }
 
 
-bool
-SpatialReference::transformXYPointArrays(double*  x,
-                                         double*  y,
-                                         unsigned count,
-                                         const SpatialReference* out_srs) const
-{  
-    // Transform the X and Y values inside an exclusive GDAL/OGR lock
+SpatialReference::TransformHandleCache::~TransformHandleCache()
+{
     GDAL_SCOPED_LOCK;
-
-    void* xform_handle = NULL;
-    TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_srs->getWKT());
-    if (itr != _transformHandleCache.end())
+    for (iterator itr = begin(); itr != end(); ++itr)
     {
-        //OE_DEBUG << LC << "using cached transform handle" << std::endl;
-        xform_handle = itr->second;
+        if ( itr->second )
+            OCTDestroyCoordinateTransformation(itr->second);
     }
-    else
+}
+
+void*
+SpatialReference::getTransformHandle(const SpatialReference* out_srs) const
+{
+    // the calling thread's cache; no lock.
+    TransformHandleCache& cache = _transformHandleCache.get();
+    TransformHandleCache::const_iterator itr = cache.find(out_srs->getWKT());
+    if (itr != cache.end())
+        return itr->second;
+
+    void* xform_handle = NULL;
     {
+        GDAL_SCOPED_LOCK;
         OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
         xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
-        const_cast<SpatialReference*>(this)->_transformHandleCache[out_srs->getWKT()] = xform_handle;
     }
 
+    cache[out_srs->getWKT()] = xform_handle;
+    return xform_handle;
+}
+
+bool
+SpatialReference::transformXYPointArrays(double*  x,
+                                         double*  y,
+                                         unsigned count,
+                                         const SpatialReference* out_srs) const
+{  
+    // Each thread has its own transformation handle, so the transform itself
+    // doesn't need the global GDAL/OGR lock.
+    void* xform_handle = getTransformHandle( out_srs );
+
     if ( !xform_handle )
     {
         OE_WARN << LC
@@ -309,15 +309,23 @@ TerrainTileModel*
 TerrainEngineNode::createTileModel(const MapFrame&   frame,
                                    const TileKey&    key,
                                    ProgressCallback* progress)
+{
+    return createTileModel(frame, key, CreateTileModelFilter(), progress);
+}
+
+TerrainTileModel*
+TerrainEngineNode::createTileModel(const MapFrame&              frame,
+                                   const TileKey&               key,
+                                   const CreateTileModelFilter& filter,
+                                   ProgressCallback*            progress)
 {
     TerrainEngineRequirements* requirements = this;
 
-    // Ask the factory to create a new tile model:
-    osg::ref_ptr<TerrainTileModel> model = _tileModelFactory->createTileModel(
-        frame, 
-        key, 
-        requirements, 
-        progress);
+    // Ask the factory to create a new tile model. Full tiles go through the
+    // unfiltered method so that factory subclasses overriding it still work.
+    osg::ref_ptr<TerrainTileModel> model = filter.empty() ?
+        _tileModelFactory->createTileModel( frame, key, requirements, progress ) :
+        _tileModelFactory->createTileModel( frame, key, filter, requirements, progress );
 
     if ( model.valid() )
     {
@@ -95,6 +95,8 @@ TerrainLayerOptions::getConfig( bool isolate ) const
     conf.updateIfSet( "vdatum", _vertDatum );
 
     conf.updateIfSet   ( "cacheid",      _cacheId );
+    conf.updateIfSet   ( "cache_image_codec", _cacheImageCodec );
+    conf.updateIfSet   ( "cache_compressor",  _cacheCompressor );
     conf.updateObjIfSet( "proxy",        _proxySettings );
 
     if ( _cachePolicy.isSet() && !_cachePolicy->empty() )
@@ -126,6 +128,8 @@ TerrainLayerOptions::fromConfig( const Config& conf )
     conf.getIfSet( "vsrs", _vertDatum );    // back compat
 
     conf.getIfSet   ( "cacheid",      _cacheId );
+    conf.getIfSet   ( "cache_image_codec", _cacheImageCodec );
+    conf.getIfSet   ( "cache_compressor",  _cacheCompressor );
     conf.getObjIfSet( "cache_policy", _cachePolicy );
     conf.getObjIfSet( "proxy",        _proxySettings );
 
@@ -447,6 +451,12 @@ TerrainLayer::getCacheSettings() const
                 CacheBin* bin = _cacheSettings->getCache()->addBin(_runtimeOptions->cacheId().get());
                 if (bin)
                 {
+                    if (_runtimeOptions->cacheImageCodec().isSet())
+                        bin->setImageCodec(_runtimeOptions->cacheImageCodec().get());
+
+                    if (_runtimeOptions->cacheCompressor().isSet())
+                        bin->setCompressor(_runtimeOptions->cacheCompressor().get());
+
                     _cacheSettings->setCacheBin(bin);
                     OE_INFO << LC << "Opened cache bin [" << bin->getID() << "]\n";
                 }
@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/ImageToHeightFieldConverter>
+#include <osgEarth/Metrics>
 
 #include <osg/Texture2D>
 
@@ -41,6 +42,16 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
                                          const TileKey&                   key,
                                          const TerrainEngineRequirements* requirements,
                                          ProgressCallback*                progress)
+{
+    return createTileModel(frame, key, CreateTileModelFilter(), requirements, progress);
+}
+
+TerrainTileModel*
+TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
+                                         const TileKey&                   key,
+                                         const CreateTileModelFilter&     filter,
+                                         const TerrainEngineRequirements* requirements,
+                                         ProgressCallback*                progress)
 {
     // Make a new model:
     osg::ref_ptr<TerrainTileModel> model = new TerrainTileModel(
@@ -48,16 +59,20 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
         frame.getRevision() );
 
     // assemble all the components:
-    addImageLayers( model.get(), frame, key, progress );
+    addImageLayers( model.get(), frame, key, filter, progress );
 
-    if ( requirements == 0L || requirements->elevationTexturesRequired() )
+    // a layer filter means we are only refreshing imagery.
+    if ( filter.empty() )
     {
-        addElevation( model.get(), frame, key, progress );
-    }
+        if ( requirements == 0L || requirements->elevationTexturesRequired() )
+        {
+            addElevation( model.get(), frame, key, progress );
+        }
 
-    if ( requirements == 0L || requirements->normalTexturesRequired() )
-    {
-        addNormalMap( model.get(), frame, key, progress );
+        if ( requirements == 0L || requirements->normalTexturesRequired() )
+        {
+            addNormalMap( model.get(), frame, key, progress );
+        }
     }
 
     // done.
@@ -68,8 +83,10 @@ void
 TerrainTileModelFactory::addImageLayers(TerrainTileModel*            model,
                                         const MapFrame&              frame,
                                         const TileKey&               key,
+                                        const CreateTileModelFilter& filter,
                                         ProgressCallback*            progress)
 {
+    ScopedMetric metric( Metrics::TIMER_FETCH_IMAGERY );
     OE_START_TIMER(fetch_image_layers);
 
     int order = 0;
@@ -80,6 +97,9 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel*            model,
     {
         ImageLayer* layer = i->get();
 
+        if ( !filter.accept(layer->getUID()) )
+            continue;
+
         if ( layer->getEnabled() && layer->isKeyInRange(key) )
         {
             // This will only go true if we are requesting a ROOT TILE but we have to
@@ -161,6 +181,7 @@ TerrainTileModelFactory::addElevation(TerrainTileModel*            model,
                                       ProgressCallback*            progress)
 {    
     // make an elevation layer.
+    ScopedMetric metric( Metrics::TIMER_FETCH_ELEVATION );
     OE_START_TIMER(fetch_elevation);
 
     const MapInfo& mapInfo = frame.getMapInfo();
@@ -215,6 +236,7 @@ TerrainTileModelFactory::addNormalMap(TerrainTileModel*            model,
                                       const TileKey&               key,
                                       ProgressCallback*            progress)
 {
+    ScopedMetric metric( Metrics::TIMER_FETCH_NORMALMAP );
     OE_START_TIMER(fetch_normalmap);
 
     const osgEarth::ElevationInterpolation& interp =
@@ -262,6 +284,7 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
     if ( _heightFieldCacheEnabled && _heightFieldCache.get(cachekey, rec) )
     {
         out_hf = rec.value().get();
+        Metrics::count( Metrics::COUNTER_HFCACHE_HIT );
 
         if (progress)
         {
@@ -272,6 +295,9 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
         return true;
     }
 
+    if ( _heightFieldCacheEnabled )
+        Metrics::count( Metrics::COUNTER_HFCACHE_MISS );
+
     if ( !out_hf.valid() )
     {
         // This sets the elevation tile size; query size for all tiles.
@@ -18,11 +18,14 @@
  */
 #include <osgEarth/ThreadingUtils>
 
+#include <vector>
+
 #ifdef _WIN32
-    extern "C" unsigned long __stdcall GetCurrentThreadId();
+#   include <windows.h>
 #else
 #   include <unistd.h>
 #   include <sys/syscall.h>
+#   include <pthread.h>
 #endif
 
 using namespace osgEarth::Threading;
@@ -44,3 +47,177 @@ unsigned osgEarth::Threading::getCurrentThreadId()
   return (unsigned)::syscall(SYS_gettid);
 #endif
 }
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    typedef ThreadLocalBase::Slot Slot;
+
+    // One per thread: that thread's slot in each ThreadLocalBase, indexed by
+    // the object's index. Only the owning thread grows the vector, and only
+    // under the registry mutex; other threads touch it (to clear entries of
+    // a dying object) under the same mutex.
+    struct SlotTable
+    {
+        std::vector<Slot*> _slots;
+    };
+
+    void destroySlotTable(SlotTable* table);
+
+#ifdef _WIN32
+    void WINAPI onThreadExit(void* data)
+    {
+        if ( data )
+            destroySlotTable( static_cast<SlotTable*>(data) );
+    }
+#else
+    void onThreadExit(void* data)
+    {
+        if ( data )
+            destroySlotTable( static_cast<SlotTable*>(data) );
+    }
+#endif
+
+    // Process-wide bookkeeping. Allocated once and never freed, so that
+    // static PerThread objects can be destroyed at exit in any order.
+    struct SlotRegistry
+    {
+        SlotRegistry() : _nextIndex( 0u )
+        {
+#ifdef _WIN32
+            _key = ::FlsAlloc( onThreadExit );
+#else
+            ::pthread_key_create( &_key, onThreadExit );
+#endif
+        }
+
+        SlotTable* getTable() const
+        {
+#ifdef _WIN32
+            return static_cast<SlotTable*>( ::FlsGetValue(_key) );
+#else
+            return static_cast<SlotTable*>( ::pthread_getspecific(_key) );
+#endif
+        }
+
+        void setTable(SlotTable* table)
+        {
+#ifdef _WIN32
+            ::FlsSetValue( _key, table );
+#else
+            ::pthread_setspecific( _key, table );
+#endif
+        }
+
+#ifdef _WIN32
+        DWORD                 _key;
+#else
+        pthread_key_t         _key;
+#endif
+        Mutex                 _mutex;
+        std::set<SlotTable*>  _tables;
+        std::vector<unsigned> _freeIndices;
+        unsigned              _nextIndex;
+    };
+
+    SlotRegistry& getSlotRegistry()
+    {
+        static SlotRegistry* s_registry = new SlotRegistry();
+        return *s_registry;
+    }
+
+    // make sure the registry exists before any threads are started.
+    struct InitSlotRegistry
+    {
+        InitSlotRegistry() { getSlotRegistry(); }
+    };
+    InitSlotRegistry s_initSlotRegistry;
+
+    // Called when a thread exits. The slots are deleted outside the lock
+    // since their destructors may use other per-thread objects.
+    void destroySlotTable(SlotTable* table)
+    {
+        SlotRegistry& reg = getSlotRegistry();
+        std::vector<Slot*> slots;
+        {
+            ScopedMutexLock lock( reg._mutex );
+            reg._tables.erase( table );
+            slots.swap( table->_slots );
+        }
+        delete table;
+
+        for(std::vector<Slot*>::iterator i = slots.begin(); i != slots.end(); ++i)
+            delete *i;
+    }
+}
+
+ThreadLocalBase::ThreadLocalBase()
+{
+    SlotRegistry& reg = getSlotRegistry();
+    ScopedMutexLock lock( reg._mutex );
+    if ( !reg._freeIndices.empty() )
+    {
+        _index = reg._freeIndices.back();
+        reg._freeIndices.pop_back();
+    }
+    else
+    {
+        _index = reg._nextIndex++;
+    }
+}
+
+ThreadLocalBase::~ThreadLocalBase()
+{
+    SlotRegistry& reg = getSlotRegistry();
+    std::vector<Slot*> slots;
+    {
+        ScopedMutexLock lock( reg._mutex );
+        for(std::set<SlotTable*>::iterator t = reg._tables.begin(); t != reg._tables.end(); ++t)
+        {
+            std::vector<Slot*>& tableSlots = (*t)->_slots;
+            if ( _index < tableSlots.size() && tableSlots[_index] )
+            {
+                slots.push_back( tableSlots[_index] );
+                tableSlots[_index] = 0L;
+            }
+        }
+        // the index is free for reuse now that no thread refers to it.
+        reg._freeIndices.push_back( _index );
+    }
+
+    for(std::vector<Slot*>::iterator i = slots.begin(); i != slots.end(); ++i)
+        delete *i;
+}
+
+ThreadLocalBase::Slot*
+ThreadLocalBase::getSlot() const
+{
+    SlotTable* table = getSlotRegistry().getTable();
+    return table && _index < table->_slots.size() ? table->_slots[_index] : 0L;
+}
+
+void
+ThreadLocalBase::setSlot(Slot* slot)
+{
+    SlotRegistry& reg = getSlotRegistry();
+    Slot* old = 0L;
+    {
+        ScopedMutexLock lock( reg._mutex );
+
+        SlotTable* table = reg.getTable();
+        if ( !table )
+        {
+            table = new SlotTable();
+            reg.setTable( table );
+            reg._tables.insert( table );
+        }
+
+        if ( _index >= table->_slots.size() )
+            table->_slots.resize( _index+1, 0L );
+
+        old = table->_slots[_index];
+        table->_slots[_index] = slot;
+    }
+    delete old;
+}
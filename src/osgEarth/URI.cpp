@@ -22,6 +22,7 @@
 #include <osgEarth/HTTPClient>
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
+#include <osgEarth/Metrics>
 #include <osgEarth/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
@@ -471,11 +472,19 @@ namespace
                     // first try to go to the cache if there is one:
                     if ( bin && cp->isCacheReadable() )
                     {                                                
-                        result = reader.fromCache( bin, uri.cacheKey() );                        
+                        {
+                            ScopedMetric metric( Metrics::TIMER_CACHE_READ );
+                            result = reader.fromCache( bin, uri.cacheKey() );
+                        }
                         if ( result.succeeded() )
                         {                                        
                             expired = cp->isExpired(result.lastModifiedTime());
                             result.setIsFromCache(true);
+                            Metrics::count( Metrics::COUNTER_CACHE_HIT );
+                        }
+                        else
+                        {
+                            Metrics::count( Metrics::COUNTER_CACHE_MISS );
                         }
                     }
 
@@ -526,6 +535,7 @@ namespace
                             if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() && bin )
                             {
                                 OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
+                                ScopedMetric metric( Metrics::TIMER_CACHE_WRITE );
                                 bin->write( uri.cacheKey(), result.getObject(), result.metadata(), remoteOptions );
                             }
                         }
@@ -154,17 +154,35 @@ VerticalDatum::transform(const VerticalDatum* from,
         ystep = (ne.y()-sw.y()) / double(rows-1);
     }
 
-    for( unsigned c=0; c<cols; ++c)
+    // Sample each geoid once over the whole grid, then apply the offsets in one
+    // pass. This is the same math as the per-point transform above; msl2hae and
+    // hae2msl are non-virtual, so there is no subclass behavior to bypass.
+    unsigned count = cols*rows;
+    std::vector<float> fromOffsets, toOffsets;
+
+    if ( from && from->getGeoid() )
+        from->getGeoid()->getHeights( sw.y(), sw.x(), ystep, xstep, cols, rows, fromOffsets );
+    else
+        fromOffsets.assign( count, 0.0f );
+
+    if ( to && to->getGeoid() )
+        to->getGeoid()->getHeights( sw.y(), sw.x(), ystep, xstep, cols, rows, toOffsets );
+    else
+        toOffsets.assign( count, 0.0f );
+
+    Units fromUnits = from ? from->getUnits() : Units::METERS;
+    Units toUnits = to ? to->getUnits() : Units::METERS;
+    double scale = fromUnits.convertTo(toUnits, 1.0);
+
+    float* heights = &hf->getFloatArray()->front();
+
+    // work in double, as the per-point transform does, and only round on the store.
+    for( unsigned i=0; i<count; ++i )
     {
-        double lon = sw.x() + xstep*double(c);
-        for( unsigned r=0; r<rows; ++r)
+        if ( heights[i] != NO_DATA_VALUE )
         {
-            double lat = sw.y() + ystep*double(r);
-            float& h = hf->getHeight(c, r);
-            if (h != NO_DATA_VALUE)
-            {
-                VerticalDatum::transform( from, to, lat, lon, h );
-            }
+            double z = (double(heights[i]) + double(fromOffsets[i])) * scale - double(toOffsets[i]);
+            heights[i] = float(z);
         }
     }
 
@@ -0,0 +1,1115 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarthAnnotation/PlaceBatchNode>
+#include <osgEarthAnnotation/AnnotationUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/VirtualProgram>
+#include <osgEarth/ScreenSpaceLayout>
+#include <osgEarth/CullingUtils>
+#include <osgEarthSymbology/Color>
+#include <osg/Depth>
+#include <osg/BlendFunc>
+#include <osg/Version>
+#include <osgText/Text>
+#include <algorithm>
+#include <float.h>
+
+#define LC "[PlaceBatchNode] "
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+
+// vertex attribute carrying the pixel offset of a quad corner
+#define OFFSET_ATTRIB       osg::Drawable::ATTRIBUTE_6
+#define OFFSET_ATTRIB_NAME  "oe_placebatch_offset"
+
+// icons draw before text; both after the terrain. (13 is the declutter bin.)
+#define ICON_BIN 11
+#define TEXT_BIN 12
+
+// size of a cell of the screen grid used to find overlapping places
+#define GRID_CELL_SIZE 64.0f
+
+namespace
+{
+    const char* placeBatchVS =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "attribute vec2 " OFFSET_ATTRIB_NAME ";\n"
+        "uniform vec2 oe_placebatch_viewport;\n"
+        "varying vec2 oe_placebatch_texCoord;\n"
+
+        "void oe_placebatch_vertex(inout vec4 vertex_clip)\n"
+        "{\n"
+        "    vertex_clip.xy += " OFFSET_ATTRIB_NAME " * 2.0 * vertex_clip.w / oe_placebatch_viewport;\n"
+        "    oe_placebatch_texCoord = gl_MultiTexCoord0.st;\n"
+        "}\n";
+
+    const char* placeBatchFS =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform sampler2D oe_placebatch_tex;\n"
+        "uniform bool oe_placebatch_glyphs;\n"
+        "varying vec2 oe_placebatch_texCoord;\n"
+
+        "void oe_placebatch_fragment(inout vec4 color)\n"
+        "{\n"
+        "    vec4 texel = texture2D(oe_placebatch_tex, oe_placebatch_texCoord);\n"
+        "    if ( oe_placebatch_glyphs )\n"
+        "        color.a *= texel.a;\n"
+        "    else\n"
+        "        color *= texel;\n"
+        "}\n";
+
+    // Orders decluttering candidates front to back, or by descending
+    // priority first, like the DeclutterSort of the ScreenSpaceLayout.
+    struct SortCandidates
+    {
+        const std::vector<float>& _depths;
+        const std::vector<float>& _priorities;
+        bool                      _byPriority;
+
+        SortCandidates(const std::vector<float>& depths, const std::vector<float>& priorities, bool byPriority)
+            : _depths( depths ), _priorities( priorities ), _byPriority( byPriority ) { }
+
+        bool operator()(unsigned lhs, unsigned rhs) const
+        {
+            if ( _byPriority && _priorities[lhs] != _priorities[rhs] )
+                return _priorities[lhs] > _priorities[rhs];
+            return _depths[lhs] < _depths[rhs];
+        }
+    };
+
+    bool overlaps(const osg::BoundingBox& a, const osg::BoundingBox& b)
+    {
+        return
+            a.xMin() <= b.xMax() && a.xMax() >= b.xMin() &&
+            a.yMin() <= b.yMax() && a.yMax() >= b.yMin();
+    }
+}
+
+//------------------------------------------------------------------------
+
+PlaceBatchNode::PlaceBatchNode(MapNode*              mapNode,
+                               const osgDB::Options* dbOptions) :
+_mapNode      ( mapNode ),
+_dbOptions    ( dbOptions ),
+_numPlaces    ( 0 ),
+_dirty        ( false ),
+_revision     ( 0 ),
+_boundRevision( 0 ),
+_declutter    ( true )
+{
+    // rebuilds the pages after structural changes.
+    ADJUST_UPDATE_TRAV_COUNT( this, 1 );
+
+    osg::StateSet* stateSet = getOrCreateStateSet();
+
+    VirtualProgram* vp = VirtualProgram::getOrCreate( stateSet );
+    vp->setName( "PlaceBatchNode" );
+    vp->setFunction( "oe_placebatch_vertex", placeBatchVS, ShaderComp::LOCATION_VERTEX_CLIP );
+    vp->setFunction( "oe_placebatch_fragment", placeBatchFS, ShaderComp::LOCATION_FRAGMENT_COLORING );
+    vp->addBindAttribLocation( OFFSET_ATTRIB_NAME, OFFSET_ATTRIB );
+
+    stateSet->addUniform( new osg::Uniform("oe_placebatch_tex", 0) );
+
+    // same as PlaceNode: draw over the terrain, and don't hide each other.
+    stateSet->setAttributeAndModes( new osg::Depth(osg::Depth::ALWAYS, 0, 1, false), 1 );
+    stateSet->setAttributeAndModes( new osg::BlendFunc(), 1 );
+    stateSet->setMode( GL_CULL_FACE, osg::StateAttribute::OFF );
+    stateSet->setMode( GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED );
+
+    _iconAtlas = new IconAtlas();
+}
+
+PlaceBatchNode::~PlaceBatchNode()
+{
+    releaseAtlasRegions( _atlasRegions );
+    releaseAtlasRegions( _staleAtlasRegions );
+}
+
+void
+PlaceBatchNode::setIconAtlas(IconAtlas* atlas)
+{
+    if ( atlas != _iconAtlas.get() )
+    {
+        releaseAtlasRegions( _atlasRegions );
+        releaseAtlasRegions( _staleAtlasRegions );
+        _iconAtlas = atlas;
+        _dirty = true;
+    }
+}
+
+unsigned
+PlaceBatchNode::addPlace(const GeoPoint&    position,
+                         const std::string& text,
+                         const Style&       style,
+                         osg::Image*        image)
+{
+    unsigned id;
+    if ( !_freeList.empty() )
+    {
+        id = _freeList.back();
+        _freeList.pop_back();
+    }
+    else
+    {
+        id = (unsigned)_places.size();
+        _places.push_back( Place() );
+    }
+
+    Place& place = _places[id];
+    place._active   = true;
+    place._position = position;
+    place._text     = text;
+    place._style    = style;
+    place._image    = image;
+    place._scale    = 1.0f;
+    place._color    = Color::White;
+    place._visible  = true;
+
+    // same as GeoPositionNode::applyStyle.
+    const TextSymbol* textSymbol = style.get<TextSymbol>();
+    const IconSymbol* iconSymbol = style.get<IconSymbol>();
+    place._priority =
+        (textSymbol && textSymbol->declutter() == false) ||
+        (iconSymbol && iconSymbol->declutter() == false) ? FLT_MAX : 0.0f;
+
+    computeWorld( place );
+
+    ++_numPlaces;
+    _dirty = true;
+    return id;
+}
+
+bool
+PlaceBatchNode::removePlace(unsigned id)
+{
+    if ( id >= _places.size() || !_places[id]._active )
+        return false;
+
+    _places[id] = Place();
+    _places[id]._active = false;
+    _freeList.push_back( id );
+
+    --_numPlaces;
+    _dirty = true;
+    return true;
+}
+
+void
+PlaceBatchNode::clear()
+{
+    _places.clear();
+    _freeList.clear();
+    _numPlaces = 0;
+    _dirty = true;
+}
+
+void
+PlaceBatchNode::setPosition(unsigned id, const GeoPoint& position)
+{
+    if ( id >= _places.size() || !_places[id]._active )
+        return;
+
+    Place& place = _places[id];
+    place._position = position;
+    computeWorld( place );
+
+    if ( !_dirty )
+        updateQuads( place );
+}
+
+void
+PlaceBatchNode::setScale(unsigned id, float scale)
+{
+    if ( id >= _places.size() || !_places[id]._active )
+        return;
+
+    Place& place = _places[id];
+    place._scale = scale;
+
+    if ( !_dirty )
+        updateQuads( place );
+}
+
+void
+PlaceBatchNode::setColor(unsigned id, const osg::Vec4f& color)
+{
+    if ( id >= _places.size() || !_places[id]._active )
+        return;
+
+    Place& place = _places[id];
+    place._color = color;
+
+    if ( !_dirty )
+        updateQuads( place );
+}
+
+void
+PlaceBatchNode::setPriority(unsigned id, float priority)
+{
+    if ( id < _places.size() && _places[id]._active )
+        _places[id]._priority = priority;
+}
+
+void
+PlaceBatchNode::setVisible(unsigned id, bool visible)
+{
+    if ( id < _places.size() && _places[id]._active )
+        _places[id]._visible = visible;
+}
+
+void
+PlaceBatchNode::computeWorld(Place& place)
+{
+    osg::ref_ptr<MapNode> mapNode;
+    _mapNode.lock( mapNode );
+
+    GeoPoint point = place._position;
+    if ( mapNode.valid() && point.isValid() )
+    {
+        place._position.transform( mapNode->getMapSRS(), point );
+    }
+
+    // toWorld resolves a relative altitude against the terrain.
+    if ( !point.toWorld(place._world, mapNode.valid() ? mapNode->getTerrain() : 0L) )
+    {
+        place._world.set( 0, 0, 0 );
+    }
+}
+
+void
+PlaceBatchNode::build()
+{
+    _pages.clear();
+    _pageIndex.clear();
+    _localBox.init();
+
+    // icons stay acquired from one build to the next; the ones left in
+    // the stale list at the end are no longer in use.
+    _staleAtlasRegions.swap( _atlasRegions );
+
+    // anchors are stored relative to the first place to keep the precision
+    // of the float vertex array; cull() puts the origin back in the modelview.
+    bool haveOrigin = false;
+    for(std::vector<Place>::iterator p = _places.begin(); p != _places.end(); ++p)
+    {
+        if ( p->_active )
+        {
+            if ( !haveOrigin )
+            {
+                _origin = p->_world;
+                haveOrigin = true;
+            }
+            buildPlace( *p );
+        }
+    }
+
+    // forget the textures of icons that are no longer in use.
+    for(std::map<osg::Image*, osg::ref_ptr<osg::Texture2D> >::iterator i = _iconTextures.begin(); i != _iconTextures.end(); )
+    {
+        if ( _pageIndex.find(i->second.get()) == _pageIndex.end() )
+            _iconTextures.erase( i++ );
+        else
+            ++i;
+    }
+    releaseAtlasRegions( _staleAtlasRegions );
+
+    _dirty = false;
+    ++_revision;
+    ++_boundRevision;
+    dirtyBound();
+
+    OE_DEBUG << LC << _numPlaces << " places in " << _pages.size() << " pages" << std::endl;
+}
+
+void
+PlaceBatchNode::buildPlace(Place& place)
+{
+    place._spans.clear();
+    place._box.init();
+
+    const Style& style = place._style;
+
+    osg::ref_ptr<const InstanceSymbol> instance = style.get<InstanceSymbol>();
+
+    // backwards compability, support for deprecated MarkerSymbol
+    if ( !instance.valid() && style.has<MarkerSymbol>() )
+    {
+        instance = style.get<MarkerSymbol>()->convertToInstanceSymbol();
+    }
+
+    const IconSymbol* icon = instance.valid() ? instance->asIcon() : 0L;
+
+    osg::Image* image = place._image.valid() ? place._image.get() : getIconImage( place, icon );
+
+    const TextSymbol* symbol = style.get<TextSymbol>();
+
+    // like the layout data of a PlaceNode, the pixel offset moves everything.
+    osg::Vec2f shift;
+    if ( symbol && symbol->pixelOffset().isSet() )
+    {
+        shift.set( symbol->pixelOffset()->x(), symbol->pixelOffset()->y() );
+    }
+
+    osg::BoundingBox imageBox(0,0,0,0,0,0);
+
+    if ( image )
+    {
+        double scale = 1.0;
+        if ( icon && icon->scale().isSet() )
+        {
+            scale = icon->scale()->eval();
+        }
+
+        float s = scale * image->s();
+        float t = scale * image->t();
+
+        // this offset anchors the image at the bottom
+        osg::Vec2f offset;
+        if ( !icon || !icon->alignment().isSet() )
+        {
+            offset.set( 0.0, t/2.0 );
+        }
+        else
+        {
+            switch (icon->alignment().value())
+            {
+            case IconSymbol::ALIGN_LEFT_TOP:      offset.set(  s/2.0, -t/2.0 ); break;
+            case IconSymbol::ALIGN_LEFT_CENTER:   offset.set(  s/2.0,  0.0   ); break;
+            case IconSymbol::ALIGN_LEFT_BOTTOM:   offset.set(  s/2.0,  t/2.0 ); break;
+            case IconSymbol::ALIGN_CENTER_TOP:    offset.set(  0.0,   -t/2.0 ); break;
+            case IconSymbol::ALIGN_CENTER_CENTER: offset.set(  0.0,    0.0   ); break;
+            case IconSymbol::ALIGN_CENTER_BOTTOM:
+            default:                              offset.set(  0.0,    t/2.0 ); break;
+            case IconSymbol::ALIGN_RIGHT_TOP:     offset.set( -s/2.0, -t/2.0 ); break;
+            case IconSymbol::ALIGN_RIGHT_CENTER:  offset.set( -s/2.0,  0.0   ); break;
+            case IconSymbol::ALIGN_RIGHT_BOTTOM:  offset.set( -s/2.0,  t/2.0 ); break;
+            }
+        }
+
+        double heading = 0.0;
+        if ( icon && icon->heading().isSet() )
+        {
+            heading = osg::DegreesToRadians( icon->heading()->eval() );
+        }
+
+        osg::Texture* texture = 0L;
+        osg::Vec2f tcLowerLeft( 0, 0 ), tcUpperRight( 1, 1 );
+
+        IconAtlas::Region region;
+        if ( getAtlasRegion(image, region) )
+        {
+            texture = _iconAtlas->getTexture( region._page );
+            tcLowerLeft  = region._uvMin;
+            tcUpperRight = region._uvMax;
+        }
+        else
+        {
+            osg::ref_ptr<osg::Texture2D>& iconTexture = _iconTextures[image];
+            if ( !iconTexture.valid() )
+            {
+                iconTexture = new osg::Texture2D( image );
+                iconTexture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR );
+                iconTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+                iconTexture->setResizeNonPowerOfTwoHint( false );
+            }
+            texture = iconTexture.get();
+        }
+
+        osg::Vec2f lowerLeft( offset.x() - s/2.0, offset.y() - t/2.0 );
+
+        addQuad(
+            place, getPage(texture, false),
+            lowerLeft, lowerLeft + osg::Vec2f(s, t),
+            tcLowerLeft, tcUpperRight,
+            Color::White, heading, shift );
+
+        // the label aligns to the icon, before the shift.
+        imageBox = place._box;
+        imageBox.xMin() -= shift.x(); imageBox.xMax() -= shift.x();
+        imageBox.yMin() -= shift.y(); imageBox.yMax() -= shift.y();
+    }
+
+    std::string text = place._text;
+    if ( text.empty() && symbol && symbol->content().isSet() )
+    {
+        text = symbol->content()->eval();
+    }
+
+    if ( text.empty() )
+        return;
+
+    osgText::Text::AlignmentType align = osgText::Text::CENTER_CENTER;
+    if ( symbol && symbol->alignment().isSet() )
+    {
+        // they're the same enum.
+        align = (osgText::Text::AlignmentType)symbol->alignment().value();
+    }
+    else if ( image )
+    {
+        // PlaceNode puts the label to the right of the icon.
+        align = osgText::Text::LEFT_CENTER;
+    }
+
+    float size = symbol && symbol->size().isSet() ? (float)(symbol->size()->eval()) : 16.0f;
+    osg::Vec4f fill = symbol && symbol->fill().isSet() ? symbol->fill()->color() : Color::White;
+
+    // PlaceNode always creates a TextSymbol, so only a bare label gets the default halo.
+    bool halo = symbol ? symbol->halo().isSet() : image == 0L;
+    osg::Vec4f haloColor = symbol && symbol->halo().isSet() ? symbol->halo()->color() : osg::Vec4f(.3,.3,.3,1);
+
+    // backdrop offsets are a fraction of the font size, 1/256th of the resolution by default.
+    float haloOffset = symbol && symbol->haloOffset().isSet() ? *symbol->haloOffset() : size/256.0f;
+    haloOffset *= size;
+
+    osgText::String::Encoding encoding = osgText::String::ENCODING_UNDEFINED;
+    if ( symbol && symbol->encoding().isSet() )
+    {
+        encoding = AnnotationUtils::convertTextSymbolEncoding( symbol->encoding().value() );
+    }
+
+    osgText::Font* font = getFont( symbol );
+    if ( !font )
+        return;
+
+    osgText::String chars( text, encoding );
+    osgText::FontResolution resolution( (unsigned)size, (unsigned)size );
+
+    // lay out the glyphs from the base line of the first line.
+    std::vector<osgText::Glyph*> glyphs;
+    std::vector<osg::Vec2f>      corners;
+    osg::BoundingBox             textBox;
+    osg::Vec2f                   cursor;
+    unsigned                     previous = 0;
+
+    for(osgText::String::iterator c = chars.begin(); c != chars.end(); ++c)
+    {
+        if ( *c == '\n' )
+        {
+            cursor.set( 0.0f, cursor.y() - size );
+            previous = 0;
+            continue;
+        }
+
+        osgText::Glyph* glyph = font->getGlyph( resolution, *c );
+        if ( !glyph )
+            continue;
+
+        if ( previous )
+        {
+            cursor.x() += font->getKerning( previous, *c, osgText::KERNING_DEFAULT ).x() * size;
+        }
+
+        osg::Vec2f lowerLeft  = cursor + glyph->getHorizontalBearing() * size;
+        osg::Vec2f upperRight = lowerLeft + osg::Vec2f( glyph->getWidth()*size, glyph->getHeight()*size );
+
+        glyphs.push_back( glyph );
+        corners.push_back( lowerLeft );
+        corners.push_back( upperRight );
+        textBox.expandBy( lowerLeft.x(), lowerLeft.y(), 0.0f );
+        textBox.expandBy( upperRight.x(), upperRight.y(), 0.0f );
+
+        cursor.x() += glyph->getHorizontalAdvance() * size;
+        previous = *c;
+    }
+
+    if ( glyphs.empty() )
+        return;
+
+    // same reference point as AnnotationUtils::createTextDrawable.
+    osg::Vec2f pos;
+    switch( align )
+    {
+    case osgText::Text::LEFT_TOP:
+        pos.set( imageBox.xMax(), imageBox.yMin() ); break;
+    case osgText::Text::LEFT_CENTER:
+        pos.set( imageBox.xMax(), imageBox.center().y() ); break;
+    case osgText::Text::LEFT_BOTTOM:
+    case osgText::Text::LEFT_BOTTOM_BASE_LINE:
+    case osgText::Text::LEFT_BASE_LINE:
+        pos.set( imageBox.xMax(), imageBox.yMax() ); break;
+    case osgText::Text::RIGHT_TOP:
+        pos.set( imageBox.xMin(), imageBox.yMin() ); break;
+    case osgText::Text::RIGHT_CENTER:
+        pos.set( imageBox.xMin(), imageBox.center().y() ); break;
+    case osgText::Text::RIGHT_BOTTOM:
+    case osgText::Text::RIGHT_BOTTOM_BASE_LINE:
+    case osgText::Text::RIGHT_BASE_LINE:
+        pos.set( imageBox.xMin(), imageBox.yMax() ); break;
+    case osgText::Text::CENTER_TOP:
+        pos.set( imageBox.center().x(), imageBox.yMin() ); break;
+    case osgText::Text::CENTER_BOTTOM:
+    case osgText::Text::CENTER_BOTTOM_BASE_LINE:
+    case osgText::Text::CENTER_BASE_LINE:
+        pos.set( imageBox.center().x(), imageBox.yMax() ); break;
+    case osgText::Text::CENTER_CENTER:
+    default:
+        pos.set( imageBox.center().x(), imageBox.center().y() ); break;
+    }
+
+    // then align the text block to that point, like osgText does.
+    switch( align )
+    {
+    case osgText::Text::LEFT_TOP:
+    case osgText::Text::LEFT_CENTER:
+    case osgText::Text::LEFT_BOTTOM:
+    case osgText::Text::LEFT_BOTTOM_BASE_LINE:
+    case osgText::Text::LEFT_BASE_LINE:
+        pos.x() -= textBox.xMin(); break;
+    case osgText::Text::RIGHT_TOP:
+    case osgText::Text::RIGHT_CENTER:
+    case osgText::Text::RIGHT_BOTTOM:
+    case osgText::Text::RIGHT_BOTTOM_BASE_LINE:
+    case osgText::Text::RIGHT_BASE_LINE:
+        pos.x() -= textBox.xMax(); break;
+    default:
+        pos.x() -= textBox.center().x(); break;
+    }
+
+    switch( align )
+    {
+    case osgText::Text::LEFT_TOP:
+    case osgText::Text::RIGHT_TOP:
+    case osgText::Text::CENTER_TOP:
+        pos.y() -= textBox.yMax(); break;
+    case osgText::Text::LEFT_BOTTOM:
+    case osgText::Text::RIGHT_BOTTOM:
+    case osgText::Text::CENTER_BOTTOM:
+        pos.y() -= textBox.yMin(); break;
+    case osgText::Text::LEFT_BOTTOM_BASE_LINE:
+    case osgText::Text::RIGHT_BOTTOM_BASE_LINE:
+    case osgText::Text::CENTER_BOTTOM_BASE_LINE:
+        pos.y() -= cursor.y(); break;
+    case osgText::Text::LEFT_BASE_LINE:
+    case osgText::Text::RIGHT_BASE_LINE:
+    case osgText::Text::CENTER_BASE_LINE:
+        break;
+    default:
+        pos.y() -= textBox.center().y(); break;
+    }
+
+    // the halo is the glyphs drawn at four diagonal offsets, beneath all the fills.
+    if ( halo )
+    {
+        const osg::Vec2f diagonals[4] = {
+            osg::Vec2f( haloOffset,  haloOffset), osg::Vec2f(-haloOffset,  haloOffset),
+            osg::Vec2f(-haloOffset, -haloOffset), osg::Vec2f( haloOffset, -haloOffset) };
+
+        for(unsigned d = 0; d < 4; ++d)
+        {
+            for(unsigned g = 0; g < glyphs.size(); ++g)
+            {
+                addQuad(
+                    place, getPage(glyphs[g]->getTexture(), true),
+                    pos + corners[2*g] + diagonals[d], pos + corners[2*g+1] + diagonals[d],
+                    glyphs[g]->getMinTexCoord(), glyphs[g]->getMaxTexCoord(),
+                    haloColor, 0.0, shift );
+            }
+        }
+    }
+
+    for(unsigned g = 0; g < glyphs.size(); ++g)
+    {
+        addQuad(
+            place, getPage(glyphs[g]->getTexture(), true),
+            pos + corners[2*g], pos + corners[2*g+1],
+            glyphs[g]->getMinTexCoord(), glyphs[g]->getMaxTexCoord(),
+            fill, 0.0, shift );
+    }
+}
+
+bool
+PlaceBatchNode::getAtlasRegion(osg::Image* image, IconAtlas::Region& region)
+{
+    if ( !_iconAtlas.valid() )
+        return false;
+
+    std::map<osg::Image*, IconAtlas::Region>::iterator i = _atlasRegions.find( image );
+    if ( i != _atlasRegions.end() )
+    {
+        region = i->second;
+        return true;
+    }
+
+    // carry over the icons of the previous build without a new reference.
+    i = _staleAtlasRegions.find( image );
+    if ( i != _staleAtlasRegions.end() )
+    {
+        region = i->second;
+        _staleAtlasRegions.erase( i );
+    }
+    else if ( !_iconAtlas->acquire(image, region) )
+    {
+        return false;
+    }
+
+    _atlasRegions[image] = region;
+    return true;
+}
+
+void
+PlaceBatchNode::releaseAtlasRegions(std::map<osg::Image*, IconAtlas::Region>& regions)
+{
+    if ( _iconAtlas.valid() )
+    {
+        for(std::map<osg::Image*, IconAtlas::Region>::iterator i = regions.begin(); i != regions.end(); ++i)
+        {
+            _iconAtlas->release( i->first );
+        }
+    }
+    regions.clear();
+}
+
+unsigned
+PlaceBatchNode::getPage(osg::Texture* texture, bool glyphs)
+{
+    std::map<osg::Texture*, unsigned>::iterator i = _pageIndex.find( texture );
+    if ( i != _pageIndex.end() )
+        return i->second;
+
+    unsigned index = (unsigned)_pages.size();
+    _pageIndex[texture] = index;
+
+    _pages.push_back( Page() );
+    Page& page = _pages.back();
+    page._verts     = new osg::Vec3Array();
+    page._offsets   = new osg::Vec2Array();
+    page._texCoords = new osg::Vec2Array();
+    page._colors    = new osg::Vec4Array();
+
+    page._stateSet = new osg::StateSet();
+    page._stateSet->setTextureAttribute( 0, texture );
+    page._stateSet->addUniform( new osg::Uniform("oe_placebatch_glyphs", glyphs) );
+    page._stateSet->setRenderBinDetails( glyphs ? TEXT_BIN : ICON_BIN, "RenderBin" );
+
+    return index;
+}
+
+void
+PlaceBatchNode::addQuad(Place&            place,
+                        unsigned          pageIndex,
+                        const osg::Vec2f& lowerLeft,
+                        const osg::Vec2f& upperRight,
+                        const osg::Vec2f& tcLowerLeft,
+                        const osg::Vec2f& tcUpperRight,
+                        const osg::Vec4f& color,
+                        double            rotation,
+                        const osg::Vec2f& shift)
+{
+    Page& page = _pages[pageIndex];
+
+    unsigned quad = page._verts->size() / 4;
+
+    osg::Vec3f corners[4] = {
+        osg::Vec3f( lowerLeft.x(),  lowerLeft.y(),  0 ),
+        osg::Vec3f( upperRight.x(), lowerLeft.y(),  0 ),
+        osg::Vec3f( upperRight.x(), upperRight.y(), 0 ),
+        osg::Vec3f( lowerLeft.x(),  upperRight.y(), 0 ) };
+
+    osg::Vec2f texCoords[4] = {
+        osg::Vec2f( tcLowerLeft.x(),  tcLowerLeft.y()  ),
+        osg::Vec2f( tcUpperRight.x(), tcLowerLeft.y()  ),
+        osg::Vec2f( tcUpperRight.x(), tcUpperRight.y() ),
+        osg::Vec2f( tcLowerLeft.x(),  tcUpperRight.y() ) };
+
+    // same as AnnotationUtils::createImageGeometry.
+    if ( rotation != 0.0 )
+    {
+        osg::Matrixd rot;
+        rot.makeRotate( rotation, 0.0, 0.0, 1.0 );
+        for(unsigned i = 0; i < 4; ++i)
+            corners[i] = rot * corners[i];
+    }
+
+    osg::Vec3f anchor = place._world - _origin;
+    osg::Vec4f tinted = osg::componentMultiply( color, place._color );
+
+    for(unsigned i = 0; i < 4; ++i)
+    {
+        osg::Vec2f offset( corners[i].x() + shift.x(), corners[i].y() + shift.y() );
+
+        page._verts->push_back( anchor );
+        page._offsets->push_back( offset * place._scale );
+        page._texCoords->push_back( texCoords[i] );
+        page._colors->push_back( tinted );
+        page._baseOffsets.push_back( offset );
+        page._baseColors.push_back( color );
+
+        place._box.expandBy( offset.x(), offset.y(), 0.0f );
+    }
+
+    _localBox.expandBy( anchor );
+
+    if ( !place._spans.empty() &&
+         place._spans.back()._page == pageIndex &&
+         place._spans.back()._first + place._spans.back()._count == quad )
+    {
+        ++place._spans.back()._count;
+    }
+    else
+    {
+        Span span;
+        span._page  = pageIndex;
+        span._first = quad;
+        span._count = 1;
+        place._spans.push_back( span );
+    }
+}
+
+void
+PlaceBatchNode::updateQuads(const Place& place)
+{
+    osg::Vec3f anchor = place._world - _origin;
+
+    for(std::vector<Span>::const_iterator span = place._spans.begin(); span != place._spans.end(); ++span)
+    {
+        Page& page = _pages[span->_page];
+
+        unsigned first = span->_first * 4;
+        unsigned last  = first + span->_count * 4;
+        for(unsigned v = first; v < last; ++v)
+        {
+            (*page._verts)[v]   = anchor;
+            (*page._offsets)[v] = page._baseOffsets[v] * place._scale;
+            (*page._colors)[v]  = osg::componentMultiply( page._baseColors[v], place._color );
+        }
+
+        page._verts->dirty();
+        page._offsets->dirty();
+        page._colors->dirty();
+    }
+
+    if ( !place._spans.empty() && !_localBox.contains(anchor) )
+    {
+        _localBox.expandBy( anchor );
+        ++_boundRevision;
+        dirtyBound();
+    }
+}
+
+osg::Image*
+PlaceBatchNode::getIconImage(const Place& place, const IconSymbol* icon)
+{
+    if ( !icon )
+        return 0L;
+
+    if ( icon->url().isSet() )
+    {
+        URI uri = icon->url()->evalURI();
+
+        // remember failures too, so a bad URL is only tried once.
+        std::map<std::string, osg::ref_ptr<osg::Image> >::iterator i = _iconImages.find( uri.full() );
+        if ( i != _iconImages.end() )
+            return i->second.get();
+
+        osg::ref_ptr<osg::Image> image = uri.getImage( _dbOptions.get() );
+        if ( !image.valid() )
+        {
+            OE_WARN << LC << "Failed to load icon " << uri.full() << std::endl;
+        }
+        _iconImages[uri.full()] = image.get();
+        return image.get();
+    }
+
+    return icon->getImage();
+}
+
+osgText::Font*
+PlaceBatchNode::getFont(const TextSymbol* symbol)
+{
+    std::string name = symbol && symbol->font().isSet() ? *symbol->font() : "";
+
+    std::map<std::string, osg::ref_ptr<osgText::Font> >::iterator i = _fonts.find( name );
+    if ( i != _fonts.end() )
+        return i->second.get();
+
+    osg::ref_ptr<osgText::Font> font;
+    if ( !name.empty() )
+        font = osgText::readRefFontFile( name );
+    if ( !font.valid() )
+        font = Registry::instance()->getDefaultFont();
+
+    if ( font.valid() )
+    {
+        // mitigates mipmapping issues that cause rendering artifacts for some fonts/placement
+        font->setGlyphImageMargin( 2 );
+    }
+
+    _fonts[name] = font.get();
+    return font.get();
+}
+
+void
+PlaceBatchNode::traverse(osg::NodeVisitor& nv)
+{
+    if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
+    {
+        if ( _dirty )
+        {
+            build();
+        }
+    }
+
+    else if ( nv.getVisitorType() == nv.CULL_VISITOR )
+    {
+        osgUtil::CullVisitor* cv = Culling::asCullVisitor( nv );
+        if ( cv && !_pages.empty() )
+        {
+            cull( cv );
+        }
+    }
+}
+
+osg::BoundingSphere
+PlaceBatchNode::computeBound() const
+{
+    osg::BoundingSphere bs;
+    if ( _localBox.valid() )
+    {
+        bs.center() = _origin + osg::Vec3d(_localBox.center());
+        bs.radius() = _localBox.radius();
+    }
+    return bs;
+}
+
+void
+PlaceBatchNode::cull(osgUtil::CullVisitor* cv)
+{
+    const osg::Viewport* viewport = cv->getViewport();
+    if ( !viewport || viewport->width() <= 0 || viewport->height() <= 0 )
+        return;
+
+    CameraData& data = _cameraData.get( cv->getCurrentCamera() );
+
+    // after a rebuild, make this camera's copies of the page geometries.
+    // they share the arrays but each has its own index list.
+    if ( data._revision != _revision )
+    {
+        data._geode = new osg::Geode();
+        data._geode->setCullingActive( false );
+        data._elements.clear();
+
+        for(std::vector<Page>::iterator page = _pages.begin(); page != _pages.end(); ++page)
+        {
+            osg::Geometry* geom = new osg::Geometry();
+            geom->setUseVertexBufferObjects( true );
+            geom->setUseDisplayList( false );
+            geom->setDataVariance( osg::Object::DYNAMIC );
+#if OSG_VERSION_GREATER_OR_EQUAL(3,3,2)
+            // cull() already tested each place; the bound holds only the anchors.
+            geom->setCullingActive( false );
+#endif
+
+            geom->setVertexArray( page->_verts.get() );
+            geom->setVertexAttribArray( OFFSET_ATTRIB, page->_offsets.get() );
+            geom->setVertexAttribBinding( OFFSET_ATTRIB, osg::Geometry::BIND_PER_VERTEX );
+            geom->setVertexAttribNormalize( OFFSET_ATTRIB, false );
+            geom->setTexCoordArray( 0, page->_texCoords.get() );
+            geom->setColorArray( page->_colors.get() );
+            geom->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
+            geom->setStateSet( page->_stateSet.get() );
+
+            osg::DrawElementsUInt* elements = new osg::DrawElementsUInt( GL_TRIANGLES );
+            elements->setDataVariance( osg::Object::DYNAMIC );
+            geom->addPrimitiveSet( elements );
+
+            data._elements.push_back( elements );
+            data._geode->addDrawable( geom );
+        }
+
+        if ( !data._stateSet.valid() )
+        {
+            data._stateSet = new osg::StateSet();
+            data._stateSet->setDataVariance( osg::Object::DYNAMIC );
+            data._viewport = new osg::Uniform( osg::Uniform::FLOAT_VEC2, "oe_placebatch_viewport" );
+            data._viewport->setDataVariance( osg::Object::DYNAMIC );
+            data._stateSet->addUniform( data._viewport.get() );
+        }
+
+        data._revision = _revision;
+        data._boundRevision = _boundRevision;
+    }
+    else if ( data._boundRevision != _boundRevision )
+    {
+        // anchors moved outside the old bounds, which feed the near/far computation.
+        for(unsigned i = 0; i < data._geode->getNumDrawables(); ++i)
+            data._geode->getDrawable(i)->dirtyBound();
+        data._boundRevision = _boundRevision;
+    }
+
+    data._viewport->set( osg::Vec2f(viewport->width(), viewport->height()) );
+
+    osg::ref_ptr<osg::RefMatrix> modelView = new osg::RefMatrix( osg::Matrixd::translate(_origin) * (*cv->getModelViewMatrix()) );
+    osg::Matrixd mvp = (*modelView) * (*cv->getProjectionMatrix());
+
+    // horizon culling on a round earth.
+    Horizon* horizon = 0L;
+    osg::ref_ptr<MapNode> mapNode;
+    if ( _mapNode.lock(mapNode) && mapNode->isGeocentric() )
+    {
+        if ( !data._horizon.valid() )
+            data._horizon = new Horizon( mapNode->getMapSRS() );
+        data._horizon->setEye( osg::Matrixd::inverse(*cv->getModelViewMatrix()).getTrans() );
+        horizon = data._horizon.get();
+    }
+
+    // project the anchor points and keep the places that are in view.
+    data._candidates.clear();
+    data._depths.clear();
+    data._boxes.clear();
+    data._priorities.clear();
+
+    for(unsigned i = 0; i < _places.size(); ++i)
+    {
+        const Place& place = _places[i];
+        if ( !place._active || !place._visible || place._spans.empty() )
+            continue;
+
+        osg::Vec4d clip = osg::Vec4d(place._world - _origin, 1.0) * mvp;
+        if ( clip.w() <= 0.0 )
+            continue;
+
+        double z = clip.z() / clip.w();
+        if ( z < -1.0 || z > 1.0 )
+            continue;
+
+        float x = viewport->x() + (clip.x()/clip.w() + 1.0) * 0.5 * viewport->width();
+        float y = viewport->y() + (clip.y()/clip.w() + 1.0) * 0.5 * viewport->height();
+
+        osg::BoundingBox box(
+            x + place._box.xMin()*place._scale, y + place._box.yMin()*place._scale, 0.0f,
+            x + place._box.xMax()*place._scale, y + place._box.yMax()*place._scale, 0.0f );
+
+        if ( box.xMax() < viewport->x() || box.xMin() > viewport->x() + viewport->width() ||
+             box.yMax() < viewport->y() || box.yMin() > viewport->y() + viewport->height() )
+            continue;
+
+        if ( horizon && !horizon->isVisible(place._world) )
+            continue;
+
+        data._candidates.push_back( i );
+        data._depths.push_back( (float)z );
+        data._boxes.push_back( box );
+        data._priorities.push_back( place._priority );
+    }
+
+    // candidate indices, in drawing priority order.
+    std::vector<unsigned> order( data._candidates.size() );
+    for(unsigned k = 0; k < order.size(); ++k)
+        order[k] = k;
+
+    data._accepted.clear();
+
+    if ( _declutter && ScreenSpaceLayout::isDeclutteringEnabled() )
+    {
+        const ScreenSpaceLayoutOptions& options = ScreenSpaceLayout::getOptions();
+        std::sort( order.begin(), order.end(), SortCandidates(data._depths, data._priorities, options.sortByPriority() == true) );
+
+        // a coarse screen grid holds the accepted boxes, so each candidate
+        // only tests its neighbors instead of everything accepted so far.
+        int cols = (int)ceilf( viewport->width() / GRID_CELL_SIZE );
+        int rows = (int)ceilf( viewport->height() / GRID_CELL_SIZE );
+        data._grid.resize( cols*rows );
+        for(unsigned c = 0; c < data._grid.size(); ++c)
+            data._grid[c].clear();
+
+        unsigned limit = options.maxObjects().get();
+
+        for(unsigned k = 0; k < order.size() && data._accepted.size() < limit; ++k)
+        {
+            unsigned candidate = order[k];
+            const osg::BoundingBox& box = data._boxes[candidate];
+
+            int c0 = osg::clampBetween( (int)floorf((box.xMin() - viewport->x()) / GRID_CELL_SIZE), 0, cols-1 );
+            int c1 = osg::clampBetween( (int)floorf((box.xMax() - viewport->x()) / GRID_CELL_SIZE), 0, cols-1 );
+            int r0 = osg::clampBetween( (int)floorf((box.yMin() - viewport->y()) / GRID_CELL_SIZE), 0, rows-1 );
+            int r1 = osg::clampBetween( (int)floorf((box.yMax() - viewport->y()) / GRID_CELL_SIZE), 0, rows-1 );
+
+            // FLT_MAX priority means never occlude.
+            bool visible = true;
+            if ( data._priorities[candidate] != FLT_MAX )
+            {
+                for(int r = r0; r <= r1 && visible; ++r)
+                {
+                    for(int c = c0; c <= c1 && visible; ++c)
+                    {
+                        const std::vector<unsigned>& cell = data._grid[r*cols + c];
+                        for(unsigned n = 0; n < cell.size() && visible; ++n)
+                        {
+                            if ( overlaps(box, data._boxes[cell[n]]) )
+                                visible = false;
+                        }
+                    }
+                }
+            }
+
+            if ( visible )
+            {
+                data._accepted.push_back( candidate );
+                for(int r = r0; r <= r1; ++r)
+                    for(int c = c0; c <= c1; ++c)
+                        data._grid[r*cols + c].push_back( candidate );
+            }
+        }
+    }
+    else
+    {
+        data._accepted.swap( order );
+    }
+
+    // rebuild the index lists. the depth test is off, so draw the
+    // farthest (or least important) places first.
+    for(unsigned e = 0; e < data._elements.size(); ++e)
+        data._elements[e]->clear();
+
+    for(std::vector<unsigned>::reverse_iterator k = data._accepted.rbegin(); k != data._accepted.rend(); ++k)
+    {
+        const Place& place = _places[ data._candidates[*k] ];
+
+        for(std::vector<Span>::const_iterator span = place._spans.begin(); span != place._spans.end(); ++span)
+        {
+            osg::DrawElementsUInt* elements = data._elements[span->_page].get();
+            for(unsigned q = span->_first; q < span->_first + span->_count; ++q)
+            {
+                unsigned v = q*4;
+                elements->push_back( v   );
+                elements->push_back( v+1 );
+                elements->push_back( v+2 );
+                elements->push_back( v   );
+                elements->push_back( v+2 );
+                elements->push_back( v+3 );
+            }
+        }
+    }
+
+    for(unsigned e = 0; e < data._elements.size(); ++e)
+        data._elements[e]->dirty();
+
+    cv->pushStateSet( data._stateSet.get() );
+    cv->pushModelViewMatrix( modelView.get(), osg::Transform::RELATIVE_RF );
+    data._geode->accept( *cv );
+    cv->popModelViewMatrix();
+    cv->popStateSet();
+}
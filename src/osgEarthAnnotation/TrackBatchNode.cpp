@@ -0,0 +1,686 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarthAnnotation/TrackBatchNode>
+#include <osgEarth/VirtualProgram>
+#include <osgEarth/CullingUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/Capabilities>
+#include <osgEarthSymbology/Color>
+#include <osg/Depth>
+#include <osg/BlendFunc>
+#include <osg/Texture2D>
+#include <osg/GLExtensions>
+#include <osg/Version>
+#include <osg/buffered_value>
+#include <osgUtil/CullVisitor>
+#include <float.h>
+
+#if !OSG_MIN_VERSION_REQUIRED(3,3,3)
+#include <osg/GL2Extensions>
+#endif
+
+#define LC "[TrackBatchNode] "
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+using namespace osgEarth::Symbology;
+
+// per-instance vertex attributes
+#define INSTANCE_ATTRIB       osg::Drawable::ATTRIBUTE_6
+#define INSTANCE_ATTRIB_NAME  "oe_trackbatch_instance"
+#define COLOR_ATTRIB          osg::Drawable::ATTRIBUTE_7
+#define COLOR_ATTRIB_NAME     "oe_trackbatch_color"
+
+// tracks draw after the terrain, like other screen-space icons.
+#define TRACK_BIN 12
+
+// number of instances uploaded together when some of them changed
+#define BLOCK_SIZE 64
+
+namespace
+{
+    const char* trackBatchVS =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "attribute vec4 " INSTANCE_ATTRIB_NAME ";\n"
+        "attribute vec4 " COLOR_ATTRIB_NAME ";\n"
+        "uniform vec2 oe_trackbatch_viewport;\n"
+        "varying vec2 oe_trackbatch_texCoord;\n"
+        "varying vec4 oe_trackbatch_tint;\n"
+
+        "void oe_trackbatch_vertex(inout vec4 vertex_clip)\n"
+        "{\n"
+        "    // the quad vertex is the pixel offset of the corner; rotate it\n"
+        "    // by the heading, clockwise, like AnnotationUtils::createImageGeometry.\n"
+        "    float c = cos(" INSTANCE_ATTRIB_NAME ".w);\n"
+        "    float s = sin(" INSTANCE_ATTRIB_NAME ".w);\n"
+        "    vec2 offset = vec2(gl_Vertex.x*c + gl_Vertex.y*s, gl_Vertex.y*c - gl_Vertex.x*s);\n"
+        "    vertex_clip = gl_ModelViewProjectionMatrix * vec4(" INSTANCE_ATTRIB_NAME ".xyz, 1.0);\n"
+        "    vertex_clip.xy += offset * 2.0 * vertex_clip.w / oe_trackbatch_viewport;\n"
+        "    oe_trackbatch_texCoord = gl_MultiTexCoord0.st;\n"
+        "    oe_trackbatch_tint = " COLOR_ATTRIB_NAME ";\n"
+        "}\n";
+
+    const char* trackBatchFS =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform sampler2D oe_trackbatch_tex;\n"
+        "varying vec2 oe_trackbatch_texCoord;\n"
+        "varying vec4 oe_trackbatch_tint;\n"
+
+        "void oe_trackbatch_fragment(inout vec4 color)\n"
+        "{\n"
+        "    color *= oe_trackbatch_tint * texture2D(oe_trackbatch_tex, oe_trackbatch_texCoord);\n"
+        "}\n";
+}
+
+//------------------------------------------------------------------------
+
+/**
+ * One quad drawn once per track. The instance array holds the position
+ * (relative to the origin of the batch) and heading of each track.
+ */
+class TrackBatchNode::Page : public osg::Geometry
+{
+public:
+    Page(osg::Image* icon) :
+      _revision ( 0 ),
+      _changed  ( false ),
+      _instanced( Registry::capabilities().supportsDrawInstanced() )
+    {
+        setUseVertexBufferObjects( true );
+        setUseDisplayList( false );
+
+        // the update traversal writes the arrays, so don't let it run
+        // ahead of the draw.
+        setDataVariance( osg::Object::DYNAMIC );
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3,3,2)
+        // the bound holds the anchor points only (see TrackBatchNode).
+        setCullingActive( false );
+#endif
+
+        float s = icon->s();
+        float t = icon->t();
+
+        // a strip of the icon corners, centered on the track.
+        osg::Vec3Array* verts = new osg::Vec3Array(4);
+        (*verts)[0].set( -s/2.0f, -t/2.0f, 0.0f );
+        (*verts)[1].set(  s/2.0f, -t/2.0f, 0.0f );
+        (*verts)[2].set( -s/2.0f,  t/2.0f, 0.0f );
+        (*verts)[3].set(  s/2.0f,  t/2.0f, 0.0f );
+        setVertexArray( verts );
+
+        osg::Vec2Array* texCoords = new osg::Vec2Array(4);
+        (*texCoords)[0].set( 0, 0 );
+        (*texCoords)[1].set( 1, 0 );
+        (*texCoords)[2].set( 0, 1 );
+        (*texCoords)[3].set( 1, 1 );
+        setTexCoordArray( 0, texCoords );
+
+        _instances = new osg::Vec4Array();
+        setVertexAttribArray( INSTANCE_ATTRIB, _instances.get() );
+        setVertexAttribBinding( INSTANCE_ATTRIB, osg::Geometry::BIND_PER_VERTEX );
+        setVertexAttribNormalize( INSTANCE_ATTRIB, false );
+
+        _colors = new osg::Vec4Array();
+        setVertexAttribArray( COLOR_ATTRIB, _colors.get() );
+        setVertexAttribBinding( COLOR_ATTRIB, osg::Geometry::BIND_PER_VERTEX );
+        setVertexAttribNormalize( COLOR_ATTRIB, false );
+
+        _drawArrays = new osg::DrawArrays( GL_TRIANGLE_STRIP, 0, 4, 0 );
+        addPrimitiveSet( _drawArrays.get() );
+
+        osg::Texture2D* texture = new osg::Texture2D( icon );
+        texture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR );
+        texture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+        texture->setResizeNonPowerOfTwoHint( false );
+
+        osg::StateSet* stateSet = getOrCreateStateSet();
+        stateSet->setTextureAttribute( 0, texture );
+        stateSet->setRenderBinDetails( TRACK_BIN, "RenderBin" );
+    }
+
+    /** Appends an instance and returns its slot. */
+    unsigned add(unsigned id, const osg::Vec4f& instance, const osg::Vec4f& color)
+    {
+        _instances->push_back( instance );
+        _colors->push_back( color );
+        _ids.push_back( id );
+        _box.expandBy( osg::Vec3f(instance.x(), instance.y(), instance.z()) );
+        resized();
+        return (unsigned)_ids.size() - 1;
+    }
+
+    /**
+     * Removes an instance by moving the last one into its slot, so the
+     * arrays stay contiguous. Returns the ID of the moved track, or
+     * INVALID if the removed slot was the last.
+     */
+    unsigned remove(unsigned slot)
+    {
+        unsigned last = (unsigned)_ids.size() - 1;
+        unsigned moved = INVALID;
+        if ( slot != last )
+        {
+            (*_instances)[slot] = (*_instances)[last];
+            (*_colors)[slot]    = (*_colors)[last];
+            _ids[slot]          = _ids[last];
+            moved = _ids[slot];
+        }
+        _instances->pop_back();
+        _colors->pop_back();
+        _ids.pop_back();
+        resized();
+        return moved;
+    }
+
+    /** Writes the position and heading of an instance. Returns true if it left the bounds. */
+    bool set(unsigned slot, const osg::Vec4f& instance)
+    {
+        (*_instances)[slot] = instance;
+
+        unsigned block = slot / BLOCK_SIZE;
+        if ( _blockRevisions[block] != _revision + 1 )
+        {
+            _blockRevisions[block] = _revision + 1;
+            _changed = true;
+        }
+
+        osg::Vec3f point( instance.x(), instance.y(), instance.z() );
+        if ( !_box.contains(point) )
+        {
+            _box.expandBy( point );
+            dirtyBound();
+            return true;
+        }
+        return false;
+    }
+
+    /** Call after a series of set() calls. */
+    void commit()
+    {
+        if ( _changed )
+        {
+            ++_revision;
+            _changed = false;
+        }
+    }
+
+    void setColor(unsigned slot, const osg::Vec4f& color)
+    {
+        (*_colors)[slot] = color;
+        _colors->dirty();
+    }
+
+    const osg::Vec4f& getInstance(unsigned slot) const
+    {
+        return (*_instances)[slot];
+    }
+
+public: // osg::Drawable
+
+    osg::BoundingBox computeBoundingBox() const
+    {
+        return _box;
+    }
+
+    void drawImplementation(osg::RenderInfo& renderInfo) const
+    {
+        // without instanced arrays every track would draw at the first position.
+        if ( _ids.empty() || !_instanced )
+            return;
+
+        osg::State& state = *renderInfo.getState();
+        unsigned contextID = state.getContextID();
+
+#if OSG_MIN_VERSION_REQUIRED(3,3,3)
+        osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+        osg::GLExtensions* bufferExt = ext;
+#else
+        const osg::GL2Extensions* ext = osg::GL2Extensions::Get( contextID, true );
+        osg::GLBufferObject::Extensions* bufferExt = osg::GLBufferObject::getExtensions( contextID, true );
+#endif
+
+        osg::VertexBufferObject* vbo = _instances->getVertexBufferObject();
+        if ( vbo )
+        {
+            osg::GLBufferObject* bo = vbo->getOrCreateGLBufferObject( contextID );
+
+            // compiles the buffer if anything in it was dirtied, which only
+            // uploads the arrays that changed size or were dirtied.
+            state.bindVertexBufferObject( bo );
+            if ( bo->isDirty() )
+                bo->compileBuffer();
+
+            if ( _uploadedModifiedCount[contextID] != _instances->getModifiedCount() )
+            {
+                // the whole array went up with the buffer.
+                _uploadedModifiedCount[contextID] = _instances->getModifiedCount();
+            }
+            else if ( _uploadedRevision[contextID] != _revision )
+            {
+                // upload the runs of blocks that changed since this context last drew.
+                unsigned last = _uploadedRevision[contextID];
+                unsigned numBlocks = (unsigned)_blockRevisions.size();
+                unsigned offset = bo->getOffset( _instances->getBufferIndex() );
+                const char* data = static_cast<const char*>( _instances->getDataPointer() );
+                unsigned stride = sizeof(osg::Vec4f);
+
+                for(unsigned b = 0; b < numBlocks; )
+                {
+                    if ( _blockRevisions[b] > last )
+                    {
+                        unsigned first = b;
+                        while( b < numBlocks && _blockRevisions[b] > last )
+                            ++b;
+
+                        unsigned begin = first * BLOCK_SIZE;
+                        unsigned end   = osg::minimum( b * BLOCK_SIZE, (unsigned)_ids.size() );
+                        bufferExt->glBufferSubData(
+                            GL_ARRAY_BUFFER_ARB,
+                            offset + begin*stride,
+                            (end - begin)*stride,
+                            data + begin*stride );
+                    }
+                    else
+                    {
+                        ++b;
+                    }
+                }
+            }
+
+            _uploadedRevision[contextID] = _revision;
+        }
+
+        ext->glVertexAttribDivisor( INSTANCE_ATTRIB, 1 );
+        ext->glVertexAttribDivisor( COLOR_ATTRIB, 1 );
+
+        osg::Geometry::drawImplementation( renderInfo );
+
+        // attribute divisors are not part of the OSG state, so restore them.
+        ext->glVertexAttribDivisor( INSTANCE_ATTRIB, 0 );
+        ext->glVertexAttribDivisor( COLOR_ATTRIB, 0 );
+    }
+
+private:
+
+    osg::ref_ptr<osg::Vec4Array>   _instances;  // xyz = position, w = heading in radians
+    osg::ref_ptr<osg::Vec4Array>   _colors;
+    osg::ref_ptr<osg::DrawArrays>  _drawArrays;
+    std::vector<unsigned>          _ids;        // track ID of each slot
+    osg::BoundingBox               _box;
+
+    // revision of the last update that touched each block of instances
+    std::vector<unsigned>          _blockRevisions;
+    unsigned                       _revision;
+    bool                           _changed;
+    bool                           _instanced;
+
+    mutable osg::buffered_value<unsigned> _uploadedRevision;
+    mutable osg::buffered_value<unsigned> _uploadedModifiedCount;
+
+    void resized()
+    {
+        // a change of size uploads the whole arrays.
+        _instances->dirty();
+        _colors->dirty();
+        _drawArrays->setNumInstances( _ids.size() );
+        _drawArrays->dirty();
+        _blockRevisions.resize( (_ids.size() + BLOCK_SIZE - 1) / BLOCK_SIZE, _revision );
+        dirtyBound();
+    }
+};
+
+//------------------------------------------------------------------------
+
+TrackBatchNode::TrackBatchNode()
+{
+    //nop
+}
+
+TrackBatchNode::TrackBatchNode(const TrackBatchNode& rhs, const osg::CopyOp& op)
+{
+    //nop
+}
+
+TrackBatchNode::~TrackBatchNode()
+{
+    //nop
+}
+
+TrackBatchNode::TrackBatchNode(MapNode* mapNode) :
+_numTracks ( 0 ),
+_haveOrigin( false )
+{
+    // positions become world coordinates as soon as they arrive.
+    const SpatialReference* mapSRS = mapNode ? mapNode->getMapSRS() : SpatialReference::get("wgs84");
+    _worldSRS = mapNode && !mapNode->isGeocentric() ? mapSRS : mapSRS->getECEF();
+
+    // the bounds hold the anchor points but not the icons around them,
+    // so a batch of close tracks would be small-feature culled.
+    setCullingActive( false );
+
+    _geode = new osg::Geode();
+    _geode->setCullingActive( false );
+    _transform = new osg::MatrixTransform();
+    _transform->setCullingActive( false );
+    _transform->addChild( _geode.get() );
+
+    // applies the queued updates.
+    ADJUST_UPDATE_TRAV_COUNT( this, 1 );
+
+    if ( !Registry::capabilities().supportsDrawInstanced() )
+    {
+        OE_WARN << LC << "Instanced drawing is not supported; tracks will not be drawn" << std::endl;
+    }
+
+    osg::StateSet* stateSet = getOrCreateStateSet();
+
+    VirtualProgram* vp = VirtualProgram::getOrCreate( stateSet );
+    vp->setName( "TrackBatchNode" );
+    vp->setFunction( "oe_trackbatch_vertex", trackBatchVS, ShaderComp::LOCATION_VERTEX_CLIP );
+    vp->setFunction( "oe_trackbatch_fragment", trackBatchFS, ShaderComp::LOCATION_FRAGMENT_COLORING );
+    vp->addBindAttribLocation( INSTANCE_ATTRIB_NAME, INSTANCE_ATTRIB );
+    vp->addBindAttribLocation( COLOR_ATTRIB_NAME, COLOR_ATTRIB );
+
+    stateSet->addUniform( new osg::Uniform("oe_trackbatch_tex", 0) );
+
+    // same as TrackNode: draw over the terrain, and don't hide each other.
+    stateSet->setAttributeAndModes( new osg::Depth(osg::Depth::ALWAYS, 0, 1, false), 1 );
+    stateSet->setAttributeAndModes( new osg::BlendFunc(), 1 );
+    stateSet->setMode( GL_CULL_FACE, osg::StateAttribute::OFF );
+    stateSet->setMode( GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED );
+}
+
+void
+TrackBatchNode::toWorld(const GeoPoint& position, osg::Vec3d& world) const
+{
+    // like TrackNode, no terrain clamping; the feed owns the altitude.
+    if ( !position.isValid() || !position.getSRS()->transform(position.vec3d(), _worldSRS.get(), world) )
+    {
+        world.set( 0, 0, 0 );
+    }
+}
+
+unsigned
+TrackBatchNode::getPage(osg::Image* icon)
+{
+    std::map<osg::Image*, unsigned>::iterator i = _pageIndex.find( icon );
+    if ( i != _pageIndex.end() )
+        return i->second;
+
+    unsigned index = (unsigned)_pages.size();
+    _pages.push_back( new Page(icon) );
+    _pageIndex[icon] = index;
+    _geode->addDrawable( _pages.back().get() );
+    return index;
+}
+
+unsigned
+TrackBatchNode::addTrack(const GeoPoint& position,
+                         osg::Image*     icon,
+                         float           heading)
+{
+    if ( !icon )
+    {
+        OE_WARN << LC << "Illegal: a track needs an icon" << std::endl;
+        return INVALID;
+    }
+
+    osg::Vec3d world;
+    toWorld( position, world );
+
+    // instances are stored relative to the first track to keep the
+    // precision of the float array.
+    if ( !_haveOrigin )
+    {
+        _origin = world;
+        _transform->setMatrix( osg::Matrixd::translate(_origin) );
+        _haveOrigin = true;
+    }
+
+    unsigned id;
+    if ( !_freeList.empty() )
+    {
+        id = _freeList.back();
+        _freeList.pop_back();
+    }
+    else
+    {
+        id = (unsigned)_tracks.size();
+        _tracks.push_back( Track() );
+    }
+
+    osg::Vec3f local = world - _origin;
+
+    Track& track = _tracks[id];
+    track._active = true;
+    track._page   = getPage( icon );
+    track._slot   = _pages[track._page]->add(
+        id,
+        osg::Vec4f(local, osg::DegreesToRadians(heading)),
+        Color::White );
+
+    ++_numTracks;
+    dirtyBound();
+    return id;
+}
+
+bool
+TrackBatchNode::removeTrack(unsigned id)
+{
+    if ( id >= _tracks.size() || !_tracks[id]._active )
+        return false;
+
+    Track& track = _tracks[id];
+
+    unsigned moved = _pages[track._page]->remove( track._slot );
+    if ( moved != INVALID )
+    {
+        _tracks[moved]._slot = track._slot;
+    }
+
+    track._active = false;
+    --_numTracks;
+
+    // the ID is reused by the next new track, which must not pick up
+    // updates queued for this one.
+    {
+        Threading::ScopedMutexLock lock( _updatesMutex );
+        unsigned kept = 0;
+        for(unsigned i = 0; i < _updates.size(); ++i)
+        {
+            if ( _updates[i]._id != id )
+                _updates[kept++] = _updates[i];
+        }
+        _updates.resize( kept );
+    }
+
+    _freeList.push_back( id );
+    return true;
+}
+
+void
+TrackBatchNode::setPosition(unsigned id, const GeoPoint& position, float heading)
+{
+    if ( id >= _tracks.size() || !_tracks[id]._active )
+        return;
+
+    osg::Vec3d world;
+    toWorld( position, world );
+
+    const Track& track = _tracks[id];
+    Page* page = _pages[track._page].get();
+
+    osg::Vec3f local = world - _origin;
+    if ( page->set(track._slot, osg::Vec4f(local, osg::DegreesToRadians(heading))) )
+        dirtyBound();
+    page->commit();
+}
+
+void
+TrackBatchNode::setColor(unsigned id, const osg::Vec4f& color)
+{
+    if ( id >= _tracks.size() || !_tracks[id]._active )
+        return;
+
+    const Track& track = _tracks[id];
+    _pages[track._page]->setColor( track._slot, color );
+}
+
+void
+TrackBatchNode::updateTracks(const unsigned*         ids,
+                             const double*           x,
+                             const double*           y,
+                             const double*           z,
+                             const float*            headings,
+                             unsigned                count,
+                             const SpatialReference* srs)
+{
+    if ( count == 0 || !srs )
+        return;
+
+    // convert in the calling thread, so the update traversal only copies.
+    std::vector<double> wx( x, x + count );
+    std::vector<double> wy( y, y + count );
+    std::vector<double> wz( count, 0.0 );
+    if ( z )
+        wz.assign( z, z + count );
+
+    if ( !srs->transform(&wx[0], &wy[0], &wz[0], count, _worldSRS.get()) )
+    {
+        OE_WARN << LC << "Failed to transform " << count << " track updates from " << srs->getName() << std::endl;
+        return;
+    }
+
+    Threading::ScopedMutexLock lock( _updatesMutex );
+
+    _updates.reserve( _updates.size() + count );
+    for(unsigned i = 0; i < count; ++i)
+    {
+        Update update;
+        update._id = ids[i];
+        update._world.set( wx[i], wy[i], wz[i] );
+        update._heading = headings ? osg::DegreesToRadians(headings[i]) : FLT_MAX;
+        _updates.push_back( update );
+    }
+}
+
+void
+TrackBatchNode::applyUpdates()
+{
+    {
+        Threading::ScopedMutexLock lock( _updatesMutex );
+        if ( _updates.empty() )
+            return;
+        _applying.swap( _updates );
+    }
+
+    bool outside = false;
+
+    for(std::vector<Update>::const_iterator u = _applying.begin(); u != _applying.end(); ++u)
+    {
+        if ( u->_id >= _tracks.size() || !_tracks[u->_id]._active )
+            continue;
+
+        const Track& track = _tracks[u->_id];
+        Page* page = _pages[track._page].get();
+
+        osg::Vec3f local = u->_world - _origin;
+        float heading = u->_heading != FLT_MAX ? u->_heading : page->getInstance(track._slot).w();
+
+        if ( page->set(track._slot, osg::Vec4f(local, heading)) )
+            outside = true;
+    }
+
+    for(unsigned p = 0; p < _pages.size(); ++p)
+    {
+        _pages[p]->commit();
+    }
+
+    if ( outside )
+    {
+        dirtyBound();
+    }
+
+    _applying.clear();
+}
+
+void
+TrackBatchNode::traverse(osg::NodeVisitor& nv)
+{
+    if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
+    {
+        applyUpdates();
+    }
+
+    else if ( nv.getVisitorType() == nv.CULL_VISITOR )
+    {
+        osgUtil::CullVisitor* cv = Culling::asCullVisitor( nv );
+        const osg::Viewport* viewport = cv ? cv->getViewport() : 0L;
+        if ( !viewport || _numTracks == 0 )
+            return;
+
+        CameraData& data = _cameraData.get( cv->getCurrentCamera() );
+        if ( !data._stateSet.valid() )
+        {
+            data._stateSet = new osg::StateSet();
+            data._stateSet->setDataVariance( osg::Object::DYNAMIC );
+            data._viewport = new osg::Uniform( osg::Uniform::FLOAT_VEC2, "oe_trackbatch_viewport" );
+            data._viewport->setDataVariance( osg::Object::DYNAMIC );
+            data._stateSet->addUniform( data._viewport.get() );
+        }
+        data._viewport->set( osg::Vec2f(viewport->width(), viewport->height()) );
+
+        cv->pushStateSet( data._stateSet.get() );
+        _transform->accept( nv );
+        cv->popStateSet();
+    }
+
+    else
+    {
+        _transform->accept( nv );
+    }
+}
+
+osg::BoundingSphere
+TrackBatchNode::computeBound() const
+{
+    _transform->dirtyBound();
+    return _transform->getBound();
+}
+
+void
+TrackBatchNode::resizeGLObjectBuffers(unsigned maxSize)
+{
+    osg::Node::resizeGLObjectBuffers( maxSize );
+    _transform->resizeGLObjectBuffers( maxSize );
+}
+
+void
+TrackBatchNode::releaseGLObjects(osg::State* state) const
+{
+    osg::Node::releaseGLObjects( state );
+    _transform->releaseGLObjects( state );
+}
@@ -28,6 +28,7 @@
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <fstream>
+#include <sstream>
 #include <sys/stat.h>
 
 using namespace osgEarth;
@@ -116,14 +117,11 @@ namespace
 
         bool binValidForWriting(bool silent =false);
 
-        const osgDB::Options* mergeOptions(const osgDB::Options* in);
-
         bool                              _ok;
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
         std::string                       _binPath;        // full path to the bin's root folder
         osg::ref_ptr<osgDB::ReaderWriter> _rw;
-        osg::ref_ptr<osgDB::Options>      _zlibOptions;
         mutable Threading::Mutex          _mutex;
     };
 
@@ -300,31 +298,11 @@ namespace
 
 #ifdef OSG_COMPRESS
 #ifdef OSGEARTH_HAVE_ZLIB
-        _zlibOptions = Registry::instance()->cloneOrCreateOptions();
-        _zlibOptions->setPluginStringData("Compressor", "zlib");
+        setCompressor("zlib");
 #endif        
 #endif
     }
 
-    const osgDB::Options*
-    FileSystemCacheBin::mergeOptions(const osgDB::Options* dbo)
-    {
-        if (!dbo)
-        {
-            return _zlibOptions.get();
-        }
-        else if (!_zlibOptions.valid())
-        {
-            return dbo;
-        }
-        else
-        {
-            osgDB::Options* merged = Registry::cloneOrCreateOptions(dbo);
-            merged->setPluginStringData("Compressor", "zlib");
-            return merged;
-        }
-    }
-
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
@@ -340,13 +318,22 @@ namespace
 
         osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);     
 
-        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+        osg::ref_ptr<const osgDB::Options> dbo = getSerializerOptions(readOptions);
 
         osgDB::ReaderWriter::ReadResult r;
         {
             ScopedMutexLock lock(_mutex);
 
-            r = _rw->readImage( path, dbo.get() );
+            // images may be stored with the bin's image codec; if not, the
+            // osgb serializer reads from the same stream.
+            std::ifstream input( path.c_str(), std::ios_base::in | std::ios_base::binary );
+            r = readImageWithCodec( input, readOptions );
+
+            if ( r.status() == r.FILE_NOT_HANDLED )
+                r = _rw->readImage( input, dbo.get() );
+
+            input.close();
+
             if ( !r.success() )
                 return ReadResult();
 
@@ -377,13 +364,20 @@ namespace
 
         osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);
 
-        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+        osg::ref_ptr<const osgDB::Options> dbo = getSerializerOptions(readOptions);
 
         osgDB::ReaderWriter::ReadResult r;
         {
             ScopedMutexLock lock(_mutex);
 
-            r = _rw->readObject( path, dbo.get() );
+            std::ifstream input( path.c_str(), std::ios_base::in | std::ios_base::binary );
+            r = readImageWithCodec( input, readOptions );
+
+            if ( r.status() == r.FILE_NOT_HANDLED )
+                r = _rw->readObject( input, dbo.get() );
+
+            input.close();
+
             if ( !r.success() )
                 return ReadResult();
 
@@ -436,13 +430,26 @@ namespace
             if ( !osgDB::fileExists( osgDB::getFilePath(fileURI.full()) ) )
                 osgEarth::makeDirectoryForFile( fileURI.full() );
 
-            osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
+            osg::ref_ptr<const osgDB::Options> dbo = getSerializerOptions(writeOptions);
 
             if ( dynamic_cast<const osg::Image*>(object) )
             {
+                const osg::Image* image = static_cast<const osg::Image*>(object);
                 std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
-                objWriteOK = r.success();
+
+                // try the bin's image codec first:
+                std::stringstream buf;
+                if ( writeImageWithCodec(image, buf) )
+                {
+                    std::ofstream output( filename.c_str(), std::ios_base::out | std::ios_base::binary );
+                    output << buf.rdbuf();
+                    objWriteOK = output.good();
+                }
+                else
+                {
+                    r = _rw->writeImage( *image, filename, dbo.get() );
+                    objWriteOK = r.success();
+                }
             }
             else if ( dynamic_cast<const osg::Node*>(object) )
             {
@@ -576,7 +583,7 @@ namespace
         ScopedMutexLock lock(_mutex);
 
         Config conf;
-        conf.fromJSON( URI(_metaPath).getString(_zlibOptions.get()) );
+        conf.fromJSON( URI(_metaPath).getString(getSerializerOptions(0L).get()) );
 
         return conf;
     }
@@ -284,7 +284,9 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
 
     // finally, decode the OSGB stream into an object.
     std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+    osgDB::ReaderWriter::ReadResult r = readImageWithCodec(datastream, reader._op);
+    if ( r.status() == r.FILE_NOT_HANDLED )
+        r = reader.read(datastream);
     if ( !r.success() )
     {
         OE_WARN << LC << "Cache read failure!"
@@ -344,15 +346,23 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     std::string       data;
     std::stringstream datastream;
 
+    osg::ref_ptr<const osgDB::Options> dbo = getSerializerOptions(writeOptions);
+
     if ( dynamic_cast<const osg::Image*>(object) )
     {
-        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
+        // try the bin's image codec first:
+        const osg::Image* image = static_cast<const osg::Image*>(object);
+        objWriteOK = writeImageWithCodec(image, datastream);
+        if ( !objWriteOK )
         {
-            OE_WARN << LC << "Internal: tried to write image to " << _rw->className() << "\n";
-            return false;
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write image to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeImage( *image, datastream, dbo.get() );
+            objWriteOK = r.success();
         }
-        r = _rw->writeImage( *static_cast<const osg::Image*>(object), datastream, writeOptions );
-        objWriteOK = r.success();
     }
     else if ( dynamic_cast<const osg::Node*>(object) )
     {
@@ -361,7 +371,7 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
             OE_WARN << LC << "Internal: tried to write node to " << _rw->className() << "\n";
             return false;
         }
-        r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, writeOptions );
+        r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, dbo.get() );
         objWriteOK = r.success();
     }
     else
@@ -371,7 +381,7 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
             OE_WARN << LC << "Internal: tried to write an object to " << _rw->className() << "\n";
             return false;
         }
-        r = _rw->writeObject( *object, datastream, writeOptions );
+        r = _rw->writeObject( *object, datastream, dbo.get() );
         objWriteOK = r.success();
     }
 
@@ -21,6 +21,7 @@
 #include <osgEarth/MapNode>
 #include <osgEarth/Registry>
 #include <osgEarth/XmlUtils>
+#include <osgEarth/ConfigReader>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
@@ -228,12 +229,10 @@ class ReaderWriterEarth : public osgDB::ReaderWriter
             // from an "anonymous" stream here)
             URIContext uriContext( readOptions ); 
 
-            osg::ref_ptr<XmlDocument> doc = XmlDocument::load( in, uriContext );
-            if ( !doc.valid() )
+            Config docConf;
+            if ( !ConfigReader::readXML(in, docConf, uriContext) )
                 return ReadResult::ERROR_IN_READING_FILE;
 
-            Config docConf = doc->getConfig();
-
             // support both "map" and "earth" tag names at the top level
             Config conf;
             if ( docConf.hasChild( "map" ) )
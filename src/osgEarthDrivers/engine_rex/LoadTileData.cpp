@@ -65,7 +65,10 @@ namespace
 
 LoadTileData::LoadTileData(TileNode* tilenode, EngineContext* context) :
 _tilenode(tilenode),
-_context(context)
+_context(context),
+_dirtyRevision(0u),
+_numTextures(0u),
+_bytes(0u)
 {
     //nop
 }
@@ -77,6 +80,12 @@ namespace
         const optional<bool>& unRefPolicy = Registry::instance()->unRefImageDataAfterApply();
         tex->setUnRefImageDataAfterApply( unRefPolicy.get() );
     }
+
+    unsigned long long getImageBytes(const osg::Texture* tex)
+    {
+        const osg::Image* image = tex->getImage(0);
+        return image ? image->getTotalSizeInBytes() : 0u;
+    }
 }
 
 
@@ -89,10 +98,18 @@ LoadTileData::invoke()
     {
         osg::ref_ptr<ProgressCallback> progress; // = new ProgressCallback();
 
+        // If only some of the tile's image layers are dirty, load just those
+        // and leave the rest of its data in place.
+        _dirtyRevision = tilenode->getDirtyLayers( _filter.layers() );
+        _emptyLayers = _filter.layers();
+        _numTextures = 0u;
+        _bytes = 0u;
+
         // Assemble all the components necessary to display this tile
         _model = _context->getEngine()->createTileModel(
             _context->getMapFrame(),
             tilenode->getTileKey(),
+            _filter,
             progress ); // progress
 
         // Prep the stateset for merging (and for GL pre-compile).
@@ -132,7 +149,10 @@ LoadTileData::invoke()
                         TerrainTileImageLayerModel* layerModel = i->get();
                         if ( layerModel && layerModel->getTexture() )
                         {
+                            _numTextures++;
+                            _bytes += getImageBytes( layerModel->getTexture() );
                             applyDefaultUnRefPolicy( layerModel->getTexture() );
+                            _emptyLayers.erase( layerModel->getImageLayer()->getUID() );
                             mptex->setLayer( layerModel->getImageLayer(), layerModel->getTexture(), layerModel->getOrder() );
                         }
                     }
@@ -152,6 +172,8 @@ LoadTileData::invoke()
                 const SamplerBinding* binding = SamplerBinding::findUsage(bindings, SamplerBinding::ELEVATION);
                 if ( binding )
                 {                
+                    _numTextures++;
+                    _bytes += getImageBytes( _model->elevationModel()->getTexture() );
                     applyDefaultUnRefPolicy( _model->elevationModel()->getTexture() );
 
                     stateSet->setTextureAttribute(
@@ -172,6 +194,9 @@ LoadTileData::invoke()
                 const SamplerBinding* binding = SamplerBinding::findUsage(bindings, SamplerBinding::NORMAL);
                 if ( binding )
                 {
+                    _numTextures++;
+                    _bytes += getImageBytes( _model->normalModel()->getTexture() );
+
                     //TODO: if we subload the normal texture later on, we will need to change unref to false.
                     applyDefaultUnRefPolicy( _model->normalModel()->getTexture() );
 
@@ -196,9 +221,18 @@ LoadTileData::invoke()
                 TerrainTileImageLayerModel* layerModel = i->get();
                 if ( layerModel->getTexture() )
                 {
+                    _emptyLayers.erase( layerModel->getImageLayer()->getUID() );
+
                     const SamplerBinding* binding = SamplerBinding::findUID(bindings, layerModel->getImageLayer()->getUID());
                     if ( binding )
                     {
+                        // visible shared layers were already counted as color layers.
+                        if ( !layerModel->getImageLayer()->getVisible() )
+                        {
+                            _numTextures++;
+                            _bytes += getImageBytes( layerModel->getTexture() );
+                        }
+
                         applyDefaultUnRefPolicy( layerModel->getTexture() );
 
                         stateSet->setTextureAttribute(
@@ -242,6 +276,13 @@ LoadTileData::apply(const osg::FrameStamp* stamp)
                 getStateSet()->removeTextureAttribute( color->unit(), mptex.get() );
             }
 
+            // Layers that were reloaded but came back with no data must not
+            // keep showing their old textures.
+            for(std::set<UID>::const_iterator i = _emptyLayers.begin(); i != _emptyLayers.end(); ++i)
+            {
+                tilenode->removeLayer( *i, bindings );
+            }
+
             // Merge our prepped stateset into the live one.
             tilenode->mergeStateSet( getStateSet(), mptex.get(), bindings);
 
@@ -249,8 +290,12 @@ LoadTileData::apply(const osg::FrameStamp* stamp)
             UpdateInheritance update( _context, getChangeSet() );
             tilenode->accept( update );
 
-            // Mark as complete. TODO: per-data requests will do something different.
-            tilenode->setDirty( false );
+            // Mark the loaded layers as complete; anything invalidated during
+            // the load keeps the tile dirty so it loads again.
+            tilenode->clearDirty( _filter.layers(), _dirtyRevision );
+
+            // Count the data we just replaced, in case this was part of a refresh.
+            _context->liveTiles()->notifyTileReloaded( tilenode->getTileKey(), _numTextures, _bytes );
 
             // Notify listeners that we've added a tile.
             _context->getEngine()->getTerrain()->notifyTileAdded( _key, tilenode );
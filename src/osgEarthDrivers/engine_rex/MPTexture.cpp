@@ -59,6 +59,19 @@ MPTexture::setLayer(const ImageLayer* layer, osg::Texture* tex, int order)
     pass._ownsTexture = true;
 }
 
+void
+MPTexture::removeLayer(UID layerUID)
+{
+    for(Passes::iterator pass = _passes.begin(); pass != _passes.end(); ++pass)
+    {
+        if ( pass->_layer.valid() && pass->_layer->getUID() == layerUID )
+        {
+            _passes.erase( pass );
+            return;
+        }
+    }
+}
+
 void
 MPTexture::merge(MPTexture* rhs)
 {
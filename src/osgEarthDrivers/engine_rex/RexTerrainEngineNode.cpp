@@ -336,6 +336,47 @@ RexTerrainEngineNode::invalidateRegion(const GeoExtent& extent,
     }
 }
 
+void
+RexTerrainEngineNode::invalidateImageLayers(const std::vector<const ImageLayer*>& layers,
+                                            const GeoExtent&                      extent,
+                                            unsigned                              minLevel,
+                                            unsigned                              maxLevel)
+{
+    if ( _liveTiles.valid() )
+    {
+        GeoExtent extentLocal = extent;
+
+        if ( !extent.getSRS()->isEquivalentTo(this->getMap()->getSRS()) )
+        {
+            extent.transform(this->getMap()->getSRS(), extentLocal);
+        }
+
+        std::set<UID> uids;
+        for(std::vector<const ImageLayer*>::const_iterator i = layers.begin(); i != layers.end(); ++i)
+        {
+            if ( *i )
+                uids.insert( (*i)->getUID() );
+        }
+
+        // an empty set would reload everything; there's nothing to do.
+        if ( !uids.empty() )
+        {
+            _liveTiles->setDirty(extentLocal, minLevel, maxLevel, uids);
+        }
+    }
+}
+
+bool
+RexTerrainEngineNode::getRefreshStats(RefreshStats& out_stats) const
+{
+    if ( _liveTiles.valid() )
+    {
+        _liveTiles->getRefreshStats( out_stats );
+        return true;
+    }
+    return false;
+}
+
 void
 RexTerrainEngineNode::refresh(bool forceDirty)
 {
@@ -64,6 +64,7 @@ namespace
 
 TileNode::TileNode() : 
 _dirty        ( false ),
+_dirtyRevision( 0u ),
 _childrenReady( false ),
 _minExpiryTime( 0.0 ),
 _minExpiryFrames( 0 ),
@@ -262,7 +263,80 @@ TileNode::isReadyToTraverse() const
 void
 TileNode::setDirty(bool value)
 {
+    Threading::ScopedMutexLock lock(_mutex);
     _dirty = value;
+    _dirtyLayers.clear();
+    ++_dirtyRevision;
+}
+
+void
+TileNode::setDirty(const std::set<UID>& layers)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    ++_dirtyRevision;
+    if ( !_dirty )
+    {
+        _dirty = true;
+        _dirtyLayers.clear();
+        for(std::set<UID>::const_iterator i = layers.begin(); i != layers.end(); ++i)
+            _dirtyLayers[*i] = _dirtyRevision;
+    }
+    else if ( !_dirtyLayers.empty() )
+    {
+        for(std::set<UID>::const_iterator i = layers.begin(); i != layers.end(); ++i)
+            _dirtyLayers[*i] = _dirtyRevision;
+    }
+}
+
+unsigned
+TileNode::getDirtyLayers(std::set<UID>& out_layers)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    out_layers.clear();
+    for(std::map<UID,unsigned>::const_iterator i = _dirtyLayers.begin(); i != _dirtyLayers.end(); ++i)
+        out_layers.insert( i->first );
+    return _dirtyRevision;
+}
+
+void
+TileNode::clearDirty(const std::set<UID>& loadedLayers, unsigned revision)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    // nothing was invalidated while the data was loading:
+    if ( revision == _dirtyRevision )
+    {
+        _dirty = false;
+        _dirtyLayers.clear();
+    }
+
+    // A partial load finished while other layers still need data. A full
+    // load, or a tile that became wholly dirty during the load, stays dirty
+    // and reloads everything.
+    else if ( !loadedLayers.empty() && !_dirtyLayers.empty() )
+    {
+        for(std::set<UID>::const_iterator i = loadedLayers.begin(); i != loadedLayers.end(); ++i)
+        {
+            std::map<UID,unsigned>::iterator d = _dirtyLayers.find( *i );
+            if ( d != _dirtyLayers.end() && d->second <= revision )
+                _dirtyLayers.erase( d );
+        }
+        _dirty = !_dirtyLayers.empty();
+    }
+}
+
+void
+TileNode::removeLayer(UID layerUID, const RenderBindings& bindings)
+{
+    _mptex->removeLayer( layerUID );
+
+    // shared layers also have their own sampler:
+    const SamplerBinding* binding = SamplerBinding::findUID( bindings, layerUID );
+    if ( binding && getStateSet() )
+    {
+        getStateSet()->removeTextureAttribute( binding->unit(), osg::StateAttribute::TEXTURE );
+        getStateSet()->removeUniform( binding->matrixName() );
+    }
 }
 
 void
@@ -81,6 +81,30 @@ TileNodeRegistry::setDirty(const GeoExtent& extent,
                            unsigned         maxLevel)
 {
     Threading::ScopedWriteLock exclusive( _tilesMutex );
+    setDirtySafely( extent, minLevel, maxLevel, 0L );
+}
+
+void
+TileNodeRegistry::setDirty(const GeoExtent&     extent,
+                           unsigned             minLevel,
+                           unsigned             maxLevel,
+                           const std::set<UID>& layers)
+{
+    Threading::ScopedWriteLock exclusive( _tilesMutex );
+    setDirtySafely( extent, minLevel, maxLevel, layers.empty() ? 0L : &layers );
+}
+
+void
+TileNodeRegistry::setDirtySafely(const GeoExtent&     extent,
+                                 unsigned             minLevel,
+                                 unsigned             maxLevel,
+                                 const std::set<UID>* layers)
+{
+    Threading::ScopedMutexLock lock( _refreshMutex );
+
+    // start a new set of refresh counters.
+    _refreshPending.clear();
+    _refreshStats = TerrainEngineNode::RefreshStats();
     
     bool checkSRS = false;
     for( TileNodeMap::iterator i = _tiles.begin(); i != _tiles.end(); ++i )
@@ -90,9 +114,39 @@ TileNodeRegistry::setDirty(const GeoExtent& extent,
             maxLevel >= key.getLOD() &&
             extent.intersects(i->first.getExtent(), checkSRS) )
         {
-            i->second.tile->setDirty( true );
+            if ( layers )
+                i->second.tile->setDirty( *layers );
+            else
+                i->second.tile->setDirty( true );
+
+            _refreshPending.insert( key );
         }
     }
+
+    _refreshStats.tilesInvalidated = _refreshPending.size();
+}
+
+void
+TileNodeRegistry::notifyTileReloaded(const TileKey&     key,
+                                     unsigned           numTextures,
+                                     unsigned long long bytes)
+{
+    Threading::ScopedMutexLock lock( _refreshMutex );
+
+    if ( _refreshPending.erase(key) > 0 )
+    {
+        _refreshStats.tilesReloaded++;
+        _refreshStats.texturesReloaded += numTextures;
+        _refreshStats.bytesFetched += bytes;
+    }
+}
+
+void
+TileNodeRegistry::getRefreshStats(TerrainEngineNode::RefreshStats& out_stats) const
+{
+    Threading::ScopedMutexLock lock( _refreshMutex );
+    out_stats = _refreshStats;
+    out_stats.tilesPending = _refreshPending.size();
 }
 
 void
@@ -131,6 +185,12 @@ TileNodeRegistry::removeSafely(const TileKey& key)
 {
     _tiles.erase( key );
 
+    // a tile that leaves before reloading is no longer part of the refresh.
+    {
+        Threading::ScopedMutexLock lock( _refreshMutex );
+        _refreshPending.erase( key );
+    }
+
     for(TileKeyOneToMany::iterator i = _notifiers.begin(); i != _notifiers.end(); )
     {
         i->second.erase( key );
@@ -182,6 +242,9 @@ TileNodeRegistry::clear()
 {
     Threading::ScopedWriteLock exclusive( _tilesMutex );
     _tiles.clear();
+
+    Threading::ScopedMutexLock lock( _refreshMutex );
+    _refreshPending.clear();
 }
 
 void
@@ -212,6 +275,9 @@ TileNodeRegistry::moveAll(TileNodeRegistry* destination)
     }
 
     _tiles.clear();
+
+    Threading::ScopedMutexLock lock( _refreshMutex );
+    _refreshPending.clear();
 }
     
 
@@ -149,9 +149,7 @@ public:
             // the pointer returned from _blob gets freed internally by sqlite, supposedly
             const char* data = (const char*)sqlite3_column_blob( select, 0 );
             int dataLen = sqlite3_column_bytes( select, 0 );
-            std::string dataBuffer( data, dataLen );
-            std::stringstream in(dataBuffer);
-            MVT::read(in, key, features);
+            MVT::read(data, dataLen, key, MVT::ReadOptions(), features);
         }
         else
         {
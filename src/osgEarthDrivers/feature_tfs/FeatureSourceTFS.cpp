@@ -164,8 +164,7 @@ public:
     {            
         if (mimeType == "application/x-protobuf" || mimeType == "binary/octet-stream")
         {
-            std::stringstream in(buffer);
-            return MVT::read(in, key, features);
+            return MVT::read(buffer.data(), buffer.size(), key, MVT::ReadOptions(), features);
         }
         else
         {            
@@ -35,6 +35,8 @@
 #include <osgDB/ImageOptions>
 
 #include <sstream>
+#include <list>
+#include <map>
 #include <stdlib.h>
 #include <memory.h>
 
@@ -623,6 +625,235 @@ GDALDatasetH GDALAutoCreateWarpedVRTforPolarStereographic(
 }
 
 
+/**
+ * Pool of dataset handles that all read the same source, so that several
+ * threads can read from it at once without sharing any GDAL objects. Each
+ * handle is a separately opened source dataset plus, if the source needs
+ * reprojection, its own warped VRT. Handles are opened on demand, so the
+ * pool grows to the number of threads reading at the same time.
+ *
+ * GDAL's driver registration is not thread-safe, but it happens once under
+ * the global GDAL lock (in the Registry) before any dataset gets opened; the
+ * pool itself never takes that lock.
+ */
+class GDALDatasetPool : public osg::Referenced
+{
+public:
+    struct Handle
+    {
+        GDALDataset* srcDS;
+        GDALDataset* warpedDS;
+    };
+
+    /**
+     * @param name    Name passed to GDALOpen (a file, a subdataset name,
+     *                or the XML of a VRT)
+     * @param warp    Whether to create a warped VRT over each source dataset
+     * @param polar   Whether to use the polar stereographic warp
+     * @param srcWKT  Source SRS of the warp
+     * @param destWKT Destination SRS of the warp
+     */
+    GDALDatasetPool(const std::string& name,
+                    bool               warp,
+                    bool               polar,
+                    const std::string& srcWKT,
+                    const std::string& destWKT) :
+        _name   ( name ),
+        _warp   ( warp ),
+        _polar  ( polar ),
+        _srcWKT ( srcWKT ),
+        _destWKT( destWKT )
+    {
+        //nop
+    }
+
+    /** Takes a free handle, opening a new one if necessary. NULL on failure. */
+    Handle* acquire()
+    {
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            if ( !_free.empty() )
+            {
+                Handle* handle = _free.back();
+                _free.pop_back();
+                return handle;
+            }
+        }
+
+        // open outside the pool lock so other threads can keep going.
+        Handle* handle = open();
+        if ( handle )
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _all.push_back( handle );
+        }
+        return handle;
+    }
+
+    /** Returns a handle taken with acquire(). */
+    void release(Handle* handle)
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        _free.push_back( handle );
+    }
+
+    /** Number of handles opened so far */
+    unsigned size() const
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        return _all.size();
+    }
+
+protected:
+
+    virtual ~GDALDatasetPool()
+    {
+        for(std::vector<Handle*>::iterator i = _all.begin(); i != _all.end(); ++i)
+        {
+            Handle* handle = *i;
+            if ( handle->warpedDS != handle->srcDS )
+                GDALClose( handle->warpedDS );
+            GDALClose( handle->srcDS );
+            delete handle;
+        }
+    }
+
+    Handle* open()
+    {
+        GDALDataset* srcDS = (GDALDataset*)GDALOpen( _name.c_str(), GA_ReadOnly );
+        if ( !srcDS )
+        {
+            OE_WARN << LC << "Failed to open a pooled dataset handle" << std::endl;
+            return 0L;
+        }
+
+        GDALDataset* warpedDS = srcDS;
+        if ( _warp )
+        {
+            if ( _polar )
+            {
+                warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                    srcDS, _srcWKT.c_str(), _destWKT.c_str(), GRA_NearestNeighbour, 5.0, NULL);
+            }
+            else
+            {
+                warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
+                    srcDS, _srcWKT.c_str(), _destWKT.c_str(), GRA_NearestNeighbour, 5.0, 0);
+            }
+
+            if ( !warpedDS )
+            {
+                OE_WARN << LC << "Failed to create a warping VRT for a pooled dataset handle" << std::endl;
+                GDALClose( srcDS );
+                return 0L;
+            }
+        }
+
+        Handle* handle = new Handle();
+        handle->srcDS    = srcDS;
+        handle->warpedDS = warpedDS;
+        return handle;
+    }
+
+    std::string           _name;
+    bool                  _warp;
+    bool                  _polar;
+    std::string           _srcWKT;
+    std::string           _destWKT;
+    std::vector<Handle*>  _all;
+    std::vector<Handle*>  _free;
+    mutable Threading::Mutex _mutex;
+};
+
+
+/**
+ * Byte-bounded, least-recently-used cache of decoded raster blocks, shared
+ * by all the dataset handles of one tile source. A block is keyed by band
+ * number, overview level (0 = full resolution) and block column and row,
+ * and holds the block's pixels in the band's native data type.
+ */
+class GDALBlockCache : public osg::Referenced
+{
+public:
+    struct Key
+    {
+        Key(int band, int level, int x, int y) : _band(band), _level(level), _x(x), _y(y) { }
+
+        bool operator < (const Key& rhs) const
+        {
+            if ( _band  != rhs._band  ) return _band  < rhs._band;
+            if ( _level != rhs._level ) return _level < rhs._level;
+            if ( _y     != rhs._y     ) return _y     < rhs._y;
+            return _x < rhs._x;
+        }
+
+        int _band, _level, _x, _y;
+    };
+
+    struct Block : public osg::Referenced
+    {
+        std::vector<unsigned char> _data;
+    };
+
+    GDALBlockCache(unsigned long long maxBytes) :
+        _maxBytes( maxBytes ),
+        _bytes   ( 0 )
+    {
+        //nop
+    }
+
+    /** Gets a cached block; returns false if it's not in the cache */
+    bool get(const Key& key, osg::ref_ptr<Block>& output)
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        BlockMap::iterator i = _blocks.find( key );
+        if ( i == _blocks.end() )
+            return false;
+
+        // move to the front of the LRU list:
+        _lru.splice( _lru.begin(), _lru, i->second._lru );
+        output = i->second._block.get();
+        return true;
+    }
+
+    /** Adds a block, evicting the least recently used ones to stay under the size limit. */
+    void insert(const Key& key, Block* block)
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        if ( _blocks.find( key ) != _blocks.end() )
+            return;
+
+        _lru.push_front( key );
+        Entry& entry = _blocks[key];
+        entry._block = block;
+        entry._lru = _lru.begin();
+        _bytes += block->_data.size();
+
+        while( _bytes > _maxBytes && _lru.size() > 1 )
+        {
+            BlockMap::iterator oldest = _blocks.find( _lru.back() );
+            _bytes -= oldest->second._block->_data.size();
+            _blocks.erase( oldest );
+            _lru.pop_back();
+        }
+    }
+
+protected:
+    struct Entry
+    {
+        osg::ref_ptr<Block>      _block;
+        std::list<Key>::iterator _lru;
+    };
+    typedef std::map<Key, Entry> BlockMap;
+
+    unsigned long long _maxBytes;
+    unsigned long long _bytes;
+    BlockMap           _blocks;
+    std::list<Key>     _lru;
+    Threading::Mutex   _mutex;
+};
+
+
 class GDALTileSource : public TileSource
 {
 public:
@@ -639,6 +870,10 @@ public:
     {
         GDAL_SCOPED_LOCK;
 
+        // Close any pooled handles first; their warped VRTs are independent
+        // of _srcDS and _warpedDS.
+        _pool = 0L;
+
         // Close the _warpedDS dataset if :
         // - it exists
         // - and is different from _srcDS
@@ -716,6 +951,9 @@ public:
 
         //URI uri = _options.url().value();
 
+        // name under which the source dataset can be opened again, if any.
+        std::string srcName;
+
         if (useExternalDataset == false)
         {
             std::vector<std::string> files;
@@ -828,12 +1066,20 @@ public:
                         return Status::Error( "Failed to build VRT from input datasets" );
                     }
                 }
+
+                // The combined VRT can be reopened from its XML.
+                char** vrtXML = _srcDS->GetMetadata( "xml:VRT" );
+                if ( vrtXML && vrtXML[0] )
+                {
+                    srcName = vrtXML[0];
+                }
             }
             else
             {
                 //If we couldn't build a VRT, just try opening the file directly
                 //Open the dataset
                 _srcDS = (GDALDataset*)GDALOpen( files[0].c_str(), GA_ReadOnly );
+                srcName = files[0];
 
                 if (_srcDS)
                 {
@@ -851,6 +1097,7 @@ public:
                         char *pszSubdatasetName = CPLStrdup( CSLFetchNameValue( subDatasets, buf.str().c_str() ) );
                         GDALClose( _srcDS );
                         _srcDS = (GDALDataset*)GDALOpen( pszSubdatasetName, GA_ReadOnly ) ;
+                        srcName = pszSubdatasetName;
                         CPLFree( pszSubdatasetName );
                     }
                 }
@@ -978,10 +1225,20 @@ public:
 
         std::string warpedSRSWKT;
 
+        bool        warp = false;
+        bool        polarWarp = false;
+        std::string warpSrcWKT, warpDestWKT;
+
         if ( requiresReprojection || (profile && !profile->getSRS()->isEquivalentTo( src_srs.get() )) )
         {
+            warp = true;
+            warpSrcWKT = src_srs->getWKT();
+
             if ( profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
             {
+                polarWarp = true;
+                warpDestWKT = profile->getSRS()->getWKT();
+
                 _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
                     _srcDS,
                     src_srs->getWKT().c_str(),
@@ -993,6 +1250,7 @@ public:
             else
             {
                 std::string destWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
+                warpDestWKT = destWKT;
                 _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
                     _srcDS,
                     src_srs->getWKT().c_str(),
@@ -1018,6 +1276,26 @@ public:
             return Status::Error( "Failed to create a warping VRT" );
         }
 
+        if ( _options.blockCacheSizeMB().isSet() && _options.blockCacheSizeMB().get() > 0u )
+        {
+            _blockCache = new GDALBlockCache( (unsigned long long)_options.blockCacheSizeMB().get() * 1024ull * 1024ull );
+            OE_INFO << LC << "Using overview-aware block reads with a "
+                << _options.blockCacheSizeMB().get() << " MB block cache" << std::endl;
+        }
+
+        if ( _options.datasetPerThread() == true )
+        {
+            if ( srcName.empty() )
+            {
+                OE_INFO << LC << "Cannot reopen this dataset, so reads will not use per-thread datasets" << std::endl;
+            }
+            else
+            {
+                _pool = new GDALDatasetPool( srcName, warp, polarWarp, warpSrcWKT, warpDestWKT );
+                OE_INFO << LC << "Using per-thread datasets" << std::endl;
+            }
+        }
+
         //Get the _geotransform
         if ( getProfile() )
         {
@@ -1148,8 +1426,6 @@ public:
     */
     static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetColorInterpretation() == colorInterp) return ds->GetRasterBand(i);
@@ -1159,8 +1435,6 @@ public:
 
     static GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetRasterDataType() == dataType) return ds->GetRasterBand(i);
@@ -1266,6 +1540,110 @@ public:
 
     }
 
+    /**
+     * Reads a window of a band into a buffer, resampling with nearest
+     * neighbor, like GDALRasterBand::RasterIO. With a block cache, the pixels
+     * come from the overview level that best matches the resampling ratio,
+     * fetched a whole internal block at a time through the cache; otherwise
+     * this is a plain RasterIO.
+     */
+    CPLErr readRaster(GDALRasterBand* band,
+                      int xOff, int yOff, int xSize, int ySize,
+                      void* buffer, int bufXSize, int bufYSize,
+                      GDALDataType bufType, int lineSpace =0)
+    {
+        if ( !_blockCache.valid() || xSize <= 0 || ySize <= 0 || bufXSize <= 0 || bufYSize <= 0 )
+        {
+            return band->RasterIO(GF_Read, xOff, yOff, xSize, ySize, buffer, bufXSize, bufYSize, bufType, 0, lineSpace);
+        }
+
+        // Pick the smallest overview that still has at least as many pixels
+        // as the buffer in each direction.
+        GDALRasterBand* source = band;
+        int level = 0;
+        double ratio = osg::minimum( (double)xSize/(double)bufXSize, (double)ySize/(double)bufYSize );
+        for(int i = 0; i < band->GetOverviewCount(); ++i)
+        {
+            GDALRasterBand* overview = band->GetOverview(i);
+            if ( !overview || overview->GetXSize() <= 0 )
+                continue;
+
+            double factor = (double)band->GetXSize() / (double)overview->GetXSize();
+            if ( factor <= ratio * 1.01 && overview->GetXSize() < source->GetXSize() )
+            {
+                source = overview;
+                level = i + 1;
+            }
+        }
+
+        double sx = (double)source->GetXSize() / (double)band->GetXSize();
+        double sy = (double)source->GetYSize() / (double)band->GetYSize();
+        double x0 = (double)xOff * sx, dx = (double)xSize * sx / (double)bufXSize;
+        double y0 = (double)yOff * sy, dy = (double)ySize * sy / (double)bufYSize;
+
+        int blockXSize, blockYSize;
+        source->GetBlockSize( &blockXSize, &blockYSize );
+
+        GDALDataType srcType     = source->GetRasterDataType();
+        int          srcTypeSize = GDALGetDataTypeSize(srcType) / 8;
+        int          bufTypeSize = GDALGetDataTypeSize(bufType) / 8;
+        if ( lineSpace == 0 )
+            lineSpace = bufXSize * bufTypeSize;
+
+        // source column of each buffer column.
+        std::vector<int> cols( bufXSize );
+        for(int i = 0; i < bufXSize; ++i)
+        {
+            cols[i] = osg::clampBetween( (int)floor(x0 + ((double)i + 0.5) * dx), 0, source->GetXSize()-1 );
+        }
+
+        std::vector<unsigned char> row( bufXSize * srcTypeSize );
+        int bandNumber = band->GetBand();
+
+        for(int j = 0; j < bufYSize; ++j)
+        {
+            int srcRow   = osg::clampBetween( (int)floor(y0 + ((double)j + 0.5) * dy), 0, source->GetYSize()-1 );
+            int blockRow = srcRow / blockYSize;
+            int rowInBlock = srcRow - blockRow * blockYSize;
+
+            osg::ref_ptr<GDALBlockCache::Block> block;
+            int blockCol = -1;
+
+            for(int i = 0; i < bufXSize; ++i)
+            {
+                int bc = cols[i] / blockXSize;
+                if ( bc != blockCol )
+                {
+                    blockCol = bc;
+                    GDALBlockCache::Key key( bandNumber, level, blockCol, blockRow );
+                    if ( !_blockCache->get(key, block) )
+                    {
+                        block = new GDALBlockCache::Block();
+                        block->_data.resize( blockXSize * blockYSize * srcTypeSize );
+                        if ( source->ReadBlock(blockCol, blockRow, &block->_data[0]) != CE_None )
+                        {
+                            return CE_Failure;
+                        }
+                        _blockCache->insert( key, block.get() );
+                    }
+                }
+
+                int colInBlock = cols[i] - blockCol * blockXSize;
+                memcpy(
+                    &row[i * srcTypeSize],
+                    &block->_data[(rowInBlock * blockXSize + colInBlock) * srcTypeSize],
+                    srcTypeSize );
+            }
+
+            GDALCopyWords(
+                &row[0], srcType, srcTypeSize,
+                (unsigned char*)buffer + j * lineSpace, bufType, bufTypeSize,
+                bufXSize );
+        }
+
+        return CE_None;
+    }
+
     osg::Image* createImage( const TileKey&        key,
                              ProgressCallback*     progress)
     {
@@ -1276,7 +1654,10 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Borrow a dataset for the read: a pooled handle of our own, or the
+        // shared dataset under the global GDAL lock.
+        DatasetLease lease( this );
+        GDALDataset* warpedDS = lease.warpedDS();
 
         int tileSize = _options.tileSize().value();
 
@@ -1308,8 +1689,8 @@ public:
             int height = (int)(src_max_y - src_min_y);
 
 
-            int rasterWidth = _warpedDS->GetRasterXSize();
-            int rasterHeight = _warpedDS->GetRasterYSize();
+            int rasterWidth = warpedDS->GetRasterXSize();
+            int rasterHeight = warpedDS->GetRasterYSize();
             if (off_x + width > rasterWidth || off_y + height > rasterHeight)
             {
                 OE_WARN << LC << "Read window outside of bounds of dataset.  Source Dimensions=" << rasterWidth << "x" << rasterHeight << " Read Window=" << off_x << ", " << off_y << " " << width << "x" << height << std::endl;
@@ -1343,44 +1724,44 @@ public:
 
 
 
-            GDALRasterBand* bandRed = findBandByColorInterp(_warpedDS, GCI_RedBand);
-            GDALRasterBand* bandGreen = findBandByColorInterp(_warpedDS, GCI_GreenBand);
-            GDALRasterBand* bandBlue = findBandByColorInterp(_warpedDS, GCI_BlueBand);
-            GDALRasterBand* bandAlpha = findBandByColorInterp(_warpedDS, GCI_AlphaBand);
+            GDALRasterBand* bandRed = findBandByColorInterp(warpedDS, GCI_RedBand);
+            GDALRasterBand* bandGreen = findBandByColorInterp(warpedDS, GCI_GreenBand);
+            GDALRasterBand* bandBlue = findBandByColorInterp(warpedDS, GCI_BlueBand);
+            GDALRasterBand* bandAlpha = findBandByColorInterp(warpedDS, GCI_AlphaBand);
 
-            GDALRasterBand* bandGray = findBandByColorInterp(_warpedDS, GCI_GrayIndex);
+            GDALRasterBand* bandGray = findBandByColorInterp(warpedDS, GCI_GrayIndex);
 
-            GDALRasterBand* bandPalette = findBandByColorInterp(_warpedDS, GCI_PaletteIndex);
+            GDALRasterBand* bandPalette = findBandByColorInterp(warpedDS, GCI_PaletteIndex);
 
             if (!bandRed && !bandGreen && !bandBlue && !bandAlpha && !bandGray && !bandPalette)
             {
                 OE_DEBUG << LC << "Could not determine bands based on color interpretation, using band count" << std::endl;
                 //We couldn't find any valid bands based on the color interp, so just make an educated guess based on the number of bands in the file
                 //RGB = 3 bands
-                if (_warpedDS->GetRasterCount() == 3)
+                if (warpedDS->GetRasterCount() == 3)
                 {
-                    bandRed   = _warpedDS->GetRasterBand( 1 );
-                    bandGreen = _warpedDS->GetRasterBand( 2 );
-                    bandBlue  = _warpedDS->GetRasterBand( 3 );
+                    bandRed   = warpedDS->GetRasterBand( 1 );
+                    bandGreen = warpedDS->GetRasterBand( 2 );
+                    bandBlue  = warpedDS->GetRasterBand( 3 );
                 }
                 //RGBA = 4 bands
-                else if (_warpedDS->GetRasterCount() == 4)
+                else if (warpedDS->GetRasterCount() == 4)
                 {
-                    bandRed   = _warpedDS->GetRasterBand( 1 );
-                    bandGreen = _warpedDS->GetRasterBand( 2 );
-                    bandBlue  = _warpedDS->GetRasterBand( 3 );
-                    bandAlpha = _warpedDS->GetRasterBand( 4 );
+                    bandRed   = warpedDS->GetRasterBand( 1 );
+                    bandGreen = warpedDS->GetRasterBand( 2 );
+                    bandBlue  = warpedDS->GetRasterBand( 3 );
+                    bandAlpha = warpedDS->GetRasterBand( 4 );
                 }
                 //Gray = 1 band
-                else if (_warpedDS->GetRasterCount() == 1)
+                else if (warpedDS->GetRasterCount() == 1)
                 {
-                    bandGray = _warpedDS->GetRasterBand( 1 );
+                    bandGray = warpedDS->GetRasterBand( 1 );
                 }
                 //Gray + alpha = 2 bands
-                else if (_warpedDS->GetRasterCount() == 2)
+                else if (warpedDS->GetRasterCount() == 2)
                 {
-                    bandGray  = _warpedDS->GetRasterBand( 1 );
-                    bandAlpha = _warpedDS->GetRasterBand( 2 );
+                    bandGray  = warpedDS->GetRasterBand( 1 );
+                    bandAlpha = warpedDS->GetRasterBand( 2 );
                 }
             }
 
@@ -1407,13 +1788,13 @@ public:
                 //Nearest interpolation just uses RasterIO to sample the imagery and should be very fast.
                 if (!*_options.interpolateImagery() || _options.interpolation() == INTERP_NEAREST)
                 {
-                    bandRed->RasterIO(GF_Read, off_x, off_y, width, height, red, target_width, target_height, GDT_Byte, 0, 0);
-                    bandGreen->RasterIO(GF_Read, off_x, off_y, width, height, green, target_width, target_height, GDT_Byte, 0, 0);
-                    bandBlue->RasterIO(GF_Read, off_x, off_y, width, height, blue, target_width, target_height, GDT_Byte, 0, 0);
+                    readRaster(bandRed, off_x, off_y, width, height, red, target_width, target_height, GDT_Byte);
+                    readRaster(bandGreen, off_x, off_y, width, height, green, target_width, target_height, GDT_Byte);
+                    readRaster(bandBlue, off_x, off_y, width, height, blue, target_width, target_height, GDT_Byte);
 
                     if (bandAlpha)
                     {
-                        bandAlpha->RasterIO(GF_Read, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, 0);
+                        readRaster(bandAlpha, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte);
                     }
 
                     for (int src_row = 0, dst_row = tile_offset_top;
@@ -1446,6 +1827,19 @@ public:
                 }
                 else
                 {
+                    PixelReader readRed  ( this, bandRed );
+                    PixelReader readGreen( this, bandGreen );
+                    PixelReader readBlue ( this, bandBlue );
+                    PixelReader readAlpha( this, bandAlpha );
+
+                    if ( _options.windowedSampling() == true )
+                    {
+                        readRed.readWindow  ( xmin, ymin, xmax, ymax, false, getMaxWindowPixels() );
+                        readGreen.readWindow( xmin, ymin, xmax, ymax, false, getMaxWindowPixels() );
+                        readBlue.readWindow ( xmin, ymin, xmax, ymax, false, getMaxWindowPixels() );
+                        readAlpha.readWindow( xmin, ymin, xmax, ymax, false, getMaxWindowPixels() );
+                    }
+
                     //Sample each point exactly
                     for (unsigned int c = 0; c < (unsigned int)tileSize; ++c)
                     {
@@ -1453,11 +1847,11 @@ public:
                         for (unsigned int r = 0; r < (unsigned int)tileSize; ++r)
                         {
                             double geoY = ymin + (dy * (double)r);
-                            *(image->data(c,r) + 0) = (unsigned char)getInterpolatedValue(bandRed,  geoX,geoY,false);
-                            *(image->data(c,r) + 1) = (unsigned char)getInterpolatedValue(bandGreen,geoX,geoY,false);
-                            *(image->data(c,r) + 2) = (unsigned char)getInterpolatedValue(bandBlue, geoX,geoY,false);
+                            *(image->data(c,r) + 0) = (unsigned char)getInterpolatedValue(readRed,  geoX,geoY,false);
+                            *(image->data(c,r) + 1) = (unsigned char)getInterpolatedValue(readGreen,geoX,geoY,false);
+                            *(image->data(c,r) + 2) = (unsigned char)getInterpolatedValue(readBlue, geoX,geoY,false);
                             if (bandAlpha != NULL)
-                                *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(bandAlpha,geoX, geoY, false);
+                                *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(readAlpha,geoX, geoY, false);
                             else
                                 *(image->data(c,r) + 3) = 255;
                         }
@@ -1528,7 +1922,7 @@ public:
                     if ( !success )
                         nodata = getOptions().noDataValue().get();
 
-                    CPLErr err = bandGray->RasterIO(GF_Read, off_x, off_y, width, height, data, target_width, target_height, gdalDataType, 0, 0);
+                    CPLErr err = readRaster(bandGray, off_x, off_y, width, height, data, target_width, target_height, gdalDataType);
                     if ( err == CE_None )
                     {
                         // copy from data to image.
@@ -1579,11 +1973,11 @@ public:
 
                     if (!*_options.interpolateImagery() || _options.interpolation() == INTERP_NEAREST)
                     {
-                        bandGray->RasterIO(GF_Read, off_x, off_y, width, height, gray, target_width, target_height, GDT_Byte, 0, 0);
+                        readRaster(bandGray, off_x, off_y, width, height, gray, target_width, target_height, GDT_Byte);
 
                         if (bandAlpha)
                         {
-                            bandAlpha->RasterIO(GF_Read, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, 0);
+                            readRaster(bandAlpha, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte);
                         }
 
                         for (int src_row = 0, dst_row = tile_offset_top;
@@ -1612,6 +2006,15 @@ public:
                     }
                     else
                     {
+                        PixelReader readGray( this, bandGray );
+                        PixelReader readAlpha( this, bandAlpha );
+
+                        if ( _options.windowedSampling() == true )
+                        {
+                            readGray.readWindow( xmin, ymin, xmax, ymax, false, getMaxWindowPixels() );
+                            readAlpha.readWindow( xmin, ymin, xmax, ymax, false, getMaxWindowPixels() );
+                        }
+
                         for (int r = 0; r < tileSize; ++r)
                         {
                             double geoY   = ymin + (dy * (double)r);
@@ -1619,13 +2022,13 @@ public:
                             for (int c = 0; c < tileSize; ++c)
                             {
                                 double geoX = xmin + (dx * (double)c);
-                                float  color = getInterpolatedValue(bandGray,geoX,geoY,false);
+                                float  color = getInterpolatedValue(readGray,geoX,geoY,false);
 
                                 *(image->data(c,r) + 0) = (unsigned char)color;
                                 *(image->data(c,r) + 1) = (unsigned char)color;
                                 *(image->data(c,r) + 2) = (unsigned char)color;
                                 if (bandAlpha != NULL)
-                                    *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(bandAlpha,geoX,geoY,false);
+                                    *(image->data(c,r) + 3) = (unsigned char)getInterpolatedValue(readAlpha,geoX,geoY,false);
                                 else
                                     *(image->data(c,r) + 3) = 255;
                             }
@@ -1666,7 +2069,7 @@ public:
                     memset(image->data(), 0, image->getImageSizeInBytes());
                 }
 
-                bandPalette->RasterIO(GF_Read, off_x, off_y, width, height, palette, target_width, target_height, GDT_Byte, 0, 0);
+                readRaster(bandPalette, off_x, off_y, width, height, palette, target_width, target_height, GDT_Byte);
 
                 ImageUtils::PixelWriter write(image);
 
@@ -1726,7 +2129,7 @@ public:
         return image.release();
     }
 
-    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    static float getBandNoDataValue(GDALRasterBand* band)
     {
         float bandNoData = -32767.0f;
         int success;
@@ -1735,7 +2138,16 @@ public:
         {
             bandNoData = value;
         }
+        return bandNoData;
+    }
 
+    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    {
+        return isValidValue(v, getBandNoDataValue(band));
+    }
+
+    bool isValidValue(float v, float bandNoData)
+    {
         //Check to see if the value is equal to the bands specified no data
         if (bandNoData == v) return false;
         //Check to see if the value is equal to the user specified nodata value
@@ -1750,12 +2162,127 @@ public:
 
     bool isValidValue(float v, GDALRasterBand* band)
     {
-        GDAL_SCOPED_LOCK;
+        // Callers already hold the band's dataset exclusively (see DatasetLease)
         return isValidValue_noLock( v, band );
     }
 
 
+    /**
+     * Reads the source pixels of a band for interpolation. After readWindow(),
+     * pixels come from a block of the band read into memory with one RasterIO
+     * call; otherwise, and outside of that block, each pixel is read with its
+     * own 1x1 RasterIO. Both give the same values.
+     */
+    class PixelReader
+    {
+    public:
+        PixelReader(GDALTileSource* source, GDALRasterBand* band) :
+            _source( source ),
+            _band  ( band ),
+            _x(0), _y(0), _width(0), _height(0)
+        {
+            _bandNoData = band ? getBandNoDataValue( band ) : -32767.0f;
+        }
+
+        /**
+         * Reads the block of pixels needed to interpolate anywhere in the
+         * given geographic bounds. Returns false, leaving the reader in
+         * per-pixel mode, if the block would be larger than maxPixels or
+         * the read fails.
+         */
+        bool readWindow(double xmin, double ymin, double xmax, double ymax, bool applyOffset, unsigned maxPixels)
+        {
+            if ( !_band )
+                return false;
+
+            double c[4], r[4];
+            _source->geoToPixel( xmin, ymin, c[0], r[0] );
+            _source->geoToPixel( xmin, ymax, c[1], r[1] );
+            _source->geoToPixel( xmax, ymin, c[2], r[2] );
+            _source->geoToPixel( xmax, ymax, c[3], r[3] );
+
+            double cMin = osg::minimum( osg::minimum(c[0], c[1]), osg::minimum(c[2], c[3]) );
+            double cMax = osg::maximum( osg::maximum(c[0], c[1]), osg::maximum(c[2], c[3]) );
+            double rMin = osg::minimum( osg::minimum(r[0], r[1]), osg::minimum(r[2], r[3]) );
+            double rMax = osg::maximum( osg::maximum(r[0], r[1]), osg::maximum(r[2], r[3]) );
+
+            if ( applyOffset )
+            {
+                cMin -= 0.5; cMax -= 0.5;
+                rMin -= 0.5; rMax -= 0.5;
+            }
+
+            // one pixel of margin on each side covers rounding and the
+            // neighbors used by the interpolation. Clamp to the band that is
+            // actually read rather than to the dataset.
+            int rasterWidth  = _band->GetXSize();
+            int rasterHeight = _band->GetYSize();
+            int x0 = osg::clampBetween( (int)floor(cMin) - 1, 0, rasterWidth-1 );
+            int x1 = osg::clampBetween( (int)ceil(cMax)  + 1, 0, rasterWidth-1 );
+            int y0 = osg::clampBetween( (int)floor(rMin) - 1, 0, rasterHeight-1 );
+            int y1 = osg::clampBetween( (int)ceil(rMax)  + 1, 0, rasterHeight-1 );
+
+            int width  = x1 - x0 + 1;
+            int height = y1 - y0 + 1;
+            if ( (double)width * (double)height > (double)maxPixels )
+                return false;
+
+            _data.resize( width * height );
+            if ( _band->RasterIO(GF_Read, x0, y0, width, height, &_data[0], width, height, GDT_Float32, 0, 0) != CE_None )
+            {
+                _data.clear();
+                return false;
+            }
+
+            _x = x0;
+            _y = y0;
+            _width = width;
+            _height = height;
+            return true;
+        }
+
+        float read(int col, int row) const
+        {
+            if ( col >= _x && col < _x + _width && row >= _y && row < _y + _height )
+            {
+                return _data[(row - _y) * _width + (col - _x)];
+            }
+
+            float value = 0.0f;
+            _band->RasterIO(GF_Read, col, row, 1, 1, &value, 1, 1, GDT_Float32, 0, 0);
+            return value;
+        }
+
+        bool isValid(float v) const
+        {
+            return _source->isValidValue( v, _bandNoData );
+        }
+
+    private:
+        GDALTileSource*    _source;
+        GDALRasterBand*    _band;
+        float              _bandNoData;
+        int                _x, _y, _width, _height;
+        std::vector<float> _data;
+    };
+
+    /**
+     * Maximum number of pixels to read into a PixelReader window for one tile;
+     * tiles that need more (low LODs of large rasters) sample pixel by pixel.
+     */
+    unsigned getMaxWindowPixels() const
+    {
+        unsigned tileSize = _options.tileSize().value();
+        return 16u * tileSize * tileSize;
+    }
+
     float getInterpolatedValue(GDALRasterBand *band, double x, double y, bool applyOffset=true)
+    {
+        PixelReader reader( this, band );
+        return getInterpolatedValue( reader, x, y, applyOffset );
+    }
+
+    float getInterpolatedValue(const PixelReader& reader, double x, double y, bool applyOffset=true)
     {
         double r, c;
         geoToPixel( x, y, c, r );
@@ -1797,8 +2324,8 @@ public:
 
         if ( _options.interpolation() == INTERP_NEAREST )
         {
-            band->RasterIO(GF_Read, (int)osg::round(c), (int)osg::round(r), 1, 1, &result, 1, 1, GDT_Float32, 0, 0);
-            if (!isValidValue( result, band))
+            result = reader.read( (int)osg::round(c), (int)osg::round(r) );
+            if (!reader.isValid( result ))
             {
                 return NO_DATA_VALUE;
             }
@@ -1815,10 +2342,10 @@ public:
 
             float urHeight, llHeight, ulHeight, lrHeight;
 
-            band->RasterIO(GF_Read, colMin, rowMin, 1, 1, &llHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMin, rowMax, 1, 1, &ulHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMin, 1, 1, &lrHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMax, 1, 1, &urHeight, 1, 1, GDT_Float32, 0, 0);
+            llHeight = reader.read( colMin, rowMin );
+            ulHeight = reader.read( colMin, rowMax );
+            lrHeight = reader.read( colMax, rowMin );
+            urHeight = reader.read( colMax, rowMax );
 
             /*
             if (!isValidValue(urHeight, band)) urHeight = 0.0f;
@@ -1826,7 +2353,7 @@ public:
             if (!isValidValue(ulHeight, band)) ulHeight = 0.0f;
             if (!isValidValue(lrHeight, band)) lrHeight = 0.0f;
             */
-            if ((!isValidValue(urHeight, band)) || (!isValidValue(llHeight, band)) ||(!isValidValue(ulHeight, band)) || (!isValidValue(lrHeight, band)))
+            if ((!reader.isValid(urHeight)) || (!reader.isValid(llHeight)) ||(!reader.isValid(ulHeight)) || (!reader.isValid(lrHeight)))
             {
                 return NO_DATA_VALUE;
             }
@@ -1890,7 +2417,10 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Borrow a dataset for the read: a pooled handle of our own, or the
+        // shared dataset under the global GDAL lock.
+        DatasetLease lease( this );
+        GDALDataset* warpedDS = lease.warpedDS();
 
         int tileSize = _options.tileSize().value();
 
@@ -1905,11 +2435,11 @@ public:
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             if (_options.interpolation() == INTERP_NEAREST)
@@ -1928,9 +2458,9 @@ public:
                 int iNumRows = iRowMax - iRowMin + 1;
 
                 int iWinColMin = max(0, iColMin);
-                int iWinColMax = min(_warpedDS->GetRasterXSize()-1, iColMax);
+                int iWinColMax = min(warpedDS->GetRasterXSize()-1, iColMax);
                 int iWinRowMin = max(0, iRowMin);
-                int iWinRowMax = min(_warpedDS->GetRasterYSize()-1, iRowMax);
+                int iWinRowMax = min(warpedDS->GetRasterYSize()-1, iRowMax);
                 int iNumWinCols = iWinColMax - iWinColMin + 1;
                 int iNumWinRows = iWinRowMax - iWinRowMin + 1;
 
@@ -1944,7 +2474,7 @@ public:
                 int startOffset = iBufRowMin * tileSize + iBufColMin;
                 int lineSpace = tileSize * sizeof(float);
 
-                band->RasterIO(GF_Read, iWinColMin, iWinRowMin, iNumWinCols, iNumWinRows, &buffer[startOffset], iNumBufCols, iNumBufRows, GDT_Float32, 0, lineSpace);
+                readRaster(band, iWinColMin, iWinRowMin, iNumWinCols, iNumWinRows, &buffer[startOffset], iNumBufCols, iNumBufRows, GDT_Float32, lineSpace);
 
                 for (int r = 0, ir = tileSize - 1; r < tileSize; ++r, --ir)
                 {
@@ -1956,6 +2486,14 @@ public:
             }
             else
             {
+                // Read the covering window once so the samples don't each
+                // need their own RasterIO calls.
+                PixelReader reader( this, band );
+                if ( _options.windowedSampling() == true )
+                {
+                    reader.readWindow( xmin, ymin, xmax, ymax, true, getMaxWindowPixels() );
+                }
+
                 double dx = (xmax - xmin) / (tileSize-1);
                 double dy = (ymax - ymin) / (tileSize-1);
                 for (int r = 0; r < tileSize; ++r)
@@ -1964,7 +2502,7 @@ public:
                     for (int c = 0; c < tileSize; ++c)
                     {
                         double geoX = xmin + (dx * (double)c);
-                        float h = getInterpolatedValue(band, geoX, geoY);
+                        float h = getInterpolatedValue(reader, geoX, geoY);
                         hf->setHeight(c, r, h);
                     }
                 }
@@ -2016,7 +2554,10 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Borrow a dataset for the read: a pooled handle of our own, or the
+        // shared dataset under the global GDAL lock.
+        DatasetLease lease( this );
+        GDALDataset* warpedDS = lease.warpedDS();
 
         int tileSize = _options.tileSize().value();
 
@@ -2040,8 +2581,8 @@ public:
             geoToPixel( intersection.xMin(), intersection.yMax(), src_min_x, src_min_y);
             geoToPixel( intersection.xMax(), intersection.yMin(), src_max_x, src_max_y);
 
-            int rasterWidth = _warpedDS->GetRasterXSize();
-            int rasterHeight = _warpedDS->GetRasterYSize();
+            int rasterWidth = warpedDS->GetRasterXSize();
+            int rasterHeight = warpedDS->GetRasterYSize();
 
             // Convert the doubles to integers.  We floor the mins and ceil the maximums to give the widest window possible.
             src_min_x = osg::round(src_min_x);
@@ -2204,11 +2745,11 @@ public:
             OE_DEBUG << LC << "Read extents " << read_min_x << ", " << read_min_y << " to " << read_max_x << ", " << read_max_y << std::endl;
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             float *heights = new float[target_width * target_height];
@@ -2216,7 +2757,7 @@ public:
             {
                 heights[i] = NO_DATA_VALUE;
             }
-            band->RasterIO(GF_Read, src_min_x, src_min_y, width, height, heights, target_width, target_height, GDT_Float32, 0, 0);
+            readRaster(band, src_min_x, src_min_y, width, height, heights, target_width, target_height, GDT_Float32);
 
             // Now create a GeoHeightField that we can sample from.  This heightfield only contains the portion that was actually read from the dataset
             osg::ref_ptr< osg::HeightField > readHF = new osg::HeightField();
@@ -2278,10 +2819,61 @@ public:
     }
 
 
+    /**
+     * Dataset to read from for the lifetime of the object. With a dataset pool,
+     * borrows a handle that belongs to the calling thread until the lease ends;
+     * otherwise (or if the pool cannot open a handle) locks the global GDAL
+     * mutex and hands out the shared dataset.
+     */
+    class DatasetLease
+    {
+    public:
+        DatasetLease(GDALTileSource* source) :
+            _pool  ( source->_pool.get() ),
+            _handle( 0L ),
+            _locked( false )
+        {
+            if ( _pool )
+            {
+                _handle = _pool->acquire();
+            }
+
+            if ( _handle )
+            {
+                _ds = _handle->warpedDS;
+            }
+            else
+            {
+                Registry::instance()->getGDALMutex().lock();
+                _locked = true;
+                _ds = source->_warpedDS;
+            }
+        }
+
+        ~DatasetLease()
+        {
+            if ( _handle )
+                _pool->release( _handle );
+            if ( _locked )
+                Registry::instance()->getGDALMutex().unlock();
+        }
+
+        GDALDataset* warpedDS() const { return _ds; }
+
+    private:
+        GDALDatasetPool*         _pool;
+        GDALDatasetPool::Handle* _handle;
+        bool                     _locked;
+        GDALDataset*             _ds;
+    };
+
+
 private:
 
     GDALDataset* _srcDS;
     GDALDataset* _warpedDS;
+    osg::ref_ptr<GDALDatasetPool> _pool;
+    osg::ref_ptr<GDALBlockCache>  _blockCache;
     double       _geotransform[6];
     double       _invtransform[6];
 
@@ -19,17 +19,189 @@
 #include "KMLReader"
 #include "KML_Root"
 #include "KML_Geometry"
+#include "KML_Placemark"
 #include <osgEarth/Registry>
 #include <osgEarth/Capabilities>
 #include <osgEarth/XmlUtils>
 #include <osgEarth/VirtualProgram>
 #include <osgEarth/ScreenSpaceLayout>
+#include <osgEarth/StateSetCache>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <stack>
 #include <iterator>
 
 using namespace osgEarth_kml;
 using namespace osgEarth;
 
+namespace osgEarth_kml
+{
+    /**
+     * State of a streaming read. Owns the parsed document, which the
+     * background tasks build placemarks from, and hands their results
+     * to the scene graph in document order.
+     */
+    class KMLBuildJob : public osg::Referenced
+    {
+    public:
+        /** A run of placemarks built by one task */
+        struct Batch : public osg::Referenced
+        {
+            Batch( unsigned first, unsigned last ) :
+                _first ( first ),
+                _last  ( last ),
+                _nodes ( new osg::Group() ),
+                _icons ( new osg::Group() ),
+                _done  ( false ) { }
+
+            unsigned                 _first, _last;
+            osg::ref_ptr<osg::Group> _nodes;    // results, in document order
+            osg::ref_ptr<osg::Group> _icons;    // results bound for the icon and label group
+            std::vector<unsigned>    _counts;   // number of _nodes children from each placemark
+            bool                     _done;
+        };
+
+        KMLBuildJob() :
+            _canceled  ( false ),
+            _nextBatch ( 0u ),
+            _start     ( osg::Timer::instance()->tick() ) { }
+
+        std::string                         _xml;       // rapidxml parses in situ, so this outlives _doc
+        xml_document<>                      _doc;
+        KMLOptions                          _options;
+        URIResultCache                      _uriCache;
+        KMLBuildQueue                       _queue;
+        KMLContext                          _cx;        // copied by each task; holds no groups
+        std::vector< osg::ref_ptr<Batch> >  _batches;
+        unsigned                            _nextBatch; // next batch to attach
+        Threading::Mutex                    _mutex;     // protects Batch::_done
+        volatile bool                       _canceled;
+        osg::Timer_t                        _start;
+
+        /** Builds the placemarks of a batch. Called from a task thread. */
+        void build( Batch* batch )
+        {
+            KMLContext cx = _cx;
+            cx._groupStack.push( batch->_nodes.get() );
+            if ( cx._iconAndLabelGroup.valid() )
+                cx._iconAndLabelGroup = batch->_icons.get();
+
+            batch->_counts.reserve( batch->_last - batch->_first );
+
+            KML_Placemark placemark;
+            for(unsigned i = batch->_first; i < batch->_last; ++i)
+            {
+                if ( _canceled )
+                    return;
+
+                unsigned before = batch->_nodes->getNumChildren();
+                placemark.build( _queue._placemarks[i].first, cx );
+                batch->_counts.push_back( batch->_nodes->getNumChildren() - before );
+            }
+
+            // share identical state (icon textures, line and polygon state) with
+            // the rest of the document and anything else already loaded:
+            Registry::stateSetCache()->optimize( batch->_nodes.get() );
+            Registry::stateSetCache()->optimize( batch->_icons.get() );
+
+            Threading::ScopedMutexLock lock( _mutex );
+            batch->_done = true;
+        }
+
+        /**
+         * Adds finished batches to the scene graph, stopping at the first one
+         * that isn't finished so that results appear in document order.
+         * Returns true once every batch is attached.
+         */
+        bool attach()
+        {
+            while( _nextBatch < _batches.size() )
+            {
+                osg::ref_ptr<Batch> batch = _batches[_nextBatch].get();
+                {
+                    Threading::ScopedMutexLock lock( _mutex );
+                    if ( !batch->_done )
+                        return false;
+                }
+
+                unsigned child = 0;
+                for(unsigned i = batch->_first; i < batch->_last; ++i)
+                {
+                    unsigned count = batch->_counts[i - batch->_first];
+                    osg::ref_ptr<osg::Group> parent;
+                    if ( _queue._parents[_queue._placemarks[i].second].lock(parent) )
+                    {
+                        for(unsigned c = child; c < child + count; ++c)
+                            parent->addChild( batch->_nodes->getChild(c) );
+                    }
+                    child += count;
+                }
+                batch->_nodes->removeChildren( 0, batch->_nodes->getNumChildren() );
+
+                if ( _cx._iconAndLabelGroup.valid() )
+                {
+                    for(unsigned c = 0; c < batch->_icons->getNumChildren(); ++c)
+                        _cx._iconAndLabelGroup->addChild( batch->_icons->getChild(c) );
+                }
+                batch->_icons->removeChildren( 0, batch->_icons->getNumChildren() );
+
+                _batches[_nextBatch] = 0L;
+                ++_nextBatch;
+            }
+            return true;
+        }
+    };
+}
+
+namespace
+{
+    struct BuildBatchTask : public TaskRequest
+    {
+        BuildBatchTask( KMLBuildJob* job, KMLBuildJob::Batch* batch ) : _job( job ), _batch( batch ) { }
+
+        void operator()( ProgressCallback* progress )
+        {
+            _job->build( _batch.get() );
+        }
+
+        osg::ref_ptr<KMLBuildJob>        _job;
+        osg::ref_ptr<KMLBuildJob::Batch> _batch;
+    };
+
+    /**
+     * Update callback that attaches finished batches to the scene graph,
+     * and removes itself when there are none left. Destroying it (with
+     * the KML root) cancels the batches that haven't run yet.
+     */
+    struct AttachBatchesCallback : public osg::NodeCallback
+    {
+        AttachBatchesCallback( KMLBuildJob* job, TaskService* service ) : _job( job ), _service( service ) { }
+
+        void operator()( osg::Node* node, osg::NodeVisitor* nv )
+        {
+            traverse( node, nv );
+
+            if ( _job->attach() )
+            {
+                OE_INFO << LC << "Streamed " << _job->_queue._placemarks.size() << " placemarks in "
+                    << osg::Timer::instance()->delta_s(_job->_start, osg::Timer::instance()->tick()) << "s" << std::endl;
+
+                // keep this callback alive until it returns:
+                osg::ref_ptr<osg::NodeCallback> self = this;
+                node->removeUpdateCallback( this );
+            }
+        }
+
+        virtual ~AttachBatchesCallback()
+        {
+            _job->_canceled = true;
+        }
+
+        osg::ref_ptr<KMLBuildJob> _job;
+        osg::ref_ptr<TaskService> _service;
+    };
+}
+
 
 KMLReader::KMLReader( MapNode* mapNode, const KMLOptions* options ) :
 _mapNode( mapNode ),
@@ -44,19 +216,26 @@ KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
     // pull the URI context out of the DB options:
     URIContext context(dbOptions);
 
+    // in streaming mode, the document has to outlive this call:
+    osg::ref_ptr<KMLBuildJob> job;
+    if ( _options && _options->streaming() == true )
+        job = new KMLBuildJob();
+
 	// Load the XML
     osg::Timer_t start = osg::Timer::instance()->tick();
 	std::stringstream buffer;
     buffer << in.rdbuf();
-    std::string xmlStr;
+    std::string localXmlStr;
+    std::string& xmlStr = job.valid() ? job->_xml : localXmlStr;
     xmlStr = buffer.str();
-	xml_document<> doc;
+	xml_document<> localDoc;
+	xml_document<>& doc = job.valid() ? job->_doc : localDoc;
 	doc.parse<0>(&xmlStr[0]);
     osg::Timer_t end = osg::Timer::instance()->tick();
 	OE_INFO << "Loaded KML in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
 
     start = osg::Timer::instance()->tick();
-	osg::Node* node = read(doc, dbOptions);
+	osg::Node* node = read(doc, dbOptions, job.get());
     end = osg::Timer::instance()->tick();
 	OE_INFO << "Parsed KML in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
 	node->setName( context.referrer() );
@@ -66,6 +245,12 @@ KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
 
 osg::Node*
 KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
+{
+    return read( doc, dbOptions, 0L );
+}
+
+osg::Node*
+KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions, KMLBuildJob* job )
 {
     osg::Group* root = new osg::Group();
     root->ref();
@@ -85,8 +270,10 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
     cx._groupStack.push( root );
 
 
-    // clone the dbOptions, and install a resource cache if there isn't one already:
-    URIResultCache defaultUriCache;
+    // clone the dbOptions, and install a resource cache if there isn't one already.
+    // (In streaming mode the cache belongs to the job, since the tasks use it.)
+    URIResultCache localUriCache;
+    URIResultCache& defaultUriCache = job ? job->_uriCache : localUriCache;
     if ( !URIResultCache::from(dbOptions) )
     {
         osgDB::Options* newOptions = Registry::instance()->cloneOrCreateOptions();
@@ -103,6 +290,16 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
     if ( cx._options == 0L )
         cx._options = &blankOptions;
 
+    // the tasks may outlive the caller's options, so use a copy:
+    if ( job )
+    {
+        job->_options  = *cx._options;
+        cx._options    = &job->_options;
+        cx._buildQueue = &job->_queue;
+    }
+
+    cx._iconAndLabelGroup = cx._options->iconAndLabelGroup();
+
     //if ( cx._options->iconAndLabelGroup().valid() && cx._options->declutter() == true )
     //{
     //    Decluttering::setEnabled( cx._options->iconAndLabelGroup()->getOrCreateStateSet(), true );
@@ -131,6 +328,34 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
         OE_INFO << "build took " << osg::Timer::instance()->delta_s(start, end) << std::endl;
     }
 
+    if ( job && !job->_queue._placemarks.empty() )
+    {
+        // the tasks build with a copy of the context. It must not hold the
+        // root, which will own the job through its update callback.
+        job->_cx = cx;
+        job->_cx._groupStack = std::stack<osg::ref_ptr<osg::Group> >();
+        job->_cx._buildQueue = 0L;
+
+        unsigned numPlacemarks = (unsigned)job->_queue._placemarks.size();
+        unsigned batchSize     = osg::maximum( 1u, *job->_options.placemarksPerBatch() );
+        unsigned numThreads    = *job->_options.numBuildThreads() > 0u ?
+            *job->_options.numBuildThreads() :
+            (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+
+        TaskService* service = new TaskService( "KML", numThreads );
+        for(unsigned first = 0; first < numPlacemarks; first += batchSize)
+        {
+            KMLBuildJob::Batch* batch = new KMLBuildJob::Batch( first, osg::minimum(first + batchSize, numPlacemarks) );
+            job->_batches.push_back( batch );
+            service->add( new BuildBatchTask(job, batch) );
+        }
+
+        root->addUpdateCallback( new AttachBatchesCallback(job, service) );
+
+        OE_INFO << LC << "Streaming " << numPlacemarks << " placemarks in " << job->_batches.size()
+            << " batches on " << numThreads << " threads" << std::endl;
+    }
+
     URIResultCache* cacheUsed = URIResultCache::from(cx._dbOptions.get());
     CacheStats stats = cacheUsed->getStats();
     OE_INFO << LC << "URI Cache: " << stats._queries << " reads, " << (stats._hitRatio*100.0) << "% hits" << std::endl;
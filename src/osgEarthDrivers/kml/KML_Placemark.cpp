@@ -37,6 +37,13 @@ using namespace osgEarth::Annotation;
 void 
 KML_Placemark::build( xml_node<>* node, KMLContext& cx )
 {
+    if ( cx._buildQueue )
+    {
+        // streaming mode: a background thread builds it later.
+        cx._buildQueue->push( node, cx._groupStack.top().get() );
+        return;
+    }
+
 	Style masterStyle;
 
 	std::string styleUrl = getValue(node, "styleurl");
@@ -52,10 +59,10 @@ KML_Placemark::build( xml_node<>* node, KMLContext& cx )
 
 	xml_node<>* style = node->first_node("style", 0, false);
 	if ( style )
-	{	// process an "inline" style
+	{	// process an "inline" style. The scan pass already added it to the
+		// style sheet, so just parse it; build() may run on several threads.
 		KML_Style kmlStyle;
-		kmlStyle.scan(style, cx);
-		masterStyle = masterStyle.combineWith(cx._activeStyle);
+		masterStyle = masterStyle.combineWith(kmlStyle.parse(style, cx));
 	}
 
     // parse the geometry. the placemark must have geometry to be valid. The 
@@ -137,7 +144,8 @@ KML_Placemark::build( xml_node<>* node, KMLContext& cx )
                     {
                         if ( !text && cx._options->defaultTextSymbol().valid() )
                         {
-                            text = cx._options->defaultTextSymbol().get();
+                            // copy it, since the content is set per placemark:
+                            text = static_cast<TextSymbol*>( cx._options->defaultTextSymbol()->clone(osg::CopyOp::SHALLOW_COPY) );
                             style.addSymbol( text );
 
                         }
@@ -218,9 +226,9 @@ KML_Placemark::build( xml_node<>* node, KMLContext& cx )
                 {
                     if ( iconNode )
                     {
-                        if ( cx._options->iconAndLabelGroup().valid() )
+                        if ( cx._iconAndLabelGroup.valid() )
                         {
-                            cx._options->iconAndLabelGroup()->addChild( iconNode );
+                            cx._iconAndLabelGroup->addChild( iconNode );
                         }
                         else
                         {
@@ -26,6 +26,16 @@ using namespace osgEarth_kml;
 
 void
 KML_Style::scan( xml_node<>* node, KMLContext& cx )
+{
+    Style style = parse( node, cx );
+
+    cx._sheet->addStyle( style );
+
+    cx._activeStyle = style;
+}
+
+Style
+KML_Style::parse( xml_node<>* node, KMLContext& cx )
 {
     Style style( getValue(node, "id") );
 
@@ -41,7 +51,5 @@ KML_Style::scan( xml_node<>* node, KMLContext& cx )
     KML_PolyStyle poly;
     poly.scan( node->first_node("polystyle", 0, false), style, cx );
 
-    cx._sheet->addStyle( style );
-
-    cx._activeStyle = style;
+    return style;
 }
@@ -24,7 +24,10 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Clamping>
 #include <osgEarth/Utils>
+#include <osgEarth/Registry>
 #include <osgEarth/Tessellator>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <osg/Geode>
 #include <osg/Geometry>
 #include <osg/MatrixTransform>
@@ -34,6 +37,8 @@
 #include <osgUtil/Simplifier>
 #include <osg/LineWidth>
 #include <osg/PolygonOffset>
+#include <OpenThreads/Thread>
+#include <algorithm>
 
 #define LC "[ExtrudeGeometryFilter] "
 
@@ -68,6 +73,554 @@ namespace
 
         return atan2( p2.x()-p1.x(), p2.y()-p1.y() );
     }
+
+    // 2D cross product of (b-a) and (p-a); positive when p is left of a->b.
+    inline double cross2d( const osg::Vec3f& a, const osg::Vec3f& b, const osg::Vec3f& p )
+    {
+        return ((double)b.x()-a.x())*((double)p.y()-a.y()) - ((double)b.y()-a.y())*((double)p.x()-a.x());
+    }
+
+    // Whether p lies inside or on the edge of triangle abc (either winding).
+    inline bool inTriangle( const osg::Vec3f& a, const osg::Vec3f& b, const osg::Vec3f& c, const osg::Vec3f& p )
+    {
+        double d1 = cross2d(a, b, p), d2 = cross2d(b, c, p), d3 = cross2d(c, a, p);
+        bool hasNeg = d1 < 0.0 || d2 < 0.0 || d3 < 0.0;
+        bool hasPos = d1 > 0.0 || d2 > 0.0 || d3 > 0.0;
+        return !(hasNeg && hasPos);
+    }
+
+    inline bool sameXY( const osg::Vec3f& a, const osg::Vec3f& b )
+    {
+        return a.x() == b.x() && a.y() == b.y();
+    }
+
+    /**
+     * Ear-clipping triangulator for extruded roofs. Works in the XY plane
+     * and supports holes by bridging each one into the outer boundary,
+     * which yields a single loop to clip. Output triangles are always CCW
+     * (facing +Z). Scratch buffers persist between calls so that a single
+     * instance can triangulate many roofs without reallocating.
+     */
+    class RoofTriangulator
+    {
+    public:
+        /**
+         * Triangulates the rings stored consecutively in "verts" starting
+         * at index "first". Ring 0 is the outer boundary; the rest are holes.
+         * Every ring must have at least 3 points. Appends vertex indices
+         * to "out".
+         */
+        void triangulate(const osg::Vec3Array&  verts,
+                         unsigned               first,
+                         const unsigned*        ringSizes,
+                         unsigned               numRings,
+                         std::vector<GLuint>&   out)
+        {
+            _loop.clear();
+            appendRing( verts, first, ringSizes[0], true, _loop );
+
+            // bridge the holes into the outer loop, rightmost hole first:
+            if ( numRings > 1 )
+            {
+                _holes.clear();
+                unsigned start = first + ringSizes[0];
+                for(unsigned r=1; r<numRings; ++r)
+                {
+                    Hole hole;
+                    hole.start = start;
+                    hole.size  = ringSizes[r];
+                    hole.right = start;
+                    for(unsigned i=start+1; i<start+hole.size; ++i)
+                    {
+                        if ( verts[i].x() > verts[hole.right].x() )
+                            hole.right = i;
+                    }
+                    hole.maxX = verts[hole.right].x();
+                    _holes.push_back( hole );
+                    start += ringSizes[r];
+                }
+
+                std::sort( _holes.begin(), _holes.end() );
+
+                for(std::vector<Hole>::const_iterator h = _holes.begin(); h != _holes.end(); ++h)
+                {
+                    bridgeHole( verts, *h );
+                }
+            }
+
+            clip( verts, out );
+        }
+
+    private:
+        struct Hole
+        {
+            unsigned start, size, right;
+            float    maxX;
+            bool operator < (const Hole& rhs) const { return maxX > rhs.maxX; }
+        };
+
+        std::vector<GLuint>   _loop;
+        std::vector<GLuint>   _ring;
+        std::vector<Hole>     _holes;
+        std::vector<unsigned> _prev;
+        std::vector<unsigned> _next;
+
+        // Appends a ring to a loop, reversing it as necessary to match the
+        // requested winding.
+        void appendRing(const osg::Vec3Array& verts, unsigned start, unsigned size, bool ccw, std::vector<GLuint>& loop)
+        {
+            double area = 0.0;
+            for(unsigned i=0, j=size-1; i<size; j=i++)
+            {
+                area += (double)verts[start+j].x()*verts[start+i].y() - (double)verts[start+i].x()*verts[start+j].y();
+            }
+
+            bool reverse = ccw ? area < 0.0 : area > 0.0;
+            if ( reverse )
+            {
+                for(unsigned i=size; i>0; --i)
+                    loop.push_back( start+i-1 );
+            }
+            else
+            {
+                for(unsigned i=0; i<size; ++i)
+                    loop.push_back( start+i );
+            }
+        }
+
+        // Finds a loop position visible from hole vertex "m" (Eberly's method).
+        unsigned findBridge(const osg::Vec3Array& verts, const osg::Vec3f& m) const
+        {
+            unsigned n = _loop.size();
+            double   qx = DBL_MAX;
+            int      candidate = -1;
+
+            // cast a ray from m in the +X direction and find the nearest edge it hits:
+            for(unsigned i=0; i<n; ++i)
+            {
+                const osg::Vec3f& a = verts[_loop[i]];
+                const osg::Vec3f& b = verts[_loop[(i+1)%n]];
+                if ( a.y() != b.y() &&
+                     ((a.y() <= m.y() && m.y() <= b.y()) || (b.y() <= m.y() && m.y() <= a.y())) )
+                {
+                    double x = a.x() + ((double)m.y()-a.y()) * ((double)b.x()-a.x()) / ((double)b.y()-a.y());
+                    if ( x >= m.x() && x < qx )
+                    {
+                        qx = x;
+                        candidate = a.x() > b.x() ? (int)i : (int)((i+1)%n);
+                    }
+                }
+            }
+
+            if ( candidate < 0 )
+            {
+                // degenerate input; settle for the closest vertex.
+                double minDist2 = DBL_MAX;
+                for(unsigned i=0; i<n; ++i)
+                {
+                    double d2 = (verts[_loop[i]] - m).length2();
+                    if ( d2 < minDist2 )
+                    {
+                        minDist2 = d2;
+                        candidate = i;
+                    }
+                }
+                return candidate;
+            }
+
+            // any vertex inside the triangle (m, hit point, candidate) would block
+            // visibility; take the one with the smallest angle to the ray instead.
+            osg::Vec3f p = verts[_loop[candidate]];
+
+            // the ray hit the candidate vertex itself, so it is visible.
+            if ( p.y() == m.y() )
+                return candidate;
+
+            osg::Vec3f hit( qx, m.y(), 0.0f );
+            unsigned   best = candidate;
+            double     bestTan = DBL_MAX;
+
+            for(unsigned i=0; i<n; ++i)
+            {
+                const osg::Vec3f& v = verts[_loop[i]];
+                if ( (int)i != candidate && v.x() > m.x() && !sameXY(v, p) && inTriangle(m, hit, p, v) )
+                {
+                    double t = fabs((double)v.y() - m.y()) / ((double)v.x() - m.x());
+                    if ( t < bestTan || (t == bestTan && v.x() < verts[_loop[best]].x()) )
+                    {
+                        bestTan = t;
+                        best = i;
+                    }
+                }
+            }
+
+            return best;
+        }
+
+        // Splices a hole into the loop through a pair of coincident bridge edges.
+        void bridgeHole(const osg::Vec3Array& verts, const Hole& hole)
+        {
+            _ring.clear();
+            appendRing( verts, hole.start, hole.size, false, _ring );
+
+            // rotate the hole so it starts at its rightmost vertex:
+            std::vector<GLuint>::iterator r = std::find( _ring.begin(), _ring.end(), (GLuint)hole.right );
+            std::rotate( _ring.begin(), r, _ring.end() );
+            _ring.push_back( hole.right );
+
+            unsigned bridge = findBridge( verts, verts[hole.right] );
+            _ring.push_back( _loop[bridge] );
+
+            _loop.insert( _loop.begin() + bridge + 1, _ring.begin(), _ring.end() );
+        }
+
+        bool isEar(const osg::Vec3Array& verts, unsigned p, unsigned i, unsigned n) const
+        {
+            const osg::Vec3f& a = verts[_loop[p]];
+            const osg::Vec3f& b = verts[_loop[i]];
+            const osg::Vec3f& c = verts[_loop[n]];
+
+            // reflex or degenerate corner:
+            if ( cross2d(a, b, c) <= 0.0 )
+                return false;
+
+            float xmin = osg::minimum(a.x(), osg::minimum(b.x(), c.x()));
+            float xmax = osg::maximum(a.x(), osg::maximum(b.x(), c.x()));
+            float ymin = osg::minimum(a.y(), osg::minimum(b.y(), c.y()));
+            float ymax = osg::maximum(a.y(), osg::maximum(b.y(), c.y()));
+
+            for(unsigned j = _next[n]; j != p; j = _next[j])
+            {
+                const osg::Vec3f& v = verts[_loop[j]];
+                if ( v.x() >= xmin && v.x() <= xmax && v.y() >= ymin && v.y() <= ymax &&
+                     !sameXY(v, a) && !sameXY(v, b) && !sameXY(v, c) &&
+                     inTriangle(a, b, c, v) )
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void emit(const osg::Vec3Array& verts, unsigned p, unsigned i, unsigned n, std::vector<GLuint>& out) const
+        {
+            if ( cross2d(verts[_loop[p]], verts[_loop[i]], verts[_loop[n]]) > 0.0 )
+            {
+                out.push_back( _loop[p] );
+                out.push_back( _loop[i] );
+                out.push_back( _loop[n] );
+            }
+        }
+
+        void clip(const osg::Vec3Array& verts, std::vector<GLuint>& out)
+        {
+            unsigned size = _loop.size();
+            if ( size < 3 )
+                return;
+
+            _prev.resize( size );
+            _next.resize( size );
+            for(unsigned i=0; i<size; ++i)
+            {
+                _prev[i] = (i+size-1) % size;
+                _next[i] = (i+1) % size;
+            }
+
+            unsigned remaining = size, i = 0, stall = 0;
+            while( remaining > 3 )
+            {
+                unsigned p = _prev[i], n = _next[i];
+
+                bool ear = isEar(verts, p, i, n);
+
+                // If we went all the way around without finding an ear, the loop
+                // is degenerate (collinear or self-touching); clip anyway so we
+                // are guaranteed to finish.
+                if ( ear || ++stall >= remaining )
+                {
+                    emit( verts, p, i, n, out );
+                    _next[p] = n;
+                    _prev[n] = p;
+                    --remaining;
+                    stall = 0;
+                }
+                i = n;
+            }
+
+            emit( verts, _prev[i], i, _next[i], out );
+        }
+    };
+
+    // Shared, per-push parameters for the fast extrusion path.
+    struct ExtrusionSettings
+    {
+        osg::Vec4f                 wallColor;
+        osg::Vec4f                 wallBaseColor;
+        osg::Vec4f                 roofColor;
+        bool                       flatten;
+        bool                       gpuClamping;
+        bool                       makeECEF;
+        bool                       localize;
+        const osg::EllipsoidModel* ellipsoid;
+        osg::Matrixd               world2local;
+    };
+
+    // One feature part to extrude. Its points live in a shared pool as the
+    // base centroid followed by a (base, roof) pair for every corner; its
+    // ring sizes live in a shared ring pool.
+    struct ExtrusionPart
+    {
+        ExtrusionPart() : feature(0L), firstPoint(0u), firstRing(0u), numRings(0u), isPolygon(false), verticalOffset(0.0f) { }
+
+        Feature*                    feature;
+        std::string                 name;
+        unsigned                    firstPoint;
+        unsigned                    firstRing;
+        unsigned                    numRings;
+        bool                        isPolygon;
+        float                       verticalOffset;
+        osg::ref_ptr<osg::Geometry> geometry;
+    };
+    typedef std::vector<ExtrusionPart> ExtrusionParts;
+
+    template<typename DE>
+    void fillExtrusionIndices(DE* de, unsigned numFaces, const std::vector<GLuint>& roofIndices)
+    {
+        typedef typename DE::value_type index_type;
+        unsigned e = 0;
+        for(unsigned f=0; f<numFaces; ++f)
+        {
+            index_type b = (index_type)(f*4);
+            (*de)[e++] = b;   (*de)[e++] = b+1; (*de)[e++] = b+2;
+            (*de)[e++] = b+2; (*de)[e++] = b+3; (*de)[e++] = b;
+        }
+        for(unsigned i=0; i<roofIndices.size(); ++i)
+        {
+            (*de)[e++] = (index_type)roofIndices[i];
+        }
+    }
+
+    /**
+     * Builds the walls and roof for a range of extrusion parts into a
+     * single geometry per part. Runs on a worker thread, so it only touches
+     * its own parts and never calls into the SRS or expression machinery.
+     */
+    struct ExtrusionBatch
+    {
+        ExtrusionBatch() : _settings(0L), _parts(0L), _points(0L), _rings(0L), _first(0u), _last(0u) { }
+
+        const ExtrusionSettings* _settings;
+        ExtrusionParts*          _parts;
+        std::vector<osg::Vec3d>* _points;
+        const std::vector<unsigned>* _rings;
+        unsigned                 _first, _last;
+
+        RoofTriangulator         _triangulator;
+        std::vector<GLuint>      _roofIndices;
+        std::vector<unsigned>    _roofRings;
+
+        void execute()
+        {
+            for(unsigned i=_first; i<_last; ++i)
+            {
+                build( (*_parts)[i] );
+            }
+        }
+
+        void localize(osg::Vec3d& p) const
+        {
+            if ( _settings->makeECEF )
+            {
+                double x, y, z;
+                _settings->ellipsoid->convertLatLongHeightToXYZ(
+                    osg::DegreesToRadians(p.y()), osg::DegreesToRadians(p.x()), p.z(),
+                    x, y, z );
+                p.set( x, y, z );
+            }
+            if ( _settings->localize )
+            {
+                p = p * _settings->world2local;
+            }
+        }
+
+        void build(ExtrusionPart& part)
+        {
+            const ExtrusionSettings& s = *_settings;
+            std::vector<osg::Vec3d>& points = *_points;
+            const unsigned* rings = &(*_rings)[part.firstRing];
+
+            // count everything up front so we can allocate exactly once.
+            unsigned numCorners = 0, numFaces = 0, numRoofVerts = 0;
+            bool     hasRoof = part.isPolygon && rings[0] >= 3;
+            _roofRings.clear();
+            for(unsigned r=0; r<part.numRings; ++r)
+            {
+                numCorners += rings[r];
+                numFaces   += part.isPolygon ? rings[r] : rings[r]-1;
+                if ( hasRoof && rings[r] >= 3 )
+                {
+                    numRoofVerts += rings[r];
+                    _roofRings.push_back( rings[r] );
+                }
+            }
+
+            unsigned numVerts = numFaces*4 + numRoofVerts;
+            if ( numVerts == 0 )
+                return;
+
+            // transform the centroid and all corners into the local frame:
+            unsigned end = part.firstPoint + 1 + numCorners*2;
+            for(unsigned i=part.firstPoint; i<end; ++i)
+            {
+                localize( points[i] );
+            }
+
+            const osg::Vec3d& centroid = points[part.firstPoint];
+            float cx = centroid.x(), cy = centroid.y(), vo = part.verticalOffset;
+
+            osg::Geometry*  geom    = new osg::Geometry();
+            osg::Vec3Array* verts   = new osg::Vec3Array( numVerts );
+            osg::Vec3Array* normals = new osg::Vec3Array( numVerts );
+            osg::Vec4Array* colors  = new osg::Vec4Array( numVerts );
+            osg::Vec4Array* anchors = s.gpuClamping ? new osg::Vec4Array( numVerts ) : 0L;
+
+            // walls; each face is a quad (left roof, left base, right base, right roof)
+            unsigned v = 0;
+            unsigned c = part.firstPoint + 1;
+            for(unsigned r=0; r<part.numRings; ++r)
+            {
+                unsigned size = rings[r];
+                unsigned ringFaces = part.isPolygon ? size : size-1;
+                for(unsigned k=0; k<ringFaces; ++k, v+=4)
+                {
+                    unsigned left  = c + 2*k;
+                    unsigned right = c + 2*((k+1) % size);
+
+                    (*verts)[v+0] = points[left+1];
+                    (*verts)[v+1] = points[left];
+                    (*verts)[v+2] = points[right];
+                    (*verts)[v+3] = points[right+1];
+
+                    // flat normal, same winding as the triangles:
+                    osg::Vec3f n = ((*verts)[v+1] - (*verts)[v+0]) ^ ((*verts)[v+2] - (*verts)[v+0]);
+                    if ( n.normalize() == 0.0f )
+                    {
+                        n = ((*verts)[v+3] - (*verts)[v+2]) ^ ((*verts)[v+0] - (*verts)[v+2]);
+                        n.normalize();
+                    }
+                    (*normals)[v+0] = (*normals)[v+1] = (*normals)[v+2] = (*normals)[v+3] = n;
+
+                    (*colors)[v+0] = s.wallColor;
+                    (*colors)[v+1] = s.wallBaseColor;
+                    (*colors)[v+2] = s.wallBaseColor;
+                    (*colors)[v+3] = s.wallColor;
+
+                    if ( anchors )
+                    {
+                        (*anchors)[v+1].set( cx, cy, vo, Clamping::ClampToGround );
+                        (*anchors)[v+2].set( cx, cy, vo, Clamping::ClampToGround );
+
+                        if ( s.flatten )
+                        {
+                            (*anchors)[v+0].set( cx, cy, vo, Clamping::ClampToAnchor );
+                            (*anchors)[v+3].set( cx, cy, vo, Clamping::ClampToAnchor );
+                        }
+                        else
+                        {
+                            (*anchors)[v+0].set( cx, cy, vo + (points[left+1]-points[left]).length(),   Clamping::ClampToGround );
+                            (*anchors)[v+3].set( cx, cy, vo + (points[right+1]-points[right]).length(), Clamping::ClampToGround );
+                        }
+                    }
+                }
+                c += 2*size;
+            }
+
+            // roof:
+            _roofIndices.clear();
+            if ( hasRoof )
+            {
+                unsigned roofStart = v;
+                c = part.firstPoint + 1;
+                for(unsigned r=0; r<part.numRings; ++r)
+                {
+                    unsigned size = rings[r];
+                    if ( size >= 3 )
+                    {
+                        for(unsigned k=0; k<size; ++k, ++v)
+                        {
+                            const osg::Vec3d& base = points[c + 2*k];
+                            const osg::Vec3d& roof = points[c + 2*k + 1];
+
+                            (*verts)[v] = roof;
+                            (*normals)[v].set( 0.0f, 0.0f, 1.0f );
+                            (*colors)[v] = s.roofColor;
+
+                            if ( anchors )
+                            {
+                                if ( s.flatten )
+                                    (*anchors)[v].set( cx, cy, vo, Clamping::ClampToAnchor );
+                                else
+                                    (*anchors)[v].set( cx, cy, vo + (roof-base).length(), Clamping::ClampToGround );
+                            }
+                        }
+                    }
+                    c += 2*size;
+                }
+
+                _triangulator.triangulate( *verts, roofStart, &_roofRings[0], _roofRings.size(), _roofIndices );
+            }
+
+            unsigned numIndices = numFaces*6 + _roofIndices.size();
+
+            if ( numVerts > 0xFFFF )
+            {
+                osg::DrawElementsUInt* de = new osg::DrawElementsUInt( GL_TRIANGLES, numIndices );
+                fillExtrusionIndices( de, numFaces, _roofIndices );
+                geom->addPrimitiveSet( de );
+            }
+            else
+            {
+                osg::DrawElementsUShort* de = new osg::DrawElementsUShort( GL_TRIANGLES, numIndices );
+                fillExtrusionIndices( de, numFaces, _roofIndices );
+                geom->addPrimitiveSet( de );
+            }
+
+            geom->setVertexArray( verts );
+            geom->setNormalArray( normals );
+            geom->setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
+            geom->setColorArray( colors );
+            geom->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
+
+            if ( anchors )
+            {
+                geom->setVertexAttribArray    ( Clamping::AnchorAttrLocation, anchors );
+                geom->setVertexAttribBinding  ( Clamping::AnchorAttrLocation, osg::Geometry::BIND_PER_VERTEX );
+                geom->setVertexAttribNormalize( Clamping::AnchorAttrLocation, false );
+            }
+
+            part.geometry = geom;
+        }
+    };
+
+    // Minimum number of parts worth handing off to another thread.
+    const unsigned MIN_PARTS_PER_BATCH = 64u;
+
+    // Thread pool shared by all extrusion filters. The Registry's task service
+    // manager owns it, so its threads are shut down along with the Registry.
+    TaskService* getExtrusionService()
+    {
+        static Threading::Mutex s_mutex;
+        static UID              s_uid = -1;
+
+        Threading::ScopedMutexLock lock( s_mutex );
+        TaskServiceManager* manager = Registry::instance()->getTaskServiceManager();
+        if ( s_uid < 0 )
+        {
+            s_uid = Registry::instance()->createUID();
+            manager->add( s_uid )->setName( "ExtrudeGeometryFilter" );
+        }
+        return manager->get( s_uid );
+    }
 }
 
 #define AS_VEC4(V3, X) osg::Vec4f( (V3).x(), (V3).y(), (V3).z(), X )
@@ -79,6 +632,7 @@ _mergeGeometry         ( true ),
 _wallAngleThresh_deg   ( 60.0 ),
 _styleDirty            ( true ),
 _makeStencilVolume     ( false ),
+_useFastPath           ( true ),
 _gpuClamping           ( false )
 {
     //NOP
@@ -1141,6 +1695,248 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     return true;
 }
 
+bool
+ExtrudeGeometryFilter::canUseFastPath() const
+{
+    return
+        _useFastPath              &&
+        !_wallSkinSymbol.valid()  &&
+        !_roofSkinSymbol.valid()  &&
+        !_outlineSymbol.valid()   &&
+        !_makeStencilVolume;
+}
+
+bool
+ExtrudeGeometryFilter::processFast( FeatureList& features, FilterContext& context )
+{
+    ExtrusionSettings settings;
+    settings.makeECEF  = false;
+    settings.ellipsoid = 0L;
+
+    const SpatialReference* srs    = 0L;
+    const SpatialReference* outSRS = 0L;
+
+    if ( context.isGeoreferenced() )
+    {
+        const SpatialReference* mapSRS = context.getSession()->getMapInfo().getProfile()->getSRS();
+        srs                = context.extent()->getSRS();
+        settings.makeECEF  = context.getSession()->getMapInfo().isGeocentric();
+
+        // for ECEF output we transform to geodetic here, and leave the
+        // conversion to ECEF (pure ellipsoid math) to the worker threads.
+        outSRS             = settings.makeECEF ? mapSRS->getECEF()->getGeodeticSRS() : mapSRS;
+        settings.ellipsoid = outSRS->getEllipsoid();
+    }
+
+    settings.localize    = srs != 0L;
+    settings.world2local = _world2local;
+    settings.flatten     = _extrusionSymbol->flatten() == true;
+    settings.gpuClamping = _gpuClamping;
+
+    settings.wallColor.set(1,1,1,1);
+    if ( _wallPolygonSymbol.valid() )
+    {
+        settings.wallColor = _wallPolygonSymbol->fill()->color();
+    }
+
+    if ( _extrusionSymbol->wallGradientPercentage().isSet() )
+    {
+        settings.wallBaseColor = Color(settings.wallColor).brightness( 1.0 - *_extrusionSymbol->wallGradientPercentage() );
+    }
+    else
+    {
+        settings.wallBaseColor = settings.wallColor;
+    }
+
+    settings.roofColor.set(1,1,1,1);
+    if ( _roofPolygonSymbol.valid() )
+    {
+        settings.roofColor = _roofPolygonSymbol->fill()->color();
+    }
+
+    ExtrusionParts          parts;
+    std::vector<osg::Vec3d> points;
+    std::vector<unsigned>   rings;
+
+    parts.reserve( features.size() );
+    points.reserve( features.size() * 16 );
+    rings.reserve( features.size() );
+
+    // Step 1 - Serially evaluate the expressions and collect the base and roof
+    // points of every part. Expressions and SRS transforms are not thread-safe.
+    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
+    {
+        Feature* input = f->get();
+
+        if ( _extrusionSymbol->script().isSet() )
+        {
+            StringExpression temp( _extrusionSymbol->script().get() );
+            input->eval( temp, &context );
+        }
+
+        float height;
+        if ( _heightCallback.valid() )
+        {
+            height = _heightCallback->operator()(input, context);
+        }
+        else if ( _heightExpr.isSet() )
+        {
+            height = input->eval( _heightExpr.mutable_value(), &context );
+        }
+        else
+        {
+            height = *_extrusionSymbol->height();
+        }
+
+        float verticalOffset = (float)input->getDouble("__oe_verticalOffset", 0.0);
+
+        std::string name;
+        if ( !_featureNameExpr.empty() )
+            name = input->eval( _featureNameExpr, &context );
+
+        GeometryIterator iter( input->getGeometry(), false );
+        while( iter.hasMore() )
+        {
+            Geometry* part = iter.next();
+
+            if ( part->size() < 2 )
+                continue;
+
+            if ( part->getType() == Geometry::TYPE_POLYGON )
+            {
+                static_cast<Polygon*>(part)->open();
+            }
+
+            // find the minimum Z and the extrusion target across all rings.
+            double absHeight = fabs(height);
+            double targetLen = -DBL_MAX;
+            double minZ      = DBL_MAX;
+
+            ConstGeometryIterator zfinder( part );
+            while( zfinder.hasMore() )
+            {
+                const Geometry* ring = zfinder.next();
+                for( Geometry::const_iterator m = ring->begin(); m != ring->end(); ++m )
+                {
+                    if ( m->z() + absHeight > targetLen )
+                        targetLen = m->z() + absHeight;
+                    if ( m->z() < minZ )
+                        minZ = m->z();
+                }
+            }
+
+            ExtrusionPart ep;
+            ep.feature        = input;
+            ep.name           = name;
+            ep.firstPoint     = points.size();
+            ep.firstRing      = rings.size();
+            ep.isPolygon      = part->getComponentType() == Geometry::TYPE_POLYGON;
+            ep.verticalOffset = verticalOffset;
+
+            osg::Vec2d c = part->getBounds().center2d();
+            points.push_back( osg::Vec3d(c.x(), c.y(), minZ) );
+
+            ConstGeometryIterator ringIter( part );
+            while( ringIter.hasMore() )
+            {
+                const Geometry* ring = ringIter.next();
+                if ( ring->size() < 2 )
+                    continue;
+
+                rings.push_back( ring->size() );
+                ++ep.numRings;
+
+                for( Geometry::const_iterator m = ring->begin(); m != ring->end(); ++m )
+                {
+                    osg::Vec3d base = *m;
+                    osg::Vec3d roof;
+
+                    if ( height >= 0 ) // extrude up
+                    {
+                        roof.set( base.x(), base.y(), settings.flatten ? targetLen : base.z() + height );
+                    }
+                    else // extrude down
+                    {
+                        roof = base;
+                        base.z() += height;
+                    }
+
+                    points.push_back( base );
+                    points.push_back( roof );
+                }
+            }
+
+            parts.push_back( ep );
+        }
+    }
+
+    if ( parts.empty() )
+        return true;
+
+    // one bulk transform for all the points of all the features:
+    if ( srs && !srs->transform(points, outSRS) )
+    {
+        OE_WARN << LC << "Failed to transform extrusion points to the map SRS" << std::endl;
+        return false;
+    }
+
+    // Step 2 - Build the geometry in parallel batches. The calling thread
+    // handles the first batch itself.
+    TaskService* service = 0L;
+    unsigned numBatches = 1u;
+    if ( parts.size() >= 2*MIN_PARTS_PER_BATCH )
+    {
+        service    = getExtrusionService();
+        numBatches = osg::minimum( (unsigned)service->getNumThreads() + 1u, (unsigned)parts.size() / MIN_PARTS_PER_BATCH );
+    }
+
+    unsigned batchSize = (parts.size() + numBatches - 1) / numBatches;
+
+    Threading::MultiEvent semaphore( numBatches - 1 );
+    std::vector< osg::ref_ptr< ParallelTask<ExtrusionBatch> > > tasks;
+    tasks.reserve( numBatches - 1 );
+
+    for( unsigned b = 1; b < numBatches; ++b )
+    {
+        ParallelTask<ExtrusionBatch>* task = new ParallelTask<ExtrusionBatch>( &semaphore );
+        task->_settings = &settings;
+        task->_parts    = &parts;
+        task->_points   = &points;
+        task->_rings    = &rings;
+        task->_first    = b * batchSize;
+        task->_last     = osg::minimum( (unsigned)parts.size(), (b+1) * batchSize );
+        tasks.push_back( task );
+        service->add( task );
+    }
+
+    ExtrusionBatch local;
+    local._settings = &settings;
+    local._parts    = &parts;
+    local._points   = &points;
+    local._rings    = &rings;
+    local._first    = 0u;
+    local._last     = osg::minimum( (unsigned)parts.size(), batchSize );
+    local.execute();
+
+    if ( numBatches > 1 )
+    {
+        semaphore.wait();
+    }
+
+    // Step 3 - Serially collect the results in feature order and index them.
+    FeatureIndexBuilder* index = context.featureIndex();
+
+    for( ExtrusionParts::iterator p = parts.begin(); p != parts.end(); ++p )
+    {
+        if ( p->geometry.valid() )
+        {
+            addDrawable( p->geometry.get(), 0L, p->name, p->feature, index );
+        }
+    }
+
+    return true;
+}
+
 osg::Node*
 ExtrudeGeometryFilter::push( FeatureList& input, FilterContext& context )
 {
@@ -1189,7 +1985,9 @@ ExtrudeGeometryFilter::push( FeatureList& input, FilterContext& context )
     computeLocalizers( context );
 
     // push all the features through the extruder.
-    bool ok = process( input, context );
+    bool ok = canUseFastPath() ?
+        processFast( input, context ) :
+        process( input, context );
 
     // parent geometry with a delocalizer (if necessary)
     osg::Group* group = createDelocalizeGroup();
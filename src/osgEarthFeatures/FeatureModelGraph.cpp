@@ -20,6 +20,7 @@
 #include <osgEarthFeatures/FeatureModelGraph>
 #include <osgEarthFeatures/CropFilter>
 #include <osgEarthFeatures/FeatureSourceIndexNode>
+#include <osgEarthFeatures/FeatureTileSerializer>
 #include <osgEarthFeatures/Session>
 
 #include <osgEarth/Map>
@@ -30,6 +31,7 @@
 #include <osgEarth/ElevationLOD>
 #include <osgEarth/ElevationQuery>
 #include <osgEarth/FadeEffect>
+#include <osgEarth/FileUtils>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/Registry>
 #include <osgEarth/ThreadingUtils>
@@ -38,6 +40,7 @@
 #include <osg/PagedLOD>
 #include <osg/ProxyNode>
 #include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
 #include <osgDB/ReaderWriter>
 #include <osgDB/WriteFile>
 #include <osgUtil/Optimizer>
@@ -249,7 +252,9 @@ _postMergeOperations( postMergeOperations ),
 _dirty              ( false ),
 _pendingUpdate      ( false ),
 _overlayInstalled   ( 0L ),
-_overlayChange      ( OVERLAY_NO_CHANGE )
+_overlayChange      ( OVERLAY_NO_CHANGE ),
+_styleHash          ( 0u ),
+_featureSourceHash  ( 0u )
 {
     ctor();
 }
@@ -268,7 +273,9 @@ _postMergeOperations( postMergeOperations ),
 _dirty              ( false ),
 _pendingUpdate      ( false ),
 _overlayInstalled   ( 0L ),
-_overlayChange      ( OVERLAY_NO_CHANGE )
+_overlayChange      ( OVERLAY_NO_CHANGE ),
+_styleHash          ( 0u ),
+_featureSourceHash  ( 0u )
 {
     ctor();
 }
@@ -295,12 +302,16 @@ FeatureModelGraph::ctor()
     if ( !_session->styles() )
         _session->setStyles( _options.styles().get() );
 
+    updateStyleHash();
+
     if ( !_session->getFeatureSource() )
     {
         OE_WARN << LC << "ILLEGAL: Session must have a feature source" << std::endl;
         return;
     }
 
+    updateFeatureSourceHash();
+
     // Set up a shared resource cache for the session. A session-wide cache means
     // that all the paging threads that load data from this FMG will load resources
     // from a single cache; e.g., once a texture is loaded in one thread, the same
@@ -868,16 +879,22 @@ namespace
 {
     std::string makeCacheKey(const FeatureLevel& level,
                              const GeoExtent& extent,
-                             const TileKey* key)
+                             const TileKey* key,
+                             unsigned styleHash,
+                             unsigned featureSourceHash,
+                             int featureSourceEdits)
     {
+        // The style and the feature source are part of the key so that
+        // changing either one invalidates previously compiled tiles.
         if (key)
         {
-            return key->str();
+            return Stringify() << key->str() << "_" << styleHash << "_" << featureSourceHash << "_" << featureSourceEdits;
         }
         else
         {
             return Stringify() << osgEarth::hashString(
-                Stringify() << extent.toString() << level.styleName().get());
+                Stringify() << extent.toString() << level.styleName().get())
+                << "_" << styleHash << "_" << featureSourceHash << "_" << featureSourceEdits;
         }
     }
 }
@@ -910,14 +927,33 @@ FeatureModelGraph::readTileFromCache(const std::string&    cacheKey,
 
         if (rr.succeeded())
         {
-            group = dynamic_cast<osg::Group*>(rr.getNode());
-            OE_DEBUG << LC << "Loaded from the cache (key = " << cacheKey << ")\n";
-            ++_cacheHits;
+            StringObject* encoded = rr.get<StringObject>();
+            if (encoded)
+            {
+                // compact binary tile (see FeatureTileSerializer)
+                osg::ref_ptr<osg::Node> node = FeatureTileSerializer().read(encoded->getString(), readOptions);
+                group = dynamic_cast<osg::Group*>(node.get());
+            }
+            else
+            {
+                group = dynamic_cast<osg::Group*>(rr.getNode());
+            }
+
+            if (group.valid())
+            {
+                OE_DEBUG << LC << "Loaded from the cache (key = " << cacheKey << ")\n";
+                ++_cacheHits;
 
-            // remap the feature index.
-            if (group.valid() && _featureIndex.valid())
+                // remap the feature index.
+                if (_featureIndex.valid())
+                {
+                    FeatureSourceIndexNode::reconstitute(group.get(), _featureIndex.get());
+                }
+            }
+            else
             {
-                FeatureSourceIndexNode::reconstitute(group.get(), _featureIndex.get());
+                // treat it as missing; the tile is rebuilt and re-cached.
+                OE_WARN << LC << "Failed to decode cached tile (cacheKey=" << cacheKey << "); regenerating\n";
             }
         }
         else if (rr.code() == ReadResult::RESULT_NOT_FOUND)
@@ -956,7 +992,26 @@ FeatureModelGraph::writeTileToCache(const std::string&    cacheKey,
 
     if (cacheBin && policy->isCacheWriteable())
     {
-        cacheBin->writeNode(cacheKey, node, Config(), writeOptions);
+        bool written = false;
+
+        if (_options.binaryTileCache() == true)
+        {
+            cacheBin->prepareNode(node, writeOptions);
+
+            std::string buffer;
+            if (FeatureTileSerializer().write(node, buffer, writeOptions))
+            {
+                osg::ref_ptr<StringObject> encoded = new StringObject(buffer);
+                written = cacheBin->write(cacheKey, encoded.get(), writeOptions);
+            }
+        }
+
+        // fall back on the OSG serializer:
+        if (!written)
+        {
+            cacheBin->writeNode(cacheKey, node, Config(), writeOptions);
+        }
+
         OE_DEBUG << LC << "Wrote " << cacheKey << " to cache\n";
     }
     return true;
@@ -977,7 +1032,12 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
     osg::ref_ptr<osg::Group> group;
 
     // Try to read it from a cache:
-    std::string cacheKey = makeCacheKey(level, extent, key);
+    Revision featureSourceRev;
+    if (_session->getFeatureSource())
+        _session->getFeatureSource()->sync(featureSourceRev);
+
+    std::string cacheKey = makeCacheKey(level, extent, key, _styleHash, _featureSourceHash,
+                                        featureSourceRev - _initialFeatureSourceRev);
     group = readTileFromCache(cacheKey, readOptions);
     
     // Not there? Build it
@@ -1812,5 +1872,39 @@ void
 FeatureModelGraph::setStyles( StyleSheet* styles )
 {
     _session->setStyles( styles );
+    updateStyleHash();
     dirty();
 }
+
+void
+FeatureModelGraph::updateFeatureSourceHash()
+{
+    // Unlike the source's revision, this stays the same from one run to the
+    // next, so tiles cached by an earlier run can be found again. A local data
+    // file also contributes its modification time.
+    const FeatureSource* source = _session->getFeatureSource();
+    Config conf = source->getFeatureSourceOptions().getConfig();
+    std::string fingerprint = conf.toJSON();
+
+    if ( conf.hasValue("url") )
+    {
+        URI uri( conf.value("url"), conf.referrer("url") );
+        if ( !uri.isRemote() && osgDB::fileExists(uri.full()) )
+        {
+            fingerprint += Stringify() << "_" << osgEarth::getLastModifiedTime(uri.full());
+        }
+    }
+
+    _featureSourceHash = osgEarth::hashString( fingerprint );
+
+    // edits made in this run still invalidate the tiles through the revision:
+    source->sync( _initialFeatureSourceRev );
+}
+
+void
+FeatureModelGraph::updateStyleHash()
+{
+    _styleHash = _session->styles() ?
+        osgEarth::hashString(_session->styles()->getConfig().toJSON()) :
+        0u;
+}
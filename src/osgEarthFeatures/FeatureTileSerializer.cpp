@@ -0,0 +1,656 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureTileSerializer>
+#include <osgEarth/Notify>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osgDB/ReaderWriter>
+#include <osgDB/Registry>
+#include <sstream>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#define LC "[FeatureTileSerializer] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+namespace
+{
+    // "OEFT" in a little-endian dword
+    const unsigned MAGIC = 0x5446454Fu;
+
+    // marks a geometry whose primitive sets stayed in the skeleton
+    const unsigned PRIMS_NOT_STRIPPED = 0xFFFFFFFFu;
+
+    enum Slot
+    {
+        SLOT_VERTEX,
+        SLOT_NORMAL,
+        SLOT_COLOR,
+        SLOT_SECONDARY_COLOR,
+        SLOT_FOG_COORD,
+        SLOT_TEXCOORD,
+        SLOT_VERTEX_ATTRIB
+    };
+
+    /** Appends aligned binary data to a string buffer. */
+    struct BlockWriter
+    {
+        std::string& _buf;
+
+        BlockWriter(std::string& buf) : _buf(buf) { }
+
+        void u32(unsigned value) {
+            _buf.append(reinterpret_cast<const char*>(&value), sizeof(unsigned));
+        }
+
+        void bytes(const void* data, unsigned len) {
+            if ( len > 0 )
+                _buf.append(static_cast<const char*>(data), len);
+            while( _buf.size() % 4 != 0 )
+                _buf.push_back('\0');
+        }
+    };
+
+    /** Reads aligned binary data from a string buffer with bounds checking. */
+    struct BlockReader
+    {
+        const std::string& _buf;
+        std::size_t        _pos;
+        bool               _ok;
+
+        BlockReader(const std::string& buf) : _buf(buf), _pos(0), _ok(true) { }
+
+        unsigned u32() {
+            unsigned value = 0u;
+            if ( _ok && _pos + sizeof(unsigned) <= _buf.size() ) {
+                ::memcpy(&value, _buf.data() + _pos, sizeof(unsigned));
+                _pos += sizeof(unsigned);
+            }
+            else {
+                _ok = false;
+            }
+            return value;
+        }
+
+        const char* bytes(unsigned len) {
+            if ( !_ok || _pos + len > _buf.size() ) {
+                _ok = false;
+                return 0L;
+            }
+            const char* ptr = _buf.data() + _pos;
+            _pos += len;
+            while( _pos % 4 != 0 )
+                ++_pos;
+            return ptr;
+        }
+    };
+
+    bool isSupported(const osg::Array* array)
+    {
+        if ( !array )
+            return false;
+
+        switch( array->getType() )
+        {
+        case osg::Array::ByteArrayType:
+        case osg::Array::ShortArrayType:
+        case osg::Array::IntArrayType:
+        case osg::Array::UByteArrayType:
+        case osg::Array::UShortArrayType:
+        case osg::Array::UIntArrayType:
+        case osg::Array::FloatArrayType:
+        case osg::Array::DoubleArrayType:
+        case osg::Array::Vec2ArrayType:
+        case osg::Array::Vec3ArrayType:
+        case osg::Array::Vec4ArrayType:
+        case osg::Array::Vec4ubArrayType:
+        case osg::Array::Vec2dArrayType:
+        case osg::Array::Vec3dArrayType:
+        case osg::Array::Vec4dArrayType:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool isSupported(const osg::PrimitiveSet* prim)
+    {
+        if ( !prim )
+            return false;
+
+        switch( prim->getType() )
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+        case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /** Allocates an array and copies the raw block straight into its storage. */
+    template<typename T>
+    osg::Array* makeArray(const char* data, unsigned numElements, unsigned numBytes)
+    {
+        if ( numElements * sizeof(typename T::ElementDataType) != numBytes )
+            return 0L;
+
+        T* array = new T(numElements);
+        if ( numElements > 0 )
+            ::memcpy( &(*array)[0], data, numBytes );
+        return array;
+    }
+
+    osg::Array* makeArray(unsigned type, const char* data, unsigned numElements, unsigned numBytes)
+    {
+        switch( type )
+        {
+        case osg::Array::ByteArrayType:   return makeArray<osg::ByteArray>  (data, numElements, numBytes);
+        case osg::Array::ShortArrayType:  return makeArray<osg::ShortArray> (data, numElements, numBytes);
+        case osg::Array::IntArrayType:    return makeArray<osg::IntArray>   (data, numElements, numBytes);
+        case osg::Array::UByteArrayType:  return makeArray<osg::UByteArray> (data, numElements, numBytes);
+        case osg::Array::UShortArrayType: return makeArray<osg::UShortArray>(data, numElements, numBytes);
+        case osg::Array::UIntArrayType:   return makeArray<osg::UIntArray>  (data, numElements, numBytes);
+        case osg::Array::FloatArrayType:  return makeArray<osg::FloatArray> (data, numElements, numBytes);
+        case osg::Array::DoubleArrayType: return makeArray<osg::DoubleArray>(data, numElements, numBytes);
+        case osg::Array::Vec2ArrayType:   return makeArray<osg::Vec2Array>  (data, numElements, numBytes);
+        case osg::Array::Vec3ArrayType:   return makeArray<osg::Vec3Array>  (data, numElements, numBytes);
+        case osg::Array::Vec4ArrayType:   return makeArray<osg::Vec4Array>  (data, numElements, numBytes);
+        case osg::Array::Vec4ubArrayType: return makeArray<osg::Vec4ubArray>(data, numElements, numBytes);
+        case osg::Array::Vec2dArrayType:  return makeArray<osg::Vec2dArray> (data, numElements, numBytes);
+        case osg::Array::Vec3dArrayType:  return makeArray<osg::Vec3dArray> (data, numElements, numBytes);
+        case osg::Array::Vec4dArrayType:  return makeArray<osg::Vec4dArray> (data, numElements, numBytes);
+        default: return 0L;
+        }
+    }
+
+    osg::Array* getArray(osg::Geometry* geom, unsigned slot, unsigned index)
+    {
+        switch( slot )
+        {
+        case SLOT_VERTEX:          return geom->getVertexArray();
+        case SLOT_NORMAL:          return geom->getNormalArray();
+        case SLOT_COLOR:           return geom->getColorArray();
+        case SLOT_SECONDARY_COLOR: return geom->getSecondaryColorArray();
+        case SLOT_FOG_COORD:       return geom->getFogCoordArray();
+        case SLOT_TEXCOORD:        return geom->getTexCoordArray(index);
+        case SLOT_VERTEX_ATTRIB:   return geom->getVertexAttribArray(index);
+        default: return 0L;
+        }
+    }
+
+    void setArray(osg::Geometry* geom, unsigned slot, unsigned index, osg::Array* array)
+    {
+        switch( slot )
+        {
+        case SLOT_VERTEX:          geom->setVertexArray(array); break;
+        case SLOT_NORMAL:          geom->setNormalArray(array); break;
+        case SLOT_COLOR:           geom->setColorArray(array); break;
+        case SLOT_SECONDARY_COLOR: geom->setSecondaryColorArray(array); break;
+        case SLOT_FOG_COORD:       geom->setFogCoordArray(array); break;
+        case SLOT_TEXCOORD:        geom->setTexCoordArray(index, array); break;
+        case SLOT_VERTEX_ATTRIB:   geom->setVertexAttribArray(index, array); break;
+        default: break;
+        }
+    }
+
+    /**
+     * The OSG 3.4 serializer cannot read back NULL entries in the texture
+     * coordinate or vertex attribute lists, so those slots get an empty
+     * placeholder array instead.
+     */
+    osg::Array* makePlaceholder(unsigned slot)
+    {
+        if ( slot == SLOT_TEXCOORD || slot == SLOT_VERTEX_ATTRIB )
+        {
+            osg::Array* placeholder = new osg::FloatArray();
+            placeholder->setBinding( osg::Array::BIND_OFF );
+            return placeholder;
+        }
+        return 0L;
+    }
+
+    /** Collects each unique geometry in a graph, in a deterministic order. */
+    struct CollectGeometry : public osg::NodeVisitor
+    {
+        std::vector<osg::Geometry*> _geoms;
+        std::set<osg::Geometry*>    _unique;
+
+        CollectGeometry() : osg::NodeVisitor()
+        {
+            setTraversalMode(TRAVERSE_ALL_CHILDREN);
+            setNodeMaskOverride(~0);
+        }
+
+        void apply(osg::Geode& geode)
+        {
+            for (unsigned i = 0; i < geode.getNumDrawables(); ++i)
+            {
+                osg::Geometry* geom = geode.getDrawable(i) ? geode.getDrawable(i)->asGeometry() : 0L;
+                if ( geom && _unique.insert(geom).second )
+                    _geoms.push_back( geom );
+            }
+            traverse(geode);
+        }
+    };
+
+    /** Data removed from a geometry before the skeleton is written. */
+    struct StrippedArray
+    {
+        unsigned                 _slot;
+        unsigned                 _index;
+        osg::ref_ptr<osg::Array> _array;
+    };
+
+    struct StrippedGeometry
+    {
+        osg::ref_ptr<osg::Geometry>     _geom;
+        std::vector<StrippedArray>      _arrays;
+        osg::Geometry::PrimitiveSetList _prims;
+        bool                            _primsStripped;
+    };
+
+    /**
+     * Removes the data blocks from all geometries in a graph, and puts
+     * them back when it goes out of scope.
+     */
+    struct GeometryStripper
+    {
+        std::vector<StrippedGeometry> _stripped;
+
+        void strip(const std::vector<osg::Geometry*>& geoms)
+        {
+            _stripped.resize( geoms.size() );
+
+            for (unsigned g = 0; g < geoms.size(); ++g)
+            {
+                osg::Geometry*    geom = geoms[g];
+                StrippedGeometry& sg   = _stripped[g];
+                sg._geom = geom;
+
+                stripArray(sg, SLOT_VERTEX, 0);
+                stripArray(sg, SLOT_NORMAL, 0);
+                stripArray(sg, SLOT_COLOR, 0);
+                stripArray(sg, SLOT_SECONDARY_COLOR, 0);
+                stripArray(sg, SLOT_FOG_COORD, 0);
+                for (unsigned i = 0; i < geom->getNumTexCoordArrays(); ++i)
+                    stripArray(sg, SLOT_TEXCOORD, i);
+                for (unsigned i = 0; i < geom->getNumVertexAttribArrays(); ++i)
+                    stripArray(sg, SLOT_VERTEX_ATTRIB, i);
+
+                // primitive sets are all-or-nothing, to preserve their order.
+                sg._primsStripped = true;
+                for (unsigned i = 0; i < geom->getNumPrimitiveSets() && sg._primsStripped; ++i)
+                {
+                    if ( !isSupported(geom->getPrimitiveSet(i)) )
+                        sg._primsStripped = false;
+                }
+
+                if ( sg._primsStripped )
+                {
+                    sg._prims = geom->getPrimitiveSetList();
+                    geom->removePrimitiveSet(0, geom->getNumPrimitiveSets());
+                }
+            }
+        }
+
+        void stripArray(StrippedGeometry& sg, unsigned slot, unsigned index)
+        {
+            osg::Array* array = getArray(sg._geom.get(), slot, index);
+            if ( isSupported(array) )
+            {
+                StrippedArray sa;
+                sa._slot  = slot;
+                sa._index = index;
+                sa._array = array;
+                sg._arrays.push_back( sa );
+                setArray( sg._geom.get(), slot, index, makePlaceholder(slot) );
+            }
+        }
+
+        ~GeometryStripper()
+        {
+            for (unsigned g = 0; g < _stripped.size(); ++g)
+            {
+                StrippedGeometry& sg = _stripped[g];
+                for (unsigned i = 0; i < sg._arrays.size(); ++i)
+                {
+                    setArray( sg._geom.get(), sg._arrays[i]._slot, sg._arrays[i]._index, sg._arrays[i]._array.get() );
+                }
+                if ( sg._primsStripped )
+                {
+                    for (unsigned i = 0; i < sg._prims.size(); ++i)
+                        sg._geom->addPrimitiveSet( sg._prims[i].get() );
+                }
+            }
+        }
+    };
+
+    void writePrimitiveSet(BlockWriter& out, const osg::PrimitiveSet* prim)
+    {
+        out.u32( prim->getType() );
+        out.u32( prim->getMode() );
+        out.u32( prim->getNumInstances() );
+
+        switch( prim->getType() )
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+            {
+                const osg::DrawArrays* da = static_cast<const osg::DrawArrays*>(prim);
+                out.u32( da->getFirst() );
+                out.u32( da->getCount() );
+            }
+            break;
+        case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+            {
+                const osg::DrawArrayLengths* dal = static_cast<const osg::DrawArrayLengths*>(prim);
+                out.u32( dal->getFirst() );
+                out.u32( dal->size() );
+                out.bytes( dal->empty() ? 0L : &dal->front(), dal->size()*sizeof(GLsizei) );
+            }
+            break;
+        default:
+            {
+                // any of the DrawElements types; index data is contiguous.
+                const osg::DrawElements* de = prim->getDrawElements();
+                out.u32( de->getNumIndices() );
+                out.bytes( de->getDataPointer(), de->getTotalDataSize() );
+            }
+            break;
+        }
+    }
+
+    osg::PrimitiveSet* readPrimitiveSet(BlockReader& in)
+    {
+        unsigned type         = in.u32();
+        unsigned mode         = in.u32();
+        unsigned numInstances = in.u32();
+
+        osg::PrimitiveSet* prim = 0L;
+
+        switch( type )
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+            {
+                unsigned first = in.u32();
+                unsigned count = in.u32();
+                prim = new osg::DrawArrays(mode, first, count, numInstances);
+            }
+            break;
+        case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+            {
+                unsigned first = in.u32();
+                unsigned num   = in.u32();
+                const char* data = in.bytes(num*sizeof(GLsizei));
+                if ( data )
+                {
+                    osg::DrawArrayLengths* dal = new osg::DrawArrayLengths(mode, first, num);
+                    if ( num > 0 )
+                        ::memcpy( &dal->front(), data, num*sizeof(GLsizei) );
+                    prim = dal;
+                }
+            }
+            break;
+        case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+            {
+                unsigned num = in.u32();
+                const char* data = in.bytes(num*sizeof(GLubyte));
+                if ( data )
+                    prim = new osg::DrawElementsUByte(mode, num, reinterpret_cast<const GLubyte*>(data), numInstances);
+            }
+            break;
+        case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+            {
+                unsigned num = in.u32();
+                const char* data = in.bytes(num*sizeof(GLushort));
+                if ( data )
+                    prim = new osg::DrawElementsUShort(mode, num, reinterpret_cast<const GLushort*>(data), numInstances);
+            }
+            break;
+        case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+            {
+                unsigned num = in.u32();
+                const char* data = in.bytes(num*sizeof(GLuint));
+                if ( data )
+                    prim = new osg::DrawElementsUInt(mode, num, reinterpret_cast<const GLuint*>(data), numInstances);
+            }
+            break;
+        default:
+            break;
+        }
+
+        if ( prim && type == osg::PrimitiveSet::DrawArrayLengthsPrimitiveType )
+            prim->setNumInstances( numInstances );
+
+        return prim;
+    }
+
+    osgDB::ReaderWriter* getSkeletonRW()
+    {
+        return osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    }
+}
+
+//........................................................................
+
+FeatureTileSerializer::FeatureTileSerializer()
+{
+    //nop
+}
+
+bool
+FeatureTileSerializer::isValid(const std::string& buffer)
+{
+    BlockReader in(buffer);
+    unsigned magic   = in.u32();
+    unsigned version = in.u32();
+    return in._ok && magic == MAGIC && version == VERSION;
+}
+
+bool
+FeatureTileSerializer::write(osg::Node*            tile,
+                             std::string&          out,
+                             const osgDB::Options* options) const
+{
+    if ( !tile )
+        return false;
+
+    osgDB::ReaderWriter* rw = getSkeletonRW();
+    if ( !rw )
+    {
+        OE_WARN << LC << "No osgb serializer available\n";
+        return false;
+    }
+
+    CollectGeometry collect;
+    tile->accept( collect );
+
+    // remove the bulk data so the skeleton is small; the stripper restores
+    // the original data when it goes out of scope.
+    GeometryStripper stripper;
+    stripper.strip( collect._geoms );
+
+    std::string skeleton;
+    {
+        std::stringstream buf;
+        osgDB::ReaderWriter::WriteResult wr = rw->writeNode( *tile, buf, options );
+        if ( !wr.success() )
+        {
+            OE_WARN << LC << "Failed to write tile skeleton: " << wr.message() << "\n";
+            return false;
+        }
+        skeleton = buf.str();
+    }
+
+    out.clear();
+    BlockWriter w(out);
+
+    w.u32( MAGIC );
+    w.u32( VERSION );
+    w.u32( skeleton.size() );
+    w.bytes( skeleton.data(), skeleton.size() );
+    w.u32( collect._geoms.size() );
+
+    for (unsigned g = 0; g < stripper._stripped.size(); ++g)
+    {
+        const StrippedGeometry& sg = stripper._stripped[g];
+
+        w.u32( sg._arrays.size() );
+        for (unsigned i = 0; i < sg._arrays.size(); ++i)
+        {
+            const osg::Array* array = sg._arrays[i]._array.get();
+            w.u32( sg._arrays[i]._slot );
+            w.u32( sg._arrays[i]._index );
+            w.u32( array->getType() );
+            w.u32( (unsigned)array->getBinding() );
+            w.u32( array->getNormalize() ? 1u : 0u );
+            w.u32( array->getNumElements() );
+            w.u32( array->getTotalDataSize() );
+            w.bytes( array->getDataPointer(), array->getTotalDataSize() );
+        }
+
+        if ( sg._primsStripped )
+        {
+            w.u32( sg._prims.size() );
+            for (unsigned i = 0; i < sg._prims.size(); ++i)
+                writePrimitiveSet( w, sg._prims[i].get() );
+        }
+        else
+        {
+            w.u32( PRIMS_NOT_STRIPPED );
+        }
+    }
+
+    return true;
+}
+
+osg::Node*
+FeatureTileSerializer::read(const std::string&    buffer,
+                            const osgDB::Options* options) const
+{
+    BlockReader in(buffer);
+
+    unsigned magic   = in.u32();
+    unsigned version = in.u32();
+    if ( !in._ok || magic != MAGIC )
+    {
+        OE_DEBUG << LC << "Buffer is not an encoded feature tile\n";
+        return 0L;
+    }
+
+    if ( version != VERSION )
+    {
+        OE_DEBUG << LC << "Buffer version " << version << " does not match " << VERSION << "\n";
+        return 0L;
+    }
+
+    osgDB::ReaderWriter* rw = getSkeletonRW();
+    if ( !rw )
+        return 0L;
+
+    unsigned skeletonSize = in.u32();
+    const char* skeletonData = in.bytes(skeletonSize);
+    if ( !skeletonData )
+        return 0L;
+
+    osg::ref_ptr<osg::Node> tile;
+    {
+        std::stringstream buf( std::string(skeletonData, skeletonSize) );
+        osgDB::ReaderWriter::ReadResult rr = rw->readNode( buf, options );
+        if ( !rr.success() )
+        {
+            OE_WARN << LC << "Failed to read tile skeleton: " << rr.message() << "\n";
+            return 0L;
+        }
+        tile = rr.getNode();
+    }
+
+    CollectGeometry collect;
+    tile->accept( collect );
+
+    unsigned numGeoms = in.u32();
+    if ( !in._ok || numGeoms != collect._geoms.size() )
+    {
+        OE_WARN << LC << "Geometry count mismatch; tile is corrupt\n";
+        return 0L;
+    }
+
+    for (unsigned g = 0; g < numGeoms; ++g)
+    {
+        osg::Geometry* geom = collect._geoms[g];
+
+        unsigned numArrays = in.u32();
+        for (unsigned i = 0; i < numArrays && in._ok; ++i)
+        {
+            unsigned slot        = in.u32();
+            unsigned index       = in.u32();
+            unsigned type        = in.u32();
+            unsigned binding     = in.u32();
+            unsigned normalize   = in.u32();
+            unsigned numElements = in.u32();
+            unsigned numBytes    = in.u32();
+            const char* data     = in.bytes(numBytes);
+            if ( !data )
+                break;
+
+            osg::Array* array = makeArray(type, data, numElements, numBytes);
+            if ( !array )
+            {
+                OE_WARN << LC << "Illegal array block; tile is corrupt\n";
+                return 0L;
+            }
+
+            array->setBinding( (osg::Array::Binding)binding );
+            array->setNormalize( normalize != 0u );
+            setArray( geom, slot, index, array );
+        }
+
+        unsigned numPrims = in.u32();
+        if ( numPrims != PRIMS_NOT_STRIPPED )
+        {
+            for (unsigned i = 0; i < numPrims && in._ok; ++i)
+            {
+                osg::PrimitiveSet* prim = readPrimitiveSet(in);
+                if ( !prim )
+                {
+                    OE_WARN << LC << "Illegal primitive set block; tile is corrupt\n";
+                    return 0L;
+                }
+                geom->addPrimitiveSet( prim );
+            }
+        }
+
+        if ( !in._ok )
+        {
+            OE_WARN << LC << "Unexpected end of buffer; tile is corrupt\n";
+            return 0L;
+        }
+
+        geom->dirtyBound();
+    }
+
+    return tile.release();
+}
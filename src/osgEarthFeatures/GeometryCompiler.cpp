@@ -22,6 +22,7 @@
 #include <osgEarthFeatures/AltitudeFilter>
 #include <osgEarthFeatures/CentroidFilter>
 #include <osgEarthFeatures/ExtrudeGeometryFilter>
+#include <osgEarthFeatures/GeometryConsolidator>
 #include <osgEarthFeatures/ScatterFilter>
 #include <osgEarthFeatures/SubstituteModelFilter>
 #include <osgEarthFeatures/TessellateOperator>
@@ -70,6 +71,7 @@ _shaderPolicy          ( SHADERPOLICY_GENERATE ),
 _geoInterp             ( GEOINTERP_GREAT_CIRCLE ),
 _optimizeStateSharing  ( true ),
 _optimize              ( false ),
+_consolidateGeometry   ( false ),
 _validate              ( false ),
 _maxPolyTilingAngle    ( 45.0f )
 {
@@ -90,6 +92,7 @@ _shaderPolicy          ( s_defaults.shaderPolicy().value() ),
 _geoInterp             ( s_defaults.geoInterp().value() ),
 _optimizeStateSharing  ( s_defaults.optimizeStateSharing().value() ),
 _optimize              ( s_defaults.optimize().value() ),
+_consolidateGeometry   ( s_defaults.consolidateGeometry().value() ),
 _validate              ( s_defaults.validate().value() ),
 _maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() )
 {
@@ -110,6 +113,7 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.getIfSet   ( "use_vbo", _useVertexBufferObjects);
     conf.getIfSet   ( "optimize_state_sharing", _optimizeStateSharing );
     conf.getIfSet   ( "optimize", _optimize );
+    conf.getIfSet   ( "consolidate_geometry", _consolidateGeometry );
     conf.getIfSet   ( "validate", _validate );
     conf.getIfSet   ( "max_polygon_tiling_angle", _maxPolyTilingAngle );
 
@@ -133,6 +137,7 @@ GeometryCompilerOptions::getConfig() const
     conf.addIfSet   ( "use_vbo", _useVertexBufferObjects);
     conf.addIfSet   ( "optimize_state_sharing", _optimizeStateSharing );
     conf.addIfSet   ( "optimize", _optimize );
+    conf.addIfSet   ( "consolidate_geometry", _consolidateGeometry );
     conf.addIfSet   ( "validate", _validate );
     conf.addIfSet   ( "max_polygon_tiling_angle", _maxPolyTilingAngle );
 
@@ -591,6 +596,17 @@ GeometryCompiler::compile(FeatureList&          workingSet,
 
         if ( trackHistory ) history.push_back( "optimize" );
     }
+
+    // Pack compatible drawables into large shared buffers to cut draw calls.
+    if ( _options.consolidateGeometry() == true )
+    {
+        GeometryConsolidator consolidator;
+        GeometryConsolidator::Stats stats = consolidator.run( resultGroup.get() );
+
+        OE_DEBUG << LC << "consolidated " << stats.drawablesIn << " drawables into " << stats.drawablesOut << std::endl;
+
+        if ( trackHistory ) history.push_back( "consolidate" );
+    }
     
 
     //test: dump the tile to disk
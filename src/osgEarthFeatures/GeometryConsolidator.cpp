@@ -0,0 +1,587 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/GeometryConsolidator>
+#include <osgEarth/Notify>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/PrimitiveSet>
+#include <osg/Version>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#define LC "[GeometryConsolidator] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+namespace
+{
+    typedef std::vector<osg::Geometry*> GeometryVector;
+
+    // Appends src to dst if both are a T. An array with fewer elements than
+    // there are vertices (an overall binding) is expanded to one per vertex.
+    template<typename T>
+    bool appendAs(osg::Array* dst, const osg::Array* src, unsigned numVerts, unsigned reserve)
+    {
+        T*       out = dynamic_cast<T*>(dst);
+        const T* in  = dynamic_cast<const T*>(src);
+        if ( !out || !in )
+            return false;
+
+        if ( out->empty() )
+            out->reserve( reserve );
+
+        if ( in->size() == numVerts )
+            out->insert( out->end(), in->begin(), in->end() );
+        else
+            out->insert( out->end(), numVerts, in->front() );
+
+        return true;
+    }
+
+    bool append(osg::Array* dst, const osg::Array* src, unsigned numVerts, unsigned reserve)
+    {
+        return
+            appendAs<osg::Vec3Array>  (dst, src, numVerts, reserve) ||
+            appendAs<osg::Vec4Array>  (dst, src, numVerts, reserve) ||
+            appendAs<osg::Vec2Array>  (dst, src, numVerts, reserve) ||
+            appendAs<osg::FloatArray> (dst, src, numVerts, reserve) ||
+            appendAs<osg::Vec4ubArray>(dst, src, numVerts, reserve) ||
+            appendAs<osg::UIntArray>  (dst, src, numVerts, reserve) ||
+            appendAs<osg::IntArray>   (dst, src, numVerts, reserve) ||
+            appendAs<osg::Vec3dArray> (dst, src, numVerts, reserve);
+    }
+
+    bool isSupportedArrayType(const osg::Array* a)
+    {
+        switch( a->getType() )
+        {
+        case osg::Array::Vec3ArrayType:
+        case osg::Array::Vec4ArrayType:
+        case osg::Array::Vec2ArrayType:
+        case osg::Array::FloatArrayType:
+        case osg::Array::Vec4ubArrayType:
+        case osg::Array::UIntArrayType:
+        case osg::Array::IntArrayType:
+        case osg::Array::Vec3dArrayType:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool isSupportedMode(GLenum mode)
+    {
+        switch( mode )
+        {
+        case GL_POINTS:
+        case GL_LINES:
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+        case GL_TRIANGLES:
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+        case GL_QUADS:
+        case GL_QUAD_STRIP:
+        case GL_POLYGON:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Describes an optional per-vertex array for the compatibility signature.
+    // Returns false if the array can't be merged.
+    bool describe(std::ostream& sig, const osg::Array* a, osg::Geometry::AttributeBinding binding, unsigned numVerts)
+    {
+        if ( !a || binding == osg::Geometry::BIND_OFF )
+        {
+            sig << "-;";
+            return true;
+        }
+
+        if ( !isSupportedArrayType(a) || a->getNumElements() == 0 )
+            return false;
+
+        if ( binding == osg::Geometry::BIND_PER_VERTEX && a->getNumElements() != numVerts )
+            return false;
+
+        if ( binding != osg::Geometry::BIND_PER_VERTEX && binding != osg::Geometry::BIND_OVERALL )
+            return false;
+
+        sig << a->getType() << "," << (a->getNormalize() ? 1 : 0);
+#if OSG_VERSION_GREATER_OR_EQUAL(3,1,8)
+        sig << "," << (a->getPreserveDataType() ? 1 : 0);
+#endif
+        sig << ";";
+        return true;
+    }
+
+    // Builds a key that is equal for geometries that can share buffers,
+    // or returns false if the geometry can't be merged at all.
+    bool getSignature(const osg::Geometry* geom, std::string& out)
+    {
+        // skip subclasses, which may carry their own data or rendering
+        if ( strcmp(geom->libraryName(), "osg") != 0 || strcmp(geom->className(), "Geometry") != 0 )
+            return false;
+
+        if ( geom->getUpdateCallback() || geom->getCullCallback() || geom->getDrawCallback() ||
+             geom->getEventCallback() || geom->getComputeBoundingBoxCallback() ||
+             geom->getUserDataContainer() )
+            return false;
+
+        const osg::Array* verts = geom->getVertexArray();
+        if ( !verts || verts->getNumElements() == 0 || !isSupportedArrayType(verts) )
+            return false;
+
+        if ( geom->getSecondaryColorArray() || geom->getFogCoordArray() )
+            return false;
+
+        for(unsigned i=0; i<geom->getNumPrimitiveSets(); ++i)
+        {
+            const osg::PrimitiveSet* ps = geom->getPrimitiveSet(i);
+            if ( ps->getNumInstances() > 0 || !isSupportedMode(ps->getMode()) )
+                return false;
+        }
+
+        unsigned numVerts = verts->getNumElements();
+
+        std::ostringstream sig;
+        sig << (const void*)geom->getStateSet() << ";"
+            << geom->getName() << ";"
+            << (geom->getUseVertexBufferObjects() ? 1 : 0) << (geom->getUseDisplayList() ? 1 : 0) << ";"
+            << verts->getType() << ";";
+
+        if ( !describe(sig, geom->getNormalArray(), geom->getNormalBinding(), numVerts) ||
+             !describe(sig, geom->getColorArray(),  geom->getColorBinding(),  numVerts) )
+            return false;
+
+        sig << "t";
+        for(unsigned i=0; i<geom->getNumTexCoordArrays(); ++i)
+        {
+            const osg::Array* a = geom->getTexCoordArray(i);
+            if ( !describe(sig, a, a ? osg::Geometry::BIND_PER_VERTEX : osg::Geometry::BIND_OFF, numVerts) )
+                return false;
+        }
+
+        sig << "a";
+        for(unsigned i=0; i<geom->getNumVertexAttribArrays(); ++i)
+        {
+            if ( !describe(sig, geom->getVertexAttribArray(i), geom->getVertexAttribBinding(i), numVerts) )
+                return false;
+        }
+
+        out = sig.str();
+        return true;
+    }
+
+    /**
+     * Decomposes primitive sets into point, line and triangle index lists,
+     * offset by the position of the source geometry in the merged arrays.
+     */
+    struct PrimitiveCollector : public osg::PrimitiveIndexFunctor
+    {
+        std::vector<GLuint> _points, _lines, _triangles;
+        GLuint              _base;
+        GLenum              _mode;
+        std::vector<GLuint> _current;
+
+        PrimitiveCollector() : _base(0), _mode(0) { }
+
+        void setVertexArray(unsigned, const osg::Vec2*)  { }
+        void setVertexArray(unsigned, const osg::Vec3*)  { }
+        void setVertexArray(unsigned, const osg::Vec4*)  { }
+        void setVertexArray(unsigned, const osg::Vec2d*) { }
+        void setVertexArray(unsigned, const osg::Vec3d*) { }
+        void setVertexArray(unsigned, const osg::Vec4d*) { }
+
+        void drawArrays(GLenum mode, GLint first, GLsizei count)
+        {
+            decompose( mode, count, Sequence(first) );
+        }
+
+        void drawElements(GLenum mode, GLsizei count, const GLubyte* indices)
+        {
+            decompose( mode, count, Indices<GLubyte>(indices) );
+        }
+
+        void drawElements(GLenum mode, GLsizei count, const GLushort* indices)
+        {
+            decompose( mode, count, Indices<GLushort>(indices) );
+        }
+
+        void drawElements(GLenum mode, GLsizei count, const GLuint* indices)
+        {
+            decompose( mode, count, Indices<GLuint>(indices) );
+        }
+
+        void begin(GLenum mode)
+        {
+            _mode = mode;
+            _current.clear();
+        }
+
+        void vertex(unsigned int pos)
+        {
+            _current.push_back( pos );
+        }
+
+        void end()
+        {
+            if ( !_current.empty() )
+                decompose( _mode, _current.size(), Indices<GLuint>(&_current.front()) );
+        }
+
+    private:
+        struct Sequence
+        {
+            Sequence(GLint first) : _first(first) { }
+            GLuint operator()(GLsizei i) const { return _first + i; }
+            GLint _first;
+        };
+
+        template<typename T>
+        struct Indices
+        {
+            Indices(const T* indices) : _indices(indices) { }
+            GLuint operator()(GLsizei i) const { return _indices[i]; }
+            const T* _indices;
+        };
+
+        inline void line(GLuint a, GLuint b)
+        {
+            _lines.push_back( _base + a );
+            _lines.push_back( _base + b );
+        }
+
+        inline void triangle(GLuint a, GLuint b, GLuint c)
+        {
+            if ( a == b || b == c || a == c )
+                return;
+            _triangles.push_back( _base + a );
+            _triangles.push_back( _base + b );
+            _triangles.push_back( _base + c );
+        }
+
+        template<typename INDEX>
+        void decompose(GLenum mode, GLsizei count, const INDEX& index)
+        {
+            switch( mode )
+            {
+            case GL_POINTS:
+                for(GLsizei i=0; i<count; ++i)
+                    _points.push_back( _base + index(i) );
+                break;
+
+            case GL_LINES:
+                for(GLsizei i=0; i+1<count; i+=2)
+                    line( index(i), index(i+1) );
+                break;
+
+            case GL_LINE_STRIP:
+            case GL_LINE_LOOP:
+                for(GLsizei i=0; i+1<count; ++i)
+                    line( index(i), index(i+1) );
+                if ( mode == GL_LINE_LOOP && count > 2 )
+                    line( index(count-1), index(0) );
+                break;
+
+            case GL_TRIANGLES:
+                for(GLsizei i=0; i+2<count; i+=3)
+                    triangle( index(i), index(i+1), index(i+2) );
+                break;
+
+            case GL_TRIANGLE_STRIP:
+                for(GLsizei i=0; i+2<count; ++i)
+                {
+                    if ( i % 2 == 0 )
+                        triangle( index(i), index(i+1), index(i+2) );
+                    else
+                        triangle( index(i+1), index(i), index(i+2) );
+                }
+                break;
+
+            case GL_TRIANGLE_FAN:
+            case GL_POLYGON:
+                for(GLsizei i=1; i+1<count; ++i)
+                    triangle( index(0), index(i), index(i+1) );
+                break;
+
+            case GL_QUADS:
+                for(GLsizei i=0; i+3<count; i+=4)
+                {
+                    triangle( index(i), index(i+1), index(i+2) );
+                    triangle( index(i), index(i+2), index(i+3) );
+                }
+                break;
+
+            case GL_QUAD_STRIP:
+                for(GLsizei i=0; i+3<count; i+=2)
+                {
+                    triangle( index(i),   index(i+1), index(i+2) );
+                    triangle( index(i+1), index(i+3), index(i+2) );
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    };
+
+    void addPrimitive(osg::Geometry* geom, GLenum mode, const std::vector<GLuint>& indices, unsigned numVerts)
+    {
+        if ( indices.empty() )
+            return;
+
+        if ( numVerts <= 0xFFFF )
+        {
+            osg::DrawElementsUShort* de = new osg::DrawElementsUShort( mode );
+            de->reserve( indices.size() );
+            for(std::vector<GLuint>::const_iterator i = indices.begin(); i != indices.end(); ++i)
+                de->push_back( (GLushort)*i );
+            geom->addPrimitiveSet( de );
+        }
+        else
+        {
+            osg::DrawElementsUInt* de = new osg::DrawElementsUInt( mode, indices.begin(), indices.end() );
+            geom->addPrimitiveSet( de );
+        }
+    }
+
+    // Makes an empty array like the prototype, for a merged geometry.
+    osg::Array* makeArray(const osg::Array* proto)
+    {
+        osg::Array* a = static_cast<osg::Array*>( proto->cloneType() );
+        a->setNormalize( proto->getNormalize() );
+#if OSG_VERSION_GREATER_OR_EQUAL(3,1,8)
+        a->setPreserveDataType( proto->getPreserveDataType() );
+#endif
+        return a;
+    }
+
+    // Merges geoms[first, last) into a single geometry.
+    osg::Geometry* merge(const GeometryVector& geoms, unsigned first, unsigned last)
+    {
+        const osg::Geometry* proto = geoms[first];
+
+        unsigned total = 0;
+        for(unsigned g=first; g<last; ++g)
+            total += geoms[g]->getVertexArray()->getNumElements();
+
+        osg::Geometry* out = new osg::Geometry();
+        out->setName( proto->getName() );
+        out->setStateSet( const_cast<osg::StateSet*>(proto->getStateSet()) );
+        out->setDataVariance( proto->getDataVariance() );
+        out->setUseDisplayList( proto->getUseDisplayList() );
+        out->setUseVertexBufferObjects( proto->getUseVertexBufferObjects() );
+
+        osg::ref_ptr<osg::Array> verts = makeArray( proto->getVertexArray() );
+        osg::ref_ptr<osg::Array> normals = proto->getNormalArray() ? makeArray( proto->getNormalArray() ) : 0L;
+        osg::ref_ptr<osg::Array> colors  = proto->getColorArray()  ? makeArray( proto->getColorArray() )  : 0L;
+
+        std::vector< osg::ref_ptr<osg::Array> > texCoords( proto->getNumTexCoordArrays() );
+        for(unsigned i=0; i<texCoords.size(); ++i)
+            if ( proto->getTexCoordArray(i) )
+                texCoords[i] = makeArray( proto->getTexCoordArray(i) );
+
+        std::vector< osg::ref_ptr<osg::Array> > attribs( proto->getNumVertexAttribArrays() );
+        for(unsigned i=0; i<attribs.size(); ++i)
+            if ( proto->getVertexAttribArray(i) )
+                attribs[i] = makeArray( proto->getVertexAttribArray(i) );
+
+        PrimitiveCollector prims;
+
+        for(unsigned g=first; g<last; ++g)
+        {
+            const osg::Geometry* geom = geoms[g];
+            unsigned numVerts = geom->getVertexArray()->getNumElements();
+
+            append( verts.get(), geom->getVertexArray(), numVerts, total );
+            if ( normals.valid() )
+                append( normals.get(), geom->getNormalArray(), numVerts, total );
+            if ( colors.valid() )
+                append( colors.get(), geom->getColorArray(), numVerts, total );
+
+            for(unsigned i=0; i<texCoords.size(); ++i)
+                if ( texCoords[i].valid() )
+                    append( texCoords[i].get(), geom->getTexCoordArray(i), numVerts, total );
+
+            for(unsigned i=0; i<attribs.size(); ++i)
+                if ( attribs[i].valid() )
+                    append( attribs[i].get(), geom->getVertexAttribArray(i), numVerts, total );
+
+            for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+                geom->getPrimitiveSet(p)->accept( prims );
+
+            prims._base += numVerts;
+        }
+
+        out->setVertexArray( verts.get() );
+
+        if ( normals.valid() )
+        {
+            out->setNormalArray( normals.get() );
+            out->setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
+        }
+
+        if ( colors.valid() )
+        {
+            out->setColorArray( colors.get() );
+            out->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
+        }
+
+        for(unsigned i=0; i<texCoords.size(); ++i)
+            if ( texCoords[i].valid() )
+                out->setTexCoordArray( i, texCoords[i].get() );
+
+        for(unsigned i=0; i<attribs.size(); ++i)
+        {
+            if ( attribs[i].valid() )
+            {
+                out->setVertexAttribArray    ( i, attribs[i].get() );
+                out->setVertexAttribBinding  ( i, osg::Geometry::BIND_PER_VERTEX );
+                out->setVertexAttribNormalize( i, attribs[i]->getNormalize() );
+            }
+        }
+
+        addPrimitive( out, GL_TRIANGLES, prims._triangles, total );
+        addPrimitive( out, GL_LINES,     prims._lines,     total );
+        addPrimitive( out, GL_POINTS,    prims._points,    total );
+
+        return out;
+    }
+
+    struct ConsolidateVisitor : public osg::NodeVisitor
+    {
+        ConsolidateVisitor(unsigned maxVertices) :
+            osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), _maxVertices(maxVertices) { }
+
+        void apply(osg::Geode& geode)
+        {
+            unsigned numDrawables = geode.getNumDrawables();
+            _stats.drawablesIn += numDrawables;
+
+            // group the mergeable geometries, in order of first appearance.
+            std::map<std::string, unsigned> groupIndex;
+            std::vector<GeometryVector>     groups;
+            std::vector<int>                drawableGroup( numDrawables, -1 );
+
+            std::string sig;
+            for(unsigned i=0; i<numDrawables; ++i)
+            {
+                osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+                if ( !geom || !getSignature(geom, sig) )
+                    continue;
+
+                std::map<std::string, unsigned>::iterator g = groupIndex.find(sig);
+                if ( g == groupIndex.end() )
+                {
+                    g = groupIndex.insert( std::make_pair(sig, (unsigned)groups.size()) ).first;
+                    groups.push_back( GeometryVector() );
+                }
+                groups[g->second].push_back( geom );
+                drawableGroup[i] = g->second;
+            }
+
+            bool changed = false;
+            for(unsigned g=0; g<groups.size() && !changed; ++g)
+                changed = groups[g].size() > 1;
+
+            if ( !changed )
+            {
+                _stats.drawablesOut += numDrawables;
+                return;
+            }
+
+            // Rebuild the drawable list. Merged geometry takes the place of
+            // the first member of its group, to roughly keep the draw order.
+            std::vector< osg::ref_ptr<osg::Drawable> > drawables;
+            drawables.reserve( numDrawables );
+            std::vector<bool> emitted( groups.size(), false );
+
+            for(unsigned i=0; i<numDrawables; ++i)
+            {
+                int g = drawableGroup[i];
+                if ( g < 0 || groups[g].size() < 2 )
+                {
+                    drawables.push_back( geode.getDrawable(i) );
+                }
+                else if ( !emitted[g] )
+                {
+                    mergeGroup( groups[g], drawables );
+                    _stats.geometriesMerged += groups[g].size();
+                    emitted[g] = true;
+                }
+            }
+
+            geode.removeDrawables( 0, numDrawables );
+            for(unsigned i=0; i<drawables.size(); ++i)
+                geode.addDrawable( drawables[i].get() );
+
+            _stats.drawablesOut += drawables.size();
+        }
+
+        // Packs a group into as few geometries as the vertex limit allows.
+        void mergeGroup(const GeometryVector& group, std::vector< osg::ref_ptr<osg::Drawable> >& output)
+        {
+            unsigned first = 0, count = 0;
+            for(unsigned g=0; g<group.size(); ++g)
+            {
+                unsigned n = group[g]->getVertexArray()->getNumElements();
+                if ( g > first && count + n > _maxVertices )
+                {
+                    output.push_back( first+1 == g ? group[first] : merge(group, first, g) );
+                    first = g;
+                    count = 0;
+                }
+                count += n;
+            }
+            output.push_back( first+1 == group.size() ? group[first] : merge(group, first, group.size()) );
+        }
+
+        unsigned                         _maxVertices;
+        GeometryConsolidator::Stats      _stats;
+    };
+}
+
+//------------------------------------------------------------------------
+
+GeometryConsolidator::GeometryConsolidator() :
+_maxVertices( 1u << 20 )
+{
+    //nop
+}
+
+GeometryConsolidator::Stats
+GeometryConsolidator::run(osg::Node* node) const
+{
+    ConsolidateVisitor visitor( osg::maximum(_maxVertices, 1u) );
+    if ( node )
+        node->accept( visitor );
+
+    OE_DEBUG << LC
+        << "Drawables: " << visitor._stats.drawablesIn << " -> " << visitor._stats.drawablesOut
+        << " (" << visitor._stats.geometriesMerged << " merged)" << std::endl;
+
+    return visitor._stats;
+}
@@ -21,14 +21,22 @@
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/GeoData>
+#include <osgEarth/StringUtils>
 #include <osgEarthFeatures/FeatureSource>
+#include <osgDB/ObjectWrapper>
 #include <list>
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include <iterator>
+#include <cfloat>
+#include <cmath>
+#include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
-#ifdef OSGEARTH_HAVE_MVT
-#include "vector_tile.pb.h"
-#endif
+#define LC "[MVT] "
 
 using namespace osgEarth;
 using namespace osgEarth::Features;
@@ -38,205 +46,1287 @@ using namespace osgEarth::Features;
 #define CMD_LINETO 2
 #define CMD_CLOSEPATH 7
 
-// https://github.com/mapbox/mapnik-vector-tile/blob/master/examples/c%2B%2B/tileinfo.cpp
-enum CommandType {
-    SEG_END    = 0,
-    SEG_MOVETO = 1,
-    SEG_LINETO = 2,
-    SEG_CLOSE = (0x40 | 0x0f)
-};
-
-enum eGeomType {
-    Unknown = 0,
-    Point = 1,
-    LineString = 2,
-    Polygon = 3
-};
-
-int zig_zag_decode(int n)
+namespace
 {
-    return (n >> 1) ^ (-(n & 1));
-}
+    // protobuf wire types
+    enum WireType
+    {
+        WIRE_VARINT = 0,
+        WIRE_FIXED64 = 1,
+        WIRE_BYTES = 2,
+        WIRE_FIXED32 = 5
+    };
 
+    // field numbers from vector_tile.proto
+    enum { TILE_LAYERS = 3 };
+    enum { LAYER_NAME = 1, LAYER_FEATURES = 2, LAYER_KEYS = 3, LAYER_VALUES = 4, LAYER_EXTENT = 5, LAYER_VERSION = 15 };
+    enum { FEATURE_ID = 1, FEATURE_TAGS = 2, FEATURE_TYPE = 3, FEATURE_GEOMETRY = 4 };
+    enum { VALUE_STRING = 1, VALUE_FLOAT = 2, VALUE_DOUBLE = 3, VALUE_INT = 4, VALUE_UINT = 5, VALUE_SINT = 6, VALUE_BOOL = 7 };
 
-bool
-    MVT::read(std::istream& in, const TileKey& key, FeatureList& features)
-{
-    features.clear();
+    inline int zig_zag_decode(uint32_t n)
+    {
+        return (int)(n >> 1) ^ (-(int)(n & 1));
+    }
 
-#ifdef OSGEARTH_HAVE_MVT
+    inline int64_t zig_zag_decode64(uint64_t n)
+    {
+        return (int64_t)(n >> 1) ^ (-(int64_t)(n & 1));
+    }
 
-    // Get the compressor
-    osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
-    if (!compressor.valid())
+    inline uint32_t zig_zag_encode(int n)
     {
-        return false;
+        return (uint32_t)((n << 1) ^ (n >> 31));
     }
 
-    // Decompress the tile
-    std::string value;
-    if ( !compressor->decompress(in, value) )
+    inline uint64_t zig_zag_encode64(int64_t n)
     {
-        OE_WARN << "Decompression failed" << std::endl;
-        return false;
+        return (uint64_t)((n << 1) ^ (n >> 63));
     }
 
+    /**
+     * Cursor over a protobuf message in memory. Length-delimited fields are
+     * returned as sub-cursors over the same buffer, so nothing is copied.
+     */
+    class PBReader
+    {
+    public:
+        PBReader() : _p(0L), _end(0L), _ok(true), _field(0), _wireType(0) { }
 
-    mapnik::vector::tile tile;
+        PBReader(const char* data, size_t length) :
+            _p((const unsigned char*)data), _end((const unsigned char*)data + length),
+            _ok(true), _field(0), _wireType(0) { }
 
-    if (tile.ParseFromString(value))
-    {
-        for (unsigned int i = 0; i < tile.layers().size(); i++)
+        /** Advances to the next field. Returns false at the end of the message or on error. */
+        bool next()
         {
-            const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
+            if ( !more() )
+                return false;
+            uint64_t key = varint();
+            _field    = (unsigned)(key >> 3);
+            _wireType = (unsigned)(key & 0x7);
+            return _ok;
+        }
 
-            for (unsigned int j = 0; j < layer.features().size(); j++)
+        bool more() const { return _ok && _p < _end; }
+        bool ok() const { return _ok; }
+        unsigned field() const { return _field; }
+        unsigned wireType() const { return _wireType; }
+
+        uint64_t varint()
+        {
+            uint64_t result = 0;
+            for(unsigned shift = 0; _p < _end && shift < 64; shift += 7)
             {
-                const mapnik::vector::tile_feature &feature = layer.features().Get(j);
+                unsigned char b = *_p++;
+                result |= (uint64_t)(b & 0x7F) << shift;
+                if ( (b & 0x80) == 0 )
+                    return result;
+            }
+            _ok = false;
+            return 0;
+        }
 
-                osg::ref_ptr< osgEarth::Symbology::Geometry > geometry; 
+        float fixed32f()
+        {
+            uint32_t bits = (uint32_t)fixed(4);
+            float f;
+            memcpy(&f, &bits, 4);
+            return f;
+        }
 
-                eGeomType geomType = static_cast<eGeomType>(feature.type());
-                if (geomType == ::Polygon)
-                {
-                    geometry = new osgEarth::Symbology::Polygon();
-                }
-                else if (geomType == ::LineString)
-                {
-                    geometry = new osgEarth::Symbology::LineString();
-                }
-                else if (geomType == ::Point)
+        double fixed64f()
+        {
+            uint64_t bits = fixed(8);
+            double d;
+            memcpy(&d, &bits, 8);
+            return d;
+        }
+
+        /** Reads a length-delimited field as a sub-message. */
+        PBReader message()
+        {
+            const char* data;
+            size_t      length;
+            bytes(data, length);
+            return _ok ? PBReader(data, length) : PBReader();
+        }
+
+        /** Reads a length-delimited field, pointing into the buffer. */
+        void bytes(const char*& data, size_t& length)
+        {
+            uint64_t len = varint();
+            if ( !_ok || len > (uint64_t)(_end - _p) )
+            {
+                _ok = false;
+                data = 0L;
+                length = 0;
+                return;
+            }
+            data = (const char*)_p;
+            length = (size_t)len;
+            _p += length;
+        }
+
+        /** Skips the value of the current field. */
+        void skip()
+        {
+            switch( _wireType )
+            {
+            case WIRE_VARINT:  varint(); break;
+            case WIRE_FIXED64: advance(8); break;
+            case WIRE_FIXED32: advance(4); break;
+            case WIRE_BYTES:   { const char* d; size_t n; bytes(d, n); } break;
+            default:           _ok = false;
+            }
+        }
+
+    private:
+        const unsigned char* _p;
+        const unsigned char* _end;
+        bool                 _ok;
+        unsigned             _field;
+        unsigned             _wireType;
+
+        void advance(size_t n)
+        {
+            if ( (size_t)(_end - _p) < n )
+                _ok = false;
+            else
+                _p += n;
+        }
+
+        // little-endian fixed width value
+        uint64_t fixed(unsigned n)
+        {
+            if ( (size_t)(_end - _p) < n )
+            {
+                _ok = false;
+                return 0;
+            }
+            uint64_t v = 0;
+            for(unsigned i=0; i<n; ++i)
+                v |= (uint64_t)_p[i] << (8*i);
+            _p += n;
+            return v;
+        }
+    };
+
+    // Encoded feature, referencing its tags and geometry in the tile buffer.
+    struct EncodedFeature
+    {
+        bool      hasId;
+        FeatureID id;
+        int       type;
+        PBReader  tags;
+        PBReader  geometry;
+    };
+
+    /**
+     * Decodes the layers of one tile. Scratch buffers are reused from one
+     * layer and feature to the next.
+     */
+    class MVTDecoder : public MVT::FeatureView
+    {
+    public:
+        MVTDecoder(const TileKey& key, const MVT::ReadOptions& options) :
+            _key(key), _options(options), _srs(key.getProfile()->getSRS()), _current(0L), _tablesDecoded(false) { }
+
+        bool decodeTile(const char* data, size_t length, FeatureList& features)
+        {
+            PBReader tile(data, length);
+            while( tile.next() )
+            {
+                if ( tile.field() == TILE_LAYERS && tile.wireType() == WIRE_BYTES )
                 {
-                    geometry = new osgEarth::Symbology::PointSet();
+                    PBReader layer = tile.message();
+                    if ( !decodeLayer(layer, features) )
+                        return false;
                 }
                 else
                 {
-                    geometry = new osgEarth::Symbology::LineString();
+                    tile.skip();
                 }
+            }
+            return tile.ok();
+        }
 
-                osg::ref_ptr< Feature > oeFeature = new Feature(geometry, key.getProfile()->getSRS());
-                features.push_back(oeFeature.get());                    
+    public: // MVT::FeatureView
 
-                // Read attributes
-                for (unsigned int k = 0; k < feature.tags().size(); k+=2)
-                {
-                    std::string key = layer.keys().Get(feature.tags().Get(k));
-                    mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
+        const std::string& getLayerName() const { return _layerName; }
 
-                    if (value.has_bool_value())
-                    {
-                        oeFeature->set(key, value.bool_value());
-                    }
-                    else if (value.has_double_value())
+        bool hasFID() const { return _current->hasId; }
+
+        FeatureID getFID() const { return _current->id; }
+
+        MVT::GeometryType getGeometryType() const { return toGeometryType(_current->type); }
+
+        const AttributeValue* getAttribute(const std::string& key) const
+        {
+            const_cast<MVTDecoder*>(this)->decodeTables();
+
+            // find the key index once, then look for it in the tag pairs.
+            unsigned keyIndex = 0;
+            for( ; keyIndex < _keys.size() && !ciEquals(_keys[keyIndex], key); ++keyIndex );
+            if ( keyIndex == _keys.size() )
+                return 0L;
+
+            PBReader tags = _current->tags;
+            while( tags.more() )
+            {
+                uint32_t k = (uint32_t)tags.varint();
+                uint32_t v = (uint32_t)tags.varint();
+                if ( k == keyIndex && v < _values.size() )
+                    return &_values[v];
+            }
+            return 0L;
+        }
+
+    private:
+        const TileKey&              _key;
+        const MVT::ReadOptions&     _options;
+        const SpatialReference*     _srs;
+
+        // current layer:
+        std::string                 _layerName;
+        unsigned                    _extent;
+        std::vector<EncodedFeature> _features;
+        std::vector<std::pair<const char*, size_t> > _keyFields;
+        std::vector<PBReader>       _valueFields;
+        std::vector<std::string>    _keys;
+        std::vector<AttributeValue> _values;
+        const EncodedFeature*       _current;
+        bool                        _tablesDecoded;
+
+        // geometry scratch space:
+        std::vector<osg::Vec3d>     _points;
+        std::vector<unsigned>       _parts;
+
+        static MVT::GeometryType toGeometryType(int type)
+        {
+            return
+                type == 1 ? MVT::GEOMETRY_POINT :
+                type == 2 ? MVT::GEOMETRY_LINESTRING :
+                type == 3 ? MVT::GEOMETRY_POLYGON :
+                MVT::GEOMETRY_UNKNOWN;
+        }
+
+        bool decodeLayer(PBReader& layer, FeatureList& output)
+        {
+            _layerName.clear();
+            _extent = 4096;
+            _features.clear();
+            _keyFields.clear();
+            _valueFields.clear();
+            _tablesDecoded = false;
+
+            // Index the layer first: keys and values may follow the features,
+            // and nothing needs to be decoded if the layer is filtered out.
+            while( layer.next() )
+            {
+                switch( layer.field() )
+                {
+                case LAYER_NAME:
                     {
-                        oeFeature->set(key, value.double_value());
+                        const char* data;
+                        size_t      length;
+                        layer.bytes(data, length);
+                        if ( data )
+                            _layerName.assign(data, length);
                     }
-                    else if (value.has_float_value())
+                    break;
+
+                case LAYER_FEATURES:
                     {
-                        oeFeature->set(key, value.float_value());
+                        PBReader f = layer.message();
+                        _features.push_back(EncodedFeature());
+                        if ( !indexFeature(f, _features.back()) )
+                            return false;
                     }
-                    else if (value.has_int_value())
+                    break;
+
+                case LAYER_KEYS:
                     {
-                        oeFeature->set(key, (int)value.int_value());
+                        std::pair<const char*, size_t> key;
+                        layer.bytes(key.first, key.second);
+                        _keyFields.push_back( key );
                     }
-                    else if (value.has_sint_value())
+                    break;
+
+                case LAYER_VALUES:
+                    _valueFields.push_back( layer.message() );
+                    break;
+
+                case LAYER_EXTENT:
+                    _extent = (unsigned)layer.varint();
+                    break;
+
+                default:
+                    layer.skip();
+                }
+            }
+
+            if ( !layer.ok() )
+            {
+                OE_WARN << LC << "Failed to parse layer \"" << _layerName << "\" in " << _key.str() << std::endl;
+                return false;
+            }
+
+            if ( !_options.layers.empty() && _options.layers.find(_layerName) == _options.layers.end() )
+                return true;
+
+            if ( _extent == 0 )
+                return true;
+
+            double sx = _key.getExtent().width()  / (double)_extent;
+            double sy = _key.getExtent().height() / (double)_extent;
+
+            for(std::vector<EncodedFeature>::const_iterator f = _features.begin(); f != _features.end(); ++f)
+            {
+                _current = &(*f);
+
+                if ( (toGeometryType(f->type) & _options.geometryTypes) == 0 )
+                    continue;
+
+                if ( _options.predicate.valid() && !_options.predicate->accept(*this) )
+                    continue;
+
+                osg::ref_ptr<Geometry> geometry = decodeGeometry(*f, sx, sy);
+                if ( !geometry.valid() )
+                    continue;
+
+                osg::ref_ptr<Feature> feature = new Feature(geometry.get(), _srs);
+                if ( f->hasId )
+                    feature->setFID( f->id );
+
+                if ( _options.readAttributes )
+                    decodeAttributes(*f, feature.get());
+
+                output.push_back( feature.get() );
+            }
+
+            _current = 0L;
+            return true;
+        }
+
+        bool indexFeature(PBReader& in, EncodedFeature& out)
+        {
+            out.hasId = false;
+            out.id    = 0;
+            out.type  = 0;
+
+            while( in.next() )
+            {
+                switch( in.field() )
+                {
+                case FEATURE_ID:       out.hasId = true; out.id = (FeatureID)in.varint(); break;
+                case FEATURE_TAGS:     out.tags = in.message(); break;
+                case FEATURE_TYPE:     out.type = (int)in.varint(); break;
+                case FEATURE_GEOMETRY: out.geometry = in.message(); break;
+                default:               in.skip();
+                }
+            }
+            return in.ok();
+        }
+
+        // Decodes the layer's keys and values, once per layer.
+        void decodeTables()
+        {
+            if ( _tablesDecoded )
+                return;
+
+            _keys.resize( _keyFields.size() );
+            for(unsigned i=0; i<_keyFields.size(); ++i)
+            {
+                if ( _keyFields[i].first )
+                    _keys[i].assign( _keyFields[i].first, _keyFields[i].second );
+                else
+                    _keys[i].clear();
+            }
+
+            _values.resize( _valueFields.size() );
+            for(unsigned i=0; i<_valueFields.size(); ++i)
+            {
+                decodeValue( _valueFields[i], _values[i] );
+            }
+
+            _tablesDecoded = true;
+        }
+
+        void decodeValue(PBReader in, AttributeValue& out)
+        {
+            out.first = ATTRTYPE_UNSPECIFIED;
+            out.second.stringValue.clear();
+            out.second.set = false;
+
+            while( in.next() )
+            {
+                switch( in.field() )
+                {
+                case VALUE_STRING:
                     {
-                        oeFeature->set(key, (int)value.sint_value());
+                        const char* data;
+                        size_t      length;
+                        in.bytes(data, length);
+                        if ( data )
+                            out.second.stringValue.assign(data, length);
+                        out.first = ATTRTYPE_STRING;
                     }
-                    else if (value.has_string_value())
+                    break;
+                case VALUE_FLOAT:
+                    out.second.doubleValue = in.fixed32f();
+                    out.first = ATTRTYPE_DOUBLE;
+                    break;
+                case VALUE_DOUBLE:
+                    out.second.doubleValue = in.fixed64f();
+                    out.first = ATTRTYPE_DOUBLE;
+                    break;
+                case VALUE_INT:
+                    out.second.intValue = (int)(int64_t)in.varint();
+                    out.first = ATTRTYPE_INT;
+                    break;
+                case VALUE_UINT:
+                    out.second.intValue = (int)in.varint();
+                    out.first = ATTRTYPE_INT;
+                    break;
+                case VALUE_SINT:
+                    out.second.intValue = (int)zig_zag_decode64(in.varint());
+                    out.first = ATTRTYPE_INT;
+                    break;
+                case VALUE_BOOL:
+                    out.second.boolValue = in.varint() != 0;
+                    out.first = ATTRTYPE_BOOL;
+                    break;
+                default:
+                    in.skip();
+                    continue;
+                }
+                out.second.set = true;
+            }
+        }
+
+        void decodeAttributes(const EncodedFeature& f, Feature* feature)
+        {
+            decodeTables();
+
+            PBReader tags = f.tags;
+            while( tags.more() )
+            {
+                uint32_t k = (uint32_t)tags.varint();
+                uint32_t v = (uint32_t)tags.varint();
+                if ( !tags.ok() || k >= _keys.size() || v >= _values.size() )
+                    break;
+
+                const std::string&    key   = _keys[k];
+                const AttributeValue& value = _values[v];
+
+                if ( value.first != ATTRTYPE_UNSPECIFIED )
+                {
+                    feature->set( key, value );
+                }
+
+                // Special path for getting heights from our test dataset.
+                if ( key == "other_tags" )
+                {
+                    StringTokenizer tok("=>");
+                    StringVector tized;
+                    tok.tokenize(value.second.stringValue, tized);
+                    if (tized.size() == 3 && tized[0] == "height")
                     {
-                        oeFeature->set(key, value.string_value());
+                        float height = as<float>(tized[2], FLT_MAX);
+                        if (height != FLT_MAX)
+                        {
+                            feature->set("height", height);
+                        }
                     }
-                    else if (value.has_uint_value())
+                }
+            }
+        }
+
+        // Decodes geometry commands into the scratch buffers and then builds a
+        // Geometry of the appropriate type, sized exactly once.
+        Geometry* decodeGeometry(const EncodedFeature& f, double sx, double sy)
+        {
+            _points.clear();
+            _parts.clear();
+
+            double xMin = _key.getExtent().xMin();
+            double yMax = _key.getExtent().yMax();
+
+            bool closed = false;
+            int x = 0, y = 0;
+            PBReader geom = f.geometry;
+
+            while( geom.more() )
+            {
+                uint32_t cmd_length = (uint32_t)geom.varint();
+                unsigned cmd        = cmd_length & ((1 << CMD_BITS) - 1);
+                unsigned count      = cmd_length >> CMD_BITS;
+
+                if ( cmd == CMD_MOVETO || cmd == CMD_LINETO )
+                {
+                    for(unsigned i=0; i<count && geom.more(); ++i)
                     {
-                        oeFeature->set(key, (int)value.uint_value());
+                        x += zig_zag_decode( (uint32_t)geom.varint() );
+                        y += zig_zag_decode( (uint32_t)geom.varint() );
+
+                        if ( cmd == CMD_MOVETO || _parts.empty() )
+                            _parts.push_back( _points.size() );
+
+                        _points.push_back( osg::Vec3d(xMin + sx*(double)x, yMax - sy*(double)y, 0.0) );
                     }
+                }
+                else if ( cmd == CMD_CLOSEPATH )
+                {
+                    closed = true;
+                }
+                else
+                {
+                    OE_DEBUG << LC << "Unknown geometry command " << cmd << " in " << _key.str() << std::endl;
+                    break;
+                }
+            }
 
-                    // Special path for getting heights from our test dataset.
-                    if (key == "other_tags")
-                    {
-                        std::string other_tags = value.string_value();
+            if ( _points.empty() )
+                return 0L;
 
-                        StringTokenizer tok("=>");
-                        StringVector tized;
-                        tok.tokenize(other_tags, tized);            
-                        if (tized.size() == 3)
+            // sentinel to simplify part ranges:
+            _parts.push_back( _points.size() );
+
+            switch( f.type )
+            {
+            case 1:
+                {
+                    PointSet* points = new PointSet( _points.size() );
+                    points->insert( points->end(), _points.begin(), _points.end() );
+                    return points;
+                }
+
+            case 3:
+                return buildPolygons();
+
+            default:
+                return buildLines( closed );
+            }
+        }
+
+        Geometry* buildLines(bool closed)
+        {
+            MultiGeometry* multi = _parts.size() > 2 ? new MultiGeometry() : 0L;
+            Geometry*      last  = 0L;
+
+            for(unsigned p=0; p+1<_parts.size(); ++p)
+            {
+                unsigned first = _parts[p], end = _parts[p+1];
+                if ( end - first < 2 )
+                    continue;
+
+                LineString* line = new LineString( end - first + (closed ? 1 : 0) );
+                line->insert( line->end(), _points.begin() + first, _points.begin() + end );
+                if ( closed )
+                    line->push_back( line->front() );
+
+                last = line;
+                if ( multi )
+                    multi->add( line );
+            }
+
+            if ( multi )
+            {
+                if ( multi->getComponents().empty() )
+                {
+                    delete multi;
+                    return 0L;
+                }
+                return multi;
+            }
+            return last;
+        }
+
+        // Each ring with the same winding as the first ring starts a new polygon;
+        // rings with the opposite winding are holes in the current polygon.
+        Geometry* buildPolygons()
+        {
+            MultiGeometry* multi   = 0L;
+            Polygon*       polygon = 0L;
+            double         firstSign = 0.0;
+
+            for(unsigned p=0; p+1<_parts.size(); ++p)
+            {
+                unsigned first = _parts[p], end = _parts[p+1];
+
+                // drop an explicit closing point; rings are implicitly closed.
+                if ( end - first > 1 && _points[end-1] == _points[first] )
+                    --end;
+
+                if ( end - first < 3 )
+                    continue;
+
+                double area = 0.0;
+                for(unsigned i=first, j=end-1; i<end; j=i++)
+                {
+                    area += _points[j].x()*_points[i].y() - _points[i].x()*_points[j].y();
+                }
+                if ( area == 0.0 )
+                    continue;
+
+                if ( firstSign == 0.0 )
+                    firstSign = area;
+
+                bool isOuter = (area > 0.0) == (firstSign > 0.0);
+
+                Ring* ring;
+                if ( isOuter )
+                {
+                    if ( polygon )
+                    {
+                        if ( !multi )
                         {
-                            if (tized[0] == "height")
-                            {
-                                std::string value = tized[2];
-                                // Remove quotes from the height
-                                float height = as<float>(value, FLT_MAX);
-                                if (height != FLT_MAX)
-                                {
-                                    oeFeature->set("height", height);                                            
-                                }
-                            }
+                            multi = new MultiGeometry();
+                            multi->add( polygon );
                         }
                     }
+                    polygon = new Polygon( end - first );
+                    if ( multi )
+                        multi->add( polygon );
+                    ring = polygon;
+                }
+                else
+                {
+                    ring = new Ring( end - first );
+                    polygon->getHoles().push_back( ring );
                 }
 
+                ring->insert( ring->end(), _points.begin() + first, _points.begin() + end );
+            }
 
-                unsigned int length = 0;
-                int cmd = -1;
-                const int cmd_bits = 3;
+            if ( !polygon )
+                return 0L;
 
-                unsigned int tileres = layer.extent();
+            Geometry* result = multi ? (Geometry*)multi : (Geometry*)polygon;
+            result->rewind( Geometry::ORIENTATION_CCW );
+            return result;
+        }
+    };
 
-                int x = 0;
-                int y = 0;
+    bool isCompressed(const char* data, unsigned length)
+    {
+        if ( length < 2 )
+            return false;
+
+        unsigned char b0 = (unsigned char)data[0], b1 = (unsigned char)data[1];
+
+        // gzip magic, or a zlib header (deflate with a valid check value).
+        // An uncompressed tile always starts with the layers field tag (0x1A).
+        return
+            (b0 == 0x1F && b1 == 0x8B) ||
+            ((b0 & 0x0F) == 8 && ((unsigned)b0*256 + b1) % 31 == 0);
+    }
+
+    /**
+     * Appends protobuf fields to a string buffer.
+     */
+    class PBWriter
+    {
+    public:
+        PBWriter(std::string& buffer) : _buf(buffer) { }
+
+        void varint(uint64_t v)
+        {
+            while( v >= 0x80 )
+            {
+                _buf.push_back( (char)((v & 0x7F) | 0x80) );
+                v >>= 7;
+            }
+            _buf.push_back( (char)v );
+        }
+
+        void key(unsigned field, unsigned wireType)
+        {
+            varint( (field << 3) | wireType );
+        }
 
-                for (int k = 0; k < feature.geometry_size();)
+        void varintField(unsigned field, uint64_t v)
+        {
+            key(field, WIRE_VARINT);
+            varint(v);
+        }
+
+        void doubleField(unsigned field, double d)
+        {
+            uint64_t bits;
+            memcpy(&bits, &d, 8);
+            key(field, WIRE_FIXED64);
+            for(unsigned i=0; i<8; ++i)
+                _buf.push_back( (char)((bits >> (8*i)) & 0xFF) );
+        }
+
+        void bytesField(unsigned field, const std::string& data)
+        {
+            key(field, WIRE_BYTES);
+            varint(data.size());
+            _buf.append(data);
+        }
+
+        /** Writes a packed repeated uint32 field. */
+        void packedField(unsigned field, const std::vector<uint32_t>& values, std::string& scratch)
+        {
+            scratch.clear();
+            PBWriter packed(scratch);
+            for(std::vector<uint32_t>::const_iterator i = values.begin(); i != values.end(); ++i)
+                packed.varint( *i );
+            bytesField(field, scratch);
+        }
+
+    private:
+        std::string& _buf;
+    };
+
+    // Point on the integer tile grid.
+    struct GridPoint
+    {
+        int x, y;
+        bool operator == (const GridPoint& rhs) const { return x == rhs.x && y == rhs.y; }
+        bool operator != (const GridPoint& rhs) const { return !(*this == rhs); }
+    };
+
+    /**
+     * Encodes the features of one layer. Geometry is transformed into tile
+     * space, clipped against the buffered tile in floating point, and then
+     * snapped to the integer grid, dropping repeated points and collapsed
+     * rings. Keys and values are shared by all the features in the layer.
+     */
+    class MVTEncoder
+    {
+    public:
+        MVTEncoder(const TileKey& key, const MVT::WriteOptions& options) :
+            _extent( options.extent )
+        {
+            const GeoExtent& e = key.getExtent();
+            _xMin = e.xMin();
+            _yMax = e.yMax();
+            _sx   = (double)options.extent / e.width();
+            _sy   = (double)options.extent / e.height();
+            _lo   = -(double)options.buffer;
+            _hi   = (double)options.extent + (double)options.buffer;
+        }
+
+        bool encodeTile(const std::string& layerName, const FeatureList& features, std::string& out)
+        {
+            std::string layer;
+            PBWriter w(layer);
+            w.varintField(LAYER_VERSION, 2);
+            w.bytesField(LAYER_NAME, layerName);
+
+            unsigned count = 0;
+            std::string feature;
+            for(FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
+            {
+                if ( f->valid() && encodeFeature(f->get(), feature) )
                 {
-                    if (!length)
+                    w.bytesField(LAYER_FEATURES, feature);
+                    ++count;
+                }
+            }
+
+            if ( count == 0 )
+                return false;
+
+            for(std::vector<std::string>::const_iterator k = _keys.begin(); k != _keys.end(); ++k)
+                w.bytesField(LAYER_KEYS, *k);
+
+            for(std::vector<std::string>::const_iterator v = _values.begin(); v != _values.end(); ++v)
+                w.bytesField(LAYER_VALUES, *v);
+
+            w.varintField(LAYER_EXTENT, _extent);
+
+            PBWriter tile(out);
+            tile.bytesField(TILE_LAYERS, layer);
+            return true;
+        }
+
+    private:
+        unsigned _extent;
+        double   _xMin, _yMax, _sx, _sy, _lo, _hi;
+
+        // layer tables:
+        std::vector<std::string>        _keys;
+        std::map<std::string, uint32_t> _keyIndex;
+        std::vector<std::string>        _values;
+        std::map<std::string, uint32_t> _valueIndex;
+
+        // per-feature scratch space:
+        std::vector<uint32_t>   _commands;
+        std::vector<uint32_t>   _tags;
+        GridPoint               _cursor;
+        std::vector<osg::Vec2d> _path;
+        std::vector<osg::Vec2d> _clipped;
+        std::vector<GridPoint>  _grid;
+        std::string             _scratch;
+
+        bool encodeFeature(const Feature* feature, std::string& out)
+        {
+            const Geometry* geom = feature->getGeometry();
+            if ( !geom )
+                return false;
+
+            _commands.clear();
+            _cursor.x = _cursor.y = 0;
+
+            unsigned type;
+            switch( geom->getComponentType() )
+            {
+            case Geometry::TYPE_POINTSET:
+                type = 1;
+                encodePoints( geom );
+                break;
+            case Geometry::TYPE_POLYGON:
+                type = 3;
+                encodePolygons( geom );
+                break;
+            default:
+                type = 2;
+                encodeLines( geom );
+            }
+
+            if ( _commands.empty() )
+                return false;
+
+            encodeTags( feature->getAttrs() );
+
+            out.clear();
+            PBWriter w(out);
+            w.varintField(FEATURE_ID, feature->getFID());
+            if ( !_tags.empty() )
+                w.packedField(FEATURE_TAGS, _tags, _scratch);
+            w.varintField(FEATURE_TYPE, type);
+            w.packedField(FEATURE_GEOMETRY, _commands, _scratch);
+            return true;
+        }
+
+        //.. geometry ........................................................
+
+        inline osg::Vec2d toTile(const osg::Vec3d& p) const
+        {
+            return osg::Vec2d( (p.x()-_xMin)*_sx, (_yMax-p.y())*_sy );
+        }
+
+        inline static GridPoint snap(const osg::Vec2d& p)
+        {
+            GridPoint g;
+            g.x = (int)floor(p.x() + 0.5);
+            g.y = (int)floor(p.y() + 0.5);
+            return g;
+        }
+
+        inline bool inside(const osg::Vec2d& p) const
+        {
+            return p.x() >= _lo && p.x() <= _hi && p.y() >= _lo && p.y() <= _hi;
+        }
+
+        inline static uint32_t command(unsigned id, unsigned count)
+        {
+            return (id & 0x7) | (count << CMD_BITS);
+        }
+
+        inline void moveCursor(const GridPoint& p)
+        {
+            _commands.push_back( zig_zag_encode(p.x - _cursor.x) );
+            _commands.push_back( zig_zag_encode(p.y - _cursor.y) );
+            _cursor = p;
+        }
+
+        // Transforms a geometry part into tile space, and returns whether
+        // any of it lies outside the buffered tile.
+        bool toTile(const Geometry* part, std::vector<osg::Vec2d>& out) const
+        {
+            out.resize( part->size() );
+            bool needsClip = false;
+            for(unsigned i=0; i<part->size(); ++i)
+            {
+                out[i] = toTile( (*part)[i] );
+                if ( !needsClip && !inside(out[i]) )
+                    needsClip = true;
+            }
+            return needsClip;
+        }
+
+        // Snaps a path to the grid, skipping repeated points.
+        void snapPath(const std::vector<osg::Vec2d>& path)
+        {
+            _grid.clear();
+            for(std::vector<osg::Vec2d>::const_iterator i = path.begin(); i != path.end(); ++i)
+            {
+                GridPoint g = snap( *i );
+                if ( _grid.empty() || g != _grid.back() )
+                    _grid.push_back( g );
+            }
+        }
+
+        void emitPath(bool close)
+        {
+            _commands.push_back( command(CMD_MOVETO, 1) );
+            moveCursor( _grid[0] );
+            _commands.push_back( command(CMD_LINETO, _grid.size()-1) );
+            for(unsigned i=1; i<_grid.size(); ++i)
+                moveCursor( _grid[i] );
+            if ( close )
+                _commands.push_back( command(CMD_CLOSEPATH, 1) );
+        }
+
+        void encodePoints(const Geometry* geom)
+        {
+            _grid.clear();
+            ConstGeometryIterator parts( geom, false );
+            while( parts.hasMore() )
+            {
+                const Geometry* part = parts.next();
+                for(Geometry::const_iterator p = part->begin(); p != part->end(); ++p)
+                {
+                    osg::Vec2d t = toTile( *p );
+                    if ( inside(t) )
+                        _grid.push_back( snap(t) );
+                }
+            }
+
+            if ( !_grid.empty() )
+            {
+                _commands.push_back( command(CMD_MOVETO, _grid.size()) );
+                for(unsigned i=0; i<_grid.size(); ++i)
+                    moveCursor( _grid[i] );
+            }
+        }
+
+        void encodeLines(const Geometry* geom)
+        {
+            ConstGeometryIterator parts( geom, true );
+            while( parts.hasMore() )
+            {
+                const Geometry* part = parts.next();
+                if ( part->size() < 2 )
+                    continue;
+
+                bool needsClip = toTile( part, _path );
+                if ( part->getType() == Geometry::TYPE_RING || part->getType() == Geometry::TYPE_POLYGON )
+                    _path.push_back( _path.front() );
+
+                if ( needsClip )
+                {
+                    clipLine();
+                }
+                else
+                {
+                    snapPath( _path );
+                    if ( _grid.size() >= 2 )
+                        emitPath( false );
+                }
+            }
+        }
+
+        // Clips _path against the buffered tile, emitting a separate
+        // line each time the path leaves and re-enters the tile.
+        void clipLine()
+        {
+            _grid.clear();
+            for(unsigned i=0; i+1<_path.size(); ++i)
+            {
+                osg::Vec2d a = _path[i], b = _path[i+1];
+                if ( !clipSegment(a, b) )
+                {
+                    flushLine();
+                    continue;
+                }
+
+                if ( a != _path[i] )
+                    flushLine();
+
+                appendLinePoint( snap(a) );
+                appendLinePoint( snap(b) );
+
+                if ( b != _path[i+1] )
+                    flushLine();
+            }
+            flushLine();
+        }
+
+        void appendLinePoint(const GridPoint& g)
+        {
+            if ( _grid.empty() || g != _grid.back() )
+                _grid.push_back( g );
+        }
+
+        void flushLine()
+        {
+            if ( _grid.size() >= 2 )
+                emitPath( false );
+            _grid.clear();
+        }
+
+        // Liang-Barsky clip of segment ab to the buffered tile.
+        bool clipSegment(osg::Vec2d& a, osg::Vec2d& b) const
+        {
+            double dx = b.x()-a.x(), dy = b.y()-a.y();
+            double p[4] = { -dx, dx, -dy, dy };
+            double q[4] = { a.x()-_lo, _hi-a.x(), a.y()-_lo, _hi-a.y() };
+            double t0 = 0.0, t1 = 1.0;
+
+            for(unsigned i=0; i<4; ++i)
+            {
+                if ( p[i] == 0.0 )
+                {
+                    if ( q[i] < 0.0 )
+                        return false;
+                }
+                else
+                {
+                    double t = q[i] / p[i];
+                    if ( p[i] < 0.0 )
                     {
-                        unsigned int cmd_length = feature.geometry(k++);
-                        cmd = cmd_length & ((1 << cmd_bits) - 1);
-                        length = cmd_length >> cmd_bits;
-                    } 
-                    if (length > 0)
+                        if ( t > t1 ) return false;
+                        if ( t > t0 ) t0 = t;
+                    }
+                    else
                     {
-                        length--;
-                        if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
-                        {
-                            int px = feature.geometry(k++);
-                            int py = feature.geometry(k++);
-                            px = zig_zag_decode(px);
-                            py = zig_zag_decode(py);
+                        if ( t < t0 ) return false;
+                        if ( t < t1 ) t1 = t;
+                    }
+                }
+            }
 
-                            x += px;
-                            y += py;
+            osg::Vec2d start = a;
+            if ( t0 > 0.0 ) a = start + osg::Vec2d(dx, dy)*t0;
+            if ( t1 < 1.0 ) b = start + osg::Vec2d(dx, dy)*t1;
+            return true;
+        }
 
-                            double width = key.getExtent().width();
-                            double height = key.getExtent().height();
+        void encodePolygons(const Geometry* geom)
+        {
+            ConstGeometryIterator parts( geom, false );
+            while( parts.hasMore() )
+            {
+                const Geometry* part = parts.next();
+                if ( !encodeRing(part, true) )
+                    continue;
 
-                            double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                            double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                            geometry->push_back(geoX, geoY, 0);
-                        }
-                        else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)))
-                        {
-                            geometry->push_back(geometry->front());
-                        }
-                    }
+                const Polygon* polygon = dynamic_cast<const Polygon*>(part);
+                if ( polygon )
+                {
+                    for(RingCollection::const_iterator h = polygon->getHoles().begin(); h != polygon->getHoles().end(); ++h)
+                        encodeRing( h->get(), false );
+                }
+            }
+        }
+
+        // Encodes a ring with the winding the spec requires: exterior rings
+        // have a positive area in (y-down) tile coordinates, holes negative.
+        bool encodeRing(const Geometry* ring, bool exterior)
+        {
+            if ( ring->size() < 3 )
+                return false;
+
+            if ( toTile(ring, _path) )
+                clipRing();
+
+            snapPath( _path );
+            if ( _grid.size() > 1 && _grid.front() == _grid.back() )
+                _grid.pop_back();
+
+            if ( _grid.size() < 3 )
+                return false;
+
+            int64_t area = 0;
+            for(unsigned i=0, j=_grid.size()-1; i<_grid.size(); j=i++)
+                area += (int64_t)_grid[j].x*_grid[i].y - (int64_t)_grid[i].x*_grid[j].y;
+
+            if ( area == 0 )
+                return false;
+
+            if ( (area > 0) != exterior )
+                std::reverse( _grid.begin(), _grid.end() );
+
+            emitPath( true );
+            return true;
+        }
+
+        // Sutherland-Hodgman clip of the ring in _path to the buffered tile.
+        void clipRing()
+        {
+            for(unsigned edge=0; edge<4 && !_path.empty(); ++edge)
+            {
+                _clipped.clear();
+                osg::Vec2d prev   = _path.back();
+                bool       prevIn = insideEdge(prev, edge);
+
+                for(std::vector<osg::Vec2d>::const_iterator i = _path.begin(); i != _path.end(); ++i)
+                {
+                    bool curIn = insideEdge(*i, edge);
+                    if ( curIn != prevIn )
+                        _clipped.push_back( intersectEdge(prev, *i, edge) );
+                    if ( curIn )
+                        _clipped.push_back( *i );
+                    prev   = *i;
+                    prevIn = curIn;
                 }
+                _path.swap( _clipped );
+            }
+        }
+
+        inline bool insideEdge(const osg::Vec2d& p, unsigned edge) const
+        {
+            switch( edge )
+            {
+            case 0:  return p.x() >= _lo;
+            case 1:  return p.x() <= _hi;
+            case 2:  return p.y() >= _lo;
+            default: return p.y() <= _hi;
+            }
+        }
+
+        inline osg::Vec2d intersectEdge(const osg::Vec2d& a, const osg::Vec2d& b, unsigned edge) const
+        {
+            double c = (edge == 0 || edge == 2) ? _lo : _hi;
+            if ( edge < 2 )
+            {
+                double t = (c - a.x()) / (b.x() - a.x());
+                return osg::Vec2d( c, a.y() + t*(b.y() - a.y()) );
+            }
+            else
+            {
+                double t = (c - a.y()) / (b.y() - a.y());
+                return osg::Vec2d( a.x() + t*(b.x() - a.x()), c );
+            }
+        }
 
-                if (geometry->getType() == Geometry::TYPE_POLYGON)
+        //.. attributes ......................................................
+
+        void encodeTags(const AttributeTable& attrs)
+        {
+            _tags.clear();
+            for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+            {
+                const AttributeValue& value = a->second;
+                if ( !value.second.set )
+                    continue;
+
+                _scratch.clear();
+                PBWriter w(_scratch);
+                switch( value.first )
                 {
-                    geometry->rewind(osgEarth::Symbology::Geometry::ORIENTATION_CCW);                                               
+                case ATTRTYPE_STRING: w.bytesField(VALUE_STRING, value.second.stringValue); break;
+                case ATTRTYPE_DOUBLE: w.doubleField(VALUE_DOUBLE, value.second.doubleValue); break;
+                case ATTRTYPE_INT:    w.varintField(VALUE_SINT, zig_zag_encode64(value.second.intValue)); break;
+                case ATTRTYPE_BOOL:   w.varintField(VALUE_BOOL, value.second.boolValue ? 1 : 0); break;
+                default:              continue;
                 }
+
+                _tags.push_back( lookup(a->first, _keys, _keyIndex) );
+                _tags.push_back( lookup(_scratch, _values, _valueIndex) );
             }
         }
+
+        // Index of an entry in a layer table, adding it if necessary.
+        static uint32_t lookup(const std::string& entry, std::vector<std::string>& table, std::map<std::string, uint32_t>& index)
+        {
+            std::map<std::string, uint32_t>::const_iterator i = index.find(entry);
+            if ( i != index.end() )
+                return i->second;
+
+            uint32_t n = table.size();
+            table.push_back( entry );
+            index[entry] = n;
+            return n;
+        }
+    };
+}
+
+bool
+MVT::read(std::istream& in, const TileKey& key, FeatureList& features)
+{
+    return read(in, key, ReadOptions(), features);
+}
+
+bool
+MVT::read(std::istream& in, const TileKey& key, const ReadOptions& options, FeatureList& features)
+{
+    std::string buffer;
+    buffer.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+    return read(buffer.data(), buffer.size(), key, options, features);
+}
+
+bool
+MVT::read(const char* data, unsigned length, const TileKey& key, const ReadOptions& options, FeatureList& features)
+{
+    features.clear();
+
+    if ( !key.valid() || !data || length == 0 )
+        return false;
+
+    // The wire format needs random access (a layer's keys and values follow its
+    // features), so compressed tiles are inflated once up front and decoded in place.
+    std::string inflated;
+    if ( isCompressed(data, length) )
+    {
+        osg::ref_ptr<osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
+        if ( !compressor.valid() )
+        {
+            OE_WARN << LC << "zlib compressor not available" << std::endl;
+            return false;
+        }
+
+        std::string compressed(data, length);
+        std::istringstream in( compressed );
+        if ( !compressor->decompress(in, inflated) )
+        {
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            return false;
+        }
+
+        data   = inflated.data();
+        length = inflated.size();
+    }
+
+    MVTDecoder decoder(key, options);
+    if ( !decoder.decodeTile(data, length, features) )
+    {
+        OE_WARN << LC << "Failed to parse mvt " << key.str() << std::endl;
+        return false;
     }
-    else
+
+    return true;
+}
+
+bool
+MVT::write(const std::string& layerName, const FeatureList& features, const TileKey& key, const WriteOptions& options, std::string& out)
+{
+    out.clear();
+
+    if ( !key.valid() || options.extent == 0 )
+        return false;
+
+    std::string tile;
+    MVTEncoder encoder(key, options);
+    if ( !encoder.encodeTile(layerName, features, tile) )
+        return false;
+
+    if ( !options.compress )
+    {
+        out.swap( tile );
+        return true;
+    }
+
+    osg::ref_ptr<osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
+    if ( !compressor.valid() )
+    {
+        OE_WARN << LC << "zlib compressor not available" << std::endl;
+        return false;
+    }
+
+    std::ostringstream buf;
+    if ( !compressor->compress(buf, tile) )
     {
-        OE_WARN << "Failed to parse mvt" << key.str() << std::endl;
+        OE_WARN << LC << "Compression failed for " << key.str() << std::endl;
         return false;
     }
 
+    out = buf.str();
     return true;
-#else
-    OE_NOTICE << "Mapnik Vector Tiles NOT SUPPORTED - please compile osgEarth with protobuf to enable." << std::endl;
-    return false;
-#endif
 }
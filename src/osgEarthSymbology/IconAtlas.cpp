@@ -0,0 +1,520 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2015 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthSymbology/IconAtlas>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Notify>
+
+#include <osg/GL>
+#include <osg/State>
+#include <string.h>
+
+#define LC "[IconAtlas] "
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+
+//---------------------------------------------------------------------------
+
+namespace
+{
+    // empty pixels around each icon, so linear filtering doesn't pick up
+    // the neighbors (same as the AtlasBuilder)
+    const unsigned MARGIN = 1;
+
+    // past this many pending rectangles, upload the whole page instead
+    const unsigned MAX_RECTS = 64;
+}
+
+//---------------------------------------------------------------------------
+
+/**
+ * Uploads a page image to its texture: the whole image when the texture
+ * object is created, then only the rectangles written since the last
+ * upload in each graphics context. Owns the mutex that guards the page
+ * pixels, since the draw threads read them.
+ */
+class IconAtlas::Uploader : public osg::Texture2D::SubloadCallback
+{
+public:
+    Uploader( osg::Image* image ) :
+        _image       ( image ),
+        _revision    ( 0 ),
+        _fullRevision( 0 )
+    {
+        //nop
+    }
+
+    /** Copies an icon into a cell of the page, and clears the margin. */
+    void write( const osg::Image* icon, unsigned x, unsigned y, unsigned cellWidth, unsigned cellHeight )
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+
+        unsigned rowBytes = cellWidth * 4;
+        for( unsigned r = 0; r < cellHeight; ++r )
+        {
+            ::memset( _image->data(x, y+r), 0, rowBytes );
+        }
+
+        unsigned iconRowBytes = icon->s() * 4;
+        for( int r = 0; r < icon->t(); ++r )
+        {
+            ::memcpy( _image->data(x+MARGIN, y+MARGIN+r), icon->data(0, r), iconRowBytes );
+        }
+
+        ++_revision;
+        if ( _rects.size() >= MAX_RECTS )
+        {
+            _rects.clear();
+            _fullRevision = _revision;
+        }
+        else
+        {
+            Rect rect = { x, y, cellWidth, cellHeight, _revision };
+            _rects.push_back( rect );
+        }
+    }
+
+public: // osg::Texture2D::SubloadCallback
+
+    void load( const osg::Texture2D& texture, osg::State& state ) const
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+
+        glPixelStorei( GL_UNPACK_ALIGNMENT, _image->getPacking() );
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_RGBA8, _image->s(), _image->t(), 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, _image->data() );
+
+        _uploaded[state.getContextID()] = _revision;
+        prune();
+    }
+
+    void subload( const osg::Texture2D& texture, osg::State& state ) const
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+
+        unsigned& uploaded = _uploaded[state.getContextID()];
+        if ( uploaded == _revision )
+            return;
+
+        glPixelStorei( GL_UNPACK_ALIGNMENT, _image->getPacking() );
+
+#ifdef GL_UNPACK_ROW_LENGTH
+        if ( uploaded >= _fullRevision )
+        {
+            glPixelStorei( GL_UNPACK_ROW_LENGTH, _image->s() );
+
+            for( std::vector<Rect>::const_iterator i = _rects.begin(); i != _rects.end(); ++i )
+            {
+                if ( i->_revision > uploaded )
+                {
+                    glTexSubImage2D(
+                        GL_TEXTURE_2D, 0, i->_x, i->_y, i->_width, i->_height,
+                        GL_RGBA, GL_UNSIGNED_BYTE, _image->data(i->_x, i->_y) );
+                }
+            }
+
+            glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+        }
+        else
+#endif
+        {
+            glTexSubImage2D(
+                GL_TEXTURE_2D, 0, 0, 0, _image->s(), _image->t(),
+                GL_RGBA, GL_UNSIGNED_BYTE, _image->data() );
+        }
+
+        uploaded = _revision;
+        prune();
+    }
+
+private:
+    struct Rect
+    {
+        unsigned _x, _y, _width, _height;
+        unsigned _revision;
+    };
+
+    // forgets the rectangles that every context has uploaded
+    void prune() const
+    {
+        unsigned oldest = _revision;
+        for( std::map<unsigned, unsigned>::const_iterator i = _uploaded.begin(); i != _uploaded.end(); ++i )
+            oldest = osg::minimum( oldest, i->second );
+
+        unsigned keep = 0;
+        for( unsigned i = 0; i < _rects.size(); ++i )
+        {
+            if ( _rects[i]._revision > oldest )
+                _rects[keep++] = _rects[i];
+        }
+        _rects.resize( keep );
+    }
+
+    osg::ref_ptr<osg::Image>             _image;
+    unsigned                             _revision;
+    unsigned                             _fullRevision;
+    mutable std::vector<Rect>            _rects;
+    mutable std::map<unsigned, unsigned> _uploaded;   // context ID => revision
+    mutable Threading::Mutex             _mutex;
+};
+
+//---------------------------------------------------------------------------
+
+IconAtlas::IconAtlas( unsigned pageSize, unsigned maxPages ) :
+_pageSize( pageSize ),
+_maxPages( osg::maximum(maxPages, 1u) )
+{
+    //nop
+}
+
+IconAtlas::~IconAtlas()
+{
+    //nop
+}
+
+bool
+IconAtlas::acquire( osg::Image* image, Region& out_region )
+{
+    if ( !image || !image->valid() )
+        return false;
+
+    Threading::ScopedMutexLock lock( _mutex );
+    return acquireLocked( image, std::string(), out_region );
+}
+
+bool
+IconAtlas::acquire( const URI& uri, const osgDB::Options* dbOptions, Region& out_region )
+{
+    if ( uri.empty() )
+        return false;
+
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        std::map<std::string, osg::Image*>::iterator i = _uris.find( uri.full() );
+        if ( i != _uris.end() )
+            return acquireLocked( i->second, uri.full(), out_region );
+    }
+
+    // read outside the lock; another thread may load the same URI meanwhile
+    osg::ref_ptr<osg::Image> image = uri.getImage( dbOptions );
+    if ( !image.valid() || !image->valid() )
+    {
+        OE_WARN << LC << "Failed to load icon \"" << uri.full() << "\"" << std::endl;
+        return false;
+    }
+
+    Threading::ScopedMutexLock lock( _mutex );
+    std::map<std::string, osg::Image*>::iterator i = _uris.find( uri.full() );
+    if ( i != _uris.end() )
+        return acquireLocked( i->second, uri.full(), out_region );
+
+    if ( !acquireLocked( image.get(), uri.full(), out_region ) )
+        return false;
+
+    _uris[uri.full()] = image.get();
+    return true;
+}
+
+bool
+IconAtlas::acquireLocked( osg::Image* image, const std::string& uri, Region& out_region )
+{
+    Entries::iterator i = _entries.find( image );
+    if ( i != _entries.end() )
+    {
+        Entry& entry = i->second;
+        if ( entry._refs == 0 )
+            _unreferenced.erase( entry._lru );
+        ++entry._refs;
+        out_region = entry._region;
+        return true;
+    }
+
+    Entry entry;
+    entry._image = image;
+    entry._uri   = uri;
+    entry._refs  = 1;
+    if ( !insert(entry) )
+        return false;
+
+    _entries[image] = entry;
+    out_region = entry._region;
+    return true;
+}
+
+bool
+IconAtlas::insert( Entry& entry )
+{
+    osg::ref_ptr<const osg::Image> icon = entry._image.get();
+    if ( icon->getPixelFormat() != GL_RGBA || icon->getDataType() != GL_UNSIGNED_BYTE )
+    {
+        icon = ImageUtils::convertToRGBA8( icon.get() );
+        if ( !icon.valid() )
+            return false;
+    }
+
+    unsigned cellWidth  = icon->s() + 2*MARGIN;
+    unsigned cellHeight = icon->t() + 2*MARGIN;
+    if ( cellWidth > _pageSize || cellHeight > _pageSize )
+    {
+        OE_DEBUG << LC << "Icon of " << icon->s() << "x" << icon->t() << " does not fit in a page" << std::endl;
+        return false;
+    }
+
+    for( ;; )
+    {
+        for( unsigned p = 0; p < _pages.size(); ++p )
+        {
+            if ( allocate(p, cellWidth, cellHeight, entry) )
+            {
+                Page& page = _pages[p];
+                unsigned y = page._shelves[entry._shelf]._y;
+                page._uploader->write( icon.get(), entry._x, y, cellWidth, cellHeight );
+
+                float size = (float)_pageSize;
+                entry._region._page   = p;
+                entry._region._width  = icon->s();
+                entry._region._height = icon->t();
+                entry._region._uvMin.set( (float)(entry._x+MARGIN)/size, (float)(y+MARGIN)/size );
+                entry._region._uvMax.set( (float)(entry._x+MARGIN+icon->s())/size, (float)(y+MARGIN+icon->t())/size );
+                return true;
+            }
+        }
+
+        if ( _pages.size() < _maxPages )
+        {
+            addPage();
+        }
+        else if ( !_unreferenced.empty() )
+        {
+            remove( _entries.find(_unreferenced.front()) );
+        }
+        else
+        {
+            OE_DEBUG << LC << "Atlas is full" << std::endl;
+            return false;
+        }
+    }
+}
+
+bool
+IconAtlas::allocate( unsigned pageIndex, unsigned cellWidth, unsigned cellHeight, Entry& entry )
+{
+    Page& page = _pages[pageIndex];
+
+    // the shelf that wastes the least height and has a gap wide enough:
+    int      best      = -1;
+    unsigned bestSpan  = 0;
+    unsigned bestWaste = ~0u;
+    for( unsigned s = 0; s < page._shelves.size(); ++s )
+    {
+        const Shelf& shelf = page._shelves[s];
+        if ( shelf._height < cellHeight || shelf._height - cellHeight >= bestWaste )
+            continue;
+
+        for( unsigned f = 0; f < shelf._free.size(); ++f )
+        {
+            if ( shelf._free[f]._width >= cellWidth )
+            {
+                best      = s;
+                bestSpan  = f;
+                bestWaste = shelf._height - cellHeight;
+                break;
+            }
+        }
+    }
+
+    // a short icon on a tall shelf wastes space; start a new shelf if there's room.
+    bool room = page._top + cellHeight <= _pageSize;
+    if ( room && (best < 0 || bestWaste > cellHeight/2) )
+    {
+        Shelf shelf;
+        shelf._y      = page._top;
+        shelf._height = cellHeight;
+        shelf._used   = 0;
+        Span span = { 0, _pageSize };
+        shelf._free.push_back( span );
+        page._shelves.push_back( shelf );
+        page._top += cellHeight;
+
+        best     = page._shelves.size() - 1;
+        bestSpan = 0;
+    }
+
+    if ( best < 0 )
+        return false;
+
+    Shelf& shelf = page._shelves[best];
+    Span&  span  = shelf._free[bestSpan];
+    entry._shelf     = best;
+    entry._x         = span._x;
+    entry._cellWidth = cellWidth;
+
+    span._x     += cellWidth;
+    span._width -= cellWidth;
+    if ( span._width == 0 )
+        shelf._free.erase( shelf._free.begin() + bestSpan );
+
+    ++shelf._used;
+    return true;
+}
+
+void
+IconAtlas::remove( Entries::iterator i )
+{
+    Entry& entry = i->second;
+    Page&  page  = _pages[entry._region._page];
+    Shelf& shelf = page._shelves[entry._shelf];
+
+    // return the cell to the shelf, merging it with the adjacent gaps
+    Span freed = { entry._x, entry._cellWidth };
+    std::vector<Span>::iterator next = shelf._free.begin();
+    while( next != shelf._free.end() && next->_x < freed._x )
+        ++next;
+
+    if ( next != shelf._free.begin() )
+    {
+        std::vector<Span>::iterator prev = next - 1;
+        if ( prev->_x + prev->_width == freed._x )
+        {
+            freed._x = prev->_x;
+            freed._width += prev->_width;
+            next = shelf._free.erase( prev );
+        }
+    }
+    if ( next != shelf._free.end() && freed._x + freed._width == next->_x )
+    {
+        freed._width += next->_width;
+        next = shelf._free.erase( next );
+    }
+    shelf._free.insert( next, freed );
+
+    --shelf._used;
+
+    // give empty shelves at the top back to the free area
+    while( !page._shelves.empty() && page._shelves.back()._used == 0 )
+    {
+        page._top = page._shelves.back()._y;
+        page._shelves.pop_back();
+    }
+
+    if ( entry._refs == 0 )
+        _unreferenced.erase( entry._lru );
+
+    if ( !entry._uri.empty() )
+        _uris.erase( entry._uri );
+
+    _entries.erase( i );
+}
+
+void
+IconAtlas::addPage()
+{
+    Page page;
+    page._top = 0;
+
+    page._image = new osg::Image();
+    page._image->allocateImage( _pageSize, _pageSize, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    page._image->setInternalTextureFormat( GL_RGBA8 );
+    ::memset( page._image->data(), 0, page._image->getTotalSizeInBytes() );
+
+    page._uploader = new Uploader( page._image.get() );
+
+    // icons draw at their pixel size, so no mipmaps.
+    page._texture = new osg::Texture2D();
+    page._texture->setTextureSize( _pageSize, _pageSize );
+    page._texture->setInternalFormat( GL_RGBA8 );
+    page._texture->setSourceFormat( GL_RGBA );
+    page._texture->setSourceType( GL_UNSIGNED_BYTE );
+    page._texture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR );
+    page._texture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+    page._texture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+    page._texture->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+    page._texture->setResizeNonPowerOfTwoHint( false );
+    page._texture->setSubloadCallback( page._uploader.get() );
+
+    _pages.push_back( page );
+
+    OE_DEBUG << LC << "Added page " << _pages.size() << " of " << _maxPages << std::endl;
+}
+
+void
+IconAtlas::release( osg::Image* image )
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    releaseLocked( image );
+}
+
+void
+IconAtlas::release( const URI& uri )
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    std::map<std::string, osg::Image*>::iterator i = _uris.find( uri.full() );
+    if ( i != _uris.end() )
+        releaseLocked( i->second );
+}
+
+void
+IconAtlas::releaseLocked( osg::Image* image )
+{
+    Entries::iterator i = _entries.find( image );
+    if ( i == _entries.end() || i->second._refs == 0 )
+        return;
+
+    Entry& entry = i->second;
+    if ( --entry._refs == 0 )
+    {
+        _unreferenced.push_back( image );
+        entry._lru = --_unreferenced.end();
+    }
+}
+
+unsigned
+IconAtlas::evict()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    unsigned count = 0;
+    while( !_unreferenced.empty() )
+    {
+        remove( _entries.find(_unreferenced.front()) );
+        ++count;
+    }
+    return count;
+}
+
+unsigned
+IconAtlas::getNumIcons() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return (unsigned)_entries.size();
+}
+
+unsigned
+IconAtlas::getNumPages() const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return (unsigned)_pages.size();
+}
+
+osg::Texture2D*
+IconAtlas::getTexture( unsigned page ) const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    return page < _pages.size() ? _pages[page]._texture.get() : 0L;
+}
@@ -372,6 +372,7 @@ MapNodeHelper::parse(MapNode*             mapNode,
     bool useLogDepth   = args.read("--logdepth");
     bool useLogDepth2  = args.read("--logdepth2");
     bool kmlUI         = args.read("--kmlui");
+    bool kmlStreaming  = args.read("--kmlstreaming");
 
     if (args.read("--verbose"))
         osgEarth::setNotifyLevel(osg::INFO);
@@ -462,6 +463,7 @@ MapNodeHelper::parse(MapNode*             mapNode,
     {
         KMLOptions kml_options;
         kml_options.declutter() = true;
+        kml_options.streaming() = kmlStreaming;
 
         // set up a default icon for point placemarks:
         IconSymbol* defaultIcon = new IconSymbol();
@@ -704,6 +706,7 @@ MapNodeHelper::usage() const
         << "  --sky                         : add a sky model\n"
         << "  --kml <file.kml>              : load a KML or KMZ file\n"
         << "  --kmlui                       : display a UI for toggling nodes loaded with --kml\n"
+        << "  --kmlstreaming                : build --kml placemarks in the background\n"
         << "  --coords                      : display map coords under mouse\n"
         << "  --dms                         : dispay deg/min/sec coords under mouse\n"
         << "  --dd                          : display decimal degrees coords under mouse\n"
@@ -0,0 +1,417 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthUtil/HeightFieldLineOfSight>
+#include <osgEarth/ElevationQuery>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/VerticalDatum>
+#include <OpenThreads/Thread>
+#include <osg/Quat>
+
+#define LC "[HeightFieldLineOfSight] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+//------------------------------------------------------------------------
+
+float
+HeightFieldLineOfSight::Result::getVisibleFraction() const
+{
+    if ( hits.empty() )
+        return 0.0f;
+
+    unsigned visible = 0;
+    for (std::vector<float>::const_iterator i = hits.begin(); i != hits.end(); ++i)
+    {
+        if ( *i < 0.0f )
+            ++visible;
+    }
+    return (float)visible / (float)hits.size();
+}
+
+//------------------------------------------------------------------------
+
+// Marches a range of (observer, radial) pairs. Work is split by radial rather
+// than by observer so that a single observer still uses all the threads.
+struct HeightFieldLineOfSight::MarchRadials
+{
+    MarchRadials() : _los(0L), _observers(0L), _valid(0L), _results(0L), _first(0), _last(0), _spacing(0.0) { }
+
+    void execute()
+    {
+        unsigned numSpokes = _los->_numSpokes;
+        for (unsigned i = _first; i < _last; ++i)
+        {
+            unsigned o = i / numSpokes;
+            if ( (*_valid)[o] )
+            {
+                unsigned spoke = i % numSpokes;
+                (*_results)[o].hits[spoke] = _los->march( (*_observers)[o], spoke, _spacing );
+            }
+        }
+    }
+
+    const HeightFieldLineOfSight*          _los;
+    const std::vector<Observer>*           _observers;
+    const std::vector<bool>*               _valid;
+    std::vector<HeightFieldLineOfSight::Result>* _results;
+    unsigned _first, _last;
+    double   _spacing;
+};
+
+//------------------------------------------------------------------------
+
+HeightFieldLineOfSight::HeightFieldLineOfSight() :
+_radius       ( 500.0 ),
+_numSpokes    ( 20 ),
+_sampleSpacing( 0.0 ),
+_numThreads   ( 0u ),
+_cellSize     ( 0.0 ),
+_geocentric   ( false )
+{
+    setNumThreads( (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() ) );
+}
+
+void
+HeightFieldLineOfSight::setNumThreads(unsigned value)
+{
+    if ( value == _numThreads )
+        return;
+
+    _numThreads = value;
+    _service = _numThreads > 1 ? new TaskService( "HeightFieldLineOfSight", _numThreads ) : 0L;
+}
+
+void
+HeightFieldLineOfSight::setElevationGrid(const GeoHeightField& grid)
+{
+    _grid = grid;
+    _cellSize = 0.0;
+    _geocentric = false;
+
+    if ( !_grid.valid() )
+        return;
+
+    const GeoExtent&        ex  = _grid.getExtent();
+    const osg::HeightField* hf  = _grid.getHeightField();
+    const SpatialReference* srs = ex.getSRS();
+
+    double dx = ex.width() / (double)osg::maximum( 1u, hf->getNumColumns()-1 );
+    double dy = ex.height() / (double)osg::maximum( 1u, hf->getNumRows()-1 );
+
+    if ( srs->isGeographic() )
+    {
+        _geocentric = true;
+        double R = srs->getEllipsoid()->getRadiusEquator();
+        double lat = osg::DegreesToRadians( 0.5*(ex.yMin()+ex.yMax()) );
+        dx = osg::DegreesToRadians(dx) * R * cos(lat);
+        dy = osg::DegreesToRadians(dy) * R;
+    }
+
+    _cellSize = osg::minimum( dx, dy );
+}
+
+bool
+HeightFieldLineOfSight::createElevationGrid(const Map*       map,
+                                            const GeoExtent& extent,
+                                            unsigned         cols,
+                                            unsigned         rows,
+                                            GeoHeightField&  out_grid)
+{
+    if ( !map || !extent.isValid() || cols < 2 || rows < 2 )
+        return false;
+
+    const SpatialReference* srs = extent.getSRS();
+
+    double dx = extent.width() / (double)(cols-1);
+    double dy = extent.height() / (double)(rows-1);
+
+    // Points the query can't resolve keep their Z, so start with NO_DATA.
+    std::vector<osg::Vec3d> points;
+    points.reserve( cols*rows );
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned c = 0; c < cols; ++c)
+        {
+            points.push_back( osg::Vec3d(extent.xMin() + dx*(double)c, extent.yMin() + dy*(double)r, NO_DATA_VALUE) );
+        }
+    }
+
+    ElevationQuery query( map );
+    if ( !query.getElevations(points, srs, true, osg::minimum(dx, dy)) )
+        return false;
+
+    const VerticalDatum* vdatum = srs->isGeographic() ? srs->getVerticalDatum() : 0L;
+
+    osg::HeightField* hf = new osg::HeightField();
+    hf->allocate( cols, rows );
+    hf->setOrigin( osg::Vec3(extent.xMin(), extent.yMin(), 0.0f) );
+    hf->setXInterval( dx );
+    hf->setYInterval( dy );
+
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned c = 0; c < cols; ++c)
+        {
+            const osg::Vec3d& p = points[r*cols + c];
+            double h = p.z();
+            if ( vdatum && h != NO_DATA_VALUE )
+                h = vdatum->msl2hae( p.y(), p.x(), h );
+            hf->setHeight( c, r, (float)h );
+        }
+    }
+
+    out_grid = GeoHeightField( hf, extent );
+    return true;
+}
+
+float
+HeightFieldLineOfSight::getHeight(double x, double y) const
+{
+    const GeoExtent& ex = _grid.getExtent();
+
+    double nx = (x - ex.xMin()) / ex.width();
+    double ny = (y - ex.yMin()) / ex.height();
+    if ( nx < 0.0 || nx > 1.0 || ny < 0.0 || ny > 1.0 )
+        return NO_DATA_VALUE;
+
+    return HeightFieldUtils::getHeightAtNormalizedLocation( _grid.getHeightField(), nx, ny, INTERP_BILINEAR );
+}
+
+bool
+HeightFieldLineOfSight::getObserver(const GeoPoint& point, Observer& out) const
+{
+    const SpatialReference* srs = _grid.getExtent().getSRS();
+
+    GeoPoint p;
+    if ( !point.transform(srs, p) )
+        return false;
+
+    if ( p.isRelative() )
+    {
+        float h = getHeight( p.x(), p.y() );
+        if ( h == NO_DATA_VALUE )
+            return false;
+
+        // grid heights are already ellipsoidal, so skip the vertical datum.
+        double hae = p.z() + (double)h;
+        if ( _geocentric )
+        {
+            srs->getEllipsoid()->convertLatLongHeightToXYZ(
+                osg::DegreesToRadians(p.y()), osg::DegreesToRadians(p.x()), hae,
+                out.center.x(), out.center.y(), out.center.z() );
+        }
+        else
+        {
+            out.center.set( p.x(), p.y(), hae );
+        }
+    }
+    else if ( !p.toWorld(out.center) )
+    {
+        return false;
+    }
+
+    // Same radial layout as RadialLineOfSightNode.
+    out.up = _geocentric ? out.center : osg::Vec3d(0,0,1);
+    out.up.normalize();
+    out.side = _geocentric ? out.up ^ osg::Vec3d(0,0,1) : osg::Vec3d(1,0,0);
+    out.side.normalize();
+    return true;
+}
+
+float
+HeightFieldLineOfSight::march(const Observer& observer, unsigned spoke, double spacing) const
+{
+    double angle = osg::PI * 2.0 / (double)_numSpokes * (double)spoke;
+    osg::Vec3d dir = osg::Quat(angle, observer.up) * observer.side;
+
+    unsigned numSteps = (unsigned)osg::maximum( 1.0, ceil(_radius / spacing) );
+
+    const osg::EllipsoidModel* em = _geocentric ? _grid.getExtent().getSRS()->getEllipsoid() : 0L;
+
+    double prevT = 0.0;
+    double prevClearance = 0.0;
+    bool   hasPrev = false;
+
+    for (unsigned s = 1; s <= numSteps; ++s)
+    {
+        double t = (double)s / (double)numSteps;
+        osg::Vec3d p = observer.center + dir * (_radius * t);
+
+        double x, y, z;
+        if ( em )
+        {
+            double lat, lon;
+            em->convertXYZToLatLongHeight( p.x(), p.y(), p.z(), lat, lon, z );
+            x = osg::RadiansToDegrees(lon);
+            y = osg::RadiansToDegrees(lat);
+        }
+        else
+        {
+            x = p.x();
+            y = p.y();
+            z = p.z();
+        }
+
+        float h = getHeight( x, y );
+        if ( h == NO_DATA_VALUE )
+        {
+            hasPrev = false;
+            continue;
+        }
+
+        double clearance = z - (double)h;
+        if ( clearance < 0.0 )
+        {
+            // Interpolate the crossing between this sample and the last one.
+            if ( hasPrev && prevClearance > clearance )
+                return (float)( prevT + (t - prevT) * prevClearance / (prevClearance - clearance) );
+            return (float)t;
+        }
+
+        prevT = t;
+        prevClearance = clearance;
+        hasPrev = true;
+    }
+
+    return -1.0f;
+}
+
+bool
+HeightFieldLineOfSight::compute(const GeoPoint& observer, Result& out_result) const
+{
+    std::vector<GeoPoint> observers( 1, observer );
+    std::vector<Result>   results;
+    bool ok = compute( observers, results );
+    out_result = results[0];
+    return ok;
+}
+
+bool
+HeightFieldLineOfSight::compute(const std::vector<GeoPoint>& points, std::vector<Result>& out_results) const
+{
+    out_results.clear();
+    out_results.resize( points.size() );
+
+    if ( !_grid.valid() || _numSpokes == 0 || _radius <= 0.0 )
+    {
+        OE_WARN << LC << "Illegal state: no elevation grid, spokes or radius" << std::endl;
+        return false;
+    }
+
+    double spacing = _sampleSpacing > 0.0 ? _sampleSpacing : 0.5*_cellSize;
+    if ( spacing <= 0.0 )
+        spacing = _radius / 256.0;
+
+    // Observer setup goes through the SRS, which isn't thread safe, so do it up front.
+    std::vector<Observer> observers( points.size() );
+    std::vector<bool>     valid( points.size(), false );
+    bool allValid = true;
+
+    for (unsigned i = 0; i < points.size(); ++i)
+    {
+        valid[i] = getObserver( points[i], observers[i] );
+        if ( valid[i] )
+            out_results[i].hits.resize( _numSpokes, -1.0f );
+        else
+            allValid = false;
+    }
+
+    unsigned total    = (unsigned)points.size() * _numSpokes;
+    unsigned numTasks = osg::minimum( _numThreads * 4u, total / 16u );
+
+    if ( _service.valid() && numTasks > 1 )
+    {
+        unsigned taskSize = (total + numTasks - 1) / numTasks;
+        numTasks = (total + taskSize - 1) / taskSize;
+
+        Threading::MultiEvent semaphore( numTasks );
+        for (unsigned t = 0; t < numTasks; ++t)
+        {
+            ParallelTask<MarchRadials>* task = new ParallelTask<MarchRadials>( &semaphore );
+            task->_los       = this;
+            task->_observers = &observers;
+            task->_valid     = &valid;
+            task->_results   = &out_results;
+            task->_first     = t * taskSize;
+            task->_last      = osg::minimum( total, (t + 1) * taskSize );
+            task->_spacing   = spacing;
+            _service->add( task );
+        }
+        semaphore.wait();
+    }
+    else
+    {
+        MarchRadials task;
+        task._los       = this;
+        task._observers = &observers;
+        task._valid     = &valid;
+        task._results   = &out_results;
+        task._first     = 0;
+        task._last      = total;
+        task._spacing   = spacing;
+        task.execute();
+    }
+
+    return allValid;
+}
+
+bool
+HeightFieldLineOfSight::computeGrid(const GeoExtent&    extent,
+                                    unsigned            cols,
+                                    unsigned            rows,
+                                    double              heightAboveTerrain,
+                                    std::vector<float>& out_visibility) const
+{
+    out_visibility.clear();
+    if ( !extent.isValid() || cols < 2 || rows < 2 )
+        return false;
+
+    double dx = extent.width() / (double)(cols-1);
+    double dy = extent.height() / (double)(rows-1);
+
+    std::vector<GeoPoint> observers;
+    observers.reserve( cols*rows );
+    for (unsigned r = 0; r < rows; ++r)
+    {
+        for (unsigned c = 0; c < cols; ++c)
+        {
+            observers.push_back( GeoPoint(
+                extent.getSRS(),
+                extent.xMin() + dx*(double)c, extent.yMin() + dy*(double)r, heightAboveTerrain,
+                ALTMODE_RELATIVE) );
+        }
+    }
+
+    std::vector<Result> results;
+    compute( observers, results );
+
+    out_visibility.reserve( results.size() );
+    for (std::vector<Result>::const_iterator i = results.begin(); i != results.end(); ++i)
+    {
+        out_visibility.push_back( i->hits.empty() ? -1.0f : i->getVisibleFraction() );
+    }
+
+    return _grid.valid();
+}
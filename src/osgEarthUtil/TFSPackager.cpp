@@ -22,9 +22,19 @@
 #include <osgEarthUtil/TFSPackager>
 
 #include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/JsonUtils>
+#include <osgEarthFeatures/MVT>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgEarth/FileUtils>
+#include <OpenThreads/Thread>
+
+#ifdef OSGEARTH_HAVE_SQLITE3
+#include <sqlite3.h>
+#endif
 
 #define LC "[TFSPackager] "
 
@@ -287,6 +297,361 @@ public:
 };
 
 
+/******************************************************************************************/
+
+// A feature's bounds in the output SRS, so vector tiles can find it at every zoom level.
+struct MVTFeatureBounds
+{
+    MVTFeatureBounds( FeatureID fid, const Bounds& bounds ) : _fid( fid ), _bounds( bounds ) { }
+    FeatureID _fid;
+    Bounds _bounds;
+};
+
+typedef std::vector< MVTFeatureBounds > MVTFeatureBoundsList;
+
+// A vector tile waiting to be encoded.
+struct MVTTileJob
+{
+    TileKey _key;
+    FeatureList _features;
+    std::string _data;
+};
+
+// Encodes a range of vector tiles. Everything the encoder touches is owned by
+// the job, so batches can run on separate threads.
+struct EncodeMVTBatch
+{
+    EncodeMVTBatch() : _jobs(0L), _first(0), _last(0), _layerName(0L), _options(0L) { }
+
+    void execute()
+    {
+        for (unsigned i = _first; i < _last; ++i)
+        {
+            MVTTileJob& job = (*_jobs)[i];
+            MVT::write( *_layerName, job._features, job._key, *_options, job._data );
+            job._features.clear();
+        }
+    }
+
+    std::vector< MVTTileJob >* _jobs;
+    unsigned _first, _last;
+    const std::string* _layerName;
+    const MVT::WriteOptions* _options;
+};
+
+#ifdef OSGEARTH_HAVE_SQLITE3
+
+// Minimal MBTiles (https://github.com/mapbox/mbtiles-spec) writer.
+class MBTilesWriter
+{
+public:
+    MBTilesWriter() : _database( 0L ), _insert( 0L ) { }
+
+    ~MBTilesWriter() { close(); }
+
+    bool open( const std::string& filename )
+    {
+        if ( !osgDB::fileExists( osgDB::getFilePath(filename) ) )
+            osgEarth::makeDirectoryForFile( filename );
+
+        if (sqlite3_open_v2( filename.c_str(), &_database, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0L ) != SQLITE_OK)
+        {
+            OE_WARN << LC << "Database \"" << filename << "\": " << sqlite3_errmsg(_database) << std::endl;
+            return false;
+        }
+
+        if (!exec( "CREATE TABLE IF NOT EXISTS metadata (name text, value text)" ) ||
+            !exec( "CREATE UNIQUE INDEX IF NOT EXISTS name ON metadata (name)" ) ||
+            !exec( "CREATE TABLE IF NOT EXISTS tiles (zoom_level integer, tile_column integer, tile_row integer, tile_data blob)" ) ||
+            !exec( "CREATE UNIQUE INDEX IF NOT EXISTS tile_index ON tiles (zoom_level, tile_column, tile_row)" ))
+        {
+            return false;
+        }
+
+        std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+        if (sqlite3_prepare_v2( _database, query.c_str(), -1, &_insert, 0L ) != SQLITE_OK)
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+            return false;
+        }
+
+        // All the tiles go in one transaction; committing per tile is very slow.
+        return exec( "BEGIN TRANSACTION" );
+    }
+
+    bool putMetaData( const std::string& name, const std::string& value )
+    {
+        sqlite3_stmt* insert = 0L;
+        std::string query = "INSERT OR REPLACE INTO metadata (name, value) VALUES (?, ?)";
+        if (sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L ) != SQLITE_OK)
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+            return false;
+        }
+        sqlite3_bind_text( insert, 1, name.c_str(), name.length(), SQLITE_STATIC );
+        sqlite3_bind_text( insert, 2, value.c_str(), value.length(), SQLITE_STATIC );
+        bool ok = sqlite3_step( insert ) == SQLITE_DONE;
+        sqlite3_finalize( insert );
+        return ok;
+    }
+
+    // Writes a tile; the y index is flipped to the TMS scheme used by MBTiles.
+    bool putTile( const TileKey& key, const std::string& data )
+    {
+        unsigned int numRows, numCols;
+        key.getProfile()->getNumTiles( key.getLevelOfDetail(), numCols, numRows );
+
+        sqlite3_reset( _insert );
+        sqlite3_bind_int( _insert, 1, key.getLevelOfDetail() );
+        sqlite3_bind_int( _insert, 2, key.getTileX() );
+        sqlite3_bind_int( _insert, 3, numRows - key.getTileY() - 1 );
+        sqlite3_bind_blob( _insert, 4, data.data(), data.length(), SQLITE_STATIC );
+
+        int rc = sqlite3_step( _insert );
+        if (rc != SQLITE_DONE)
+        {
+            OE_WARN << LC << "Failed to write tile " << key.str() << ": " << sqlite3_errmsg(_database) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (_insert)
+        {
+            sqlite3_finalize( _insert );
+            _insert = 0L;
+        }
+        if (_database)
+        {
+            exec( "COMMIT" );
+            sqlite3_close( _database );
+            _database = 0L;
+        }
+    }
+
+private:
+    sqlite3* _database;
+    sqlite3_stmt* _insert;
+
+    bool exec( const std::string& query )
+    {
+        char* errorMsg = 0L;
+        if (sqlite3_exec( _database, query.c_str(), 0L, 0L, &errorMsg ) != SQLITE_OK)
+        {
+            OE_WARN << LC << "Failed query: " << query << "; " << (errorMsg ? errorMsg : "") << std::endl;
+            sqlite3_free( errorMsg );
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // OSGEARTH_HAVE_SQLITE3
+
+
+
+
+// Range of tiles at a level that a bounding box touches.
+static void
+getTileRange( const Profile* profile, unsigned int lod, const Bounds& bounds,
+              unsigned int& xMin, unsigned int& yMin, unsigned int& xMax, unsigned int& yMax )
+{
+    unsigned int numCols, numRows;
+    profile->getNumTiles( lod, numCols, numRows );
+
+    const GeoExtent& e = profile->getExtent();
+    double tileWidth  = e.width() / (double)numCols;
+    double tileHeight = e.height() / (double)numRows;
+
+    xMin = (unsigned int)osg::clampBetween( (int)floor((bounds.xMin() - e.xMin()) / tileWidth),  0, (int)numCols-1 );
+    xMax = (unsigned int)osg::clampBetween( (int)floor((bounds.xMax() - e.xMin()) / tileWidth),  0, (int)numCols-1 );
+    yMin = (unsigned int)osg::clampBetween( (int)floor((e.yMax() - bounds.yMax()) / tileHeight), 0, (int)numRows-1 );
+    yMax = (unsigned int)osg::clampBetween( (int)floor((e.yMax() - bounds.yMin()) / tileHeight), 0, (int)numRows-1 );
+}
+
+// Name of an attribute type in the MBTiles "vector_layers" fields.
+static const char*
+getFieldType( AttributeType type )
+{
+    switch (type)
+    {
+    case ATTRTYPE_INT:
+    case ATTRTYPE_DOUBLE: return "Number";
+    case ATTRTYPE_BOOL:   return "Boolean";
+    default:              return "String";
+    }
+}
+
+// Encodes every feature into each tile it touches at every level from firstLevel to
+// highestLevel, and stores the tiles in an MBTiles file. Vector tile clients only
+// read one zoom level at a time, so unlike the TFS tree a feature has to be repeated
+// at each level rather than living in a single tile.
+static void
+writeMBTiles( const MVTFeatureBoundsList& featureBounds, FeatureSource* features, const SpatialReference* srs,
+              unsigned int numThreads, const std::string& destination, const std::string& layername,
+              const std::string& description, const GeoExtent& extent, int firstLevel, int highestLevel )
+{
+#ifdef OSGEARTH_HAVE_SQLITE3
+    MBTilesWriter db;
+    if (!db.open( destination ))
+        return;
+
+    GeoExtent bounds = extent.transform( SpatialReference::get("wgs84") );
+    std::stringstream boundsStr;
+    boundsStr << bounds.xMin() << "," << bounds.yMin() << "," << bounds.xMax() << "," << bounds.yMax();
+
+    db.putMetaData( "name", layername );
+    db.putMetaData( "description", description );
+    db.putMetaData( "format", "pbf" );
+    db.putMetaData( "type", "overlay" );
+    db.putMetaData( "minzoom", Stringify() << firstLevel );
+    db.putMetaData( "maxzoom", Stringify() << highestLevel );
+    db.putMetaData( "bounds", boundsStr.str() );
+
+    // Attribute names and types for the "vector_layers" metadata. Sources without
+    // a schema get their fields from the features as they are read.
+    FeatureSchema fields = features->getSchema();
+
+    if (numThreads == 0)
+        numThreads = (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() );
+    osg::ref_ptr< TaskService > service = numThreads > 1 ? new TaskService( "TFSPackager", numThreads ) : 0L;
+
+    const Profile* profile = Registry::instance()->getSphericalMercatorProfile();
+
+    MVT::WriteOptions options;
+
+    // Reading from the feature source, reprojecting and writing to the database
+    // are serial, so the tiles are processed in chunks: read a chunk, encode it
+    // on all threads, write it out, and move on. This also bounds the number of
+    // features held in memory at once.
+    const unsigned chunkSize = numThreads * 64u;
+    unsigned written = 0;
+
+    for (int lod = firstLevel; lod <= highestLevel; ++lod)
+    {
+        // Find the tiles each feature touches at this level:
+        typedef std::map< TileKey, FeatureIDList > TileFeatures;
+        TileFeatures tileFeatures;
+        for (MVTFeatureBoundsList::const_iterator i = featureBounds.begin(); i != featureBounds.end(); ++i)
+        {
+            unsigned int xMin, yMin, xMax, yMax;
+            getTileRange( profile, lod, i->_bounds, xMin, yMin, xMax, yMax );
+            for (unsigned int y = yMin; y <= yMax; ++y)
+            {
+                for (unsigned int x = xMin; x <= xMax; ++x)
+                {
+                    tileFeatures[TileKey(lod, x, y, profile)].push_back( i->_fid );
+                }
+            }
+        }
+
+        TileFeatures::const_iterator chunkStart = tileFeatures.begin();
+        while (chunkStart != tileFeatures.end())
+        {
+            std::vector< MVTTileJob > jobs;
+            jobs.reserve( chunkSize );
+
+            // Features shared by the tiles of this chunk are only read once.
+            std::map< FeatureID, osg::ref_ptr< Feature > > loaded;
+
+            TileFeatures::const_iterator t = chunkStart;
+            for (; t != tileFeatures.end() && jobs.size() < chunkSize; ++t)
+            {
+                jobs.push_back( MVTTileJob() );
+                MVTTileJob& job = jobs.back();
+                job._key = t->first;
+
+                for (FeatureIDList::const_iterator i = t->second.begin(); i != t->second.end(); i++)
+                {
+                    osg::ref_ptr< Feature >& f = loaded[*i];
+                    if (!f.valid())
+                    {
+                        f = features->getFeature( *i );
+                        if (!f.valid())
+                        {
+                            OE_NOTICE << "couldn't get feature " << *i << std::endl;
+                            continue;
+                        }
+
+                        if (!f->getSRS()->isEquivalentTo( srs ))
+                        {
+                            f->transform( srs );
+                        }
+
+                        for (AttributeTable::const_iterator a = f->getAttrs().begin(); a != f->getAttrs().end(); ++a)
+                        {
+                            if (fields.find( a->first ) == fields.end())
+                                fields[a->first] = a->second.first;
+                        }
+                    }
+                    job._features.push_back( f.get() );
+                }
+            }
+            chunkStart = t;
+
+            unsigned numBatches = service.valid() ? osg::minimum( numThreads, (unsigned)jobs.size() ) : 1u;
+            unsigned batchSize = (jobs.size() + numBatches - 1) / numBatches;
+
+            if (numBatches > 1)
+            {
+                Threading::MultiEvent semaphore( numBatches );
+                for (unsigned b = 0; b < numBatches; ++b)
+                {
+                    ParallelTask< EncodeMVTBatch >* task = new ParallelTask< EncodeMVTBatch >( &semaphore );
+                    task->_jobs = &jobs;
+                    task->_first = b * batchSize;
+                    task->_last = osg::minimum( (unsigned)jobs.size(), (b + 1) * batchSize );
+                    task->_layerName = &layername;
+                    task->_options = &options;
+                    service->add( task );
+                }
+                semaphore.wait();
+            }
+            else
+            {
+                EncodeMVTBatch batch;
+                batch._jobs = &jobs;
+                batch._first = 0;
+                batch._last = jobs.size();
+                batch._layerName = &layername;
+                batch._options = &options;
+                batch.execute();
+            }
+
+            for (std::vector< MVTTileJob >::const_iterator job = jobs.begin(); job != jobs.end(); ++job)
+            {
+                if (!job->_data.empty() && db.putTile( job->_key, job->_data ))
+                {
+                    ++written;
+                }
+            }
+        }
+    }
+
+    // MBTiles 1.3 requires a "json" row describing the layers of vector tiles.
+    Json::Value fieldsJson( Json::objectValue );
+    for (FeatureSchema::const_iterator i = fields.begin(); i != fields.end(); ++i)
+    {
+        fieldsJson[i->first] = getFieldType( i->second );
+    }
+
+    Json::Value layerJson( Json::objectValue );
+    layerJson["id"]          = layername;
+    layerJson["description"] = description;
+    layerJson["minzoom"]     = firstLevel;
+    layerJson["maxzoom"]     = highestLevel;
+    layerJson["fields"]      = fieldsJson;
+
+    Json::Value json( Json::objectValue );
+    json["vector_layers"].append( layerJson );
+    db.putMetaData( "json", trim(Json::FastWriter().write( json )) );
+
+    OE_NOTICE << "Wrote " << written << " vector tiles to " << destination << std::endl;
+#endif
+}
+
 
 /******************************************************************************************/
 
@@ -294,14 +659,38 @@ TFSPackager::TFSPackager():
 _firstLevel( 0 ),
     _maxLevel( 10 ),
     _maxFeatures( 300 ),
-    _method( CropFilter::METHOD_CENTROID )
+    _method( CropFilter::METHOD_CENTROID ),
+    _format( FORMAT_JSON ),
+    _numThreads( 0 )
 {
 }
 
 void
     TFSPackager::package( FeatureSource* features, const std::string& destination, const std::string& layername, const std::string& description )
 {   
-    if (!_destSRSString.empty())
+#ifndef OSGEARTH_HAVE_SQLITE3
+    if (_format == FORMAT_MVT)
+    {
+        OE_WARN << LC << "MVT output requires SQLite3 support, which is not available in this build" << std::endl;
+        return;
+    }
+#endif
+
+    // Vector tiles clip each feature to its tile, so a feature has to go into
+    // every tile it crosses or the parts outside its centroid's tile are lost.
+    CropFilter::Method method = _method;
+    if (_format == FORMAT_MVT && method != CropFilter::METHOD_CROPPING)
+    {
+        OE_NOTICE << LC << "MVT output clips features to their tiles; using the cropping method" << std::endl;
+        method = CropFilter::METHOD_CROPPING;
+    }
+
+    if (_format == FORMAT_MVT)
+    {
+        // Vector tiles are always cut from the standard web mercator tiling scheme.
+        _srs = Registry::instance()->getSphericalMercatorProfile()->getSRS();
+    }
+    else if (!_destSRSString.empty())
     {
         _srs = SpatialReference::create( _destSRSString );
     }
@@ -320,7 +709,9 @@ void
     //Transform to lat/lon extents
     GeoExtent extent = srsExtent.transform( _srs.get() );
 
-    osg::ref_ptr< const osgEarth::Profile > profile = osgEarth::Profile::create(extent.getSRS(), extent.xMin(), extent.yMin(), extent.xMax(), extent.yMax(), 1, 1);
+    osg::ref_ptr< const osgEarth::Profile > profile = _format == FORMAT_MVT ?
+        Registry::instance()->getSphericalMercatorProfile() :
+        osgEarth::Profile::create(extent.getSRS(), extent.xMin(), extent.yMin(), extent.xMax(), extent.yMax(), 1, 1);
 
 
     TileKey rootKey = TileKey(0, 0, 0, profile );    
@@ -333,6 +724,7 @@ void
     int failed = 0;
     int skipped = 0;
     int highestLevel = 0;
+    MVTFeatureBoundsList featureBounds;
 
     while (cursor.valid() && cursor->hasMore())
     {        
@@ -347,7 +739,7 @@ void
         if (feature->getGeometry() && feature->getGeometry()->getBounds().valid() && feature->getGeometry()->isValid())
         {
 
-            AddFeatureVisitor v(feature.get(), _maxFeatures, _firstLevel, _maxLevel, _method);
+            AddFeatureVisitor v(feature.get(), _maxFeatures, _firstLevel, _maxLevel, method);
             root->accept( &v );
             if (!v._added)
             {
@@ -360,6 +752,10 @@ void
                 {
                     highestLevel = v._levelAdded;
                 }
+                if (_format == FORMAT_MVT)
+                {
+                    featureBounds.push_back( MVTFeatureBounds(feature->getFID(), feature->getGeometry()->getBounds()) );
+                }
                 added++;
                 OE_DEBUG << "Added " << added << std::endl;
             }   
@@ -382,7 +778,13 @@ void
     }
 #endif
 
-    WriteFeaturesVisitor write(features, destination, _method, _srs);
+    if (_format == FORMAT_MVT)
+    {
+        writeMBTiles( featureBounds, features, _srs.get(), _numThreads, destination, layername, description, extent, _firstLevel, highestLevel );
+        return;
+    }
+
+    WriteFeaturesVisitor write(features, destination, method, _srs);
     root->accept( &write );
 
     //Write out the meta doc
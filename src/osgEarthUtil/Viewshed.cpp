@@ -0,0 +1,340 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2015 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthUtil/Viewshed>
+#include <osgEarthUtil/HeightFieldLineOfSight>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/VerticalDatum>
+#include <OpenThreads/Thread>
+#include <cfloat>
+#include <cstdlib>
+#include <string.h>
+
+#define LC "[Viewshed] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    inline int roundToInt(double v)
+    {
+        return (int)floor(v + 0.5);
+    }
+
+    inline int sign(int v)
+    {
+        return v < 0 ? -1 : 1;
+    }
+
+    // The edge cell, at offsets (px,py) from the observer, of the ray that
+    // owns the cell at offsets (ox,oy). This is the inverse of the cell
+    // selection in Sweep::castRay.
+    inline void getOwner(int ox, int oy, int n, int& px, int& py)
+    {
+        if ( abs(ox) >= abs(oy) )
+        {
+            px = sign(ox) * n;
+            py = roundToInt( (double)oy * (double)n / (double)abs(ox) );
+        }
+        else
+        {
+            px = roundToInt( (double)ox * (double)n / (double)abs(oy) );
+            py = sign(oy) * n;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+// Casts the rays to a range of edge cells, writing the cells they own.
+struct Viewshed::Sweep
+{
+    Sweep() : _hf(0L), _mask(0L), _edge(0L), _first(0), _last(0), _n(0),
+              _observerZ(0.0), _cellSize(0.0), _targetHeight(0.0), _curvature(0.0), _radius(0.0) { }
+
+    void execute()
+    {
+        for (unsigned i = _first; i < _last; ++i)
+        {
+            castRay( (*_edge)[i].first, (*_edge)[i].second );
+        }
+    }
+
+    void castRay(int px, int py)
+    {
+        bool xMajor = abs(px) == _n;
+        int  majorSign = xMajor ? sign(px) : sign(py);
+        int  minorEnd = xMajor ? py : px;
+
+        double maxSlope = -DBL_MAX;
+
+        for (int k = 1; k <= _n; ++k)
+        {
+            double minor = (double)k * (double)minorEnd / (double)_n;
+            double dist  = _cellSize * sqrt( (double)(k*k) + minor*minor );
+            if ( dist > _radius )
+                break;
+
+            // terrain height where the ray crosses the grid line.
+            int    m0 = (int)floor(minor);
+            double f  = minor - (double)m0;
+            float  h0 = getHeight( xMajor, majorSign*k, m0 );
+            float  h1 = f > 0.0 ? getHeight( xMajor, majorSign*k, m0+1 ) : h0;
+            if ( h0 == NO_DATA_VALUE || h1 == NO_DATA_VALUE )
+                continue;
+
+            double z = (double)h0 + f*(double)(h1 - h0) - _curvature*dist*dist;
+
+            int m  = roundToInt(minor);
+            int ox = xMajor ? majorSign*k : m;
+            int oy = xMajor ? m : majorSign*k;
+
+            int ownerX, ownerY;
+            getOwner( ox, oy, _n, ownerX, ownerY );
+            if ( ownerX == px && ownerY == py )
+            {
+                bool visible = (z + _targetHeight - _observerZ) / dist >= maxSlope;
+                _mask[(oy + _n)*(2*_n+1) + (ox + _n)] = visible ? 255 : 0;
+            }
+
+            maxSlope = osg::maximum( maxSlope, (z - _observerZ) / dist );
+        }
+    }
+
+    float getHeight(bool xMajor, int major, int minor) const
+    {
+        int ox = xMajor ? major : minor;
+        int oy = xMajor ? minor : major;
+        return _hf->getHeight( ox + _n, oy + _n );
+    }
+
+    const osg::HeightField*                  _hf;
+    unsigned char*                           _mask;
+    const std::vector< std::pair<int,int> >* _edge;
+    unsigned _first, _last;
+    int      _n;
+    double   _observerZ;
+    double   _cellSize;
+    double   _targetHeight;
+    double   _curvature;
+    double   _radius;
+};
+
+//------------------------------------------------------------------------
+
+Viewshed::Viewshed() :
+_radius      ( 5000.0 ),
+_resolution  ( 256 ),
+_targetHeight( 0.0 ),
+_refraction  ( 0.13 ),
+_numThreads  ( 0u )
+{
+    setNumThreads( (unsigned)osg::maximum( 1, OpenThreads::GetNumberOfProcessors() ) );
+}
+
+void
+Viewshed::setNumThreads(unsigned value)
+{
+    if ( value == _numThreads )
+        return;
+
+    _numThreads = value;
+    _service = _numThreads > 1 ? new TaskService( "Viewshed", _numThreads ) : 0L;
+}
+
+GeoExtent
+Viewshed::getExtent(const GeoPoint& observer) const
+{
+    // Build the extent in geographic coordinates so the cells come out square
+    // in meters, then bring it into the observer's SRS.
+    const SpatialReference* geoSRS = observer.getSRS()->getGeographicSRS();
+    GeoPoint geo;
+    if ( !observer.transform(geoSRS, geo) )
+        return GeoExtent::INVALID;
+
+    double R    = geoSRS->getEllipsoid()->getRadiusEquator();
+    double dLat = osg::RadiansToDegrees( _radius / R );
+    double dLon = osg::RadiansToDegrees( _radius / (R * osg::maximum(0.01, cos(osg::DegreesToRadians(geo.y())))) );
+
+    GeoExtent geoExtent( geoSRS, geo.x()-dLon, geo.y()-dLat, geo.x()+dLon, geo.y()+dLat );
+    GeoExtent extent;
+    if ( !geoExtent.transform(observer.getSRS(), extent) )
+        return GeoExtent::INVALID;
+
+    double hw = 0.5*extent.width(), hh = 0.5*extent.height();
+    return GeoExtent( observer.getSRS(), observer.x()-hw, observer.y()-hh, observer.x()+hw, observer.y()+hh );
+}
+
+bool
+Viewshed::compute(const Map* map, const GeoPoint& observer, GeoImage& out_mask) const
+{
+    if ( !map || !map->getProfile() || _resolution == 0 )
+        return false;
+
+    const SpatialReference* srs = map->getProfile()->getSRS();
+
+    GeoPoint p;
+    if ( !observer.transform(srs, p) )
+        return false;
+
+    GeoExtent extent = getExtent( p );
+    if ( !extent.isValid() )
+        return false;
+
+    unsigned size = 2*_resolution + 1;
+    GeoHeightField grid;
+    if ( !HeightFieldLineOfSight::createElevationGrid(map, extent, size, size, grid) )
+        return false;
+
+    // The grid holds ellipsoidal heights when the SRS has a vertical datum.
+    const osg::HeightField* hf = grid.getHeightField();
+    double z = p.z();
+    if ( p.isRelative() )
+    {
+        float h = hf->getHeight( _resolution, _resolution );
+        if ( h == NO_DATA_VALUE )
+            return false;
+        z += (double)h;
+    }
+    else if ( srs->isGeographic() && srs->getVerticalDatum() )
+    {
+        z = srs->getVerticalDatum()->msl2hae( p.y(), p.x(), z );
+    }
+
+    return computeMask( hf, extent, z, out_mask );
+}
+
+bool
+Viewshed::compute(const GeoHeightField& grid, const GeoPoint& observer, GeoImage& out_mask) const
+{
+    if ( !grid.valid() || _resolution == 0 )
+        return false;
+
+    const GeoExtent& gridExtent = grid.getExtent();
+
+    GeoPoint p;
+    if ( !observer.transform(gridExtent.getSRS(), p) )
+        return false;
+
+    GeoExtent extent = getExtent( p );
+    if ( !extent.isValid() )
+        return false;
+
+    // Resample the grid around the observer; cells off the grid get NO_DATA.
+    unsigned size = 2*_resolution + 1;
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+    hf->allocate( size, size );
+    hf->setOrigin( osg::Vec3(extent.xMin(), extent.yMin(), 0.0f) );
+    hf->setXInterval( extent.width() / (double)(size-1) );
+    hf->setYInterval( extent.height() / (double)(size-1) );
+
+    for (unsigned r = 0; r < size; ++r)
+    {
+        double ny = (extent.yMin() + extent.height()*(double)r/(double)(size-1) - gridExtent.yMin()) / gridExtent.height();
+        for (unsigned c = 0; c < size; ++c)
+        {
+            double nx = (extent.xMin() + extent.width()*(double)c/(double)(size-1) - gridExtent.xMin()) / gridExtent.width();
+            float h = NO_DATA_VALUE;
+            if ( nx >= 0.0 && nx <= 1.0 && ny >= 0.0 && ny <= 1.0 )
+                h = HeightFieldUtils::getHeightAtNormalizedLocation( grid.getHeightField(), nx, ny, INTERP_BILINEAR );
+            hf->setHeight( c, r, h );
+        }
+    }
+
+    double z = p.z();
+    if ( p.isRelative() )
+    {
+        float h = hf->getHeight( _resolution, _resolution );
+        if ( h == NO_DATA_VALUE )
+            return false;
+        z += (double)h;
+    }
+
+    return computeMask( hf.get(), extent, z, out_mask );
+}
+
+bool
+Viewshed::computeMask(const osg::HeightField* hf, const GeoExtent& extent, double observerZ, GeoImage& out_mask) const
+{
+    int      n    = (int)_resolution;
+    unsigned size = 2*_resolution + 1;
+
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage( size, size, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    image->setInternalTextureFormat( GL_LUMINANCE8 );
+    ::memset( image->data(), 0, image->getTotalSizeInBytes() );
+
+    // the observer sees its own cell.
+    image->data()[n*size + n] = 255;
+
+    // The cells on the edge of the grid, counterclockwise from the south-east corner.
+    std::vector< std::pair<int,int> > edge;
+    edge.reserve( 8*n );
+    for (int i = -n; i < n; ++i) edge.push_back( std::make_pair(n, i) );
+    for (int i = n; i > -n; --i) edge.push_back( std::make_pair(i, n) );
+    for (int i = n; i > -n; --i) edge.push_back( std::make_pair(-n, i) );
+    for (int i = -n; i < n; ++i) edge.push_back( std::make_pair(i, -n) );
+
+    double R = extent.getSRS()->getEllipsoid()->getRadiusEquator();
+
+    Sweep sweep;
+    sweep._hf           = hf;
+    sweep._mask         = image->data();
+    sweep._edge         = &edge;
+    sweep._n            = n;
+    sweep._observerZ    = observerZ;
+    sweep._cellSize     = _radius / (double)n;
+    sweep._targetHeight = _targetHeight;
+    sweep._curvature    = (1.0 - _refraction) / (2.0 * R);
+    sweep._radius       = _radius;
+
+    unsigned total      = edge.size();
+    unsigned numSectors = osg::minimum( _numThreads * 4u, total );
+
+    if ( _service.valid() && numSectors > 1 )
+    {
+        unsigned sectorSize = (total + numSectors - 1) / numSectors;
+        numSectors = (total + sectorSize - 1) / sectorSize;
+
+        Threading::MultiEvent semaphore( numSectors );
+        for (unsigned s = 0; s < numSectors; ++s)
+        {
+            ParallelTask<Sweep>* task = new ParallelTask<Sweep>( &semaphore );
+            static_cast<Sweep&>(*task) = sweep;
+            task->_first = s * sectorSize;
+            task->_last  = osg::minimum( total, (s + 1) * sectorSize );
+            _service->add( task );
+        }
+        semaphore.wait();
+    }
+    else
+    {
+        sweep._first = 0;
+        sweep._last  = total;
+        sweep.execute();
+    }
+
+    out_mask = GeoImage( image.get(), extent );
+    return true;
+}